@@ -0,0 +1,211 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Logger.h"
+
+class Cleaner;
+
+/**
+ * @brief What a job submitted to the agent does
+ */
+enum class JobKind : uint8_t {
+    Clean,      ///< Clean the targets
+    Analyze,    ///< Dry run over the targets
+    Backup,     ///< Back the targets up without cleaning
+    Restore     ///< Restore JobRequest::backupPath
+};
+
+/**
+ * @brief Cleaners a job covers, combined as bits of JobRequest::targets
+ */
+enum JobTarget : uint32_t {
+    kJobTemp = 1,
+    kJobBrowser = 2,
+    kJobRecycle = 4,
+    kJobRegistry = 8
+};
+
+/**
+ * @brief A job as submitted by a client; equal requests are coalesced
+ */
+struct JobRequest {
+    JobKind kind = JobKind::Clean;
+    uint32_t targets = 0;           ///< JobTarget bits, ignored by Restore
+    bool withBackup = false;        ///< Clean: back files up before deleting them
+    std::string backupPath;         ///< Restore: backup to restore
+
+    bool operator==(const JobRequest& other) const {
+        return kind == other.kind && targets == other.targets && withBackup == other.withBackup &&
+               backupPath == other.backupPath;
+    }
+};
+
+/**
+ * @brief Outcome of a job as reported to every client that submitted it
+ */
+struct JobResult {
+    bool success = false;
+    uint64_t jobId = 0;             ///< Agent-wide job number
+    bool coalesced = false;         ///< The request joined an equal job that was already queued
+    uint64_t filesDeleted = 0;      ///< Files deleted, or selected by an analysis
+    uint64_t bytesFreed = 0;
+    uint64_t errors = 0;
+    std::string message;            ///< Why the job failed, empty on success
+};
+
+/**
+ * @brief Encode a request as the payload of a submit message
+ */
+std::string encodeJobRequest(const JobRequest& request);
+
+/**
+ * @brief Decode a submit payload
+ * @return False if the payload is truncated or malformed
+ */
+bool decodeJobRequest(const std::string& payload, JobRequest& request);
+
+/**
+ * @brief Encode and decode the payload of a job's final message
+ *
+ * jobId and coalesced travel in the acceptance message instead.
+ */
+std::string encodeJobResult(const JobResult& result);
+bool decodeJobResult(const std::string& payload, JobResult& result);
+
+/**
+ * @brief Default endpoint of the agent
+ *
+ * A socket in $XDG_RUNTIME_DIR (or the temp directory, named after the
+ * user) on POSIX systems, \\.\pipe\cookiemonster on Windows.
+ */
+std::string defaultAgentEndpoint();
+
+/**
+ * @brief Counters of a running agent
+ */
+struct AgentStats {
+    uint64_t jobsRun = 0;           ///< Jobs handed to the runner
+    uint64_t jobsCoalesced = 0;     ///< Requests that joined an equal queued job
+    uint64_t queued = 0;            ///< Jobs waiting to run
+    uint64_t connections = 0;       ///< Clients accepted since start
+};
+
+/**
+ * @brief Resident agent that runs cleaning jobs for local clients
+ *
+ * Clients connect to a Unix domain socket (a named pipe on Windows) and
+ * exchange length-prefixed binary messages: a submit message carrying a
+ * JobRequest is answered with an acceptance, then the job's log lines as
+ * it runs, then its JobResult. Jobs run one at a time on a single worker,
+ * so the runner and the Cleaner behind it stay warm between jobs instead
+ * of being rebuilt by a new process for every run. A request equal to a
+ * job that is still queued joins that job: it runs once and every client
+ * receives its progress and result. A client that reads slowly loses log
+ * lines, never the result.
+ *
+ * The socket is created with owner-only permissions, since every job runs
+ * with the agent's privileges.
+ */
+class AgentServer {
+public:
+    /// Runs one job; may log through Logger to stream progress
+    using JobRunner = std::function<JobResult(const JobRequest&)>;
+
+    AgentServer(std::string endpoint, JobRunner runner);
+    ~AgentServer();
+
+    AgentServer(const AgentServer&) = delete;
+    AgentServer& operator=(const AgentServer&) = delete;
+
+    /**
+     * @brief Listen on the endpoint and start accepting jobs
+     * @param error Receives the reason on failure, e.g. another agent owning the endpoint
+     */
+    bool start(std::string& error);
+
+    /**
+     * @brief Block until a client asks the agent to shut down, or stop() is called
+     */
+    void wait();
+
+    /**
+     * @brief Finish the running job, fail the queued ones and close every connection
+     */
+    void stop();
+
+    AgentStats getStats() const;
+
+private:
+    struct Channel;
+    struct Job;
+    struct Connection;
+
+    void acceptLoop();
+    void serve(Connection& connection);
+    void workLoop();
+    std::shared_ptr<Job> submit(const JobRequest& request, const std::shared_ptr<Channel>& channel, bool& coalesced);
+    void requestShutdown();
+
+    std::string endpoint;
+    JobRunner runner;
+    intptr_t listener;
+    bool started = false;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::shared_ptr<Job>> queue;
+    std::list<std::unique_ptr<Connection>> connections;
+    bool shutdownRequested = false;
+    bool stopping = false;
+    uint64_t nextJobId = 1;
+    AgentStats stats;
+
+    std::mutex progressMutex;       ///< Guards current, taken by the log sink
+    std::shared_ptr<Job> current;
+
+    std::thread acceptor;
+    std::thread worker;
+};
+
+/**
+ * @brief Client side of the agent protocol, one connection per call
+ */
+class AgentClient {
+public:
+    explicit AgentClient(std::string endpoint);
+
+    /**
+     * @brief Submit a job and wait for its result
+     * @param onProgress Receives the job's log lines as they arrive, may be null
+     * @param result Receives the outcome, including the job id
+     * @param error Receives the reason if the agent cannot be reached or hangs up
+     * @return False if no result arrived
+     */
+    bool submit(const JobRequest& request, const std::function<void(LogLevel, const std::string&)>& onProgress,
+                JobResult& result, std::string& error);
+
+    /**
+     * @brief Ask the agent to exit once its running job finished
+     *
+     * Returns when the agent closes the connection, i.e. when it stops.
+     */
+    bool shutdown(std::string& error);
+
+private:
+    std::string endpoint;
+};
+
+/**
+ * @brief Runner executing jobs with a long-lived Cleaner
+ *
+ * Statistics are reset before every job, so each result covers only its
+ * own job, and the cleaners' statistics are logged (and streamed) after it.
+ */
+AgentServer::JobRunner makeCleanerJobRunner(Cleaner& cleaner);
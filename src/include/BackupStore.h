@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "CleaningEngine.h"
+
+class RunJournal;
+
+/**
+ * @brief How files are preserved when cleaning with a backup
+ */
+enum class BackupMode {
+    None,           ///< Delete without keeping a copy
+    Copy,           ///< Copy into the backup directory, then delete
+    Quarantine      ///< Move into the backup directory; copy and delete across devices
+};
+
+/**
+ * @brief Where a file is kept inside a backup directory
+ *
+ * The source path is mirrored below the directory, with the root name (a
+ * drive or server) as its first component, so files of the same name from
+ * different directories never share a target.
+ */
+std::filesystem::path backupLocation(const std::filesystem::path& directory, const std::filesystem::path& source);
+
+/**
+ * @brief Copy a file to its backup location without replacing an existing backup
+ *
+ * A target that already holds the same contents counts as copied, so an
+ * interrupted backup can be resumed.
+ *
+ * @param ec Set to file_exists if the target holds a different file
+ */
+bool copyToBackup(const std::filesystem::path& source, const std::filesystem::path& target, std::error_code& ec);
+
+/**
+ * @brief Backup directory filled file by file during a fused backup-and-clean pass
+ *
+ * Each file is stored at backupLocation(), the layout restoreFromBackup()
+ * expects. An existing backup is never replaced: a file whose target is
+ * taken is stored only if the target already holds the same contents, as it
+ * does for files preserved by an interrupted attempt of the run, and is kept
+ * otherwise. Every stored file is recorded in the run journal; copy()
+ * returns only after that record is durable, so a file is never deleted
+ * before its backup is on record. All methods are thread-safe.
+ */
+class BackupStore {
+public:
+    /**
+     * @param directory Existing backup directory
+     * @param journal Journal of the active run, nullptr if not journaling
+     * @param alreadyBackedUp Source paths stored by an earlier attempt of the run
+     */
+    BackupStore(std::filesystem::path directory, RunJournal* journal,
+                const std::vector<std::string>& alreadyBackedUp);
+
+    /**
+     * @brief Copy a file into the store
+     * @param entry File to preserve
+     * @return False if the copy or its journal record failed, or the target
+     *         holds a different file
+     */
+    bool copy(const FileEntry& entry);
+
+    /**
+     * @brief Move a file into the store by renaming it
+     *
+     * The rename is the deletion, so nothing is left to remove afterwards.
+     *
+     * @param entry File to preserve
+     * @return False, with the file untouched, if it cannot be renamed (e.g.
+     *         it lives on another device) or its target already exists
+     */
+    bool moveIn(const FileEntry& entry);
+
+    const std::filesystem::path& getDirectory() const { return directory; }
+
+    /**
+     * @brief Source paths stored by this store, excluding alreadyBackedUp
+     */
+    std::vector<std::string> getFiles() const;
+    uint64_t getTotalSize() const;
+
+private:
+    void record(const std::string& source, uint64_t size);
+
+    std::filesystem::path directory;
+    RunJournal* journal;
+    std::unordered_set<std::string> stored;
+    std::vector<std::string> files;
+    uint64_t totalSize = 0;
+    mutable std::mutex mutex;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief Append an unsigned LEB128 varint
+ * @param out Buffer to append to
+ * @param value Value to encode
+ */
+void appendVarint(std::string& out, uint64_t value);
+
+/**
+ * @brief Append a little-endian 32-bit integer
+ * @param out Buffer to append to
+ * @param value Value to encode
+ */
+void appendU32(std::string& out, uint32_t value);
+
+/**
+ * @brief Append a little-endian 64-bit integer
+ * @param out Buffer to append to
+ * @param value Value to encode
+ */
+void appendU64(std::string& out, uint64_t value);
+
+/**
+ * @brief Append a big-endian (network order) 32-bit integer
+ * @param out Buffer to append to
+ * @param value Value to encode
+ */
+void appendU32BE(std::string& out, uint32_t value);
+
+/**
+ * @brief Compute the CRC-32 (IEEE 802.3) of a buffer
+ * @param data Start of the buffer
+ * @param length Number of bytes
+ * @return Checksum of the buffer
+ */
+uint32_t crc32(const void* data, size_t length);
+
+/**
+ * @brief Replace a file atomically with new contents
+ *
+ * The contents go to a temporary file next to the target, are flushed to
+ * disk and only then renamed over the target, so readers and crashes see
+ * either the old or the new file, never a partial one. The temporary file
+ * is removed when any step fails.
+ * @param path File to replace
+ * @param content New contents
+ * @param temp Temporary file, path with ".tmp" appended when empty
+ * @return true if the target now holds the new contents
+ */
+bool writeFileAtomically(const std::filesystem::path& path, const std::string& content,
+                         const std::filesystem::path& temp = {});
+
+/**
+ * @brief Bounds-checked sequential reader over an encoded buffer
+ *
+ * Every read fails instead of running past the end, so truncated or corrupt
+ * input is detected by the caller checking the return values.
+ */
+class ByteReader {
+public:
+    ByteReader(const void* data, size_t size, size_t offset = 0);
+
+    bool readByte(uint8_t& value);
+    bool readVarint(uint64_t& value);
+    bool readU32(uint32_t& value);
+    bool readU64(uint64_t& value);
+    bool readU32BE(uint32_t& value);
+    bool readBytes(size_t count, std::string& out);
+
+    size_t getPosition() const { return pos; }
+    size_t remaining() const { return size - pos; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+};
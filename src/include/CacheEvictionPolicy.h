@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief Which browser cache entries to evict
+ *
+ * Entries unused for more than maxAgeDays go first, then the least valuable
+ * remaining entries (least recently used, or lowest frecency for Firefox)
+ * until the cache fits maxBytes.
+ */
+struct CacheEvictionPolicy {
+    int maxAgeDays = 0;             ///< Evict entries unused for longer than this, 0 for no age limit
+    uint64_t maxBytes = std::numeric_limits<uint64_t>::max();  ///< Size budget for what stays cached
+
+    bool isSet() const { return maxAgeDays > 0 || maxBytes != std::numeric_limits<uint64_t>::max(); }
+};
@@ -2,97 +2,36 @@
 #include <string>
 #include <vector>
 #include <iostream>
-#include <windows.h>
-#include <shlobj.h>
 #include <fstream>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
 #include <memory>
 #include <mutex>
+#include <filesystem>
+#include <optional>
+#include <unordered_set>
+#include "Logger.h"
+#include "IoThrottle.h"
+#include "BackupStore.h"
+#include "CleaningEngine.h"
+#include "CleaningKernel.h"
+#include "DeletionPlan.h"
+#include "FileTypeFilter.h"
+#include "FirefoxCache.h"
+#include "ProfileDiscovery.h"
+#include "RuleSet.h"
+#include "RunJournal.h"
+#include "SecureErase.h"
+#include "SimpleCache.h"
+#include "RegistryBackend.h"
+#include "RegistrySnapshot.h"
+#include "TrashBin.h"
 
-/**
- * @brief Logging levels for the application
- */
-enum class LogLevel {
-    DEBUG,   ///< Debug information
-    INFO,    ///< General information
-    WARNING, ///< Warning messages
-    ERROR    ///< Error messages
-};
-
-/**
- * @brief Singleton logger class for the application
- */
-class Logger {
-private:
-    std::ofstream logFile;
-    bool consoleOutput;
-    static std::unique_ptr<Logger> instance;
-    static std::mutex mutex;
-
-    Logger() : consoleOutput(true) {
-        auto now = std::chrono::system_clock::now();
-        auto time = std::chrono::system_clock::to_time_t(now);
-        std::stringstream ss;
-        ss << "cookiemonster_" << std::put_time(std::localtime(&time), "%Y%m%d_%H%M%S") << ".log";
-        logFile.open(ss.str(), std::ios::app);
-    }
-
-public:
-    /**
-     * @brief Get the singleton instance of the logger
-     * @return Reference to the logger instance
-     */
-    static Logger& getInstance() {
-        std::lock_guard<std::mutex> lock(mutex);
-        if (!instance) {
-            instance = std::make_unique<Logger>();
-        }
-        return *instance;
-    }
-
-    /**
-     * @brief Log a message with specified level
-     * @param level Logging level
-     * @param message Message to log
-     */
-    void log(LogLevel level, const std::string& message) {
-        std::string levelStr;
-        switch (level) {
-            case LogLevel::DEBUG: levelStr = "DEBUG"; break;
-            case LogLevel::INFO: levelStr = "INFO"; break;
-            case LogLevel::WARNING: levelStr = "WARNING"; break;
-            case LogLevel::ERROR: levelStr = "ERROR"; break;
-        }
-
-        auto now = std::chrono::system_clock::now();
-        auto time = std::chrono::system_clock::to_time_t(now);
-        std::stringstream ss;
-        ss << "[" << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") << "] "
-           << "[" << levelStr << "] " << message;
-
-        if (consoleOutput) {
-            std::cout << ss.str() << std::endl;
-        }
-        logFile << ss.str() << std::endl;
-        logFile.flush();
-    }
-
-    /**
-     * @brief Enable or disable console output
-     * @param enable True to enable console output, false to disable
-     */
-    void setConsoleOutput(bool enable) {
-        consoleOutput = enable;
-    }
-
-    ~Logger() {
-        if (logFile.is_open()) {
-            logFile.close();
-        }
-    }
-};
+#ifdef _WIN32
+#include <windows.h>
+#include <shlobj.h>
+#endif
 
 /**
  * @brief Statistics for temporary files cleaning
@@ -101,6 +40,9 @@ struct TempFilesStats {
     int filesDeleted = 0;           ///< Number of files deleted
     int errors = 0;                 ///< Number of errors encountered
     uint64_t bytesFreed = 0;        ///< Total size of freed space in bytes
+    uint64_t physicalBytesFreed = 0;  ///< Allocated disk space actually reclaimed
+    int filesInUse = 0;             ///< Files skipped because another process held them open
+    int directoriesRemoved = 0;     ///< Directories removed after their contents were cleaned
     std::vector<std::string> errorMessages;  ///< List of error messages
 };
 
@@ -111,6 +53,9 @@ struct RecycleBinStats {
     int filesDeleted = 0;           ///< Number of files deleted
     int errors = 0;                 ///< Number of errors encountered
     uint64_t bytesFreed = 0;        ///< Total size of freed space in bytes
+    uint64_t physicalBytesFreed = 0;  ///< Allocated disk space actually reclaimed
+    int filesInUse = 0;             ///< Files skipped because another process held them open
+    int directoriesRemoved = 0;     ///< Directories removed after their contents were cleaned
     std::vector<std::string> errorMessages;  ///< List of error messages
 };
 
@@ -121,10 +66,30 @@ struct BrowserCacheStats {
     int filesDeleted = 0;           ///< Number of files deleted
     int errors = 0;                 ///< Number of errors encountered
     uint64_t bytesFreed = 0;        ///< Total size of freed space in bytes
+    uint64_t physicalBytesFreed = 0;  ///< Allocated disk space actually reclaimed
+    int filesInUse = 0;             ///< Files skipped because another process held them open
+    int directoriesRemoved = 0;     ///< Directories removed after their contents were cleaned
     std::string browserName;        ///< Name of the browser
     std::vector<std::string> errorMessages;  ///< List of error messages
 };
 
+/**
+ * @brief Statistics for one rule of a rule file
+ */
+struct RuleStats {
+    int filesDeleted = 0;           ///< Number of files deleted
+    int errors = 0;                 ///< Number of errors encountered
+    uint64_t bytesFreed = 0;        ///< Total size of freed space in bytes
+    uint64_t physicalBytesFreed = 0;  ///< Allocated disk space actually reclaimed
+    int filesInUse = 0;             ///< Files skipped because another process held them open
+    int directoriesRemoved = 0;     ///< Directories removed after their contents were cleaned
+    int filesReported = 0;          ///< Files selected by a report rule
+    uint64_t bytesReported = 0;     ///< Total size of the reported files
+    int filesProtected = 0;         ///< Matches kept because the file type filter protects them
+    std::string ruleName;           ///< Name of the rule
+    std::vector<std::string> errorMessages;  ///< List of error messages
+};
+
 /**
  * @brief Statistics for registry cleaning
  */
@@ -135,6 +100,16 @@ struct RegistryStats {
     std::vector<std::string> errorMessages;  ///< List of error messages
 };
 
+/**
+ * @brief Totals over every cleaner's statistics
+ */
+struct CleaningSummary {
+    int filesDeleted = 0;           ///< Files deleted, or selected by a dry run
+    uint64_t bytesFreed = 0;        ///< Total size of those files in bytes
+    int registryEntriesDeleted = 0; ///< Registry keys and values deleted
+    int errors = 0;                 ///< Errors of every cleaner
+};
+
 /**
  * @brief Information about a backup operation
  */
@@ -142,8 +117,8 @@ struct BackupInfo {
     std::string timestamp;          ///< Backup creation timestamp
     std::string operationType;      ///< Type of operation ("temp", "registry", "browser", "recycle")
     std::string backupPath;         ///< Path to backup files
-    uint64_t totalSize;             ///< Total size of backup in bytes
-    std::vector<std::string> files; ///< List of backed up files
+    uint64_t totalSize = 0;         ///< Total size of backup in bytes
+    std::vector<std::string> files; ///< Source paths of the backed up files, in UTF-8
     std::vector<std::pair<std::string, std::string>> registryKeys;  ///< List of backed up registry keys
 };
 
@@ -160,25 +135,76 @@ public:
     bool cleanBrowserCache(bool dryRun = false);
     bool cleanRecycleBin(bool dryRun = false);
     bool cleanRegistry(bool dryRun = false);
+    bool cleanRules(const RulePlan& plan, bool dryRun = false);
 
     // Browser-specific cleaning functions
-    bool cleanChromiumCache(bool dryRun = false);  // For Chrome and Edge
+    bool cleanChromiumCache(bool dryRun = false);  // For Chrome, Edge and Chromium
     bool cleanFirefoxCache(bool dryRun = false);
     bool cleanOperaCache(bool dryRun = false);
     bool cleanBraveCache(bool dryRun = false);
     bool cleanVivaldiCache(bool dryRun = false);
+    void setCacheEvictionPolicy(int maxAgeDays, uint64_t maxBytes);
+    void setAllUsers(bool enable);
+    void setUserHomes(const std::vector<std::filesystem::path>& homes);
 
     // Utility functions
     bool isAdmin() const;
     void showStatistics() const;
+    CleaningSummary getSummary() const;
+    std::vector<RuleStats> getRuleStats() const;
+    void resetStatistics();
     std::string formatSize(uint64_t bytes) const;
     std::vector<std::wstring> getTempDirectories() const;
     bool deleteFile(const std::string& path, bool dryRun = false);
-    void setExcludedPaths(const std::vector<std::wstring>& paths);
-    void setIncludedPaths(const std::vector<std::wstring>& paths);
+    void setExcludedPaths(const std::vector<std::filesystem::path>& paths);
+    void setIncludedPaths(const std::vector<std::filesystem::path>& paths);
+
+    // I/O throttling functions
+    void setIoLimits(uint64_t maxOpsPerSecond, uint64_t maxBytesPerSecond);
+    void setAdaptiveThrottle(bool enable);
+    bool enableIdleIoPriority();
+
+    // Parallel engine functions
+    void setStorageConcurrency(StorageType type, size_t threads);
+    bool setStorageType(const std::filesystem::path& path, StorageType type);
+    void setMaxThreads(int threads);
+    int getMaxThreads() const;
+    void setBatchSize(int size);
+    int getBatchSize() const;
+    void setAutotune(bool enable);
+    void setOpenFileCheck(bool enable);
+    void setOpenFileRetries(int retries, int delayMs);
+    void setFollowSymlinks(bool enable);
+    bool isFollowingSymlinks() const;
+    void setMaxScanDepth(int depth);
+    int getMaxScanDepth() const;
+    void setSameFileSystem(bool enable);
+    void setAsyncIo(bool enable);
+    void setFileSystem(std::shared_ptr<FileSystemBackend> fileSystem);
+    void setSecureErase(bool enable);
+
+    // File type filtering functions
+    void setExcludedFileTypes(const std::vector<std::string>& types);
+    std::vector<std::string> getExcludedFileTypes() const;
+    void setAllowedFileTypes(const std::vector<std::string>& types);
+    void setFileTypeSniffing(bool enable);
+    bool isFileTypeAllowed(const std::filesystem::path& path) const;
+
+    // Deletion plan functions
+    bool startPlan(const std::string& planPath);
+    bool finishPlan();
+    bool executePlan(const std::string& planPath);
+
+    // Journal functions
+    bool enableJournal(const std::string& journalPath);
+
+    // Recycle bin functions
+    void setTrashPolicy(int maxAgeDays, uint64_t maxBytes);
+    void setTrashDirectories(const std::vector<std::wstring>& paths);
 
     // Registry cleaning functions
-    bool cleanRegistryKey(HKEY hKey, const std::wstring& subKey, bool dryRun = false);
+    void setRegistryBackend(std::unique_ptr<RegistryBackend> backend);
+    bool cleanRegistryKey(RegistryRoot root, const std::wstring& subKey, bool dryRun = false);
     std::vector<std::wstring> getObsoleteRegistryKeys() const;
 
     // Backup and restore functions
@@ -192,33 +218,70 @@ public:
     bool cleanRegistryWithBackup(bool dryRun = false);
     bool cleanBrowserCacheWithBackup(bool dryRun = false);
     bool cleanRecycleBinWithBackup(bool dryRun = false);
+    void setBackupMode(BackupMode mode);
 
 private:
     // Helper methods
-    bool deleteDirectory(const std::wstring& path, bool dryRun = false);
-    std::wstring getLocalAppData() const;
-    std::vector<std::wstring> getBrowserPaths() const;
-    bool isPathExcluded(const std::wstring& path) const;
-    bool isPathIncluded(const std::wstring& path) const;
+    bool deleteDirectory(const std::filesystem::path& path, bool dryRun = false);
+    std::vector<BrowserProfile> discoverBrowserProfiles() const;
+    std::vector<std::filesystem::path> getBrowserPaths() const;
+    bool isPathExcluded(const std::filesystem::path& path) const;
+    bool isPathIncluded(const std::filesystem::path& path) const;
+    bool removeFile(const std::filesystem::path& path, uint64_t size);
+    KernelContext makeKernelContext(bool dryRun, bool recordPlan);
+    CleaningEngine::EntryHandler makeEntryHandler(bool dryRun, bool recordPlan = true);
+    std::vector<EngineResult> runKernel(const std::vector<std::vector<std::filesystem::path>>& rootSets,
+                                        bool recursive, bool dryRun,
+                                        const std::function<void(const FileEntry&)>& observer = nullptr);
+    CleaningEngine::DirectoryHandler makeDirectoryHandler(bool dryRun);
+    EngineResult cleanPaths(const std::vector<std::wstring>& paths, bool recursive, bool dryRun);
+    EngineResult evictChromiumCache(const std::vector<std::filesystem::path>& paths, bool dryRun);
+    EngineResult evictFirefoxCache(const std::vector<std::filesystem::path>& paths, bool dryRun);
+    void beginPlanSection(PlanSection kind, const std::string& name);
+    bool beginJournalRun(const std::string& operation);
+    void endJournalRun(bool finished);
+    bool cleanBrowsers(const std::vector<std::string>& names, bool dryRun);
     void logError(const std::string& operation, const std::string& error);
     
     TempFilesStats tempStats;
     RecycleBinStats recycleBinStats;
     std::vector<BrowserCacheStats> browserStats;
-    std::vector<std::wstring> excludedPaths;
-    std::vector<std::wstring> includedPaths;
+    std::vector<RuleStats> ruleStats;
+    std::vector<std::filesystem::path> excludedPaths;
+    std::vector<std::filesystem::path> includedPaths;
     RegistryStats registryStats;
+    IoThrottle ioThrottle;
+    CleaningEngine engine;
+    std::unique_ptr<PlanWriter> planWriter;
+    std::unique_ptr<RunJournal> journal;
+    std::optional<JournalRun> interruptedRun;
+    std::optional<JournalRun> currentRun;
+    std::unique_ptr<RegistryBackend> registry;
+    TrashPurgePolicy trashPolicy;
+    CacheEvictionPolicy cachePolicy;            ///< Partial eviction instead of wiping caches when set
+    std::vector<std::filesystem::path> trashDirectories;  ///< Overrides trash discovery when not empty
+    bool allUsers = false;                      ///< Clean the browser profiles of every account on the host
+    std::vector<std::filesystem::path> userHomes;  ///< Overrides user discovery when not empty
+    BackupMode backupMode = BackupMode::Copy;   ///< How *WithBackup preserves files
+    bool asyncIo = false;                       ///< Scan and delete through an asynchronous I/O executor
+    std::unique_ptr<BackupStore> fusedBackup;   ///< Set while a fused backup-and-clean pass runs
+    std::unique_ptr<SecureEraser> eraser;       ///< Overwrites files before deletion when set
+    FileTypeFilter fileTypes;                   ///< Protects executables and documents by default
     
     // Registry helper methods
-    bool deleteRegistryKey(HKEY hKey, const std::wstring& subKey, bool dryRun = false);
-    bool deleteRegistryValue(HKEY hKey, const std::wstring& subKey, const std::wstring& valueName, bool dryRun = false);
+    void registryError(const std::string& error);
 
     // Backup helper methods
     std::string generateBackupPath(const std::string& operationType) const;
-    bool backupFile(const std::string& sourcePath, const std::string& backupPath);
-    bool backupRegistryKey(HKEY hKey, const std::wstring& subKey, const std::string& backupPath);
-    bool restoreFile(const std::string& backupPath, const std::string& targetPath);
-    bool restoreRegistryKey(const std::string& backupPath, HKEY hKey, const std::wstring& subKey);
+    BackupInfo beginBackup(const std::string& operationType);
+    bool cleanWithBackup(const std::string& operationType, bool dryRun, bool (Cleaner::*clean)(bool));
+    bool backupFile(const std::filesystem::path& sourcePath, const std::filesystem::path& backupPath);
+    void backupTree(const std::filesystem::path& root, BackupInfo& backup, std::unordered_set<std::string>& backedUp);
+    void addBackupToHistory(const BackupInfo& backup);
+    bool restoreFile(const std::filesystem::path& backupPath, const std::filesystem::path& targetPath);
+    bool backupRegistryKey(RegistryRoot root, const std::wstring& subKey, const std::string& backupPath);
+    bool restoreRegistryKey(const std::string& backupPath, const std::wstring& subKey);
+    std::filesystem::path registrySnapshotPath(const std::string& backupPath, const std::wstring& subKey) const;
     
     std::vector<BackupInfo> backupHistory;
 }; 
\ No newline at end of file
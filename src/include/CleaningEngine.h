@@ -0,0 +1,339 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "FileSystemBackend.h"
+#include "StorageInfo.h"
+
+/**
+ * @brief A regular file discovered during a scan
+ */
+struct FileEntry {
+    std::filesystem::path path;     ///< Full path of the file
+    uint64_t size = 0;              ///< Logical size in bytes
+    uint64_t allocated = 0;         ///< Bytes allocated on disk
+    uint32_t links = 1;             ///< Number of hard links to the file
+    uint64_t device = 0;            ///< Device the file lives on
+    uint64_t inode = 0;             ///< Inode number, 0 where unavailable
+    int64_t mtime = 0;              ///< Modification time in platform ticks
+    size_t directory = 0;           ///< Scan-local index of the parent directory, 0 if untracked
+    uint32_t rootSet = 0;           ///< Index of the root set the entry was found under
+};
+
+/**
+ * @brief Fill an entry from the file system metadata of a path
+ *
+ * Symlinks are not followed. On Windows the device is left untouched, the
+ * inode stays 0 and the allocation is the compressed/sparse size.
+ *
+ * @param path File to inspect
+ * @param entry Receives path, sizes, link count, device, inode and mtime
+ * @return False if the path cannot be inspected
+ */
+bool statFileEntry(const std::filesystem::path& path, FileEntry& entry);
+
+/**
+ * @brief Aggregated outcome of an engine run
+ */
+struct EngineResult {
+    int filesDeleted = 0;           ///< Number of entries the handler accepted
+    int errors = 0;                 ///< Number of errors encountered
+    uint64_t bytesFreed = 0;        ///< Logical size of accepted entries, hardlinks counted once
+    uint64_t physicalBytesFreed = 0;  ///< Allocated space released by the accepted entries
+    int filesInUse = 0;             ///< Entries left alone because another process held them open
+    int directoriesRemoved = 0;     ///< Emptied directories the directory handler removed
+    int directoriesSkipped = 0;     ///< Directories not entered: seen before, too deep or on another device
+    std::vector<std::string> errorMessages;  ///< List of error messages
+};
+
+class IoExecutor;
+class OpenFileIndex;
+class SpaceAccounting;
+
+/**
+ * @brief Parallel cleaning engine with one worker pool per device
+ *
+ * Roots are scanned, the discovered files are grouped by the device they
+ * live on, and every device gets an independent worker pool sized for its
+ * storage type. Rotational devices process their files in inode order to
+ * keep the head moving in one direction.
+ *
+ * Files held open by another process are not handed to the handler. They
+ * go to a deferred queue that is retried with exponential backoff and, if
+ * still open after the last attempt, are counted in filesInUse rather than
+ * as errors.
+ */
+class CleaningEngine {
+public:
+    /**
+     * @brief Callback invoked for every discovered file on a worker thread
+     *
+     * Returns true if the entry was processed (deleted, or would be in a dry
+     * run) and false if it was skipped. Exceptions are counted as errors.
+     */
+    using EntryHandler = std::function<bool(const FileEntry&)>;
+
+    /**
+     * @brief Callback invoked on a worker thread for a directory whose children are all gone
+     *
+     * Returns true if the directory was removed (or would be in a dry run),
+     * which releases it from its parent's child count.
+     */
+    using DirectoryHandler = std::function<bool(const std::filesystem::path&)>;
+
+    /**
+     * @brief Completion of an asynchronous entry handler, called exactly once
+     *
+     * Reports true if the entry was processed, or the error that stopped it;
+     * both are counted like the return value and exceptions of an EntryHandler.
+     */
+    using EntryCompletion = std::function<void(bool handled, std::exception_ptr error)>;
+
+    /**
+     * @brief Entry handler that starts its I/O on an executor and completes later
+     *
+     * Runs, like its completion, on the thread driving the executor.
+     */
+    using AsyncEntryHandler = std::function<void(const FileEntry&, IoExecutor&, EntryCompletion)>;
+
+    CleaningEngine();
+
+    /**
+     * @brief Set the number of worker threads used for a storage type
+     * @param type Storage type
+     * @param threads Thread count, 0 restores the default
+     */
+    void setConcurrency(StorageType type, size_t threads);
+    size_t getConcurrency(StorageType type) const;
+
+    /**
+     * @brief Override storage type detection for the device holding a path
+     * @param path Existing path on the device
+     * @param type Storage type to assume
+     * @return False if the device of the path cannot be determined
+     */
+    bool setStorageType(const std::filesystem::path& path, StorageType type);
+
+    /**
+     * @brief Set the number of entries handed to a worker at once
+     * @param size Batch size, values below 1 are clamped to 1
+     */
+    void setBatchSize(size_t size);
+    size_t getBatchSize() const;
+
+    /**
+     * @brief Set the upper bound on worker threads per device
+     * @param threads Thread limit, 0 restores the default
+     */
+    void setMaxThreads(size_t threads);
+    size_t getMaxThreads() const;
+
+    /**
+     * @brief Let a feedback controller resize each device pool at runtime
+     *
+     * When enabled every pool starts at its storage-type default and is
+     * adjusted between 1 and getMaxThreads() from the measured files/sec and
+     * operation latency. Every change is logged.
+     *
+     * @param enable True to enable the autotuner
+     */
+    void setAutotune(bool enable);
+    bool isAutotuneEnabled() const;
+
+    /**
+     * @brief Skip files that running processes hold open
+     *
+     * Enabled by default. The open-file index is built once per run and
+     * rebuilt only before each retry of the deferred queue.
+     *
+     * @param enable False to hand every file to the handler
+     */
+    void setOpenFileCheck(bool enable);
+    bool isOpenFileCheckEnabled() const;
+
+    /**
+     * @brief Descend into symlinked directories during recursive scans
+     *
+     * Disabled by default. Every directory is identified by its (device,
+     * inode) pair, so a link back into the tree or to a directory that is
+     * also reached another way is walked once per root. Directories entered
+     * through a link are never removed by the directory handler, and neither
+     * are their parents. Below a world-writable root such as /tmp, or in a
+     * world-writable directory, anyone may have planted a link, so a link is
+     * only followed if its owner is root or also owns the target.
+     *
+     * @param enable True to follow symlinks to directories
+     */
+    void setFollowSymlinks(bool enable);
+    bool isFollowingSymlinks() const;
+
+    /**
+     * @brief Limit how many directory levels below a root are scanned
+     * @param depth Levels below the root, 0 restores the default
+     */
+    void setMaxDepth(size_t depth);
+    size_t getMaxDepth() const;
+
+    /**
+     * @brief Stay on the device of each root, like find -xdev
+     * @param enable True to skip directories on other devices
+     */
+    void setSameFileSystem(bool enable);
+    bool isSameFileSystem() const;
+
+    /**
+     * @brief Scan through another file system, e.g. a MemoryFileSystem
+     *
+     * Only the scan goes through the backend; handlers delete files
+     * themselves and should use getFileSystem() as well.
+     *
+     * @param backend File system to use, nullptr for the native one
+     */
+    void setFileSystem(std::shared_ptr<FileSystemBackend> backend);
+    FileSystemBackend& getFileSystem() const;
+
+    /**
+     * @brief Configure retries of files that were open
+     * @param retries Number of retry rounds, 0 reports them immediately
+     * @param delay Wait before the first retry, doubled for every further round
+     */
+    void setOpenFileRetries(size_t retries, std::chrono::milliseconds delay);
+    size_t getOpenFileRetries() const;
+
+    /**
+     * @brief Scan roots and run the handler on every regular file found
+     *
+     * With a directory handler on a recursive scan, every directory gets a
+     * counter of the children seen during the scan. Each accepted file
+     * decrements its directory's counter; a directory that reaches zero is
+     * handed to the directory handler and, if removed, decrements its parent
+     * in turn. Directories are thus pruned bottom-up in parallel without a
+     * second walk. Roots themselves are never pruned, and directories that
+     * were already empty before the run are left alone.
+     *
+     * @param roots Directories to scan, missing ones are skipped
+     * @param recursive True to descend into subdirectories
+     * @param handler Callback run for every file
+     * @param directoryHandler Optional callback run for every emptied directory
+     * @return Aggregated statistics of the run
+     */
+    EngineResult run(const std::vector<std::filesystem::path>& roots, bool recursive,
+                     const EntryHandler& handler, const DirectoryHandler& directoryHandler = nullptr);
+
+    /**
+     * @brief Scan several sets of roots as one job set with per-set statistics
+     *
+     * All sets are scanned up front and their files share the same device
+     * pools, so many small sets (e.g. the caches of every browser profile on
+     * a host) are processed in one parallel pass. Each file is accounted to
+     * the set it was found under; a hardlink reachable from two sets is
+     * counted in both.
+     *
+     * @param rootSets Sets of directories to scan, see run()
+     * @param recursive True to descend into subdirectories
+     * @param handler Callback run for every file, FileEntry::rootSet tells the set
+     * @param directoryHandler Optional callback run for every emptied directory
+     * @return One result per set, in the order of rootSets
+     */
+    std::vector<EngineResult> runSets(const std::vector<std::vector<std::filesystem::path>>& rootSets,
+                                      bool recursive, const EntryHandler& handler,
+                                      const DirectoryHandler& directoryHandler = nullptr);
+
+    /**
+     * @brief Scan and clean like runSets(), with all I/O on one executor
+     *
+     * Directory reads, stats and the handler's operations are started without
+     * waiting for each other, thousands at a time, and their completions are
+     * handled on the calling thread. This suits high-latency storage such as
+     * network-mounted profiles, where a thread per blocking call does not
+     * scale. Device pools, inode ordering and the autotuner do not apply; the
+     * open-file check, retries and directory pruning do.
+     *
+     * @param rootSets Sets of directories to scan, see run()
+     * @param recursive True to descend into subdirectories
+     * @param handler Callback starting the work for every file
+     * @param directoryHandler Optional callback run for every emptied directory
+     * @return One result per set, in the order of rootSets
+     */
+    std::vector<EngineResult> runSetsAsync(const std::vector<std::vector<std::filesystem::path>>& rootSets,
+                                           bool recursive, const AsyncEntryHandler& handler,
+                                           const DirectoryHandler& directoryHandler = nullptr);
+
+    /**
+     * @brief Run the handler on a known set of entries without scanning
+     * @param entries Entries to process, grouped by their device field
+     * @param handler Callback run for every entry
+     * @return Aggregated statistics of the run
+     */
+    EngineResult runEntries(std::vector<FileEntry> entries, const EntryHandler& handler);
+
+private:
+    struct DeviceGroup {
+        StorageType type = StorageType::Unknown;
+        std::vector<FileEntry> entries;
+    };
+
+    struct DeviceRun;
+    struct DirectoryTable;
+    struct AsyncScan;
+    using VisitedSet = std::unordered_set<FileId, FileId::Hash>;
+
+    /// How a scan treats a child directory
+    enum class Descent {
+        Skip,
+        Enter,
+        Follow      ///< Entered through a symlink, never pruned
+    };
+
+    /// Processes one round of groups, deferring open files; the tally spans every round
+    using Dispatcher = std::function<void(std::map<uint64_t, DeviceGroup>&, const OpenFileIndex*,
+                                          SpaceAccounting&, std::vector<FileEntry>&)>;
+
+    void tune(DeviceRun& run, double seconds);
+
+    void scanRoot(const std::filesystem::path& root, bool recursive, uint32_t rootSet,
+                  std::map<uint64_t, DeviceGroup>& groups, DirectoryTable* directories,
+                  EngineResult& result);
+    void listAsync(IoExecutor& io, const std::shared_ptr<AsyncScan>& scan,
+                   const std::filesystem::path& directory, size_t node, size_t depth);
+    Descent descend(const DirectoryItem& item, FileType target, size_t depth, uint64_t rootDevice,
+                    bool sharedRoot, VisitedSet& visited, EngineResult& result);
+    bool isSharedRoot(const std::filesystem::path& root) const;
+    bool isTrustedLink(const std::filesystem::path& link, bool sharedRoot) const;
+    void addToGroup(std::map<uint64_t, DeviceGroup>& groups, FileEntry&& entry,
+                    const std::filesystem::path* sample);
+    void process(std::map<uint64_t, DeviceGroup>& groups, const Dispatcher& dispatcher,
+                 std::vector<EngineResult>& results);
+    void dispatch(std::map<uint64_t, DeviceGroup>& groups, const EntryHandler& handler,
+                  DirectoryTable* directories, const DirectoryHandler& directoryHandler,
+                  const OpenFileIndex* openFiles, SpaceAccounting& accounting,
+                  std::vector<FileEntry>& deferred, std::vector<EngineResult>& results);
+    void dispatchAsync(IoExecutor& io, std::map<uint64_t, DeviceGroup>& groups, const AsyncEntryHandler& handler,
+                       DirectoryTable* directories, const DirectoryHandler& directoryHandler,
+                       const OpenFileIndex* openFiles, SpaceAccounting& accounting,
+                       std::vector<FileEntry>& deferred, std::vector<EngineResult>& results);
+    StorageType resolveStorageType(uint64_t device, const std::filesystem::path& sample);
+    size_t threadsFor(StorageType type) const;
+
+    std::map<StorageType, size_t> concurrency;
+    std::map<uint64_t, StorageType> storageTypes;   ///< Overridden or cached per device
+    size_t batchSize;
+    size_t maxThreads;
+    bool autotune;
+    bool openFileCheck;
+    size_t openFileRetries;
+    std::chrono::milliseconds openFileDelay;
+    bool followSymlinks;
+    size_t maxDepth;
+    bool sameFileSystem;
+    std::shared_ptr<FileSystemBackend> fileSystem;  ///< Native file system when null
+    mutable std::mutex mutex;
+};
@@ -0,0 +1,265 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "BackupStore.h"
+#include "CleaningEngine.h"
+#include "DeletionPlan.h"
+#include "FileTypeFilter.h"
+#include "IoExecutor.h"
+#include "IoThrottle.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "PathArena.h"
+#include "RunJournal.h"
+#include "SecureErase.h"
+
+/**
+ * @brief Run policy: record and report every file without touching it
+ */
+struct DryRunPolicy {
+    static constexpr bool kDelete = false;
+};
+
+/**
+ * @brief Run policy: delete every file
+ */
+struct DeletePolicy {
+    static constexpr bool kDelete = true;
+};
+
+/**
+ * @brief Backup policy selecting a BackupMode at compile time
+ */
+template <BackupMode Mode>
+struct BackupPolicy {
+    static constexpr BackupMode kMode = Mode;
+};
+
+using NoBackupPolicy = BackupPolicy<BackupMode::None>;
+using CopyBackupPolicy = BackupPolicy<BackupMode::Copy>;
+using QuarantinePolicy = BackupPolicy<BackupMode::Quarantine>;
+
+/**
+ * @brief Stats policy: only the engine's aggregate counters, nothing per file
+ */
+struct SummaryStatsPolicy {
+    static constexpr bool kPerFile = false;
+};
+
+/**
+ * @brief Stats policy: additionally log every processed file
+ */
+struct PerFileStatsPolicy {
+    static constexpr bool kPerFile = true;
+};
+
+/**
+ * @brief Shared state a kernel writes to; members a mode does not use may be null
+ */
+struct KernelContext {
+    IoThrottle* throttle = nullptr;     ///< Paces deletions
+    PlanWriter* plan = nullptr;         ///< Receives dry-run entries
+    RunJournal* journal = nullptr;      ///< Receives deletions of a journaled run
+    BackupStore* backup = nullptr;      ///< Receives files before they are deleted
+    FileSystemBackend* fileSystem = nullptr;  ///< Deletes files, the native file system when null
+    SecureEraser* eraser = nullptr;     ///< Overwrites files before they are unlinked
+    const FileTypeFilter* fileTypes = nullptr;  ///< Files of types it rejects are left alone
+};
+
+/**
+ * @brief Per-file body of a cleaning pass, specialized on its policies
+ *
+ * Every mode decision is an `if constexpr`, so each combination compiles to
+ * its own straight-line handler without per-file dryRun or backup checks.
+ * With a backup policy the file is preserved and deleted in the same call,
+ * which makes backup-and-clean a single pass over the tree. Failures throw,
+ * so the engine counts them as errors (or defers files in use).
+ *
+ * The asynchronous form does the same work as a chain of executor
+ * operations: the backup and any overwrite on the executor's threads, the
+ * unlink on its ring.
+ *
+ * @tparam Run DryRunPolicy or DeletePolicy
+ * @tparam Backup NoBackupPolicy, CopyBackupPolicy or QuarantinePolicy
+ * @tparam Stats SummaryStatsPolicy or PerFileStatsPolicy
+ */
+template <typename Run, typename Backup, typename Stats>
+class CleaningKernel {
+    static_assert(Run::kDelete || Backup::kMode == BackupMode::None, "dry runs never back up");
+
+public:
+    explicit CleaningKernel(const KernelContext& context) : context(context) {}
+
+    bool operator()(const FileEntry& entry) const {
+        if (!isTypeAllowed(entry)) return false;
+        if constexpr (!Run::kDelete) {
+            if (context.plan) context.plan->add(entry);
+            if constexpr (Stats::kPerFile) {
+                Logger::getInstance().log(LogLevel::INFO,
+                    "Would delete: " + toUtf8(entry.path) + " (" + std::to_string(entry.size) + " bytes)");
+            }
+            return true;
+        } else {
+            if constexpr (Backup::kMode == BackupMode::Quarantine) {
+                if (context.backup->moveIn(entry)) {
+                    finish(entry, "Quarantined: ");
+                    return true;
+                }
+                // Across devices a move is a copy plus a delete
+            }
+            if constexpr (Backup::kMode != BackupMode::None) {
+                if (!context.backup->copy(entry)) {
+                    throw std::runtime_error("backup failed, file kept");
+                }
+            }
+
+            context.throttle->acquire(entry.size);
+            if (context.eraser) {
+                std::error_code ec;
+                bool present = erase(context.eraser, entry, ec);
+                if (ec) throw std::filesystem::filesystem_error("cannot overwrite", entry.path, ec);
+                if (!present) return false;
+            }
+            auto start = std::chrono::steady_clock::now();
+            std::error_code ec;
+            FileSystemBackend& fileSystem = context.fileSystem ? *context.fileSystem : NativeFileSystem::instance();
+            bool removed = fileSystem.remove(entry.path, ec);
+            auto latency = std::chrono::steady_clock::now() - start;
+            context.throttle->recordLatency(latency);
+            Metrics::getInstance().record(MetricOperation::Unlink, latency);
+            if (ec) throw std::filesystem::filesystem_error("cannot remove", entry.path, ec);
+            if (!removed) return false;
+            finish(entry, "Deleted: ");
+            return true;
+        }
+    }
+
+    void operator()(const FileEntry& entry, IoExecutor& io, CleaningEngine::EntryCompletion done) const {
+        if constexpr (!Run::kDelete) {
+            done((*this)(entry), nullptr);
+        } else if (!isTypeAllowed(entry)) {
+            // Sniffing reads a few bytes at most, so it stays on the calling thread
+            done(false, nullptr);
+        } else if constexpr (Backup::kMode == BackupMode::None) {
+            unlink(entry, io, std::move(done));
+        } else {
+            // A backup is a copy plus a journal sync, both blocking
+            auto moved = std::make_shared<bool>(false);
+            BackupStore* backup = context.backup;
+            io.submit([backup, entry, moved] {
+                if constexpr (Backup::kMode == BackupMode::Quarantine) {
+                    if (backup->moveIn(entry)) {
+                        *moved = true;
+                        return std::error_code();
+                    }
+                }
+                return backup->copy(entry) ? std::error_code() : std::make_error_code(std::errc::io_error);
+            }, [kernel = *this, entry, moved, executor = &io, done = std::move(done)](std::error_code ec) {
+                if (ec) {
+                    done(false, std::make_exception_ptr(std::runtime_error("backup failed, file kept")));
+                } else if (*moved) {
+                    kernel.finish(entry, "Quarantined: ");
+                    done(true, nullptr);
+                } else {
+                    kernel.unlink(entry, *executor, done);
+                }
+            });
+        }
+    }
+
+private:
+    bool isTypeAllowed(const FileEntry& entry) const {
+        if (!context.fileTypes || context.fileTypes->allows(entry.path)) return true;
+        if constexpr (Stats::kPerFile) {
+            Logger::getInstance().log(LogLevel::INFO, "Protected file type: " + toUtf8(entry.path));
+        }
+        return false;
+    }
+
+    // False if the file is gone or cannot be overwritten (ec set); a file
+    // that cannot be overwritten effectively is still deleted
+    static bool erase(SecureEraser* eraser, const FileEntry& entry, std::error_code& ec) {
+        EraseOutcome outcome = eraser->overwrite(entry, ec);
+        if (ec || outcome == EraseOutcome::Missing) return false;
+        if (outcome != EraseOutcome::Overwritten && outcome != EraseOutcome::Sparse) {
+            Logger& logger = Logger::getInstance();
+            if (logger.isEnabled(LogLevel::DEBUG)) {
+                logger.log(LogLevel::DEBUG, std::string("Not overwritten (") + eraseOutcomeName(outcome) + "): " +
+                           toUtf8(entry.path));
+            }
+        }
+        return true;
+    }
+
+    void unlink(const FileEntry& entry, IoExecutor& io, CleaningEngine::EntryCompletion done) const {
+        context.throttle->acquire(entry.size);
+        if (!context.eraser) {
+            unlinkNow(entry, io, std::move(done));
+            return;
+        }
+        // Overwriting is blocking, so it runs on the executor's threads
+        SecureEraser* eraser = context.eraser;
+        io.submit([eraser, entry] {
+            std::error_code ec;
+            if (!erase(eraser, entry, ec) && !ec) ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            return ec;
+        }, [kernel = *this, entry, executor = &io, done = std::move(done)](std::error_code ec) {
+            if (ec == std::errc::no_such_file_or_directory) {
+                done(false, nullptr);
+            } else if (ec) {
+                done(false, std::make_exception_ptr(std::filesystem::filesystem_error("cannot overwrite", entry.path, ec)));
+            } else {
+                kernel.unlinkNow(entry, *executor, done);
+            }
+        });
+    }
+
+    void unlinkNow(const FileEntry& entry, IoExecutor& io, CleaningEngine::EntryCompletion done) const {
+        auto start = std::chrono::steady_clock::now();
+        io.unlink(entry.path, [kernel = *this, entry, start, done = std::move(done)](std::error_code ec) {
+            auto latency = std::chrono::steady_clock::now() - start;
+            kernel.context.throttle->recordLatency(latency);
+            Metrics::getInstance().record(MetricOperation::Unlink, latency);
+            if (ec == std::errc::no_such_file_or_directory) {
+                done(false, nullptr);
+            } else if (ec) {
+                done(false, std::make_exception_ptr(std::filesystem::filesystem_error("cannot remove", entry.path, ec)));
+            } else {
+                kernel.finish(entry, "Deleted: ");
+                done(true, nullptr);
+            }
+        });
+    }
+
+    void finish(const FileEntry& entry, const char* verb) const {
+        if (context.journal) context.journal->recordDeleted(entry.size);
+        if constexpr (Stats::kPerFile) {
+            Logger::getInstance().log(LogLevel::INFO, verb + toUtf8(entry.path));
+        }
+    }
+
+    KernelContext context;
+};
+
+/**
+ * @brief Pick the kernel specialization for a run configuration
+ *
+ * The configuration is resolved once per pass; the returned handler runs the
+ * specialized kernel for every file.
+ *
+ * @param context State the kernel writes to
+ * @param dryRun True for DryRunPolicy; the backup mode is ignored then
+ * @param mode Backup mode, context.backup must be set unless it is None
+ * @param perFile True for PerFileStatsPolicy
+ */
+CleaningEngine::EntryHandler makeCleaningKernel(const KernelContext& context, bool dryRun,
+                                                BackupMode mode, bool perFile);
+
+/**
+ * @brief Asynchronous counterpart of makeCleaningKernel() for CleaningEngine::runSetsAsync()
+ */
+CleaningEngine::AsyncEntryHandler makeAsyncCleaningKernel(const KernelContext& context, bool dryRun,
+                                                          BackupMode mode, bool perFile);
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "CleaningEngine.h"
+
+/**
+ * @brief Cleaner a group of plan entries belongs to
+ */
+enum class PlanSection : uint8_t {
+    Temp = 1,       ///< Temporary files
+    Browser = 2,    ///< Cache of the browser named by the section
+    Rule = 3        ///< Files selected by the rule named by the section
+};
+
+/**
+ * @brief Entries of one plan section
+ */
+struct PlanSectionData {
+    PlanSection kind = PlanSection::Temp;
+    std::string name;                   ///< Browser or rule name, empty for temp files
+    std::vector<FileEntry> entries;
+};
+
+/**
+ * @brief Streams a deletion plan to disk while a dry run is in progress
+ *
+ * The file starts with a magic/version header and is followed by section
+ * and entry records. Paths are prefix-compressed against the previous entry
+ * and all integers are LEB128 varints, so a plan of a large cache tree is a
+ * small fraction of its textual listing. A footer with the entry count and
+ * total size marks a complete plan.
+ *
+ * add() is thread-safe and may be called from engine workers.
+ */
+class PlanWriter {
+public:
+    PlanWriter() = default;
+    ~PlanWriter();
+
+    /**
+     * @brief Create the plan file and write the header
+     * @param file Destination path
+     * @return False if the file cannot be created
+     */
+    bool open(const std::filesystem::path& file);
+
+    /**
+     * @brief Start a new section, subsequent entries belong to it
+     * @param kind Cleaner the entries come from
+     * @param name Browser or rule name, empty for temp files
+     */
+    void beginSection(PlanSection kind, const std::string& name);
+
+    /**
+     * @brief Append an entry with its fingerprint to the current section
+     * @param entry Entry as seen by the dry run
+     */
+    void add(const FileEntry& entry);
+
+    /**
+     * @brief Write the footer and close the file
+     * @return False if any write failed
+     */
+    bool close();
+
+    bool isOpen() const;
+    uint64_t getEntryCount() const;
+
+private:
+    void writeVarint(uint64_t value);
+    void writeBytes(const std::string& bytes);
+
+    std::ofstream stream;
+    std::string previousPath;
+    uint64_t entryCount = 0;
+    uint64_t totalBytes = 0;
+    mutable std::mutex mutex;
+};
+
+/**
+ * @brief Reads a plan written by PlanWriter through a read-only memory mapping
+ */
+class PlanReader {
+public:
+    PlanReader() = default;
+    ~PlanReader();
+
+    PlanReader(const PlanReader&) = delete;
+    PlanReader& operator=(const PlanReader&) = delete;
+
+    /**
+     * @brief Map a plan file into memory
+     * @param file Plan to open
+     * @return False if the file cannot be opened or mapped
+     */
+    bool open(const std::filesystem::path& file);
+
+    /**
+     * @brief Decode every section of the mapped plan
+     * @param sections Receives the decoded sections
+     * @param error Receives a description when decoding fails
+     * @return False for truncated, corrupt or incomplete plans
+     */
+    bool read(std::vector<PlanSectionData>& sections, std::string& error) const;
+
+    void close();
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+/**
+ * @brief Check that a file still matches the fingerprint recorded in a plan
+ * @param planned Entry as recorded by the dry run
+ * @return True if size, device, inode and mtime are unchanged
+ */
+bool matchesFingerprint(const FileEntry& planned);
@@ -0,0 +1,279 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "StorageInfo.h"
+
+struct FileEntry;
+
+/**
+ * @brief Type of a directory entry, symlinks not followed
+ */
+enum class FileType {
+    None,           ///< Does not exist
+    Regular,
+    Directory,
+    Symlink,
+    Other
+};
+
+/**
+ * @brief One child of a listed directory
+ */
+struct DirectoryItem {
+    std::filesystem::path path;     ///< Full path of the child
+    FileType type = FileType::None;
+};
+
+/**
+ * @brief Identity of a file or directory, whatever path reaches it
+ */
+struct FileId {
+    uint64_t device = 0;
+    uint64_t inode = 0;             ///< File index on Windows
+
+    bool operator==(const FileId& other) const { return device == other.device && inode == other.inode; }
+
+    struct Hash {
+        size_t operator()(const FileId& id) const {
+            return static_cast<size_t>(id.inode * 0x9E3779B97F4A7C15ull ^ id.device);
+        }
+    };
+};
+
+/**
+ * @brief Who owns a path and whether anyone may add entries to it
+ */
+struct FileOwner {
+    uint64_t user = 0;              ///< Owning user id, 0 for root
+    bool worldWritable = false;     ///< Writable by every user, as /tmp is
+};
+
+/**
+ * @brief File system operations the cleaning engine performs
+ *
+ * Failures are reported through error codes, never exceptions, so callers
+ * decide how to count them.
+ */
+class FileSystemBackend {
+public:
+    virtual ~FileSystemBackend() = default;
+
+    /**
+     * @brief Get the type of a path, following symlinks
+     * @return FileType::None if the path does not exist
+     */
+    virtual FileType status(const std::filesystem::path& path, std::error_code& ec) = 0;
+
+    /**
+     * @brief Collect the children of a directory
+     * @param path Directory to list
+     * @param items Receives one item per child; unreadable directories yield none
+     * @param ec Set if the directory cannot be listed for another reason
+     */
+    virtual void listDirectory(const std::filesystem::path& path, std::vector<DirectoryItem>& items,
+                               std::error_code& ec) = 0;
+
+    /**
+     * @brief Fill an entry from the metadata of a path, see statFileEntry()
+     * @return False, with ec set, if the path cannot be inspected
+     */
+    virtual bool stat(const std::filesystem::path& path, FileEntry& entry, std::error_code& ec) = 0;
+
+    /**
+     * @brief Remove a file or an empty directory
+     * @return False if nothing was removed; ec is only set for failures, not for missing paths
+     */
+    virtual bool remove(const std::filesystem::path& path, std::error_code& ec) = 0;
+
+    /**
+     * @brief Rename a file, replacing an existing target
+     */
+    virtual void rename(const std::filesystem::path& from, const std::filesystem::path& to,
+                        std::error_code& ec) = 0;
+
+    /**
+     * @brief Get the device a path lives on, see getDeviceId()
+     */
+    virtual bool deviceId(const std::filesystem::path& path, uint64_t& device) = 0;
+
+    /**
+     * @brief Identify what a path resolves to, following symlinks
+     * @return False, with ec set, if the path cannot be resolved
+     */
+    virtual bool identify(const std::filesystem::path& path, FileId& id, std::error_code& ec) = 0;
+
+    /**
+     * @brief Get the owner of a path
+     * @param follow False to describe a symlink itself instead of its target
+     * @return False, with ec set, if the path cannot be inspected
+     */
+    virtual bool owner(const std::filesystem::path& path, bool follow, FileOwner& owner, std::error_code& ec) = 0;
+
+    /**
+     * @brief Classify the storage behind a path, see detectStorageType()
+     */
+    virtual StorageType storageType(const std::filesystem::path& path) = 0;
+};
+
+/**
+ * @brief The real file system through std::filesystem and the platform API
+ */
+class NativeFileSystem : public FileSystemBackend {
+public:
+    /**
+     * @brief Shared instance used wherever no other backend is configured
+     */
+    static NativeFileSystem& instance();
+
+    FileType status(const std::filesystem::path& path, std::error_code& ec) override;
+    void listDirectory(const std::filesystem::path& path, std::vector<DirectoryItem>& items,
+                       std::error_code& ec) override;
+    bool stat(const std::filesystem::path& path, FileEntry& entry, std::error_code& ec) override;
+    bool remove(const std::filesystem::path& path, std::error_code& ec) override;
+    void rename(const std::filesystem::path& from, const std::filesystem::path& to,
+                std::error_code& ec) override;
+    bool deviceId(const std::filesystem::path& path, uint64_t& device) override;
+    bool identify(const std::filesystem::path& path, FileId& id, std::error_code& ec) override;
+
+    /**
+     * On Windows every path reports user 0 and no world write access: links
+     * there need a privilege to create, so their owner is not checked.
+     */
+    bool owner(const std::filesystem::path& path, bool follow, FileOwner& owner, std::error_code& ec) override;
+    StorageType storageType(const std::filesystem::path& path) override;
+};
+
+/**
+ * @brief Operations of a MemoryFileSystem that latency and faults apply to
+ */
+enum class FileOperation {
+    List,       ///< listDirectory()
+    Stat,       ///< status() and stat()
+    Remove,
+    Rename,
+    Count
+};
+
+/**
+ * @brief File system held entirely in memory
+ *
+ * Lets the engine be benchmarked and stress-tested without disks. Every
+ * operation can be slowed down by a fixed latency and made to fail with a
+ * chosen error (EACCES, EBUSY, ENOENT, ...) for a given path, a given number
+ * of times. Directories list their children in name order and a hook runs
+ * after every listing, so a mutation "during" a walk happens at a
+ * reproducible point. All methods are thread-safe; files get sequential
+ * inode numbers and 4 KiB allocation units.
+ */
+class MemoryFileSystem : public FileSystemBackend {
+public:
+    /**
+     * @param device Device id reported for every path
+     * @param type Storage type reported for every path
+     */
+    explicit MemoryFileSystem(uint64_t device = 0x4d454d4653, StorageType type = StorageType::SolidState);
+
+    /**
+     * @brief Create a file, and any missing parent directories
+     * @param mtime Modification time in the units of FileEntry::mtime
+     */
+    void addFile(const std::filesystem::path& path, uint64_t size, int64_t mtime = 0);
+    void addDirectory(const std::filesystem::path& path);
+
+    /**
+     * @brief Create root/d<i>/f<j> for a synthetic workload
+     */
+    void addTree(const std::filesystem::path& root, size_t directories, size_t filesPerDirectory,
+                 uint64_t fileSize);
+
+    FileType typeOf(const std::filesystem::path& path) const;
+    uint64_t getFileCount() const;
+
+    /**
+     * @brief Delay every call of an operation
+     */
+    void setLatency(FileOperation operation, std::chrono::nanoseconds latency);
+
+    /**
+     * @brief Make an operation fail on a path
+     * @param operation Operation to fail
+     * @param path Path to fail on, empty for every path
+     * @param error Error to report
+     * @param count Number of failures, -1 for all calls
+     */
+    void injectFault(FileOperation operation, const std::filesystem::path& path, std::errc error,
+                     int count = -1);
+    void clearFaults();
+
+    /**
+     * @brief Run a callback after every directory listing, outside the lock
+     *
+     * The callback may modify the file system, e.g. delete a child that was
+     * just listed, to reproduce a concurrent mutation deterministically.
+     */
+    void setListHook(std::function<void(const std::filesystem::path&)> hook);
+
+    uint64_t getCallCount(FileOperation operation) const;
+
+    FileType status(const std::filesystem::path& path, std::error_code& ec) override;
+    void listDirectory(const std::filesystem::path& path, std::vector<DirectoryItem>& items,
+                       std::error_code& ec) override;
+    bool stat(const std::filesystem::path& path, FileEntry& entry, std::error_code& ec) override;
+    bool remove(const std::filesystem::path& path, std::error_code& ec) override;
+    void rename(const std::filesystem::path& from, const std::filesystem::path& to,
+                std::error_code& ec) override;
+    bool deviceId(const std::filesystem::path& path, uint64_t& device) override;
+    bool identify(const std::filesystem::path& path, FileId& id, std::error_code& ec) override;
+
+    /**
+     * Every path is owned by user 0 and private; the memory file system has
+     * no symlinks whose owner would matter.
+     */
+    bool owner(const std::filesystem::path& path, bool follow, FileOwner& owner, std::error_code& ec) override;
+    StorageType storageType(const std::filesystem::path& path) override;
+
+private:
+    struct Node {
+        FileType type = FileType::Regular;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t inode = 0;
+    };
+
+    // Children by name, so listings come out sorted
+    using Directory = std::map<std::string, Node>;
+
+    struct Fault {
+        FileOperation operation;
+        std::string key;
+        std::errc error;
+        int remaining;
+    };
+
+    static std::string keyOf(const std::filesystem::path& path);
+    static std::pair<std::string, std::string> split(const std::string& key);
+    bool enter(FileOperation operation, const std::string& key, std::error_code& ec);
+    const Node* find(const std::string& key) const;
+    Directory& makeDirectory(const std::string& key);
+
+    uint64_t device;
+    StorageType type;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Directory> directories;
+    std::vector<Fault> faults;
+    std::function<void(const std::filesystem::path&)> listHook;
+    uint64_t nextInode = 1;
+    uint64_t files = 0;
+    std::array<std::atomic<int64_t>, static_cast<size_t>(FileOperation::Count)> latencies{};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(FileOperation::Count)> calls{};
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Immutable set of file extensions behind a perfect hash
+ *
+ * Built once from the configured extensions: each extension hashes into one
+ * of a small number of buckets, and every bucket stores a displacement that
+ * sends its extensions to distinct slots of the table. A lookup is one hash
+ * of the extension, one displacement load and one slot compare, whatever
+ * the number of extensions. Matching ignores ASCII case.
+ */
+class ExtensionSet {
+public:
+    ExtensionSet() = default;
+
+    /**
+     * @param extensions Extensions with or without a leading dot, any case
+     */
+    explicit ExtensionSet(const std::vector<std::string>& extensions);
+
+    /**
+     * @brief Test an extension given without its dot
+     */
+    bool contains(const std::filesystem::path::value_type* begin, const std::filesystem::path::value_type* end) const;
+    bool contains(const std::string& extension) const;
+
+    bool empty() const { return extensions.empty(); }
+    size_t size() const { return extensions.size(); }
+
+    /**
+     * @brief The extensions, lowercase and without dots, in configuration order
+     */
+    const std::vector<std::string>& getExtensions() const { return extensions; }
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t index = kEmpty;    ///< Into extensions
+    };
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    bool build(size_t tableSize, const std::vector<uint64_t>& hashes);
+    bool matches(uint32_t index, const std::filesystem::path::value_type* begin,
+                 const std::filesystem::path::value_type* end) const;
+
+    std::vector<std::string> extensions;
+    std::vector<std::filesystem::path::string_type> nativeExtensions;   ///< Compared against paths
+    std::vector<uint32_t> displacements;    ///< Per bucket
+    std::vector<Slot> slots;
+    std::vector<uint32_t> sameHash;         ///< Extensions whose hash an earlier one already has
+};
+
+/**
+ * @brief Recognize a file by its first bytes
+ * @param header Start of the file
+ * @param length Bytes available, at most kSniffBytes are looked at
+ * @return A type name usable in type lists ("exe", "elf", "macho", "script",
+ *         "pdf", "ole", "zip", "rtf"), nullptr if the content is not recognized
+ */
+const char* sniffFileType(const unsigned char* header, size_t length);
+
+constexpr size_t kSniffBytes = 16;
+
+/**
+ * @brief Decides which files a cleaning pass may touch by their type
+ *
+ * The type of a file is its extension; files without one can optionally be
+ * typed by sniffing their first bytes. Excluded types are always kept, and
+ * when an allow list is set only the types on it are cleaned. By default
+ * executables, scripts and documents are excluded.
+ */
+class FileTypeFilter {
+public:
+    FileTypeFilter();
+
+    /**
+     * @brief Types excluded unless configured otherwise
+     */
+    static const std::vector<std::string>& getDefaultExcludedTypes();
+
+    void setExcludedTypes(const std::vector<std::string>& types) { excluded = ExtensionSet(types); }
+    const std::vector<std::string>& getExcludedTypes() const { return excluded.getExtensions(); }
+
+    /**
+     * @brief Only clean files of these types; empty to clean every type not excluded
+     */
+    void setAllowedTypes(const std::vector<std::string>& types) { allowed = ExtensionSet(types); }
+    const std::vector<std::string>& getAllowedTypes() const { return allowed.getExtensions(); }
+
+    /**
+     * @brief Read the first kSniffBytes of files without an extension to type them
+     */
+    void setContentSniffing(bool enable) { sniffing = enable; }
+    bool isContentSniffing() const { return sniffing; }
+
+    /**
+     * @brief False if no file can be rejected, so the check can be skipped
+     */
+    bool isActive() const { return !excluded.empty() || !allowed.empty(); }
+
+    /**
+     * @brief Test whether a file may be cleaned
+     */
+    bool allows(const std::filesystem::path& path) const;
+
+private:
+    bool allowsType(const std::filesystem::path::value_type* begin, const std::filesystem::path::value_type* end) const;
+
+    ExtensionSet excluded;
+    ExtensionSet allowed;
+    bool sniffing = false;
+};
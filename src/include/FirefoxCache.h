@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "CacheEvictionPolicy.h"
+
+/**
+ * @brief One record of a Firefox cache2 index
+ */
+struct FirefoxCacheEntry {
+    std::array<uint8_t, 20> hash{}; ///< SHA-1 of the cache key, names the entry file
+    uint32_t frecency = 0;          ///< Firefox's usefulness score, low values are evicted first
+    uint32_t flags = 0;             ///< Record flags with the file size in kB in the low 24 bits
+    uint32_t lastFetched = 0;       ///< Last fetch from the entry metadata (Unix time), 0 if unread
+    std::string record;             ///< Raw record bytes, written back unchanged
+
+    uint64_t size() const { return static_cast<uint64_t>(flags & 0x00FFFFFFu) * 1024; }
+};
+
+/**
+ * @brief Reader and writer of the cache2 index file of a Firefox profile
+ *
+ * The index holds a big-endian header (version, timestamp, dirty flag, kB
+ * written), one fixed-size record per entry and a trailing Jenkins hash of
+ * everything before it. Only version 0xA records are understood. A dirty
+ * index means Firefox is running or crashed; it rebuilds such an index from
+ * the entries directory itself, so it is never rewritten here.
+ */
+class FirefoxCacheIndex {
+public:
+    /**
+     * @brief Check whether a directory is a cache2 directory with an index
+     */
+    static bool isCache2(const std::filesystem::path& directory);
+
+    /**
+     * @brief Path of the file holding an entry (entries/<SHA-1 in upper-case hex>)
+     */
+    static std::filesystem::path entryFile(const std::filesystem::path& directory,
+                                           const std::array<uint8_t, 20>& hash);
+
+    /**
+     * @brief Read the last-fetched time from the metadata at the end of an entry file
+     * @return False if the file has no valid metadata
+     */
+    static bool readLastFetched(const std::filesystem::path& file, uint32_t& lastFetched);
+
+    bool load(const std::filesystem::path& directory);
+
+    /**
+     * @brief Write the index with the current entries, replacing it through index.tmp
+     */
+    bool save(const std::filesystem::path& directory) const;
+
+    std::vector<FirefoxCacheEntry>& getEntries() { return entries; }
+    const std::vector<FirefoxCacheEntry>& getEntries() const { return entries; }
+    bool isDirty() const { return dirty != 0; }
+    const std::string& getError() const { return error; }
+
+private:
+    std::vector<FirefoxCacheEntry> entries;
+    uint32_t version = 0;
+    uint32_t dirty = 0;
+    uint32_t kbWritten = 0;
+    std::string error;
+};
+
+/**
+ * @brief Bob Jenkins' lookup2 hash as used by the Firefox cache (CacheHash)
+ */
+uint32_t firefoxCacheHash(const void* data, size_t length, uint32_t initval = 0);
+
+/**
+ * @brief Pick the entries a policy evicts
+ *
+ * Entries fetched more than maxAgeDays ago go first; entries without
+ * metadata are never evicted for age. The budget then evicts the lowest
+ * frecency first, as Firefox itself does.
+ *
+ * @param entries Records of the index
+ * @param policy Age limit and size budget
+ * @param now Current Unix time
+ * @return Entries to evict
+ */
+std::vector<FirefoxCacheEntry> selectFirefoxEvictions(std::vector<FirefoxCacheEntry> entries,
+                                                      const CacheEvictionPolicy& policy, std::time_t now);
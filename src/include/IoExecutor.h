@@ -0,0 +1,121 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+#include "CleaningEngine.h"
+#include "WorkerPool.h"
+
+/**
+ * @brief Small I/O executor keeping many file operations in flight
+ *
+ * Operations are started with a completion callback and return at once.
+ * On Linux, stats, unlinks and renames are queued on an io_uring, so
+ * thousands of them can be outstanding from a single thread; directory
+ * reads, copies, other work and every operation where io_uring is not
+ * available run on a few blocking threads instead.
+ *
+ * Callbacks always run on the thread that calls drain() or wait(), never
+ * concurrently, so state touched only by callbacks needs no locking.
+ * Callbacks may start further operations. The executor itself must only
+ * be used from that one thread.
+ */
+class IoExecutor {
+public:
+    using Callback = std::function<void(std::error_code)>;
+    using StatCallback = std::function<void(std::error_code, FileEntry&&)>;
+    using DirectoryCallback = std::function<void(std::error_code, std::vector<DirectoryItem>&&)>;
+
+    /**
+     * @param queueDepth Operations kept in flight on the ring at once
+     * @param threads Threads for blocking operations, at least one
+     * @param fileSystem Backend for every operation but copies, nullptr for
+     *        the native file system; other backends never use the ring
+     */
+    explicit IoExecutor(size_t queueDepth = 1024, size_t threads = 4, FileSystemBackend* fileSystem = nullptr);
+
+    /**
+     * @brief Run every outstanding operation and its callback to completion
+     */
+    ~IoExecutor();
+
+    IoExecutor(const IoExecutor&) = delete;
+    IoExecutor& operator=(const IoExecutor&) = delete;
+
+    /**
+     * @brief List a directory, see FileSystemBackend::listDirectory()
+     */
+    void readDirectory(const std::filesystem::path& path, DirectoryCallback done);
+
+    /**
+     * @brief Inspect a file without following symlinks, see statFileEntry()
+     */
+    void stat(const std::filesystem::path& path, StatCallback done);
+
+    /**
+     * @brief Remove a file
+     */
+    void unlink(const std::filesystem::path& path, Callback done);
+
+    /**
+     * @brief Rename a file, replacing an existing target
+     */
+    void rename(const std::filesystem::path& from, const std::filesystem::path& to, Callback done);
+
+    /**
+     * @brief Copy a file, replacing an existing target
+     */
+    void copy(const std::filesystem::path& from, const std::filesystem::path& to, Callback done);
+
+    /**
+     * @brief Run blocking work on the executor's threads
+     * @param work Callable returning its outcome, must not throw
+     */
+    void submit(std::function<std::error_code()> work, Callback done);
+
+    /**
+     * @brief Run callbacks until at most maxOutstanding operations remain
+     *
+     * Lets a producer bound the operations it has queued.
+     */
+    void drain(size_t maxOutstanding);
+
+    /**
+     * @brief Run callbacks until no operation remains
+     */
+    void wait() { drain(0); }
+
+    /**
+     * @brief Number of operations started whose callback has not run yet
+     */
+    size_t getOutstanding() const { return outstanding; }
+
+    /**
+     * @brief True if operations go through io_uring
+     */
+    bool isNative() const;
+
+private:
+    struct Operation;
+    class Ring;
+
+    void start(std::unique_ptr<Operation> operation);
+    void runBlocking(std::unique_ptr<Operation> operation);
+    void complete(Operation& operation);
+    bool reapBlocking(bool block);
+
+    FileSystemBackend& fileSystem;
+    std::unique_ptr<Ring> ring;
+    std::deque<std::unique_ptr<Operation>> backlog;  ///< Ring operations waiting for a free slot
+    std::unique_ptr<WorkerPool> pool;
+    std::mutex mutex;
+    std::condition_variable completed;
+    std::vector<std::unique_ptr<Operation>> finished;   ///< Blocking operations awaiting their callback
+    size_t blockingInFlight = 0;
+    size_t outstanding = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @brief Token-bucket limiter shared by every cleaner thread
+ *
+ * Two buckets are kept: operations per second and bytes per second. A limit
+ * of zero disables the corresponding bucket. In adaptive mode the effective
+ * rates are scaled down while the observed delete latency is above its
+ * baseline and recover gradually once it settles again.
+ */
+class IoThrottle {
+public:
+    IoThrottle();
+
+    /**
+     * @brief Set the maximum number of I/O operations per second
+     * @param ops Operations per second, 0 disables the limit
+     */
+    void setMaxOpsPerSecond(uint64_t ops);
+
+    /**
+     * @brief Set the maximum number of bytes processed per second
+     * @param bytes Bytes per second, 0 disables the limit
+     */
+    void setMaxBytesPerSecond(uint64_t bytes);
+
+    /**
+     * @brief Enable or disable latency-driven back-off
+     * @param enable True to scale the rates by observed latency
+     */
+    void setAdaptive(bool enable);
+
+    uint64_t getMaxOpsPerSecond() const;
+    uint64_t getMaxBytesPerSecond() const;
+    bool isAdaptive() const;
+
+    /**
+     * @brief Check whether any limit or adaptive mode is active
+     * @return True if acquire() may block
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief Block until one operation of the given size may proceed
+     * @param bytes Number of bytes the operation will touch
+     */
+    void acquire(uint64_t bytes);
+
+    /**
+     * @brief Report the latency of a completed operation
+     * @param latency Wall-clock duration of the operation
+     */
+    void recordLatency(std::chrono::nanoseconds latency);
+
+    /**
+     * @brief Get the current adaptive scale factor
+     * @return Value in (0, 1], 1 meaning no back-off
+     */
+    double getRateScale() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Bucket {
+        double rate = 0.0;      ///< Tokens added per second, 0 if disabled
+        double tokens = 0.0;    ///< Currently available tokens, negative when in debt
+    };
+
+    void refill(Bucket& bucket, double elapsedSeconds) const;
+    double reserve(Bucket& bucket, double cost) const;
+
+    mutable std::mutex mutex;
+    Bucket opsBucket;
+    Bucket bytesBucket;
+    uint64_t maxOps;
+    uint64_t maxBytes;
+    bool adaptive;
+    double scale;
+    double fastLatency;     ///< Short-term latency average in seconds
+    double baseLatency;     ///< Long-term latency baseline in seconds
+    Clock::time_point lastRefill;
+    Clock::time_point lastAdjust;
+};
+
+/**
+ * @brief Lower the I/O priority of the calling process to idle
+ *
+ * Uses ioprio_set(IOPRIO_CLASS_IDLE) on Linux and background processing mode
+ * on Windows. Must be called before worker threads are started so that they
+ * inherit the priority.
+ *
+ * @return True if the priority was changed
+ */
+bool applyIdleIoPriority();
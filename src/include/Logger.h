@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include "Trace.h"
+
+/**
+ * @brief Logging levels for the application
+ */
+enum class LogLevel {
+    DEBUG,   ///< Debug information
+    INFO,    ///< General information
+    WARNING, ///< Warning messages
+    ERROR    ///< Error messages
+};
+
+/**
+ * @brief Singleton logger class for the application
+ */
+class Logger {
+private:
+    std::ofstream logFile;
+    bool consoleOutput;
+    std::atomic<LogLevel> minLevel{LogLevel::DEBUG};
+    std::mutex writeMutex;
+    std::function<void(LogLevel, const std::string&)> sink;
+    static std::unique_ptr<Logger> instance;
+    static std::mutex mutex;
+
+    Logger() : consoleOutput(true) {
+        auto now = std::chrono::system_clock::now();
+        auto time = std::chrono::system_clock::to_time_t(now);
+        std::stringstream ss;
+        ss << "cookiemonster_" << std::put_time(std::localtime(&time), "%Y%m%d_%H%M%S") << ".log";
+        logFile.open(ss.str(), std::ios::app);
+    }
+
+public:
+    /**
+     * @brief Get the singleton instance of the logger
+     * @return Reference to the logger instance
+     */
+    static Logger& getInstance() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!instance) {
+            instance.reset(new Logger());
+        }
+        return *instance;
+    }
+
+    /**
+     * @brief Log a message with specified level
+     * @param level Logging level
+     * @param message Message to log
+     */
+    void log(LogLevel level, const std::string& message) {
+        if (!isEnabled(level)) return;
+        TraceScope span("log", "logging");
+        std::lock_guard<std::mutex> lock(writeMutex);
+        std::string levelStr;
+        switch (level) {
+            case LogLevel::DEBUG: levelStr = "DEBUG"; break;
+            case LogLevel::INFO: levelStr = "INFO"; break;
+            case LogLevel::WARNING: levelStr = "WARNING"; break;
+            case LogLevel::ERROR: levelStr = "ERROR"; break;
+        }
+
+        auto now = std::chrono::system_clock::now();
+        auto time = std::chrono::system_clock::to_time_t(now);
+        std::stringstream ss;
+        ss << "[" << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") << "] "
+           << "[" << levelStr << "] " << message;
+
+        if (consoleOutput) {
+            std::cout << ss.str() << std::endl;
+        }
+        logFile << ss.str() << std::endl;
+        logFile.flush();
+        if (sink) sink(level, message);
+    }
+
+    /**
+     * @brief Also hand every written message to a callback
+     *
+     * Lets a resident agent stream a job's log to the client that submitted
+     * it. The callback runs under the logger's lock and must not log itself.
+     *
+     * @param callback Receives level and message text, nullptr to remove it
+     */
+    void setSink(std::function<void(LogLevel, const std::string&)> callback) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        sink = std::move(callback);
+    }
+
+    /**
+     * @brief Drop messages below a level
+     * @param level Least severe level that is still written
+     */
+    void setLevel(LogLevel level) {
+        minLevel = level;
+    }
+
+    /**
+     * @brief Check whether a level is written
+     *
+     * Per-file messages test this first so that their text (and the path
+     * conversion it needs) is never built when it would be dropped.
+     */
+    bool isEnabled(LogLevel level) const {
+        return level >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Enable or disable console output
+     * @param enable True to enable console output, false to disable
+     */
+    void setConsoleOutput(bool enable) {
+        consoleOutput = enable;
+    }
+
+    ~Logger() {
+        if (logFile.is_open()) {
+            logFile.close();
+        }
+    }
+};
@@ -0,0 +1,202 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Log-linear latency histogram in the style of HdrHistogram
+ *
+ * Values are nanoseconds. Every power of two is split into 16 linear
+ * sub-buckets, so any recorded value is known to within 1/16 (6.25 %) from
+ * 1 ns up to the full 64-bit range. Recording is a few relaxed atomic
+ * increments and never blocks, so any number of threads may record at once.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+    static constexpr size_t kBuckets = kSubBuckets + (64 - kSubBucketBits) * kSubBuckets;
+
+    void record(uint64_t nanoseconds);
+
+    uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+    uint64_t getSum() const { return sum.load(std::memory_order_relaxed); }
+    uint64_t getMax() const { return max.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Get the value below which a fraction of the recordings fall
+     * @param quantile Fraction in [0, 1], e.g. 0.99
+     * @return Upper bound of the bucket holding that rank, 0 when empty
+     */
+    uint64_t getQuantile(double quantile) const;
+
+    /**
+     * @brief Count the recordings below a bound
+     */
+    uint64_t countBelow(uint64_t nanoseconds) const;
+
+    void reset();
+
+    static size_t bucketOf(uint64_t nanoseconds);
+
+    /**
+     * @brief Smallest value of the bucket after the given one
+     */
+    static uint64_t bucketEnd(size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+/**
+ * @brief Operations whose latency is measured
+ */
+enum class MetricOperation {
+    ReadDirectory,
+    Stat,
+    Unlink,
+    Copy,
+    Registry,
+    Overwrite,
+    Count
+};
+
+/**
+ * @brief Name of an operation as it appears in the exported label
+ */
+const char* metricOperationName(MetricOperation operation);
+
+/**
+ * @brief Label name/value pairs of a counter, e.g. {{"cleaner", "browser"}}
+ */
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * @brief Process-wide metrics: one latency histogram per operation and
+ * labelled counters
+ *
+ * Latencies are only measured while enabled, so instrumented code pays one
+ * relaxed load otherwise. Counters are added once per cleaner run and may
+ * take a lock.
+ */
+class Metrics {
+public:
+    static Metrics& getInstance();
+
+    void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Start timing an operation
+     * @return Opaque start time, 0 while disabled
+     */
+    uint64_t start() const;
+
+    /**
+     * @brief Record an operation begun with start(); ignored for a start of 0
+     */
+    void finish(MetricOperation operation, uint64_t started);
+
+    void record(MetricOperation operation, std::chrono::nanoseconds latency);
+
+    LatencyHistogram& getHistogram(MetricOperation operation) {
+        return histograms[static_cast<size_t>(operation)];
+    }
+
+    /**
+     * @brief Add to a counter, creating it at zero first
+     */
+    void addCounter(const std::string& name, const MetricLabels& labels, uint64_t value);
+    uint64_t getCounter(const std::string& name, const MetricLabels& labels) const;
+
+    /**
+     * @brief Render everything in the Prometheus text exposition format
+     */
+    std::string toPrometheus() const;
+
+    /**
+     * @brief Render everything as one JSON object with latency quantiles
+     */
+    std::string toJson() const;
+
+    /**
+     * @brief Write the requested formats, each replaced atomically
+     * @param prometheusPath Target of toPrometheus(), empty to skip
+     * @param jsonPath Target of toJson(), empty to skip
+     * @return False if a file could not be written
+     */
+    bool write(const std::string& prometheusPath, const std::string& jsonPath) const;
+
+    void reset();
+
+private:
+    Metrics() = default;
+
+    std::atomic<bool> enabled{false};
+    std::array<LatencyHistogram, static_cast<size_t>(MetricOperation::Count)> histograms;
+    mutable std::mutex counterMutex;
+    std::map<std::pair<std::string, MetricLabels>, uint64_t> counters;
+};
+
+/**
+ * @brief Times the enclosing scope as one operation
+ */
+class OperationTimer {
+public:
+    explicit OperationTimer(MetricOperation operation)
+        : operation(operation), started(Metrics::getInstance().start()) {}
+    ~OperationTimer() { Metrics::getInstance().finish(operation, started); }
+
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+private:
+    MetricOperation operation;
+    uint64_t started;
+};
+
+/**
+ * @brief Writes the metrics files periodically from a background thread
+ *
+ * For long-running processes: the node exporter's textfile collector then
+ * sees current values instead of only those of the last finished run. The
+ * files are written once more when the reporter stops.
+ */
+class MetricsReporter {
+public:
+    MetricsReporter(std::string prometheusPath, std::string jsonPath, std::chrono::milliseconds interval);
+    ~MetricsReporter();
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    /**
+     * @brief Stop the thread and write the final values
+     */
+    void stop();
+
+    uint64_t getReportCount() const { return reports.load(); }
+
+private:
+    void run();
+
+    std::string prometheusPath;
+    std::string jsonPath;
+    std::chrono::milliseconds interval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::atomic<uint64_t> reports{0};
+    std::thread thread;
+};
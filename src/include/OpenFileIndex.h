@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <system_error>
+#include <unordered_set>
+#include "CleaningEngine.h"
+
+/**
+ * @brief Set of files currently held open by running processes
+ *
+ * On Linux the index is built by resolving every descriptor under
+ * /proc/<pid>/fd to its (device, inode). Unlinking such a file succeeds but
+ * frees nothing until the last descriptor is closed, so the engine defers
+ * those entries instead. Descriptors of other users' processes are only
+ * visible with sufficient privileges; unreadable processes are skipped.
+ *
+ * Windows has no cheap system-wide listing, so the index stays empty there
+ * and open files are recognized by the sharing violation the delete fails
+ * with (see isFileInUseError()).
+ */
+class OpenFileIndex {
+public:
+    /**
+     * @brief Rebuild the index from the running processes
+     * @return Number of distinct open files found
+     */
+    size_t build();
+
+    /**
+     * @brief Add a file by identity, used where /proc is not available
+     */
+    void add(uint64_t device, uint64_t inode);
+
+    /**
+     * @brief Check whether an entry is held open
+     *
+     * Entries without an inode number are never reported as open.
+     */
+    bool contains(const FileEntry& entry) const;
+
+    size_t size() const { return files.size(); }
+    void clear() { files.clear(); }
+
+private:
+    struct FileKeyHash {
+        size_t operator()(const std::pair<uint64_t, uint64_t>& key) const {
+            return std::hash<uint64_t>()(key.second * 0x9E3779B97F4A7C15ull ^ key.first);
+        }
+    };
+
+    std::unordered_set<std::pair<uint64_t, uint64_t>, FileKeyHash> files;
+};
+
+/**
+ * @brief Check whether a failed delete was caused by another process using the file
+ * @param error Error code of the failed operation
+ * @return True for sharing/lock violations and busy files
+ */
+bool isFileInUseError(const std::error_code& error);
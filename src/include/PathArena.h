@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Non-owning view of a native path string
+ */
+using PathView = std::basic_string_view<std::filesystem::path::value_type>;
+
+/**
+ * @brief Monotonic arena for the native path strings of one scan
+ *
+ * Strings are copied into large blocks from a std::pmr monotonic buffer and
+ * never freed individually; the returned views stay valid until the arena is
+ * destroyed. A scan owns one arena on its scanning thread, so the arena is
+ * not thread-safe. Views are turned back into std::filesystem::path only
+ * where a path is actually handed to the file system or printed.
+ */
+class PathArena {
+public:
+    /**
+     * @param blockSize Size of the first block, later blocks grow geometrically
+     */
+    explicit PathArena(size_t blockSize = 64 * 1024);
+    PathArena(const PathArena&) = delete;
+    PathArena& operator=(const PathArena&) = delete;
+
+    /**
+     * @brief Copy a path string into the arena
+     * @param text Native path string
+     * @return View of the copy, valid for the lifetime of the arena
+     */
+    PathView store(PathView text);
+
+    /**
+     * @brief Memory resource for containers that live as long as the arena
+     */
+    std::pmr::memory_resource* resource() { return &arena; }
+
+    /**
+     * @brief Number of path bytes stored so far
+     */
+    size_t getBytesStored() const { return bytesStored; }
+
+private:
+    std::pmr::monotonic_buffer_resource arena;
+    size_t bytesStored = 0;
+};
+
+/**
+ * @brief Convert a path to UTF-8 for logs and reports
+ *
+ * Lossless on every platform, unlike narrowing each wide character; on
+ * POSIX the native bytes are returned unchanged.
+ */
+std::string toUtf8(const std::filesystem::path& path);
+
+/**
+ * @brief Append one code point to a string as UTF-8
+ *
+ * The caller checks that the code point is valid; surrogates and values
+ * above U+10FFFF are not replaced here.
+ */
+void appendUtf8(std::string& out, uint32_t code);
+
+/**
+ * @brief Convert wide text that is not a path, such as a registry key name, to UTF-8
+ *
+ * wchar_t holds UTF-16 on Windows and UTF-32 elsewhere. Unpaired surrogates
+ * and invalid code points become U+FFFD. Unlike std::filesystem::path, this
+ * does not depend on the locale, which cannot convert non-ASCII text in the
+ * default "C" locale on POSIX.
+ */
+std::string wideToUtf8(const std::wstring& text);
+
+/**
+ * @brief Decode UTF-8 into wide text, the inverse of wideToUtf8()
+ *
+ * Invalid sequences become U+FFFD, one per byte.
+ */
+std::wstring utf8ToWide(const std::string& text);
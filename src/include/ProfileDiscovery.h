@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Cache layout a browser uses for its profiles
+ */
+enum class BrowserFamily {
+    Chromium,   ///< Simple Cache directories per profile, profiles listed in Local State
+    Firefox     ///< cache2 directory per profile, profiles listed in profiles.ini
+};
+
+/**
+ * @brief Per-user base directories browsers keep their data under
+ *
+ * On Windows configDir is the roaming and cacheDir the local application
+ * data folder; elsewhere they are the XDG config and cache homes.
+ *
+ * The homes of other accounts are confined: their owners control every file
+ * in them, so a cache directory is only used if it lies inside the home, no
+ * component below the home is a symlink (or junction), and on POSIX the
+ * directory belongs to the account.
+ */
+struct UserDirectories {
+    std::string user;                   ///< Account name, informational
+    std::filesystem::path home;         ///< Home or profile directory
+    std::filesystem::path configDir;    ///< Roaming AppData or ~/.config
+    std::filesystem::path cacheDir;     ///< Local AppData or ~/.cache
+    bool confined = false;              ///< Home of another account, see above
+    uint64_t owner = 0;                 ///< User id cache directories of a confined home must have
+};
+
+/**
+ * @brief A browser profile found on disk together with its cache directories
+ */
+struct BrowserProfile {
+    std::string browserName;            ///< Display name, e.g. "Google Chrome"
+    BrowserFamily family = BrowserFamily::Chromium;
+    std::string user;                   ///< Owner of the profile
+    std::string profileName;            ///< Profile directory name, e.g. "Profile 1"
+    std::vector<std::filesystem::path> cacheDirs;  ///< Existing cache directories of the profile
+};
+
+/**
+ * @brief Entry of a Firefox profiles.ini [ProfileN] section
+ */
+struct FirefoxProfileEntry {
+    std::string path;                   ///< Path= value
+    bool relative = true;               ///< IsRelative= value, relative to the Firefox data directory
+};
+
+/**
+ * @brief Names of all supported browsers in cleaning order
+ */
+std::vector<std::string> supportedBrowsers();
+
+/**
+ * @brief Family of a supported browser
+ * @param browserName Name as returned by supportedBrowsers()
+ * @return Family, Chromium for unknown names
+ */
+BrowserFamily browserFamily(const std::string& browserName);
+
+/**
+ * @brief Base directories of the platform default layout below a home directory
+ * @param home Home or profile directory of the user
+ * @param user Account name
+ */
+UserDirectories userDirectoriesForHome(const std::filesystem::path& home, const std::string& user);
+
+/**
+ * @brief Enumerate the users whose browser profiles should be cleaned
+ *
+ * The current user's directories honour the known-folder settings
+ * (XDG_CONFIG_HOME/XDG_CACHE_HOME, or the shell folders on Windows). With
+ * allUsers set every other local account is added with the default layout:
+ * the directories below the Users folder on Windows, and the passwd entries
+ * of regular accounts and root elsewhere. These homes are confined. Homes
+ * that do not exist are skipped, homes that are not readable simply yield
+ * no profiles later.
+ *
+ * @param allUsers True to include every account on the host
+ */
+std::vector<UserDirectories> findUserDirectories(bool allUsers);
+
+/**
+ * @brief Find every browser profile of one user
+ *
+ * Chromium profiles are read from the profile.info_cache dictionary of the
+ * browser's Local State file, falling back to the "Default" and "Profile N"
+ * directories when the file is missing or unreadable. Firefox profiles are
+ * read from profiles.ini, falling back to every profile directory holding a
+ * cache2 directory. Profiles without any existing cache directory are
+ * omitted, and so are cache directories a confined home does not vouch for.
+ */
+std::vector<BrowserProfile> discoverProfiles(const UserDirectories& user);
+
+/**
+ * @brief Find the browser profiles of several users in parallel
+ * @return Profiles ordered by user, then browser
+ */
+std::vector<BrowserProfile> discoverProfiles(const std::vector<UserDirectories>& users);
+
+/**
+ * @brief Extract the profile directory names from a Chromium Local State file
+ *
+ * Names that are empty or would escape the user data directory are dropped.
+ *
+ * @param json Contents of Local State
+ * @return Keys of profile.info_cache in file order, empty if absent or malformed
+ */
+std::vector<std::string> parseLocalStateProfiles(const std::string& json);
+
+/**
+ * @brief Extract the profile entries from a Firefox profiles.ini file
+ * @param text Contents of profiles.ini
+ * @return One entry per [ProfileN] section with a Path= key
+ */
+std::vector<FirefoxProfileEntry> parseProfilesIni(const std::string& text);
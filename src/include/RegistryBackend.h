@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Registry value types, numerically identical to the Win32 REG_* constants
+ */
+namespace RegistryType {
+    constexpr uint32_t None = 0;
+    constexpr uint32_t String = 1;
+    constexpr uint32_t ExpandString = 2;
+    constexpr uint32_t Binary = 3;
+    constexpr uint32_t DWord = 4;
+    constexpr uint32_t MultiString = 7;
+    constexpr uint32_t QWord = 11;
+}
+
+/**
+ * @brief Predefined root a registry path is relative to
+ */
+enum class RegistryRoot {
+    CurrentUser,
+    LocalMachine
+};
+
+/**
+ * @brief Access requested when opening a key
+ */
+enum class RegistryAccess {
+    Read,       ///< Enumerate and read only
+    Write,      ///< Modify an existing key
+    Create      ///< Modify, creating missing keys along the path
+};
+
+/**
+ * @brief A named registry value with its raw data
+ */
+struct RegistryValue {
+    std::wstring name;
+    uint32_t type = RegistryType::None;
+    std::vector<uint8_t> data;
+};
+
+/**
+ * @brief An open registry key
+ *
+ * The key stays open for the lifetime of the object, so all operations on it
+ * and its children reuse one handle instead of reopening the path.
+ */
+class RegistryKey {
+public:
+    virtual ~RegistryKey() = default;
+
+    /**
+     * @brief Collect the values of the key
+     * @param values Receives one entry per value
+     * @param withData False to fetch only names and types
+     * @return False if the key cannot be enumerated
+     */
+    virtual bool listValues(std::vector<RegistryValue>& values, bool withData) const = 0;
+
+    /**
+     * @brief Collect the names of the direct subkeys
+     * @param names Receives the subkey names
+     * @return False if the key cannot be enumerated
+     */
+    virtual bool listSubKeys(std::vector<std::wstring>& names) const = 0;
+
+    /**
+     * @brief Open a direct or nested subkey relative to this key
+     * @param path Subkey path, components separated by backslashes
+     * @param access Requested access
+     * @return Null if the subkey does not exist or cannot be opened
+     */
+    virtual std::unique_ptr<RegistryKey> openSubKey(const std::wstring& path, RegistryAccess access) = 0;
+
+    virtual bool setValue(const RegistryValue& value) = 0;
+    virtual bool deleteValue(const std::wstring& name) = 0;
+
+    /**
+     * @brief Delete a subkey together with everything below it
+     * @param name Name of the direct subkey
+     * @return False if the subkey could not be deleted
+     */
+    virtual bool deleteTree(const std::wstring& name) = 0;
+};
+
+/**
+ * @brief Source of registry keys used by the registry cleaner
+ */
+class RegistryBackend {
+public:
+    virtual ~RegistryBackend() = default;
+
+    /**
+     * @brief Open a key below one of the predefined roots
+     * @param root Predefined root
+     * @param path Key path, components separated by backslashes
+     * @param access Requested access
+     * @return Null if the key does not exist or cannot be opened
+     */
+    virtual std::unique_ptr<RegistryKey> openKey(RegistryRoot root, const std::wstring& path,
+                                                 RegistryAccess access) = 0;
+};
+
+/**
+ * @brief Registry hive held entirely in memory
+ *
+ * Behaves like the Win32 registry (case-insensitive names, deleted keys stay
+ * valid but empty for open handles) and works on every platform, so registry
+ * cleaning can be tested and benchmarked without Windows. Every key
+ * operation is counted to compare API round trips.
+ */
+class MemoryRegistry : public RegistryBackend {
+public:
+    struct Node;
+
+    MemoryRegistry();
+
+    std::unique_ptr<RegistryKey> openKey(RegistryRoot root, const std::wstring& path,
+                                         RegistryAccess access) override;
+
+    /**
+     * @brief Get the number of operations issued against the hive
+     */
+    uint64_t getCallCount() const;
+
+private:
+    friend class MemoryRegistryKey;
+
+    std::shared_ptr<Node> currentUser;
+    std::shared_ptr<Node> localMachine;
+    std::mutex mutex;
+    std::atomic<uint64_t> calls;
+};
+
+#ifdef _WIN32
+/**
+ * @brief Registry backend on top of the Win32 registry API
+ */
+class Win32Registry : public RegistryBackend {
+public:
+    std::unique_ptr<RegistryKey> openKey(RegistryRoot root, const std::wstring& path,
+                                         RegistryAccess access) override;
+};
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "RegistryBackend.h"
+
+/**
+ * @brief Complete copy of a registry key tree that can be saved and restored
+ *
+ * A snapshot holds every value of every key below its root path, whatever
+ * the value type or size. The binary file starts with a magic/version
+ * header, stores names as varint-encoded UTF-16 code units and ends with a
+ * CRC-32 of the contents. Capture and restore go through a RegistryBackend,
+ * so they run in-process and work against the in-memory hive as well.
+ */
+class RegistrySnapshot {
+public:
+    /**
+     * @brief Read a key and everything below it
+     * @param backend Registry to read from
+     * @param root Predefined root of the key
+     * @param path Path of the key below the root
+     * @return False if the key or one of its subkeys cannot be read
+     */
+    bool capture(RegistryBackend& backend, RegistryRoot root, const std::wstring& path);
+
+    /**
+     * @brief Write the captured tree back, creating missing keys
+     *
+     * Existing values with the same names are overwritten; values and keys
+     * that are not part of the snapshot are left alone.
+     *
+     * @param backend Registry to write to
+     * @return False if any key or value could not be written
+     */
+    bool restore(RegistryBackend& backend);
+
+    bool save(const std::filesystem::path& file) const;
+    bool load(const std::filesystem::path& file);
+
+    RegistryRoot getRoot() const { return root; }
+    const std::wstring& getPath() const { return path; }
+    size_t getKeyCount() const;
+    size_t getValueCount() const;
+
+    /**
+     * @brief Describe the last failure of capture, restore or load
+     */
+    const std::string& getError() const { return error; }
+
+private:
+    struct Node {
+        std::wstring name;
+        std::vector<RegistryValue> values;
+        std::vector<Node> children;
+    };
+
+    bool captureKey(RegistryKey& key, Node& node, const std::wstring& keyPath);
+    bool restoreKey(RegistryKey& key, const Node& node, const std::wstring& keyPath);
+
+    RegistryRoot root = RegistryRoot::CurrentUser;
+    std::wstring path;
+    Node tree;
+    std::string error;
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+#include "CleaningEngine.h"
+
+/**
+ * @brief What happens to the files a rule selects
+ */
+enum class RuleAction {
+    Delete,     ///< Delete the file
+    Report,     ///< Only log and count the file
+    Keep        ///< Protect the file from every other rule
+};
+
+/**
+ * @brief One rule of a rule file
+ *
+ * A file is selected when it lies below one of the roots (directly below
+ * them for non-recursive rules) and passes every filter that is set.
+ */
+struct CleaningRule {
+    std::string name;
+    std::vector<std::filesystem::path> roots;
+    std::vector<std::string> globs;             ///< Any may match; without '/' only the file name is matched
+    std::vector<std::string> extensions;        ///< Lowercase, without dot; empty for any
+    std::vector<std::string> excludedExtensions;
+    int64_t minAgeSeconds = 0;                  ///< Only files not modified for this long
+    uint64_t minSize = 0;
+    uint64_t maxSize = std::numeric_limits<uint64_t>::max();
+    bool recursive = true;
+    RuleAction action = RuleAction::Delete;
+};
+
+/**
+ * @brief Parse the text of a rule file
+ *
+ * The format is INI-like: every `[name]` section is a rule, keys are
+ * `root` and `glob` (both repeatable), `extensions` and
+ * `exclude-extensions` (comma-separated), `min-age` (number with s, m, h or
+ * d; days by default), `min-size` and `max-size` (bytes with K, M or G),
+ * `recursive` (yes/no) and `action` (delete, report or keep). Lines
+ * starting with '#' or ';' are comments. A leading `~` and `${VAR}` in roots
+ * are expanded from the environment.
+ *
+ * @param text Contents of the rule file
+ * @param rules Receives the rules in file order
+ * @param error Receives "line N: reason" when parsing fails
+ * @return False on the first invalid line or a rule without roots
+ */
+bool parseRules(const std::string& text, std::vector<CleaningRule>& rules, std::string& error);
+
+/**
+ * @brief Read and parse a rule file, see parseRules()
+ */
+bool loadRules(const std::filesystem::path& path, std::vector<CleaningRule>& rules, std::string& error);
+
+/**
+ * @brief Match a glob against a path: `*` and `?` stay within one path
+ * component, `**` spans components
+ */
+bool globMatch(const std::filesystem::path::string_type& pattern, const std::filesystem::path::string_type& text);
+
+/**
+ * @brief Rules compiled for a single walk
+ *
+ * Roots of all rules are merged: a root below another one is walked as part
+ * of it, so every tree is listed once no matter how many rules cover it.
+ * Each merged root keeps the rules that apply somewhere below it; a file
+ * found under merged root i (FileEntry::rootSet == i) is only tested against
+ * those.
+ */
+class RulePlan {
+public:
+    /**
+     * @brief Outcome of matching one file
+     */
+    struct Match {
+        RuleAction action = RuleAction::Keep;
+        int rule = -1;          ///< Index of the deciding rule, -1 if none selects the file
+    };
+
+    RulePlan() = default;
+    explicit RulePlan(std::vector<CleaningRule> rules);
+
+    /**
+     * @brief Roots to walk, one root set each
+     */
+    const std::vector<std::filesystem::path>& getRoots() const { return roots; }
+
+    /**
+     * @brief True if some rule needs more than the direct children of a root
+     */
+    bool isRecursive() const { return recursive; }
+
+    const std::vector<CleaningRule>& getRules() const { return rules; }
+
+    /**
+     * @brief Decide what happens to a file found while walking getRoots()
+     *
+     * A matching keep rule wins; otherwise the first matching delete rule,
+     * then the first matching report rule, in file order.
+     *
+     * @param entry File with its rootSet set to the index of its root
+     * @param now Current time in seconds since the Unix epoch
+     */
+    Match match(const FileEntry& entry, std::time_t now) const;
+
+private:
+    using NativeString = std::filesystem::path::string_type;
+
+    struct CompiledRule {
+        std::vector<NativeString> paths;        ///< Globs matched against the path below the root
+        std::vector<NativeString> names;        ///< Globs matched against the file name
+        std::vector<NativeString> extensions;
+        std::vector<NativeString> excludedExtensions;
+    };
+
+    // A rule root below a merged root
+    struct Binding {
+        size_t rule;
+        NativeString root;
+    };
+
+    bool accepts(const Binding& binding, const FileEntry& entry, std::time_t now) const;
+
+    std::vector<CleaningRule> rules;
+    std::vector<CompiledRule> compiled;
+    std::vector<std::filesystem::path> roots;
+    std::vector<std::vector<Binding>> bindings;     ///< Per merged root, in rule order
+    bool recursive = false;
+};
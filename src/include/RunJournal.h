@@ -0,0 +1,122 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Progress of one cleaning or backup run, rebuilt from the journal
+ */
+struct JournalRun {
+    std::string operation;                              ///< Operation type ("temp", "browser", ...)
+    std::string backupPath;                             ///< Backup directory, empty if no backup was started
+    std::string timestamp;                              ///< Backup creation timestamp
+    std::vector<std::string> backedUpFiles;             ///< Files copied into the backup
+    uint64_t backupBytes = 0;                           ///< Total size of the copied files
+    std::unordered_set<std::string> backupDirectories;  ///< Directories whose files are all backed up
+    std::unordered_set<std::string> cleanedDirectories; ///< Roots that were cleaned completely
+    int filesDeleted = 0;                               ///< Files deleted before the interruption
+    uint64_t bytesFreed = 0;                            ///< Bytes freed before the interruption
+    bool backupComplete = false;                        ///< Backup phase finished
+    bool finished = false;                              ///< Whole run finished
+};
+
+/**
+ * @brief Write-ahead journal of completed work for resumable runs
+ *
+ * Every record is framed with its length and a CRC-32, so a record torn by a
+ * crash is detected and dropped on the next open together with everything
+ * after it. Records are buffered in memory and a background thread writes and
+ * fsyncs them in groups, either when the commit interval elapses or when
+ * enough records are pending. sync() is a barrier for callers that must know
+ * their records are durable, e.g. before deleting files that were backed up.
+ */
+class RunJournal {
+public:
+    RunJournal();
+    ~RunJournal();
+
+    RunJournal(const RunJournal&) = delete;
+    RunJournal& operator=(const RunJournal&) = delete;
+
+    /**
+     * @brief Open or create a journal and replay its valid records
+     * @param file Journal path
+     * @param runs Receives every run recorded in the journal
+     * @return False if the journal cannot be opened for appending
+     */
+    bool open(const std::filesystem::path& file, std::vector<JournalRun>& runs);
+
+    /**
+     * @brief Commit pending records and close the journal
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * @brief Set how long records may wait before a group commit
+     * @param interval Maximum delay between commits
+     */
+    void setCommitInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief Set how many pending records trigger an early commit
+     * @param records Record count, at least 1
+     */
+    void setCommitBatch(size_t records);
+
+    void beginRun(const std::string& operation);
+    void recordBackupStarted(const std::string& backupPath, const std::string& timestamp);
+    void recordBackedUp(const std::string& source, uint64_t size);
+    void recordBackupDirectory(const std::string& directory);
+    void recordBackupComplete();
+    void recordDeleted(uint64_t size);
+    void recordCleanedDirectory(const std::string& directory);
+    void finishRun();
+
+    /**
+     * @brief Block until every record appended so far is on stable storage
+     * @return False if a write or fsync failed
+     */
+    bool sync();
+
+    /**
+     * @brief Discard all records once no run needs resuming
+     * @return False if the journal cannot be truncated
+     */
+    bool reset();
+
+    /**
+     * @brief Get the number of fsyncs issued since the journal was opened
+     */
+    uint64_t getSyncCount() const;
+
+private:
+    void append(uint8_t type, uint64_t value, const std::string& text = std::string());
+    void flusherLoop();
+    void commit(std::unique_lock<std::mutex>& lock);
+
+    std::filesystem::path path;
+    std::FILE* file = nullptr;
+    std::thread flusher;
+    std::string pending;
+    size_t pendingRecords = 0;
+    uint64_t appended = 0;
+    uint64_t durable = 0;
+    uint64_t syncs = 0;
+    bool syncRequested = false;
+    bool stopping = false;
+    bool failed = false;
+    std::chrono::milliseconds commitInterval;
+    size_t commitBatch;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable committed;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include "CleaningEngine.h"
+
+/**
+ * @brief What overwriting a file achieved
+ */
+enum class EraseOutcome {
+    Overwritten,    ///< Every allocated byte was overwritten in place
+    Sparse,         ///< The data extents were overwritten, holes hold nothing to erase
+    CopyOnWrite,    ///< Not overwritten: the file system writes new blocks, old ones survive
+    Compressed,     ///< Not overwritten: compressed clusters are reallocated on write
+    HardLinked,     ///< Not overwritten: other names of the file still need its contents
+    Missing         ///< The file no longer exists
+};
+
+/**
+ * @brief Totals of a SecureEraser, snapshot of its counters
+ */
+struct SecureEraseStats {
+    uint64_t filesOverwritten = 0;  ///< Fully or, for sparse files, extent-wise overwritten
+    uint64_t bytesOverwritten = 0;
+    uint64_t sparseFiles = 0;       ///< Included in filesOverwritten
+    uint64_t copyOnWriteFiles = 0;  ///< Left to plain deletion
+    uint64_t compressedFiles = 0;   ///< Left to plain deletion
+    uint64_t hardLinkedFiles = 0;   ///< Left to plain deletion
+    uint64_t bufferedFiles = 0;     ///< Written through the page cache, direct I/O was refused
+};
+
+/**
+ * @brief Overwrites file contents before they are unlinked
+ *
+ * Each file is opened for direct I/O where the file system allows it and
+ * overwritten with zeros in large aligned chunks, then synced. For sparse
+ * files only the data extents are written. Files whose old blocks would
+ * survive an overwrite (copy-on-write or compressed file systems) and files
+ * with other hard links are not written and are reported instead; deleting
+ * them is up to the caller. Flash drives may remap overwritten blocks as
+ * well, which no file-level overwrite can detect.
+ *
+ * The eraser is stateless per file, so one instance serves every worker
+ * thread of a cleaning pass and files are erased in parallel.
+ */
+class SecureEraser {
+public:
+    static constexpr size_t kChunkSize = size_t(1) << 20;   ///< Bytes per write
+    static constexpr size_t kAlignment = 4096;              ///< Direct I/O offset and length alignment
+
+    /**
+     * @brief Overwrite a file found by a scan
+     * @param entry File to overwrite; only its path and device are used
+     * @param ec Set if the file cannot be opened or written; a busy file sets
+     *        an error isFileInUseError() recognizes
+     * @return What was done; Missing without an error if the file is gone,
+     *         meaningless when ec is set
+     */
+    EraseOutcome overwrite(const FileEntry& entry, std::error_code& ec);
+
+    SecureEraseStats getStats() const;
+    void resetStats();
+
+private:
+    std::mutex mutex;
+    std::unordered_map<uint64_t, bool> copyOnWriteDevices;     ///< Per device, detected once
+    std::atomic<uint64_t> filesOverwritten{0};
+    std::atomic<uint64_t> bytesOverwritten{0};
+    std::atomic<uint64_t> sparseFiles{0};
+    std::atomic<uint64_t> copyOnWriteFiles{0};
+    std::atomic<uint64_t> compressedFiles{0};
+    std::atomic<uint64_t> hardLinkedFiles{0};
+    std::atomic<uint64_t> bufferedFiles{0};
+};
+
+/**
+ * @brief Printable reason for an outcome, e.g. "copy-on-write file system"
+ */
+const char* eraseOutcomeName(EraseOutcome outcome);
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "CacheEvictionPolicy.h"
+
+/**
+ * @brief One entry of a Chromium Simple Cache index
+ */
+struct SimpleCacheEntry {
+    uint64_t hash = 0;              ///< Entry hash, names the entry files
+    int64_t lastUsed = 0;           ///< Last use in Chromium time (microseconds since 1601)
+    uint64_t size = 0;              ///< Size on disk as recorded in the index
+};
+
+/**
+ * @brief Reader and writer of the Simple Cache index (index-dir/the-real-index)
+ *
+ * The index is a Chromium pickle: a payload size and CRC-32 header followed
+ * by the magic number, format version, entry count, total size, one record
+ * per entry (hash, last-used time, size) and the last-modified time.
+ * Versions 7 to 9 are understood. Saving writes a temporary file next to
+ * the index and renames it over the original, as Chromium does.
+ */
+class SimpleCacheIndex {
+public:
+    /**
+     * @brief Check whether a directory holds a Simple Cache
+     */
+    static bool isSimpleCache(const std::filesystem::path& directory);
+
+    /**
+     * @brief Find Simple Cache directories at or directly below a path
+     *
+     * Covers "Cache" as well as its "Cache_Data" subdirectory and the "js"
+     * and "wasm" caches below "Code Cache".
+     */
+    static std::vector<std::filesystem::path> find(const std::filesystem::path& root);
+
+    /**
+     * @brief List the files that store an entry (stream 0/1, stream 2 and sparse data)
+     */
+    static std::vector<std::filesystem::path> entryFiles(const std::filesystem::path& directory, uint64_t hash);
+
+    bool load(const std::filesystem::path& directory);
+    bool save(const std::filesystem::path& directory) const;
+
+    std::vector<SimpleCacheEntry>& getEntries() { return entries; }
+    const std::vector<SimpleCacheEntry>& getEntries() const { return entries; }
+    uint32_t getVersion() const { return version; }
+    void setVersion(uint32_t value) { version = value; }
+    const std::string& getError() const { return error; }
+
+private:
+    std::vector<SimpleCacheEntry> entries;
+    uint32_t version = 9;
+    uint32_t reason = 0;
+    std::string error;
+};
+
+/**
+ * @brief Convert a Unix time to Chromium's internal time value
+ */
+int64_t toChromiumTime(std::time_t time);
+
+/**
+ * @brief Pick the entries a policy evicts
+ * @param entries Entries of the index
+ * @param policy Age limit and size budget
+ * @param now Current time in Chromium time
+ * @return Entries to evict, least recently used first
+ */
+std::vector<SimpleCacheEntry> selectCacheEvictions(std::vector<SimpleCacheEntry> entries,
+                                                   const CacheEvictionPolicy& policy, int64_t now);
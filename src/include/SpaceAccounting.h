@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "CleaningEngine.h"
+
+/**
+ * @brief Hardlink- and allocation-aware tally of freed space
+ *
+ * Logical bytes count the size of every distinct file once, no matter how
+ * many of its links are removed. Physical bytes count the blocks actually
+ * allocated on disk and are only credited once the last link of a file is
+ * gone, so sparse files and partially removed hardlink sets are not
+ * overcounted. Files with more than one link are tracked by (device, inode)
+ * in a sharded hash map; single-link files never touch the map.
+ *
+ * One instance covers a whole pass, so links removed through different root
+ * sets or rules still meet in the same map. The bytes are credited to the
+ * bucket that removed the first (logical) or last (physical) link.
+ *
+ * record() is thread-safe.
+ */
+class SpaceAccounting {
+public:
+    /**
+     * @brief Create a tally
+     * @param buckets Number of buckets the freed bytes are credited to
+     */
+    explicit SpaceAccounting(size_t buckets = 1);
+
+    /**
+     * @brief Account for one removed entry
+     * @param entry Entry as scanned, with its link count and allocation
+     * @param bucket Bucket credited with the bytes this removal frees
+     */
+    void record(const FileEntry& entry, size_t bucket = 0);
+
+    uint64_t getLogicalBytes(size_t bucket = 0) const;
+    uint64_t getPhysicalBytes(size_t bucket = 0) const;
+
+private:
+    struct InodeKey {
+        uint64_t device;
+        uint64_t inode;
+        bool operator==(const InodeKey& other) const {
+            return device == other.device && inode == other.inode;
+        }
+    };
+
+    struct InodeKeyHash {
+        size_t operator()(const InodeKey& key) const {
+            return std::hash<uint64_t>()(key.inode * 0x9E3779B97F4A7C15ull ^ key.device);
+        }
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<InodeKey, uint32_t, InodeKeyHash> removedLinks;
+    };
+
+    struct Bucket {
+        std::atomic<uint64_t> logicalBytes{0};
+        std::atomic<uint64_t> physicalBytes{0};
+    };
+
+    static constexpr size_t kShards = 32;
+
+    std::array<Shard, kShards> shards;
+    std::vector<Bucket> buckets;
+};
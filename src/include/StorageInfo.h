@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief Kind of storage backing a device
+ */
+enum class StorageType {
+    Unknown,    ///< Detection failed, treated conservatively
+    Rotational, ///< Spinning disk, seeks are expensive
+    SolidState, ///< SSD or NVMe, benefits from deep queues
+    Network     ///< Remote filesystem, latency-bound
+};
+
+/**
+ * @brief Get a printable name for a storage type
+ * @param type Storage type
+ * @return Short name ("hdd", "ssd", "network" or "unknown")
+ */
+const char* storageTypeName(StorageType type);
+
+/**
+ * @brief Parse a storage type name as accepted on the command line
+ * @param name One of "hdd", "ssd" or "network"
+ * @param type Receives the parsed type
+ * @return True if the name was recognized
+ */
+bool parseStorageType(const std::string& name, StorageType& type);
+
+/**
+ * @brief Get an identifier of the device holding a path
+ *
+ * Returns st_dev on POSIX and the volume serial number on Windows.
+ *
+ * @param path Existing file or directory
+ * @param device Receives the device identifier
+ * @return True on success
+ */
+bool getDeviceId(const std::filesystem::path& path, uint64_t& device);
+
+/**
+ * @brief Detect the storage type of the device holding a path
+ *
+ * On Linux network filesystems are recognized by statfs magic and local
+ * block devices by /sys/dev/block/<major>:<minor>/queue/rotational. On
+ * Windows remote drives are recognized by drive type and local ones by the
+ * seek penalty storage property.
+ *
+ * @param path Existing file or directory
+ * @return Detected storage type, Unknown if it cannot be determined
+ */
+StorageType detectStorageType(const std::filesystem::path& path);
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Strip leading and trailing spaces, tabs and line breaks
+ */
+std::string trim(const std::string& text);
+
+/**
+ * @brief Parse a non-negative number with an optional K, M or G suffix (powers of 1024)
+ *
+ * The text must start with a digit, so signs and leading whitespace are
+ * rejected, and a suffix that would overflow 64 bits fails.
+ * @param text Text to parse, such as "512" or "10M"
+ * @param value Receives the number of bytes
+ * @return true if the whole text is a valid size
+ */
+bool parseSize(const std::string& text, uint64_t& value);
+
+/**
+ * @brief Parse a plain non-negative integer: digits only, no sign or suffix
+ * @param text Text to parse
+ * @param value Receives the number
+ * @return true if the whole text is a number that fits 64 bits
+ */
+bool parseCount(const std::string& text, uint64_t& value);
+
+/**
+ * @brief Escape text for use inside a JSON string literal
+ *
+ * Quotes and backslashes are escaped and control characters written as
+ * \uXXXX; other bytes, including UTF-8 sequences, are copied unchanged.
+ */
+std::string escapeJson(const std::string& value);
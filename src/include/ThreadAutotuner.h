@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+
+/**
+ * @brief Outcome of one autotuner step
+ */
+struct TuningDecision {
+    size_t previousThreads = 0;     ///< Worker count before the step
+    size_t threads = 0;             ///< Worker count to use from now on
+    double throughput = 0.0;        ///< Measured files per second
+    double latency = 0.0;           ///< Measured mean operation latency in seconds
+    const char* reason = "";        ///< Why the count changed or stayed
+};
+
+/**
+ * @brief Feedback controller choosing a worker count from observed throughput
+ *
+ * Hill climbing with AIMD safeguards: the controller adds one worker while
+ * each addition still improves files/sec, steps back when it stops paying
+ * off, and halves the count when operation latency rises well above the
+ * best latency seen so far. After a step back it holds for a few intervals
+ * before probing upwards again, so a shifting workload is tracked over time.
+ */
+class ThreadAutotuner {
+public:
+    /**
+     * @brief Create a controller
+     * @param initialThreads Starting worker count
+     * @param minThreads Lower bound, at least 1
+     * @param maxThreads Upper bound, at least minThreads
+     */
+    ThreadAutotuner(size_t initialThreads, size_t minThreads, size_t maxThreads);
+
+    /**
+     * @brief Feed one measurement interval and get the next worker count
+     * @param throughput Files completed per second during the interval
+     * @param latency Mean operation latency in seconds during the interval
+     * @return Decision including the new worker count and its reason
+     */
+    TuningDecision update(double throughput, double latency);
+
+    size_t getThreads() const;
+
+private:
+    enum class Phase { Probing, Holding };
+
+    size_t threads;
+    size_t minThreads;
+    size_t maxThreads;
+    Phase phase;
+    size_t holdIntervals;
+    double lastThroughput;
+    double bestLatency;
+    bool hasSample;
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One finished span of a trace
+ */
+struct TraceEvent {
+    std::string name;
+    const char* category = "";
+    uint64_t start = 0;         ///< Nanoseconds since the tracer was created
+    uint64_t duration = 0;      ///< Nanoseconds
+    const char* argName = nullptr;  ///< Optional numeric argument shown with the span
+    uint64_t argValue = 0;
+};
+
+/**
+ * @brief Collects spans in the Chrome trace-event format
+ *
+ * Every thread appends to its own buffer, so recording never contends with
+ * other threads; the buffers are only merged when the trace is written.
+ * While disabled a span costs one relaxed load. Each thread keeps at most
+ * kMaxEventsPerThread spans, later ones are counted as dropped.
+ */
+class Tracer {
+public:
+    static constexpr size_t kMaxEventsPerThread = size_t(1) << 20;
+
+    static Tracer& getInstance();
+
+    void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Nanoseconds since the tracer was created
+     */
+    uint64_t now() const;
+
+    /**
+     * @brief Add a finished span to the calling thread's buffer
+     */
+    void record(TraceEvent event);
+
+    /**
+     * @brief Merge every thread's spans and write them as a trace-event JSON file
+     * @return False if the file cannot be written
+     */
+    bool write(const std::string& path) const;
+
+    /**
+     * @brief Render the merged spans, ordered by start time
+     */
+    std::string toJson() const;
+
+    size_t getEventCount() const;
+    uint64_t getDroppedCount() const { return dropped.load(); }
+
+    /**
+     * @brief Forget all spans and the buffers of finished threads
+     */
+    void reset();
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;   ///< Only contended while the trace is merged
+        std::vector<TraceEvent> events;
+        uint32_t thread = 0;
+    };
+
+    Tracer();
+    ThreadBuffer& localBuffer();
+
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<bool> enabled{false};
+    std::atomic<uint64_t> dropped{0};
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    uint32_t nextThread = 0;
+};
+
+/**
+ * @brief Records the enclosing scope as one span
+ *
+ * Names given as literals are only copied when the span is recorded.
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const char* category = "cleaner");
+    explicit TraceScope(std::string name, const char* category = "cleaner");
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    /**
+     * @brief Attach a number, e.g. the file count of a batch
+     * @param name Argument name, must outlive the scope
+     */
+    void setArgument(const char* name, uint64_t value) {
+        argName = name;
+        argValue = value;
+    }
+
+private:
+    const char* literal = nullptr;
+    std::string name;
+    const char* category;
+    uint64_t start = 0;
+    bool active;
+    const char* argName = nullptr;
+    uint64_t argValue = 0;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One trashed item: a file or directory under files/ and its .trashinfo
+ */
+struct TrashItem {
+    std::filesystem::path file;     ///< Path of the item below files/
+    std::filesystem::path info;     ///< Path of the matching .trashinfo file
+    std::string originalPath;       ///< Decoded Path= key, where the item came from
+    std::time_t deletionTime = 0;   ///< Decoded DeletionDate= key, 0 if missing
+    uint64_t size = 0;              ///< Logical size, summed over directory contents
+    uint64_t allocated = 0;         ///< Allocated bytes, summed over directory contents
+    uint64_t device = 0;            ///< Device holding the trash directory
+    uint64_t inode = 0;             ///< Inode of the item itself
+};
+
+/**
+ * @brief Which trashed items to purge
+ *
+ * With neither limit set everything is purged. Otherwise items older than
+ * maxAgeDays go first, then the oldest remaining items until the total size
+ * fits maxBytes.
+ */
+struct TrashPurgePolicy {
+    int maxAgeDays = 0;             ///< Purge items deleted more than this many days ago, 0 for no age limit
+    uint64_t maxBytes = std::numeric_limits<uint64_t>::max();  ///< Size budget for what stays in the trash
+};
+
+/**
+ * @brief Freedesktop.org trash directory ($XDG_DATA_HOME/Trash or a per-mount .Trash-$uid)
+ *
+ * Items are read from the .trashinfo files in info/ and sized from files/.
+ * Entries of files/ without a .trashinfo are left alone.
+ */
+class TrashBin {
+public:
+    explicit TrashBin(std::filesystem::path directory) : directory(std::move(directory)) {}
+
+    /**
+     * @brief Locate every trash directory of the current user
+     *
+     * Returns the home trash and, for each mount point, $topdir/.Trash/$uid
+     * (only if .Trash is a sticky, non-symlink directory) and
+     * $topdir/.Trash-$uid, if they exist.
+     */
+    static std::vector<std::filesystem::path> findAll();
+
+    /**
+     * @brief Parse the trash and size its items
+     * @param items Receives one entry per readable .trashinfo with an existing item
+     * @return False if the info directory cannot be read
+     */
+    bool load(std::vector<TrashItem>& items) const;
+
+    /**
+     * @brief Delete an item and then its .trashinfo
+     * @param file Path of the item below files/
+     * @return False if the item could not be removed; its .trashinfo is then kept
+     */
+    static bool purge(const std::filesystem::path& file);
+
+    /**
+     * @brief Drop directorysizes cache lines of items that no longer exist
+     */
+    bool pruneDirectorySizes() const;
+
+    const std::filesystem::path& getDirectory() const { return directory; }
+
+private:
+    std::filesystem::path directory;
+};
+
+/**
+ * @brief Pick the items a policy purges
+ * @param items Items of all trash directories
+ * @param policy Age limit and size budget
+ * @param now Current time used for the age limit
+ * @return Items to purge, oldest first
+ */
+std::vector<TrashItem> selectTrashItems(std::vector<TrashItem> items, const TrashPurgePolicy& policy,
+                                        std::time_t now);
+
+/**
+ * @brief Parse the contents of a .trashinfo file
+ * @return False if the [Trash Info] group or the Path key is missing
+ */
+bool parseTrashInfo(const std::string& text, std::string& originalPath, std::time_t& deletionTime);
@@ -0,0 +1,73 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Pool of worker threads processing a FIFO task queue
+ *
+ * All threads are started up front, but only the first activeLimit of them
+ * take tasks. The limit can be changed while tasks are running, which lets a
+ * controller resize the pool without creating or joining threads.
+ */
+class WorkerPool {
+public:
+    /**
+     * @brief Start the worker threads
+     * @param threadCount Number of threads, at least one is always started
+     * @param activeLimit Number of threads taking tasks, 0 for all of them
+     */
+    explicit WorkerPool(size_t threadCount, size_t activeLimit = 0);
+
+    /**
+     * @brief Finish all queued tasks and join the threads
+     */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * @brief Queue a task for execution
+     * @param task Callable to run on a worker thread, must not throw
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Block until every submitted task has finished
+     */
+    void wait();
+
+    /**
+     * @brief Block until every submitted task has finished or the timeout expires
+     * @param timeout Maximum time to wait
+     * @return True if no tasks are pending
+     */
+    bool waitFor(std::chrono::steady_clock::duration timeout);
+
+    /**
+     * @brief Change the number of threads taking tasks
+     * @param limit New limit, clamped to [1, getThreadCount()]
+     */
+    void setActiveLimit(size_t limit);
+    size_t getActiveLimit() const;
+
+    size_t getThreadCount() const;
+
+private:
+    void workerLoop(size_t index);
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    mutable std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    size_t pending;     ///< Queued plus running tasks
+    size_t activeLimit;
+    bool stopping;
+};
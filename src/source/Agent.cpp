@@ -0,0 +1,723 @@
+#include "Agent.h"
+#include "BinaryIO.h"
+#include "Cleaner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    enum MessageType : uint8_t {
+        kSubmit = 1,
+        kShutdown = 2,
+        kAccepted = 16,
+        kProgress = 17,
+        kDone = 18
+    };
+
+    constexpr uint8_t kProtocolVersion = 1;
+    // Largest frame a peer can make the other side allocate
+    constexpr uint32_t kMaxFrame = 1u << 20;
+    // Log lines queued for one client before newer ones are dropped
+    constexpr size_t kMaxQueuedFrames = 4096;
+
+#ifdef _WIN32
+    using Handle = HANDLE;
+    const Handle kInvalidHandle = INVALID_HANDLE_VALUE;
+
+    Handle fromStored(intptr_t value) { return reinterpret_cast<Handle>(value); }
+    intptr_t toStored(Handle handle) { return reinterpret_cast<intptr_t>(handle); }
+
+    std::string lastError() {
+        return std::error_code(static_cast<int>(GetLastError()), std::system_category()).message();
+    }
+#else
+    using Handle = int;
+    constexpr Handle kInvalidHandle = -1;
+
+    Handle fromStored(intptr_t value) { return static_cast<Handle>(value); }
+    intptr_t toStored(Handle handle) { return handle; }
+
+    std::string lastError() {
+        return std::strerror(errno);
+    }
+
+#ifdef MSG_NOSIGNAL
+    constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+    constexpr int kSendFlags = 0;
+#endif
+
+    // A client that hung up must fail the write, not raise SIGPIPE
+    void suppressSigpipe([[maybe_unused]] Handle handle) {
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+
+    bool makeAddress(const std::string& endpoint, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (endpoint.empty() || endpoint.size() >= sizeof(address.sun_path)) return false;
+        std::memcpy(address.sun_path, endpoint.c_str(), endpoint.size() + 1);
+        return true;
+    }
+#endif
+
+    bool writeAll(Handle handle, const char* data, size_t size) {
+        while (size > 0) {
+#ifdef _WIN32
+            DWORD written = 0;
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, kMaxFrame));
+            if (!WriteFile(handle, data, chunk, &written, nullptr) || written == 0) return false;
+#else
+            ssize_t written = ::send(handle, data, size, kSendFlags);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+#endif
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool readAll(Handle handle, char* data, size_t size) {
+        while (size > 0) {
+#ifdef _WIN32
+            DWORD read = 0;
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, kMaxFrame));
+            if (!ReadFile(handle, data, chunk, &read, nullptr) || read == 0) return false;
+#else
+            ssize_t read = ::recv(handle, data, size, 0);
+            if (read < 0 && errno == EINTR) continue;
+            if (read <= 0) return false;
+#endif
+            data += read;
+            size -= static_cast<size_t>(read);
+        }
+        return true;
+    }
+
+    // Unblock another thread reading from or writing to the handle
+    void interrupt(Handle handle) {
+#ifdef _WIN32
+        CancelIoEx(handle, nullptr);
+#else
+        ::shutdown(handle, SHUT_RDWR);
+#endif
+    }
+
+    void closeHandle(Handle handle) {
+        if (handle == kInvalidHandle) return;
+#ifdef _WIN32
+        CloseHandle(handle);
+#else
+        ::close(handle);
+#endif
+    }
+
+    std::string makeFrame(uint8_t type, const std::string& payload) {
+        std::string frame;
+        frame.reserve(payload.size() + 5);
+        appendU32(frame, static_cast<uint32_t>(payload.size() + 1));
+        frame.push_back(static_cast<char>(type));
+        frame += payload;
+        return frame;
+    }
+
+    uint8_t frameType(const std::string& frame) {
+        return static_cast<uint8_t>(frame[4]);
+    }
+
+    bool writeFrame(Handle handle, const std::string& frame) {
+        return writeAll(handle, frame.data(), frame.size());
+    }
+
+    bool readFrame(Handle handle, uint8_t& type, std::string& payload) {
+        char header[4];
+        if (!readAll(handle, header, sizeof(header))) return false;
+        uint32_t length = 0;
+        ByteReader(header, sizeof(header)).readU32(length);
+        if (length == 0 || length > kMaxFrame) return false;
+        std::string body(length, '\0');
+        if (!readAll(handle, &body[0], length)) return false;
+        type = static_cast<uint8_t>(body[0]);
+        payload = body.substr(1);
+        return true;
+    }
+
+    void appendString(std::string& out, const std::string& text) {
+        appendVarint(out, text.size());
+        out += text;
+    }
+
+    bool readString(ByteReader& reader, std::string& text) {
+        uint64_t length = 0;
+        if (!reader.readVarint(length) || length > reader.remaining()) return false;
+        return reader.readBytes(static_cast<size_t>(length), text);
+    }
+
+    Handle connectTo(const std::string& endpoint, std::string& error) {
+#ifdef _WIN32
+        std::wstring name = std::filesystem::u8path(endpoint).wstring();
+        for (;;) {
+            Handle handle = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0,
+                                        nullptr);
+            if (handle != INVALID_HANDLE_VALUE) return handle;
+            // Every instance is taken until the agent creates the next one
+            if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(name.c_str(), 5000)) {
+                error = "cannot connect to " + endpoint + ": " + lastError();
+                return kInvalidHandle;
+            }
+        }
+#else
+        sockaddr_un address;
+        if (!makeAddress(endpoint, address)) {
+            error = "invalid socket path " + endpoint;
+            return kInvalidHandle;
+        }
+        Handle handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (handle < 0) {
+            error = "cannot create socket: " + lastError();
+            return kInvalidHandle;
+        }
+        suppressSigpipe(handle);
+        if (::connect(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            error = "cannot connect to " + endpoint + ": " + lastError();
+            ::close(handle);
+            return kInvalidHandle;
+        }
+        return handle;
+#endif
+    }
+
+#ifdef _WIN32
+    Handle createPipeInstance(const std::string& endpoint, bool first) {
+        std::wstring name = std::filesystem::u8path(endpoint).wstring();
+        DWORD openMode = PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+        return CreateNamedPipeW(name.c_str(), openMode,
+                                PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, nullptr);
+    }
+#endif
+
+    Handle listenOn(const std::string& endpoint, std::string& error) {
+#ifdef _WIN32
+        Handle handle = createPipeInstance(endpoint, true);
+        if (handle == INVALID_HANDLE_VALUE) {
+            error = GetLastError() == ERROR_ACCESS_DENIED ? "another agent is listening on " + endpoint
+                                                          : "cannot create pipe " + endpoint + ": " + lastError();
+        }
+        return handle;
+#else
+        sockaddr_un address;
+        if (!makeAddress(endpoint, address)) {
+            error = "invalid socket path " + endpoint;
+            return kInvalidHandle;
+        }
+        // A socket left behind by an agent that died is replaced, a live agent is not
+        std::string ignored;
+        Handle probe = connectTo(endpoint, ignored);
+        if (probe != kInvalidHandle) {
+            ::close(probe);
+            error = "another agent is listening on " + endpoint;
+            return kInvalidHandle;
+        }
+        struct stat st;
+        if (::lstat(endpoint.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(endpoint.c_str());
+
+        Handle handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (handle < 0) {
+            error = "cannot create socket: " + lastError();
+            return kInvalidHandle;
+        }
+        // Jobs run with the agent's rights, so only its owner may connect
+        mode_t mask = ::umask(0177);
+        int bound = ::bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        ::umask(mask);
+        if (bound != 0 || ::listen(handle, SOMAXCONN) != 0) {
+            error = "cannot listen on " + endpoint + ": " + lastError();
+            ::close(handle);
+            return kInvalidHandle;
+        }
+        return handle;
+#endif
+    }
+
+    // Wait for the next client; on Windows the connected instance is handed
+    // out and a fresh one takes its place as the listener
+    Handle acceptOn(intptr_t& listener, [[maybe_unused]] const std::string& endpoint) {
+#ifdef _WIN32
+        Handle pipe = fromStored(listener);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            listener = toStored(createPipeInstance(endpoint, false));
+            return kInvalidHandle;
+        }
+        if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) return kInvalidHandle;
+        listener = toStored(createPipeInstance(endpoint, false));
+        return pipe;
+#else
+        for (;;) {
+            Handle handle = ::accept(fromStored(listener), nullptr, nullptr);
+            if (handle >= 0) {
+                suppressSigpipe(handle);
+                return handle;
+            }
+            if (errno != EINTR) return kInvalidHandle;
+        }
+#endif
+    }
+
+    void closeConnection(Handle handle) {
+#ifdef _WIN32
+        // Let the client read what is still in the pipe
+        FlushFileBuffers(handle);
+        DisconnectNamedPipe(handle);
+#endif
+        closeHandle(handle);
+    }
+
+    std::string rejection(const std::string& message) {
+        JobResult result;
+        result.message = message;
+        return makeFrame(kDone, encodeJobResult(result));
+    }
+}
+
+std::string encodeJobRequest(const JobRequest& request) {
+    std::string payload;
+    payload.push_back(static_cast<char>(kProtocolVersion));
+    payload.push_back(static_cast<char>(request.kind));
+    appendVarint(payload, request.targets);
+    payload.push_back(request.withBackup ? 1 : 0);
+    appendString(payload, request.backupPath);
+    return payload;
+}
+
+bool decodeJobRequest(const std::string& payload, JobRequest& request) {
+    ByteReader reader(payload.data(), payload.size());
+    uint8_t version = 0, kind = 0, withBackup = 0;
+    uint64_t targets = 0;
+    if (!reader.readByte(version) || version != kProtocolVersion) return false;
+    if (!reader.readByte(kind) || kind > static_cast<uint8_t>(JobKind::Restore)) return false;
+    if (!reader.readVarint(targets) || targets > UINT32_MAX) return false;
+    if (!reader.readByte(withBackup) || !readString(reader, request.backupPath)) return false;
+    request.kind = static_cast<JobKind>(kind);
+    request.targets = static_cast<uint32_t>(targets);
+    request.withBackup = withBackup != 0;
+    return reader.remaining() == 0;
+}
+
+std::string encodeJobResult(const JobResult& result) {
+    std::string payload;
+    payload.push_back(result.success ? 1 : 0);
+    appendVarint(payload, result.filesDeleted);
+    appendVarint(payload, result.bytesFreed);
+    appendVarint(payload, result.errors);
+    appendString(payload, result.message);
+    return payload;
+}
+
+bool decodeJobResult(const std::string& payload, JobResult& result) {
+    ByteReader reader(payload.data(), payload.size());
+    uint8_t success = 0;
+    if (!reader.readByte(success) || !reader.readVarint(result.filesDeleted) ||
+        !reader.readVarint(result.bytesFreed) || !reader.readVarint(result.errors) ||
+        !readString(reader, result.message)) {
+        return false;
+    }
+    result.success = success != 0;
+    return reader.remaining() == 0;
+}
+
+std::string defaultAgentEndpoint() {
+#ifdef _WIN32
+    return "\\\\.\\pipe\\cookiemonster";
+#else
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) return std::string(runtime) + "/cookiemonster.sock";
+    std::error_code ec;
+    std::filesystem::path temp = std::filesystem::temp_directory_path(ec);
+    if (ec) temp = "/tmp";
+    return (temp / ("cookiemonster-" + std::to_string(::getuid()) + ".sock")).string();
+#endif
+}
+
+// Frames bound for one client; the job produces, the connection consumes
+struct AgentServer::Channel {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::string> frames;
+
+    void push(std::string frame) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (frameType(frame) == kProgress && frames.size() >= kMaxQueuedFrames) return;
+            frames.push_back(std::move(frame));
+        }
+        ready.notify_one();
+    }
+
+    std::string pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !frames.empty(); });
+        std::string frame = std::move(frames.front());
+        frames.pop_front();
+        return frame;
+    }
+};
+
+// Channels are only added while the job is queued, under the server's mutex
+struct AgentServer::Job {
+    uint64_t id = 0;
+    JobRequest request;
+    std::vector<std::shared_ptr<Channel>> channels;
+
+    void broadcast(const std::string& frame) {
+        for (auto& channel : channels) channel->push(frame);
+    }
+};
+
+struct AgentServer::Connection {
+    Handle handle = kInvalidHandle;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+};
+
+AgentServer::AgentServer(std::string endpoint, JobRunner runner)
+    : endpoint(std::move(endpoint)), runner(std::move(runner)), listener(toStored(kInvalidHandle)) {}
+
+AgentServer::~AgentServer() {
+    stop();
+}
+
+bool AgentServer::start(std::string& error) {
+    if (started) return true;
+    Handle handle = listenOn(endpoint, error);
+    if (handle == kInvalidHandle) return false;
+    listener = toStored(handle);
+    started = true;
+    stopping = false;
+    shutdownRequested = false;
+
+    // Whatever the running job logs goes to the clients waiting for it
+    Logger::getInstance().setSink([this](LogLevel level, const std::string& message) {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        if (!current) return;
+        std::string payload(1, static_cast<char>(level));
+        payload += message;
+        current->broadcast(makeFrame(kProgress, payload));
+    });
+    worker = std::thread([this] { workLoop(); });
+    acceptor = std::thread([this] { acceptLoop(); });
+    return true;
+}
+
+void AgentServer::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return shutdownRequested || stopping; });
+}
+
+void AgentServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started || stopping) return;
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+    Logger::getInstance().setSink(nullptr);
+
+    // A connection of our own wakes the acceptor
+    std::string ignored;
+    Handle wake = connectTo(endpoint, ignored);
+    acceptor.join();
+    closeHandle(wake);
+
+    std::list<std::unique_ptr<Connection>> open;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        open.swap(connections);
+        for (auto& connection : open) interrupt(connection->handle);
+    }
+    for (auto& connection : open) {
+        connection->thread.join();
+        closeConnection(connection->handle);
+    }
+    closeHandle(fromStored(listener));
+    listener = toStored(kInvalidHandle);
+#ifndef _WIN32
+    ::unlink(endpoint.c_str());
+#endif
+    started = false;
+}
+
+AgentStats AgentServer::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void AgentServer::requestShutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdownRequested = true;
+    }
+    changed.notify_all();
+}
+
+std::shared_ptr<AgentServer::Job> AgentServer::submit(const JobRequest& request,
+                                                      const std::shared_ptr<Channel>& channel, bool& coalesced) {
+    std::shared_ptr<Job> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || shutdownRequested) return nullptr;
+        // A running job may already have passed files the new request
+        // expects to be handled, so only queued jobs are joined
+        for (auto& queued : queue) {
+            if (queued->request == request) {
+                queued->channels.push_back(channel);
+                coalesced = true;
+                stats.jobsCoalesced++;
+                return queued;
+            }
+        }
+        job = std::make_shared<Job>();
+        job->id = nextJobId++;
+        job->request = request;
+        job->channels.push_back(channel);
+        queue.push_back(job);
+        stats.queued = queue.size();
+    }
+    coalesced = false;
+    changed.notify_all();
+    return job;
+}
+
+void AgentServer::acceptLoop() {
+    for (;;) {
+        Handle handle = acceptOn(listener, endpoint);
+        if (handle == kInvalidHandle) {
+            // E.g. out of descriptors; clients that finish free some
+            Logger::getInstance().log(LogLevel::WARNING, "Agent cannot accept a connection: " + lastError());
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            closeHandle(handle);
+            break;
+        }
+        if (handle == kInvalidHandle) continue;
+
+        // Threads of clients that have gone are collected here
+        for (auto it = connections.begin(); it != connections.end();) {
+            if ((*it)->finished) {
+                (*it)->thread.join();
+                closeConnection((*it)->handle);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->handle = handle;
+        Connection* served = connection.get();
+        connection->thread = std::thread([this, served] { serve(*served); });
+        connections.push_back(std::move(connection));
+        stats.connections++;
+    }
+}
+
+void AgentServer::serve(Connection& connection) {
+    Handle handle = connection.handle;
+    uint8_t type = 0;
+    std::string payload;
+    while (readFrame(handle, type, payload)) {
+        if (type == kShutdown) {
+            requestShutdown();
+            break;
+        }
+        JobRequest request;
+        if (type != kSubmit || !decodeJobRequest(payload, request)) {
+            writeFrame(handle, rejection("malformed request"));
+            break;
+        }
+
+        auto channel = std::make_shared<Channel>();
+        bool coalesced = false;
+        std::shared_ptr<Job> job = submit(request, channel, coalesced);
+        if (!job) {
+            writeFrame(handle, rejection("agent is shutting down"));
+            break;
+        }
+        std::string accepted;
+        appendVarint(accepted, job->id);
+        accepted.push_back(coalesced ? 1 : 0);
+        bool connected = writeFrame(handle, makeFrame(kAccepted, accepted));
+
+        // A client that hangs up abandons its channel, the job still runs
+        while (connected) {
+            std::string frame = channel->pop();
+            connected = writeFrame(handle, frame);
+            if (frameType(frame) == kDone) break;
+        }
+        if (!connected) break;
+    }
+    connection.finished = true;
+}
+
+void AgentServer::workLoop() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) break;
+            job = queue.front();
+            queue.pop_front();
+            stats.queued = queue.size();
+            stats.jobsRun++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            current = job;
+        }
+        JobResult result;
+        try {
+            result = runner(job->request);
+        } catch (const std::exception& e) {
+            result = JobResult();
+            result.message = e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            current.reset();
+        }
+        job->broadcast(makeFrame(kDone, encodeJobResult(result)));
+    }
+
+    // Nobody is left waiting for a job that will never run
+    std::deque<std::shared_ptr<Job>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled.swap(queue);
+        stats.queued = 0;
+    }
+    for (auto& job : cancelled) {
+        job->broadcast(rejection("agent is shutting down"));
+    }
+}
+
+AgentClient::AgentClient(std::string endpoint) : endpoint(std::move(endpoint)) {}
+
+bool AgentClient::submit(const JobRequest& request,
+                         const std::function<void(LogLevel, const std::string&)>& onProgress,
+                         JobResult& result, std::string& error) {
+    Handle handle = connectTo(endpoint, error);
+    if (handle == kInvalidHandle) return false;
+
+    bool finished = false;
+    uint8_t type = 0;
+    std::string payload;
+    bool ok = writeFrame(handle, makeFrame(kSubmit, encodeJobRequest(request)));
+    while (ok && readFrame(handle, type, payload)) {
+        if (type == kAccepted) {
+            ByteReader reader(payload.data(), payload.size());
+            uint8_t coalesced = 0;
+            ok = reader.readVarint(result.jobId) && reader.readByte(coalesced);
+            result.coalesced = coalesced != 0;
+        } else if (type == kProgress) {
+            if (payload.empty()) continue;
+            uint8_t level = static_cast<uint8_t>(payload[0]);
+            if (level > static_cast<uint8_t>(LogLevel::ERROR)) level = static_cast<uint8_t>(LogLevel::INFO);
+            if (onProgress) onProgress(static_cast<LogLevel>(level), payload.substr(1));
+        } else if (type == kDone) {
+            finished = decodeJobResult(payload, result);
+            break;
+        } else {
+            break;
+        }
+    }
+    closeHandle(handle);
+    if (!finished) error = "agent closed the connection before the job finished";
+    return finished;
+}
+
+bool AgentClient::shutdown(std::string& error) {
+    Handle handle = connectTo(endpoint, error);
+    if (handle == kInvalidHandle) return false;
+    bool sent = writeFrame(handle, makeFrame(kShutdown, std::string()));
+    if (!sent) {
+        error = "cannot reach agent at " + endpoint;
+    } else {
+        // Nothing is sent back; the connection closes when the agent stops
+        uint8_t type = 0;
+        std::string payload;
+        while (readFrame(handle, type, payload)) {}
+    }
+    closeHandle(handle);
+    return sent;
+}
+
+AgentServer::JobRunner makeCleanerJobRunner(Cleaner& cleaner) {
+    struct Target {
+        uint32_t bit;
+        const char* operation;
+        bool needsAdmin;
+        bool (Cleaner::*clean)(bool);
+        bool (Cleaner::*cleanWithBackup)(bool);
+    };
+    static const Target targets[] = {
+        {kJobTemp, "temp", false, &Cleaner::cleanTempFiles, &Cleaner::cleanTempFilesWithBackup},
+        {kJobBrowser, "browser", true, &Cleaner::cleanBrowserCache, &Cleaner::cleanBrowserCacheWithBackup},
+        {kJobRecycle, "recycle", true, &Cleaner::cleanRecycleBin, &Cleaner::cleanRecycleBinWithBackup},
+        {kJobRegistry, "registry", true, &Cleaner::cleanRegistry, &Cleaner::cleanRegistryWithBackup},
+    };
+
+    return [&cleaner](const JobRequest& request) {
+        cleaner.resetStatistics();
+        bool success = true;
+        if (request.kind == JobKind::Restore) {
+            success = cleaner.restoreFromBackup(request.backupPath);
+        } else {
+            for (const auto& target : targets) {
+                if (!(request.targets & target.bit)) continue;
+                // Same rule as a direct run of the cleaner
+                if (target.needsAdmin && !cleaner.isAdmin()) {
+                    Logger::getInstance().log(LogLevel::WARNING,
+                        std::string("Skipping ") + target.operation + ": administrator privileges required");
+                    continue;
+                }
+                if (request.kind == JobKind::Backup) {
+                    success &= cleaner.createBackup(target.operation);
+                } else if (request.kind == JobKind::Analyze) {
+                    success &= (cleaner.*target.clean)(true);
+                } else {
+                    success &= (cleaner.*(request.withBackup ? target.cleanWithBackup : target.clean))(false);
+                }
+            }
+            if (request.kind != JobKind::Backup) cleaner.showStatistics();
+        }
+
+        CleaningSummary summary = cleaner.getSummary();
+        JobResult result;
+        result.success = success;
+        result.filesDeleted = static_cast<uint64_t>(summary.filesDeleted);
+        result.bytesFreed = summary.bytesFreed;
+        result.errors = static_cast<uint64_t>(summary.errors);
+        if (!success) result.message = "one or more operations failed";
+        return result;
+    };
+}
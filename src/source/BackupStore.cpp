@@ -0,0 +1,140 @@
+#include "BackupStore.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "PathArena.h"
+#include "RunJournal.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace {
+    // True if both files hold the same bytes
+    bool sameContents(const std::filesystem::path& first, const std::filesystem::path& second) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(first, ec);
+        if (ec || std::filesystem::file_size(second, ec) != size || ec) return false;
+        std::ifstream a(first, std::ios::binary);
+        std::ifstream b(second, std::ios::binary);
+        std::vector<char> bufferA(64 * 1024);
+        std::vector<char> bufferB(bufferA.size());
+        while (a && b) {
+            a.read(bufferA.data(), static_cast<std::streamsize>(bufferA.size()));
+            b.read(bufferB.data(), static_cast<std::streamsize>(bufferB.size()));
+            if (a.gcount() != b.gcount() ||
+                std::memcmp(bufferA.data(), bufferB.data(), static_cast<size_t>(a.gcount())) != 0) {
+                return false;
+            }
+        }
+        return a.eof() && b.eof();
+    }
+
+    // Rename that fails instead of replacing an existing target
+    bool renameNoReplace(const std::filesystem::path& from, const std::filesystem::path& to, std::error_code& ec) {
+#ifdef _WIN32
+        // Without MOVEFILE_REPLACE_EXISTING (and MOVEFILE_COPY_ALLOWED) the move
+        // fails on an existing target or another volume
+        if (MoveFileExW(from.c_str(), to.c_str(), 0)) return true;
+        ec = std::error_code(static_cast<int>(GetLastError()), std::system_category());
+        return false;
+#else
+        // A hard link never replaces its target; dropping the source completes the move
+        if (::link(from.c_str(), to.c_str()) != 0) {
+            ec = std::error_code(errno, std::generic_category());
+            return false;
+        }
+        if (::unlink(from.c_str()) != 0) {
+            ec = std::error_code(errno, std::generic_category());
+            ::unlink(to.c_str());
+            return false;
+        }
+        return true;
+#endif
+    }
+}
+
+std::filesystem::path backupLocation(const std::filesystem::path& directory, const std::filesystem::path& source) {
+    std::filesystem::path location = directory;
+    const auto rootName = source.root_name();
+    std::filesystem::path::string_type root;
+    for (auto c : rootName.native()) {
+        if (c != ':' && c != '\\' && c != '/') root += c;
+    }
+    if (!root.empty()) location /= root;
+    for (const auto& component : source.lexically_normal().relative_path()) {
+        if (component.empty() || component == ".") continue;
+        // Relative sources must not climb out of the backup
+        location /= component == ".." ? std::filesystem::path("__") : component;
+    }
+    return location;
+}
+
+bool copyToBackup(const std::filesystem::path& source, const std::filesystem::path& target, std::error_code& ec) {
+    std::filesystem::create_directories(target.parent_path(), ec);
+    if (ec) return false;
+    if (std::filesystem::copy_file(source, target, std::filesystem::copy_options::none, ec)) return true;
+    if (ec == std::errc::file_exists && sameContents(source, target)) {
+        // Preserved by an interrupted attempt that did not get to delete it
+        ec.clear();
+        return true;
+    }
+    return false;
+}
+
+BackupStore::BackupStore(std::filesystem::path directory, RunJournal* journal,
+                         const std::vector<std::string>& alreadyBackedUp)
+    : directory(std::move(directory)), journal(journal),
+      stored(alreadyBackedUp.begin(), alreadyBackedUp.end()) {}
+
+void BackupStore::record(const std::string& source, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!stored.insert(source).second) return;
+    files.push_back(source);
+    totalSize += size;
+    if (journal) journal->recordBackedUp(source, size);
+}
+
+bool BackupStore::copy(const FileEntry& entry) {
+    std::error_code ec;
+    {
+        OperationTimer timer(MetricOperation::Copy);
+        copyToBackup(entry.path, backupLocation(directory, entry.path), ec);
+    }
+    if (ec) {
+        Logger::getInstance().log(LogLevel::ERROR,
+            "Error in backupFile: Error backing up file " + toUtf8(entry.path) + ": " + ec.message());
+        return false;
+    }
+    record(toUtf8(entry.path), entry.size);
+    // Group commit: concurrent workers share the fsync
+    return !journal || journal->sync();
+}
+
+bool BackupStore::moveIn(const FileEntry& entry) {
+    std::filesystem::path target = backupLocation(directory, entry.path);
+    std::error_code ec;
+    std::filesystem::create_directories(target.parent_path(), ec);
+    // The original is gone once renamed, so it is recorded afterwards: a crash
+    // in between leaves an unlisted file in the backup rather than a listed
+    // backup that does not exist. A taken target falls back to copy(), which
+    // keeps the file unless the target holds the same contents.
+    if (ec || !renameNoReplace(entry.path, target, ec)) return false;
+    record(toUtf8(entry.path), entry.size);
+    return true;
+}
+
+std::vector<std::string> BackupStore::getFiles() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return files;
+}
+
+uint64_t BackupStore::getTotalSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalSize;
+}
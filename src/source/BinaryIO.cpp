@@ -0,0 +1,140 @@
+#include "BinaryIO.h"
+#include <array>
+#include <cstdio>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+void appendVarint(std::string& out, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out.push_back(static_cast<char>(value ? (byte | 0x80) : byte));
+    } while (value);
+}
+
+void appendU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void appendU64(std::string& out, uint64_t value) {
+    appendU32(out, static_cast<uint32_t>(value));
+    appendU32(out, static_cast<uint32_t>(value >> 32));
+}
+
+void appendU32BE(std::string& out, uint32_t value) {
+    for (int i = 3; i >= 0; --i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint32_t crc32(const void* data, size_t length) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> values{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            values[i] = c;
+        }
+        return values;
+    }();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+ByteReader::ByteReader(const void* data, size_t size, size_t offset)
+    : data(static_cast<const uint8_t*>(data)), size(size), pos(offset < size ? offset : size) {}
+
+bool ByteReader::readByte(uint8_t& value) {
+    if (pos >= size) return false;
+    value = data[pos++];
+    return true;
+}
+
+bool ByteReader::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        if (!readByte(byte)) return false;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+bool ByteReader::readU32(uint32_t& value) {
+    if (size - pos < 4) return false;
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(data[pos++]) << (8 * i);
+    }
+    return true;
+}
+
+bool ByteReader::readU64(uint64_t& value) {
+    uint32_t low, high;
+    if (size - pos < 8 || !readU32(low) || !readU32(high)) return false;
+    value = (static_cast<uint64_t>(high) << 32) | low;
+    return true;
+}
+
+bool ByteReader::readU32BE(uint32_t& value) {
+    if (size - pos < 4) return false;
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value = (value << 8) | data[pos++];
+    }
+    return true;
+}
+
+bool ByteReader::readBytes(size_t count, std::string& out) {
+    if (count > size - pos) return false;
+    out.assign(reinterpret_cast<const char*>(data + pos), count);
+    pos += count;
+    return true;
+}
+
+bool writeFileAtomically(const std::filesystem::path& path, const std::string& content,
+                         const std::filesystem::path& temp) {
+    std::filesystem::path staged = temp;
+    if (staged.empty()) {
+        staged = path;
+        staged += ".tmp";
+    }
+#ifdef _WIN32
+    std::FILE* file = _wfopen(staged.c_str(), L"wb");
+#else
+    std::FILE* file = std::fopen(staged.c_str(), "wb");
+#endif
+    if (!file) return false;
+    bool written = std::fwrite(content.data(), 1, content.size(), file) == content.size() &&
+                   std::fflush(file) == 0;
+    // On disk before the rename, or a crash could leave an empty target
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = std::fclose(file) == 0 && written;
+
+    std::error_code ec;
+    if (written) std::filesystem::rename(staged, path, ec);
+    if (!written || ec) {
+        std::filesystem::remove(staged, ec);
+        return false;
+    }
+    return true;
+}
@@ -1,25 +1,75 @@
 #include "Cleaner.h"
-#define WIN32_LEAN_AND_MEAN
+#include "Metrics.h"
+#include "OpenFileIndex.h"
+#include "Trace.h"
+#include "PathArena.h"
+#include "SpaceAccounting.h"
+#include "WorkerPool.h"
+#ifdef _WIN32
 #include <windows.h>
 #include <shlobj.h>
 #include <shellapi.h>
+#else
+#include <unistd.h>
+#include <cstdlib>
+#endif
 #include <iostream>
 #include <filesystem>
 #include <iomanip>
 #include <sstream>
 #include <thread>
-#include <future>
 #include <chrono>
 #include <fstream>
 #include <algorithm>
 #include <regex>
 #include <mutex>
+#include <atomic>
+#include <stdexcept>
 
 // Initialize static members
 std::unique_ptr<Logger> Logger::instance = nullptr;
 std::mutex Logger::mutex;
 
+namespace {
+    // Merge an engine run into one of the per-cleaner statistics structures
+    template <typename Stats>
+    void addResult(Stats& stats, const EngineResult& result) {
+        stats.filesDeleted += result.filesDeleted;
+        stats.errors += result.errors;
+        stats.bytesFreed += result.bytesFreed;
+        stats.physicalBytesFreed += result.physicalBytesFreed;
+        stats.filesInUse += result.filesInUse;
+        stats.directoriesRemoved += result.directoriesRemoved;
+        stats.errorMessages.insert(stats.errorMessages.end(),
+            result.errorMessages.begin(), result.errorMessages.end());
+    }
+
+    // Add the outcome of a file cleaner's run to the exported counters
+    template <typename Stats>
+    void recordMetrics(const MetricLabels& labels, const Stats& stats) {
+        Metrics& metrics = Metrics::getInstance();
+        if (!metrics.isEnabled()) return;
+        metrics.addCounter("cookiemonster_files_deleted_total", labels, static_cast<uint64_t>(stats.filesDeleted));
+        metrics.addCounter("cookiemonster_bytes_freed_total", labels, stats.bytesFreed);
+        metrics.addCounter("cookiemonster_physical_bytes_freed_total", labels, stats.physicalBytesFreed);
+        metrics.addCounter("cookiemonster_files_in_use_total", labels, static_cast<uint64_t>(stats.filesInUse));
+        metrics.addCounter("cookiemonster_directories_removed_total", labels,
+                           static_cast<uint64_t>(stats.directoriesRemoved));
+        metrics.addCounter("cookiemonster_errors_total", labels, static_cast<uint64_t>(stats.errors));
+    }
+
+    // Registry round trips are timed one call at a time
+    template <typename Call>
+    auto timedRegistryCall(Call call) {
+        OperationTimer timer(MetricOperation::Registry);
+        return call();
+    }
+}
+
 Cleaner::Cleaner() : tempStats(), recycleBinStats() {
+#ifdef _WIN32
+    registry = std::make_unique<Win32Registry>();
+#endif
     Logger::getInstance().log(LogLevel::INFO, "Cleaner initialized");
 }
 
@@ -32,33 +82,426 @@ void Cleaner::logError(const std::string& operation, const std::string& error) {
     Logger::getInstance().log(LogLevel::ERROR, message);
 }
 
-bool Cleaner::isPathExcluded(const std::wstring& path) const {
+// Patterns are kept as native strings so matching needs no conversion
+bool Cleaner::isPathExcluded(const std::filesystem::path& path) const {
     for (const auto& excluded : excludedPaths) {
-        if (path.find(excluded) != std::wstring::npos) {
+        if (path.native().find(excluded.native()) != std::filesystem::path::string_type::npos) {
             return true;
         }
     }
     return false;
 }
 
-bool Cleaner::isPathIncluded(const std::wstring& path) const {
+bool Cleaner::isPathIncluded(const std::filesystem::path& path) const {
     if (includedPaths.empty()) return true;
     for (const auto& included : includedPaths) {
-        if (path.find(included) != std::wstring::npos) {
+        if (path.native().find(included.native()) != std::filesystem::path::string_type::npos) {
             return true;
         }
     }
     return false;
 }
 
-void Cleaner::setExcludedPaths(const std::vector<std::wstring>& paths) {
+void Cleaner::setExcludedPaths(const std::vector<std::filesystem::path>& paths) {
     excludedPaths = paths;
 }
 
-void Cleaner::setIncludedPaths(const std::vector<std::wstring>& paths) {
+void Cleaner::setIncludedPaths(const std::vector<std::filesystem::path>& paths) {
     includedPaths = paths;
 }
 
+void Cleaner::setIoLimits(uint64_t maxOpsPerSecond, uint64_t maxBytesPerSecond) {
+    ioThrottle.setMaxOpsPerSecond(maxOpsPerSecond);
+    ioThrottle.setMaxBytesPerSecond(maxBytesPerSecond);
+}
+
+void Cleaner::setAdaptiveThrottle(bool enable) {
+    ioThrottle.setAdaptive(enable);
+}
+
+bool Cleaner::enableIdleIoPriority() {
+    if (!applyIdleIoPriority()) {
+        Logger::getInstance().log(LogLevel::WARNING, "Failed to switch to idle I/O priority");
+        return false;
+    }
+    Logger::getInstance().log(LogLevel::INFO, "Running at idle I/O priority");
+    return true;
+}
+
+void Cleaner::setStorageConcurrency(StorageType type, size_t threads) {
+    engine.setConcurrency(type, threads);
+}
+
+bool Cleaner::setStorageType(const std::filesystem::path& path, StorageType type) {
+    if (!engine.setStorageType(path, type)) {
+        logError("setStorageType", "Cannot determine device of " + toUtf8(path));
+        return false;
+    }
+    return true;
+}
+
+void Cleaner::setMaxThreads(int threads) {
+    engine.setMaxThreads(threads > 0 ? static_cast<size_t>(threads) : 0);
+}
+
+int Cleaner::getMaxThreads() const {
+    return static_cast<int>(engine.getMaxThreads());
+}
+
+void Cleaner::setBatchSize(int size) {
+    engine.setBatchSize(size > 0 ? static_cast<size_t>(size) : 1);
+}
+
+int Cleaner::getBatchSize() const {
+    return static_cast<int>(engine.getBatchSize());
+}
+
+void Cleaner::setAutotune(bool enable) {
+    engine.setAutotune(enable);
+}
+
+void Cleaner::setOpenFileCheck(bool enable) {
+    engine.setOpenFileCheck(enable);
+}
+
+void Cleaner::setOpenFileRetries(int retries, int delayMs) {
+    engine.setOpenFileRetries(retries > 0 ? static_cast<size_t>(retries) : 0,
+                              std::chrono::milliseconds(std::max(delayMs, 0)));
+}
+
+void Cleaner::setFollowSymlinks(bool enable) {
+    engine.setFollowSymlinks(enable);
+}
+
+bool Cleaner::isFollowingSymlinks() const {
+    return engine.isFollowingSymlinks();
+}
+
+void Cleaner::setMaxScanDepth(int depth) {
+    engine.setMaxDepth(depth > 0 ? static_cast<size_t>(depth) : 0);
+}
+
+int Cleaner::getMaxScanDepth() const {
+    return static_cast<int>(engine.getMaxDepth());
+}
+
+void Cleaner::setSameFileSystem(bool enable) {
+    engine.setSameFileSystem(enable);
+}
+
+void Cleaner::setAsyncIo(bool enable) {
+    asyncIo = enable;
+}
+
+void Cleaner::setSecureErase(bool enable) {
+    eraser = enable ? std::make_unique<SecureEraser>() : nullptr;
+}
+
+void Cleaner::setExcludedFileTypes(const std::vector<std::string>& types) {
+    fileTypes.setExcludedTypes(types);
+}
+
+std::vector<std::string> Cleaner::getExcludedFileTypes() const {
+    return fileTypes.getExcludedTypes();
+}
+
+void Cleaner::setAllowedFileTypes(const std::vector<std::string>& types) {
+    fileTypes.setAllowedTypes(types);
+}
+
+void Cleaner::setFileTypeSniffing(bool enable) {
+    fileTypes.setContentSniffing(enable);
+}
+
+bool Cleaner::isFileTypeAllowed(const std::filesystem::path& path) const {
+    return fileTypes.allows(path);
+}
+
+void Cleaner::setFileSystem(std::shared_ptr<FileSystemBackend> fileSystem) {
+    engine.setFileSystem(std::move(fileSystem));
+}
+
+KernelContext Cleaner::makeKernelContext(bool dryRun, bool recordPlan) {
+    KernelContext context;
+    context.throttle = &ioThrottle;
+    context.plan = dryRun && recordPlan ? planWriter.get() : nullptr;
+    context.journal = !dryRun && currentRun ? journal.get() : nullptr;
+    context.backup = dryRun ? nullptr : fusedBackup.get();
+    context.fileSystem = &engine.getFileSystem();
+    // Overwriting goes through the native file system only
+    if (!dryRun && context.fileSystem == &NativeFileSystem::instance()) context.eraser = eraser.get();
+    context.fileTypes = fileTypes.isActive() ? &fileTypes : nullptr;
+    return context;
+}
+
+CleaningEngine::EntryHandler Cleaner::makeEntryHandler(bool dryRun, bool recordPlan) {
+    // The run configuration is fixed for the whole pass, so it selects a
+    // specialized kernel once instead of being tested for every file
+    return makeCleaningKernel(makeKernelContext(dryRun, recordPlan), dryRun, backupMode,
+                              Logger::getInstance().isEnabled(LogLevel::INFO));
+}
+
+std::vector<EngineResult> Cleaner::runKernel(const std::vector<std::vector<std::filesystem::path>>& rootSets,
+                                             bool recursive, bool dryRun,
+                                             const std::function<void(const FileEntry&)>& observer) {
+    // An observer sees every entry first and takes over recording the plan
+    KernelContext context = makeKernelContext(dryRun, !observer);
+    const bool perFile = Logger::getInstance().isEnabled(LogLevel::INFO);
+    if (asyncIo) {
+        auto kernel = makeAsyncCleaningKernel(context, dryRun, backupMode, perFile);
+        return engine.runSetsAsync(rootSets, recursive,
+            [&observer, &kernel](const FileEntry& entry, IoExecutor& io, CleaningEngine::EntryCompletion done) {
+                if (observer) observer(entry);
+                kernel(entry, io, std::move(done));
+            }, makeDirectoryHandler(dryRun));
+    }
+
+    auto kernel = makeCleaningKernel(context, dryRun, backupMode, perFile);
+    if (!observer) return engine.runSets(rootSets, recursive, kernel, makeDirectoryHandler(dryRun));
+    return engine.runSets(rootSets, recursive, [&observer, &kernel](const FileEntry& entry) {
+        observer(entry);
+        return kernel(entry);
+    }, makeDirectoryHandler(dryRun));
+}
+
+CleaningEngine::DirectoryHandler Cleaner::makeDirectoryHandler(bool dryRun) {
+    // Directories emptied by the run are removed unless an exclusion covers them
+    return [this, dryRun](const std::filesystem::path& directory) {
+        return !isPathExcluded(directory) && deleteDirectory(directory, dryRun);
+    };
+}
+
+EngineResult Cleaner::cleanPaths(const std::vector<std::wstring>& paths, bool recursive, bool dryRun) {
+    std::vector<std::filesystem::path> roots(paths.begin(), paths.end());
+    return runKernel({roots}, recursive, dryRun).front();
+}
+
+EngineResult Cleaner::evictChromiumCache(const std::vector<std::filesystem::path>& paths, bool dryRun) {
+    EngineResult total;
+    const int64_t now = toChromiumTime(std::time(nullptr));
+    for (const auto& path : paths) {
+        for (const auto& cacheDir : SimpleCacheIndex::find(path)) {
+            SimpleCacheIndex index;
+            if (!index.load(cacheDir)) {
+                // Without the index there is no usage information to evict by
+                Logger::getInstance().log(LogLevel::WARNING,
+                    "Skipping cache " + toUtf8(cacheDir) + ": " + index.getError());
+                continue;
+            }
+
+            std::vector<SimpleCacheEntry> evicted = selectCacheEvictions(index.getEntries(), cachePolicy, now);
+            std::vector<FileEntry> files;
+            for (const auto& entry : evicted) {
+                for (const auto& file : SimpleCacheIndex::entryFiles(cacheDir, entry.hash)) {
+                    FileEntry fileEntry;
+                    if (statFileEntry(file, fileEntry)) files.push_back(std::move(fileEntry));
+                }
+            }
+            Logger::getInstance().log(LogLevel::INFO,
+                "Evicting " + std::to_string(evicted.size()) + " of " + std::to_string(index.getEntries().size()) +
+                " entries from " + toUtf8(cacheDir));
+
+            EngineResult result = engine.runEntries(std::move(files), makeEntryHandler(dryRun));
+            total.filesDeleted += result.filesDeleted;
+            total.errors += result.errors;
+            total.bytesFreed += result.bytesFreed;
+            total.physicalBytesFreed += result.physicalBytesFreed;
+            total.filesInUse += result.filesInUse;
+            total.errorMessages.insert(total.errorMessages.end(),
+                result.errorMessages.begin(), result.errorMessages.end());
+            if (dryRun || evicted.empty()) continue;
+
+            // Drop entries whose files are all gone so the index matches the disk
+            auto& entries = index.getEntries();
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [&cacheDir](const SimpleCacheEntry& entry) {
+                auto files = SimpleCacheIndex::entryFiles(cacheDir, entry.hash);
+                return std::none_of(files.begin(), files.end(), [](const std::filesystem::path& file) {
+                    std::error_code ec;
+                    return std::filesystem::exists(file, ec);
+                });
+            }), entries.end());
+            if (!index.save(cacheDir)) {
+                total.errors++;
+                total.errorMessages.push_back("Cannot rewrite cache index in " + toUtf8(cacheDir));
+            }
+        }
+    }
+    return total;
+}
+
+void Cleaner::beginPlanSection(PlanSection kind, const std::string& name) {
+    if (planWriter) planWriter->beginSection(kind, name);
+}
+
+bool Cleaner::enableJournal(const std::string& journalPath) {
+    auto opened = std::make_unique<RunJournal>();
+    std::vector<JournalRun> runs;
+    if (!opened->open(journalPath, runs)) {
+        logError("enableJournal", "Cannot open journal " + journalPath);
+        return false;
+    }
+
+    // Backups of earlier runs stay restorable even if they are never resumed
+    for (const auto& run : runs) {
+        if (run.backupPath.empty()) continue;
+        BackupInfo backup;
+        backup.operationType = run.operation;
+        backup.timestamp = run.timestamp;
+        backup.backupPath = run.backupPath;
+        backup.files = run.backedUpFiles;
+        backup.totalSize = run.backupBytes;
+        addBackupToHistory(backup);
+    }
+
+    // Only the most recent run can be resumed
+    if (!runs.empty() && !runs.back().finished) {
+        interruptedRun = runs.back();
+        Logger::getInstance().log(LogLevel::WARNING,
+            "Found interrupted " + interruptedRun->operation + " run: " +
+            std::to_string(interruptedRun->backedUpFiles.size()) + " files backed up, " +
+            std::to_string(interruptedRun->filesDeleted) + " files deleted");
+    } else if (!runs.empty()) {
+        opened->reset();
+    }
+
+    journal = std::move(opened);
+    Logger::getInstance().log(LogLevel::INFO, "Journaling progress to " + journalPath);
+    return true;
+}
+
+bool Cleaner::beginJournalRun(const std::string& operation) {
+    if (!journal || currentRun) return false;
+
+    if (interruptedRun && interruptedRun->operation == operation) {
+        Logger::getInstance().log(LogLevel::INFO, "Resuming interrupted " + operation + " run");
+        currentRun = std::move(interruptedRun);
+    } else {
+        currentRun = JournalRun();
+        currentRun->operation = operation;
+        journal->beginRun(operation);
+    }
+    interruptedRun.reset();
+    return true;
+}
+
+void Cleaner::endJournalRun(bool finished) {
+    if (!currentRun) return;
+    if (finished) {
+        // A finished run needs no resuming, so its records are dropped
+        journal->finishRun();
+        if (!journal->reset()) {
+            logError("endJournalRun", "Failed to reset journal");
+        }
+    } else if (!journal->sync()) {
+        logError("endJournalRun", "Failed to sync journal");
+    }
+    currentRun.reset();
+}
+
+bool Cleaner::startPlan(const std::string& planPath) {
+    auto writer = std::make_unique<PlanWriter>();
+    if (!writer->open(planPath)) {
+        logError("startPlan", "Cannot create plan file " + planPath);
+        return false;
+    }
+    planWriter = std::move(writer);
+    Logger::getInstance().log(LogLevel::INFO, "Recording deletion plan to " + planPath);
+    return true;
+}
+
+bool Cleaner::finishPlan() {
+    if (!planWriter) return false;
+    uint64_t entries = planWriter->getEntryCount();
+    bool ok = planWriter->close();
+    planWriter.reset();
+    if (!ok) {
+        logError("finishPlan", "Failed to write deletion plan");
+        return false;
+    }
+    Logger::getInstance().log(LogLevel::INFO, "Deletion plan written: " + std::to_string(entries) + " entries");
+    return true;
+}
+
+bool Cleaner::executePlan(const std::string& planPath) {
+    TraceScope span("executePlan");
+    Logger::getInstance().log(LogLevel::INFO, "Executing deletion plan " + planPath);
+
+    PlanReader reader;
+    if (!reader.open(planPath)) {
+        logError("executePlan", "Cannot open plan file " + planPath);
+        return false;
+    }
+    std::vector<PlanSectionData> sections;
+    std::string error;
+    if (!reader.read(sections, error)) {
+        logError("executePlan", "Invalid plan " + planPath + ": " + error);
+        return false;
+    }
+    reader.close();
+
+    tempStats = TempFilesStats();
+    browserStats.clear();
+    ruleStats.clear();
+    std::atomic<int> changed(0);
+
+    // Files that changed since the dry run are left alone rather than deleted
+    auto kernel = makeEntryHandler(false);
+    auto handler = [this, &changed, &kernel](const FileEntry& entry) {
+        if (!matchesFingerprint(entry)) {
+            changed++;
+            Logger& logger = Logger::getInstance();
+            if (logger.isEnabled(LogLevel::WARNING)) {
+                logger.log(LogLevel::WARNING, "Skipping changed file: " + toUtf8(entry.path));
+            }
+            return false;
+        }
+        return kernel(entry);
+    };
+
+    bool success = true;
+    for (auto& section : sections) {
+        EngineResult result = engine.runEntries(std::move(section.entries), handler);
+        for (const auto& message : result.errorMessages) {
+            logError("executePlan", message);
+        }
+        success = success && result.errors == 0;
+
+        if (section.kind == PlanSection::Temp) {
+            addResult(tempStats, result);
+        } else if (section.kind == PlanSection::Rule) {
+            auto stats = std::find_if(ruleStats.begin(), ruleStats.end(),
+                [&section](const RuleStats& s) { return s.ruleName == section.name; });
+            if (stats == ruleStats.end()) {
+                RuleStats added;
+                added.ruleName = section.name;
+                stats = ruleStats.insert(ruleStats.end(), added);
+            }
+            addResult(*stats, result);
+        } else {
+            auto stats = std::find_if(browserStats.begin(), browserStats.end(),
+                [&section](const BrowserCacheStats& s) { return s.browserName == section.name; });
+            if (stats == browserStats.end()) {
+                BrowserCacheStats added;
+                added.browserName = section.name;
+                stats = browserStats.insert(browserStats.end(), added);
+            }
+            addResult(*stats, result);
+        }
+    }
+
+    Logger::getInstance().log(LogLevel::INFO,
+        "Deletion plan executed, " + std::to_string(changed.load()) + " changed files skipped");
+    return success;
+}
+
+bool Cleaner::removeFile(const std::filesystem::path& path, uint64_t size) {
+    ioThrottle.acquire(size);
+    auto start = std::chrono::steady_clock::now();
+    bool removed = std::filesystem::remove(path);
+    ioThrottle.recordLatency(std::chrono::steady_clock::now() - start);
+    return removed;
+}
+
 std::string Cleaner::formatSize(uint64_t bytes) const {
     const char* units[] = {"B", "KB", "MB", "GB", "TB"};
     int unitIndex = 0;
@@ -74,6 +517,34 @@ std::string Cleaner::formatSize(uint64_t bytes) const {
     return ss.str();
 }
 
+std::vector<RuleStats> Cleaner::getRuleStats() const {
+    return ruleStats;
+}
+
+CleaningSummary Cleaner::getSummary() const {
+    CleaningSummary summary;
+    auto add = [&summary](const auto& stats) {
+        summary.filesDeleted += stats.filesDeleted;
+        summary.bytesFreed += stats.bytesFreed;
+        summary.errors += stats.errors;
+    };
+    add(tempStats);
+    add(recycleBinStats);
+    for (const auto& stats : browserStats) add(stats);
+    for (const auto& stats : ruleStats) add(stats);
+    summary.registryEntriesDeleted = registryStats.keysDeleted + registryStats.valuesDeleted;
+    summary.errors += registryStats.errors;
+    return summary;
+}
+
+void Cleaner::resetStatistics() {
+    tempStats = TempFilesStats();
+    recycleBinStats = RecycleBinStats();
+    browserStats.clear();
+    ruleStats.clear();
+    registryStats = RegistryStats();
+}
+
 void Cleaner::showStatistics() const {
     Logger& logger = Logger::getInstance();
     logger.log(LogLevel::INFO, "=== Cleaning Statistics ===");
@@ -81,7 +552,10 @@ void Cleaner::showStatistics() const {
     // Temp files stats
     logger.log(LogLevel::INFO, "Temporary Files:");
     logger.log(LogLevel::INFO, "  Files deleted: " + std::to_string(tempStats.filesDeleted));
-    logger.log(LogLevel::INFO, "  Space freed: " + formatSize(tempStats.bytesFreed));
+    logger.log(LogLevel::INFO, "  Space freed: " + formatSize(tempStats.bytesFreed) +
+               " (" + formatSize(tempStats.physicalBytesFreed) + " on disk)");
+    logger.log(LogLevel::INFO, "  Directories removed: " + std::to_string(tempStats.directoriesRemoved));
+    logger.log(LogLevel::INFO, "  Files in use (skipped): " + std::to_string(tempStats.filesInUse));
     logger.log(LogLevel::INFO, "  Errors: " + std::to_string(tempStats.errors));
     
     if (!tempStats.errorMessages.empty()) {
@@ -96,7 +570,10 @@ void Cleaner::showStatistics() const {
     for (const auto& stats : browserStats) {
         logger.log(LogLevel::INFO, "  " + stats.browserName + ":");
         logger.log(LogLevel::INFO, "    Files deleted: " + std::to_string(stats.filesDeleted));
-        logger.log(LogLevel::INFO, "    Space freed: " + formatSize(stats.bytesFreed));
+        logger.log(LogLevel::INFO, "    Space freed: " + formatSize(stats.bytesFreed) +
+                   " (" + formatSize(stats.physicalBytesFreed) + " on disk)");
+        logger.log(LogLevel::INFO, "    Directories removed: " + std::to_string(stats.directoriesRemoved));
+        logger.log(LogLevel::INFO, "    Files in use (skipped): " + std::to_string(stats.filesInUse));
         logger.log(LogLevel::INFO, "    Errors: " + std::to_string(stats.errors));
 
         if (!stats.errorMessages.empty()) {
@@ -107,12 +584,56 @@ void Cleaner::showStatistics() const {
         }
     }
 
+    // Rule stats
+    if (!ruleStats.empty()) {
+        logger.log(LogLevel::INFO, "Rules:");
+    }
+    for (const auto& stats : ruleStats) {
+        logger.log(LogLevel::INFO, "  " + stats.ruleName + ":");
+        logger.log(LogLevel::INFO, "    Files deleted: " + std::to_string(stats.filesDeleted));
+        logger.log(LogLevel::INFO, "    Space freed: " + formatSize(stats.bytesFreed) +
+                   " (" + formatSize(stats.physicalBytesFreed) + " on disk)");
+        if (stats.filesReported > 0) {
+            logger.log(LogLevel::INFO, "    Files reported: " + std::to_string(stats.filesReported) +
+                       " (" + formatSize(stats.bytesReported) + ")");
+        }
+        if (stats.filesProtected > 0) {
+            logger.log(LogLevel::INFO, "    Protected file types kept: " + std::to_string(stats.filesProtected));
+        }
+        logger.log(LogLevel::INFO, "    Errors: " + std::to_string(stats.errors));
+
+        if (!stats.errorMessages.empty()) {
+            logger.log(LogLevel::ERROR, stats.ruleName + " Error Details:");
+            for (const auto& error : stats.errorMessages) {
+                logger.log(LogLevel::ERROR, "  " + error);
+            }
+        }
+    }
+
     // Recycle bin stats
     logger.log(LogLevel::INFO, "Recycle Bin:");
     logger.log(LogLevel::INFO, "  Files deleted: " + std::to_string(recycleBinStats.filesDeleted));
-    logger.log(LogLevel::INFO, "  Space freed: " + formatSize(recycleBinStats.bytesFreed));
+    logger.log(LogLevel::INFO, "  Space freed: " + formatSize(recycleBinStats.bytesFreed) +
+               " (" + formatSize(recycleBinStats.physicalBytesFreed) + " on disk)");
     logger.log(LogLevel::INFO, "  Errors: " + std::to_string(recycleBinStats.errors));
 
+    // Secure erase stats
+    if (eraser) {
+        SecureEraseStats erased = eraser->getStats();
+        logger.log(LogLevel::INFO, "Secure Erase:");
+        logger.log(LogLevel::INFO, "  Files overwritten: " + std::to_string(erased.filesOverwritten) +
+                   " (" + formatSize(erased.bytesOverwritten) + ")");
+        logger.log(LogLevel::INFO, "  Sparse files (data extents only): " + std::to_string(erased.sparseFiles));
+        logger.log(LogLevel::INFO, "  Without direct I/O: " + std::to_string(erased.bufferedFiles));
+        uint64_t skipped = erased.copyOnWriteFiles + erased.compressedFiles + erased.hardLinkedFiles;
+        if (skipped > 0) {
+            logger.log(LogLevel::WARNING, "  Deleted without overwriting: " + std::to_string(skipped) + " (" +
+                       std::to_string(erased.copyOnWriteFiles) + " on copy-on-write file systems, " +
+                       std::to_string(erased.compressedFiles) + " compressed, " +
+                       std::to_string(erased.hardLinkedFiles) + " with other hard links)");
+        }
+    }
+
     // Registry stats
     logger.log(LogLevel::INFO, "Registry:");
     logger.log(LogLevel::INFO, "  Keys deleted: " + std::to_string(registryStats.keysDeleted));
@@ -121,99 +642,291 @@ void Cleaner::showStatistics() const {
 }
 
 bool Cleaner::cleanTempFiles(bool dryRun) {
+    TraceScope span("cleanTempFiles");
     Logger::getInstance().log(LogLevel::INFO, "Starting temporary files cleaning" + std::string(dryRun ? " (dry run)" : ""));
     
+    bool ownsRun = !dryRun && beginJournalRun("temp");
     tempStats = TempFilesStats();
-    auto tempDirs = getTempDirectories();
-    
-    for (const auto& dir : tempDirs) {
-        if (!isPathIncluded(dir) || isPathExcluded(dir)) {
+    if (currentRun && !dryRun) {
+        // Work done before an interruption counts towards this run
+        tempStats.filesDeleted = currentRun->filesDeleted;
+        tempStats.bytesFreed = currentRun->bytesFreed;
+    }
+
+    std::vector<std::wstring> tempDirs;
+    for (const auto& dir : getTempDirectories()) {
+        if (currentRun && !dryRun && currentRun->cleanedDirectories.count(toUtf8(dir))) {
+            Logger::getInstance().log(LogLevel::INFO, "Skipping already cleaned " + toUtf8(dir));
             continue;
         }
-        
-        try {
-            for (const auto& entry : std::filesystem::recursive_directory_iterator(dir)) {
-                if (entry.is_regular_file()) {
-                    std::string path = entry.path().string();
-                    if (deleteFile(path, dryRun)) {
-                        tempStats.filesDeleted++;
-                        tempStats.bytesFreed += entry.file_size();
-                    }
-                }
-            }
-        } catch (const std::exception& e) {
-            std::string error = "Error processing directory " + std::string(dir.begin(), dir.end()) + ": " + e.what();
-            logError("cleanTempFiles", error);
-            tempStats.errors++;
-            tempStats.errorMessages.push_back(error);
+        if (isPathIncluded(dir) && !isPathExcluded(dir)) {
+            tempDirs.push_back(dir);
         }
     }
     
+    beginPlanSection(PlanSection::Temp, "");
+    EngineResult result = cleanPaths(tempDirs, true, dryRun);
+    addResult(tempStats, result);
+    for (const auto& error : tempStats.errorMessages) {
+        logError("cleanTempFiles", error);
+    }
+    if (currentRun && !dryRun && result.errors == 0) {
+        for (const auto& dir : tempDirs) {
+            journal->recordCleanedDirectory(toUtf8(dir));
+        }
+    }
+    if (!dryRun) recordMetrics({{"cleaner", "temp"}}, result);
+    
     Logger::getInstance().log(LogLevel::INFO, 
         "Temporary files cleaning completed: " + 
         std::to_string(tempStats.filesDeleted) + " files deleted, " +
         formatSize(tempStats.bytesFreed) + " freed");
     
+    if (ownsRun) endJournalRun(tempStats.errors == 0);
     return tempStats.errors == 0;
 }
 
 bool Cleaner::cleanRecycleBin(bool dryRun) {
+    TraceScope span("cleanRecycleBin");
     Logger::getInstance().log(LogLevel::INFO, "Starting recycle bin cleaning" + std::string(dryRun ? " (dry run)" : ""));
     
     recycleBinStats = RecycleBinStats();
     
+#ifdef _WIN32
+    if (trashPolicy.maxAgeDays > 0 || trashPolicy.maxBytes != std::numeric_limits<uint64_t>::max()) {
+        Logger::getInstance().log(LogLevel::WARNING, "Age and size limits are not supported for the Windows recycle bin");
+        return false;
+    }
+
+    // The shell reports item count and size for all drives at once
+    SHQUERYRBINFO info = {};
+    info.cbSize = sizeof(info);
+    if (SUCCEEDED(SHQueryRecycleBinW(nullptr, &info))) {
+        recycleBinStats.filesDeleted = static_cast<int>(info.i64NumItems);
+        recycleBinStats.bytesFreed = static_cast<uint64_t>(info.i64Size);
+        recycleBinStats.physicalBytesFreed = recycleBinStats.bytesFreed;
+    }
+
     if (dryRun) {
-        Logger::getInstance().log(LogLevel::INFO, "Dry run: would empty recycle bin");
+        Logger::getInstance().log(LogLevel::INFO, "Dry run: would empty recycle bin (" +
+            std::to_string(recycleBinStats.filesDeleted) + " items, " + formatSize(recycleBinStats.bytesFreed) + ")");
         return true;
     }
-    
-    SHEmptyRecycleBinW(nullptr, nullptr, SHERB_NOCONFIRMATION | SHERB_NOPROGRESSUI | SHERB_NOSOUND);
-    
-    // Note: We can't get exact statistics for recycle bin
+
+    HRESULT result = SHEmptyRecycleBinW(nullptr, nullptr, SHERB_NOCONFIRMATION | SHERB_NOPROGRESSUI | SHERB_NOSOUND);
+    // An already empty bin reports E_UNEXPECTED
+    if (FAILED(result) && recycleBinStats.filesDeleted > 0) {
+        recycleBinStats = RecycleBinStats();
+        recycleBinStats.errors++;
+        recycleBinStats.errorMessages.push_back("SHEmptyRecycleBinW failed");
+        logError("cleanRecycleBin", "SHEmptyRecycleBinW failed");
+        return false;
+    }
     Logger::getInstance().log(LogLevel::INFO, "Recycle bin emptied");
+    recordMetrics({{"cleaner", "recycle"}}, recycleBinStats);
     return true;
+#else
+    std::vector<std::filesystem::path> trashDirs = trashDirectories.empty() ? TrashBin::findAll() : trashDirectories;
+    std::vector<TrashItem> items;
+    for (const auto& dir : trashDirs) {
+        if (!TrashBin(dir).load(items)) {
+            recycleBinStats.errors++;
+            recycleBinStats.errorMessages.push_back("Cannot read trash directory " + toUtf8(dir));
+        }
+    }
+
+    std::vector<TrashItem> selected = selectTrashItems(std::move(items), trashPolicy, std::time(nullptr));
+    std::vector<FileEntry> entries;
+    entries.reserve(selected.size());
+    for (const auto& item : selected) {
+        FileEntry entry;
+        entry.path = item.file;
+        entry.size = item.size;
+        entry.allocated = item.allocated;
+        entry.device = item.device;
+        entry.inode = item.inode;
+        entries.push_back(std::move(entry));
+    }
+
+    // Items are purged in parallel through the engine's per-device pools
+    EngineResult result = engine.runEntries(std::move(entries), [this, dryRun](const FileEntry& entry) {
+        Logger& logger = Logger::getInstance();
+        if (dryRun) {
+            if (logger.isEnabled(LogLevel::INFO)) {
+                logger.log(LogLevel::INFO,
+                    "Would purge from trash: " + toUtf8(entry.path) + " (" + formatSize(entry.size) + ")");
+            }
+            return true;
+        }
+        ioThrottle.acquire(entry.size);
+        if (!TrashBin::purge(entry.path)) {
+            throw std::runtime_error("cannot remove trashed item");
+        }
+        if (logger.isEnabled(LogLevel::INFO)) {
+            logger.log(LogLevel::INFO, "Purged from trash: " + toUtf8(entry.path));
+        }
+        return true;
+    });
+    addResult(recycleBinStats, result);
+    for (const auto& error : result.errorMessages) {
+        logError("cleanRecycleBin", error);
+    }
+
+    if (!dryRun) {
+        for (const auto& dir : trashDirs) {
+            TrashBin(dir).pruneDirectorySizes();
+        }
+        recordMetrics({{"cleaner", "recycle"}}, result);
+    }
+
+    Logger::getInstance().log(LogLevel::INFO,
+        "Recycle bin cleaning completed: " + std::to_string(recycleBinStats.filesDeleted) + " items, " +
+        formatSize(recycleBinStats.bytesFreed) + " freed");
+    return recycleBinStats.errors == 0;
+#endif
+}
+
+void Cleaner::setTrashPolicy(int maxAgeDays, uint64_t maxBytes) {
+    trashPolicy.maxAgeDays = std::max(maxAgeDays, 0);
+    trashPolicy.maxBytes = maxBytes > 0 ? maxBytes : std::numeric_limits<uint64_t>::max();
+}
+
+EngineResult Cleaner::evictFirefoxCache(const std::vector<std::filesystem::path>& paths, bool dryRun) {
+    struct Profile {
+        std::filesystem::path cacheDir;
+        FirefoxCacheIndex index;
+        std::vector<FirefoxCacheEntry> evicted;
+        bool loaded = false;
+    };
+
+    std::vector<Profile> profiles;
+    for (const auto& path : paths) {
+        if (!FirefoxCacheIndex::isCache2(path)) continue;
+        profiles.emplace_back();
+        profiles.back().cacheDir = path;
+    }
+
+    // Index parsing and metadata reads of all profiles run side by side
+    const std::time_t now = std::time(nullptr);
+    {
+        WorkerPool pool(std::max<size_t>(std::min<size_t>(profiles.size(), std::thread::hardware_concurrency()), 1));
+        for (auto& profile : profiles) {
+            pool.submit([this, &profile, now] {
+                if (!profile.index.load(profile.cacheDir)) return;
+                profile.loaded = true;
+                if (cachePolicy.maxAgeDays > 0) {
+                    for (auto& entry : profile.index.getEntries()) {
+                        FirefoxCacheIndex::readLastFetched(
+                            FirefoxCacheIndex::entryFile(profile.cacheDir, entry.hash), entry.lastFetched);
+                    }
+                }
+                profile.evicted = selectFirefoxEvictions(profile.index.getEntries(), cachePolicy, now);
+            });
+        }
+        pool.wait();
+    }
+
+    std::vector<FileEntry> files;
+    for (const auto& profile : profiles) {
+        if (!profile.loaded) {
+            Logger::getInstance().log(LogLevel::WARNING,
+                "Skipping cache " + toUtf8(profile.cacheDir) + ": " + profile.index.getError());
+            continue;
+        }
+        Logger::getInstance().log(LogLevel::INFO,
+            "Evicting " + std::to_string(profile.evicted.size()) + " of " +
+            std::to_string(profile.index.getEntries().size()) + " entries from " + toUtf8(profile.cacheDir));
+        for (const auto& entry : profile.evicted) {
+            FileEntry fileEntry;
+            if (statFileEntry(FirefoxCacheIndex::entryFile(profile.cacheDir, entry.hash), fileEntry)) {
+                files.push_back(std::move(fileEntry));
+            }
+        }
+    }
+
+    // One engine run deletes the evicted entries of every profile
+    EngineResult result = engine.runEntries(std::move(files), makeEntryHandler(dryRun));
+    if (dryRun) return result;
+
+    for (auto& profile : profiles) {
+        // Firefox rebuilds a dirty index on its own
+        if (!profile.loaded || profile.evicted.empty() || profile.index.isDirty()) continue;
+        auto& entries = profile.index.getEntries();
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&profile](const FirefoxCacheEntry& entry) {
+            std::error_code ec;
+            return !std::filesystem::exists(FirefoxCacheIndex::entryFile(profile.cacheDir, entry.hash), ec);
+        }), entries.end());
+        if (!profile.index.save(profile.cacheDir)) {
+            result.errors++;
+            result.errorMessages.push_back("Cannot rewrite cache index in " + toUtf8(profile.cacheDir));
+        }
+    }
+    return result;
+}
+
+void Cleaner::setCacheEvictionPolicy(int maxAgeDays, uint64_t maxBytes) {
+    cachePolicy.maxAgeDays = std::max(maxAgeDays, 0);
+    cachePolicy.maxBytes = maxBytes > 0 ? maxBytes : std::numeric_limits<uint64_t>::max();
+}
+
+void Cleaner::setTrashDirectories(const std::vector<std::wstring>& paths) {
+    trashDirectories.assign(paths.begin(), paths.end());
+}
+
+void Cleaner::setAllUsers(bool enable) {
+    allUsers = enable;
+}
+
+void Cleaner::setUserHomes(const std::vector<std::filesystem::path>& homes) {
+    userHomes = homes;
 }
 
 bool Cleaner::cleanBrowserCache(bool dryRun) {
     Logger::getInstance().log(LogLevel::INFO, "Starting browser cache cleaning" + std::string(dryRun ? " (dry run)" : ""));
     
     browserStats.clear();
-    bool success = true;
-    
-    // Clean Chromium-based browsers
-    success &= cleanChromiumCache(dryRun);
-    success &= cleanBraveCache(dryRun);
-    success &= cleanVivaldiCache(dryRun);
-    success &= cleanOperaCache(dryRun);
-    
-    // Clean Firefox
-    success &= cleanFirefoxCache(dryRun);
-    
-    return success;
+    return cleanBrowsers(supportedBrowsers(), dryRun);
 }
 
 bool Cleaner::cleanRegistry(bool dryRun) {
+    TraceScope span("cleanRegistry");
     Logger::getInstance().log(LogLevel::INFO, "Starting registry cleaning" + std::string(dryRun ? " (dry run)" : ""));
     
     registryStats = RegistryStats();
+    if (!registry) {
+        Logger::getInstance().log(LogLevel::WARNING, "Registry cleaning is not supported on this platform");
+        return false;
+    }
+
     auto obsoleteKeys = getObsoleteRegistryKeys();
     
     for (const auto& key : obsoleteKeys) {
-        if (cleanRegistryKey(HKEY_CURRENT_USER, key, dryRun)) {
+        if (cleanRegistryKey(RegistryRoot::CurrentUser, key, dryRun)) {
             registryStats.keysDeleted++;
-        } else {
-            registryStats.errors++;
         }
     }
     
     Logger::getInstance().log(LogLevel::INFO, 
         "Registry cleaning completed: " + 
         std::to_string(registryStats.keysDeleted) + " keys deleted");
+
+    Metrics& metrics = Metrics::getInstance();
+    if (!dryRun && metrics.isEnabled()) {
+        const MetricLabels labels{{"cleaner", "registry"}};
+        metrics.addCounter("cookiemonster_registry_keys_deleted_total", labels,
+                           static_cast<uint64_t>(registryStats.keysDeleted));
+        metrics.addCounter("cookiemonster_registry_values_deleted_total", labels,
+                           static_cast<uint64_t>(registryStats.valuesDeleted));
+        metrics.addCounter("cookiemonster_errors_total", labels, static_cast<uint64_t>(registryStats.errors));
+    }
     
     return registryStats.errors == 0;
 }
 
 bool Cleaner::isAdmin() const {
+#ifndef _WIN32
+    return geteuid() == 0;
+#else
     BOOL isAdmin = FALSE;
     PSID adminGroup = nullptr;
     SID_IDENTIFIER_AUTHORITY NtAuthority = SECURITY_NT_AUTHORITY;
@@ -227,11 +940,20 @@ bool Cleaner::isAdmin() const {
     }
     
     return isAdmin != FALSE;
+#endif
 }
 
 std::vector<std::wstring> Cleaner::getTempDirectories() const {
     std::vector<std::wstring> tempDirs;
     
+#ifndef _WIN32
+    std::error_code ec;
+    auto systemTemp = std::filesystem::temp_directory_path(ec);
+    if (!ec) {
+        tempDirs.push_back(systemTemp.wstring());
+    }
+    tempDirs.push_back(L"/var/tmp");
+#else
     // System temp directory
     wchar_t systemTemp[MAX_PATH];
     if (GetTempPathW(MAX_PATH, systemTemp) > 0) {
@@ -245,6 +967,7 @@ std::vector<std::wstring> Cleaner::getTempDirectories() const {
         userTempPath += L"\\Temp";
         tempDirs.push_back(userTempPath);
     }
+#endif
     
     return tempDirs;
 }
@@ -256,7 +979,9 @@ bool Cleaner::deleteFile(const std::string& path, bool dryRun) {
             return true;
         }
         
-        if (std::filesystem::remove(path)) {
+        std::error_code ec;
+        uint64_t fileSize = std::filesystem::file_size(path, ec);
+        if (removeFile(path, ec ? 0 : fileSize)) {
             Logger::getInstance().log(LogLevel::INFO, "Deleted: " + path);
             return true;
         }
@@ -267,343 +992,296 @@ bool Cleaner::deleteFile(const std::string& path, bool dryRun) {
 }
 
 bool Cleaner::cleanChromiumCache(bool dryRun) {
-    const std::wstring localAppData = getLocalAppData();
-    if (localAppData.empty()) return false;
-
-    // Chrome cache paths
-    std::vector<std::wstring> chromePaths = {
-        localAppData + L"\\Google\\Chrome\\User Data\\Default\\Cache",
-        localAppData + L"\\Google\\Chrome\\User Data\\Default\\Code Cache",
-        localAppData + L"\\Google\\Chrome\\User Data\\Default\\GPUCache"
-    };
-
-    // Edge cache paths
-    std::vector<std::wstring> edgePaths = {
-        localAppData + L"\\Microsoft\\Edge\\User Data\\Default\\Cache",
-        localAppData + L"\\Microsoft\\Edge\\User Data\\Default\\Code Cache",
-        localAppData + L"\\Microsoft\\Edge\\User Data\\Default\\GPUCache"
-    };
-
-    BrowserCacheStats chromeStats;
-    chromeStats.browserName = "Google Chrome";
-    
-    // Clean Chrome cache
-    for (const auto& path : chromePaths) {
-        try {
-            if (std::filesystem::exists(path)) {
-                for (const auto& entry : std::filesystem::directory_iterator(path)) {
-                    try {
-                        if (std::filesystem::is_regular_file(entry)) {
-                            uint64_t fileSize = std::filesystem::file_size(entry.path());
-                            if (dryRun) {
-                                Logger::getInstance().log(LogLevel::INFO, 
-                                    "Would delete: " + entry.path().string() + 
-                                    " (" + formatSize(fileSize) + ")");
-                            } else {
-                                if (std::filesystem::remove(entry.path())) {
-                                    chromeStats.filesDeleted++;
-                                    chromeStats.bytesFreed += fileSize;
-                                }
-                            }
-                        }
-                    } catch (const std::exception& e) {
-                        chromeStats.errors++;
-                    }
-                }
-            }
-        } catch (const std::exception& e) {
-            chromeStats.errors++;
-        }
-    }
-    
-    BrowserCacheStats edgeStats;
-    edgeStats.browserName = "Microsoft Edge";
-    
-    // Clean Edge cache
-    for (const auto& path : edgePaths) {
-        try {
-            if (std::filesystem::exists(path)) {
-                for (const auto& entry : std::filesystem::directory_iterator(path)) {
-                    try {
-                        if (std::filesystem::is_regular_file(entry)) {
-                            uint64_t fileSize = std::filesystem::file_size(entry.path());
-                            if (dryRun) {
-                                Logger::getInstance().log(LogLevel::INFO, 
-                                    "Would delete: " + entry.path().string() + 
-                                    " (" + formatSize(fileSize) + ")");
-                            } else {
-                                if (std::filesystem::remove(entry.path())) {
-                                    edgeStats.filesDeleted++;
-                                    edgeStats.bytesFreed += fileSize;
-                                }
-                            }
-                        }
-                    } catch (const std::exception& e) {
-                        edgeStats.errors++;
-                    }
-                }
-            }
-        } catch (const std::exception& e) {
-            edgeStats.errors++;
-        }
-    }
-
-    browserStats.push_back(chromeStats);
-    browserStats.push_back(edgeStats);
-    
-    return true;
+    return cleanBrowsers({"Google Chrome", "Microsoft Edge", "Chromium"}, dryRun);
 }
 
 bool Cleaner::cleanFirefoxCache(bool dryRun) {
-    const std::wstring localAppData = getLocalAppData();
-    if (localAppData.empty()) return false;
-
-    // Firefox cache paths
-    std::vector<std::wstring> firefoxPaths = {
-        localAppData + L"\\Mozilla\\Firefox\\Profiles"
-    };
-
-    BrowserCacheStats firefoxStats;
-    firefoxStats.browserName = "Mozilla Firefox";
-
-    try {
-        for (const auto& basePath : firefoxPaths) {
-            if (!std::filesystem::exists(basePath)) continue;
-
-            // Iterate through profile directories
-            for (const auto& profile : std::filesystem::directory_iterator(basePath)) {
-                if (!std::filesystem::is_directory(profile)) continue;
-
-                // Cache2 directory contains the browser cache
-                std::wstring cachePath = profile.path() / L"cache2";
-                if (!std::filesystem::exists(cachePath)) continue;
-
-                // Clean cache files
-                for (const auto& entry : std::filesystem::recursive_directory_iterator(cachePath)) {
-                    try {
-                        if (std::filesystem::is_regular_file(entry)) {
-                            uint64_t fileSize = std::filesystem::file_size(entry.path());
-                            if (dryRun) {
-                                Logger::getInstance().log(LogLevel::INFO, 
-                                    "Would delete: " + entry.path().string() + 
-                                    " (" + formatSize(fileSize) + ")");
-                            } else {
-                                if (std::filesystem::remove(entry.path())) {
-                                    firefoxStats.filesDeleted++;
-                                    firefoxStats.bytesFreed += fileSize;
-                                }
-                            }
-                        }
-                    } catch (const std::exception& e) {
-                        firefoxStats.errors++;
-                    }
-                }
-            }
-        }
-    } catch (const std::exception& e) {
-        firefoxStats.errors++;
-    }
-
-    browserStats.push_back(firefoxStats);
-    return true;
+    return cleanBrowsers({"Mozilla Firefox"}, dryRun);
 }
 
 bool Cleaner::cleanOperaCache(bool dryRun) {
-    const std::wstring localAppData = getLocalAppData();
-    if (localAppData.empty()) return false;
+    return cleanBrowsers({"Opera"}, dryRun);
+}
 
-    BrowserCacheStats operaStats;
-    operaStats.browserName = "Opera";
-    
-    std::wstring operaPath = localAppData + L"\\Opera Software\\Opera Stable\\Cache";
-    if (!std::filesystem::exists(operaPath)) {
-        Logger::getInstance().log(LogLevel::WARNING, "Opera cache directory not found");
-        return false;
-    }
+bool Cleaner::cleanBraveCache(bool dryRun) {
+    return cleanBrowsers({"Brave"}, dryRun);
+}
 
-    try {
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(operaPath)) {
-            if (entry.is_regular_file()) {
-                uint64_t fileSize = entry.file_size();
-                if (dryRun) {
-                    Logger::getInstance().log(LogLevel::INFO, 
-                        "Would delete: " + entry.path().string() + 
-                        " (" + formatSize(fileSize) + ")");
-                } else {
-                    if (std::filesystem::remove(entry.path())) {
-                        operaStats.filesDeleted++;
-                        operaStats.bytesFreed += fileSize;
-                    }
-                }
-            }
+bool Cleaner::cleanVivaldiCache(bool dryRun) {
+    return cleanBrowsers({"Vivaldi"}, dryRun);
+}
+
+std::vector<BrowserProfile> Cleaner::discoverBrowserProfiles() const {
+    std::vector<UserDirectories> users;
+    if (userHomes.empty()) {
+        users = findUserDirectories(allUsers);
+    } else {
+        for (const auto& home : userHomes) {
+            users.push_back(userDirectoriesForHome(home, toUtf8(home.filename())));
         }
-    } catch (const std::exception& e) {
-        std::string error = "Error cleaning Opera cache: " + std::string(e.what());
-        logError("cleanOperaCache", error);
-        operaStats.errors++;
-        operaStats.errorMessages.push_back(error);
     }
 
-    browserStats.push_back(operaStats);
-    return operaStats.errors == 0;
+    std::vector<BrowserProfile> profiles = discoverProfiles(users);
+    Logger::getInstance().log(LogLevel::INFO,
+        "Found " + std::to_string(profiles.size()) + " browser profiles of " + std::to_string(users.size()) + " users");
+    return profiles;
 }
 
-bool Cleaner::cleanBraveCache(bool dryRun) {
-    const std::wstring localAppData = getLocalAppData();
-    if (localAppData.empty()) return false;
-
-    BrowserCacheStats braveStats;
-    braveStats.browserName = "Brave";
-    
-    std::wstring bravePath = localAppData + L"\\BraveSoftware\\Brave-Browser\\User Data\\Default\\Cache";
-    if (!std::filesystem::exists(bravePath)) {
-        Logger::getInstance().log(LogLevel::WARNING, "Brave cache directory not found");
-        return false;
+bool Cleaner::cleanBrowsers(const std::vector<std::string>& names, bool dryRun) {
+    TraceScope span("cleanBrowsers");
+    span.setArgument("browsers", names.size());
+    // One root set per browser, holding the caches of all its profiles
+    std::vector<std::vector<std::filesystem::path>> rootSets(names.size());
+    for (const auto& profile : discoverBrowserProfiles()) {
+        auto name = std::find(names.begin(), names.end(), profile.browserName);
+        if (name == names.end()) continue;
+        Logger::getInstance().log(LogLevel::DEBUG,
+            profile.browserName + " profile \"" + profile.profileName + "\" of " + profile.user);
+        auto& roots = rootSets[static_cast<size_t>(name - names.begin())];
+        roots.insert(roots.end(), profile.cacheDirs.begin(), profile.cacheDirs.end());
     }
 
-    try {
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(bravePath)) {
-            if (entry.is_regular_file()) {
-                uint64_t fileSize = entry.file_size();
-                if (dryRun) {
-                    Logger::getInstance().log(LogLevel::INFO, 
-                        "Would delete: " + entry.path().string() + 
-                        " (" + formatSize(fileSize) + ")");
-                } else {
-                    if (std::filesystem::remove(entry.path())) {
-                        braveStats.filesDeleted++;
-                        braveStats.bytesFreed += fileSize;
-                    }
-                }
+    std::vector<EngineResult> results(names.size());
+    if (cachePolicy.isSet()) {
+        // Eviction reads each cache's own index, so it goes browser by browser
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (rootSets[i].empty()) continue;
+            TraceScope browserSpan(names[i]);
+            beginPlanSection(PlanSection::Browser, names[i]);
+            results[i] = browserFamily(names[i]) == BrowserFamily::Firefox ? evictFirefoxCache(rootSets[i], dryRun)
+                                                                           : evictChromiumCache(rootSets[i], dryRun);
+        }
+    } else {
+        // Every profile of every browser is cleaned in one parallel pass. Plan
+        // sections are sequential, so planned entries are buffered per browser.
+        std::vector<std::vector<FileEntry>> planned(names.size());
+        std::mutex plannedMutex;
+        const bool recordPlan = dryRun && planWriter;
+        auto observer = [&](const FileEntry& entry) {
+            std::lock_guard<std::mutex> lock(plannedMutex);
+            planned[entry.rootSet].push_back(entry);
+        };
+        results = recordPlan ? runKernel(rootSets, true, dryRun, observer) : runKernel(rootSets, true, dryRun);
+
+        for (size_t i = 0; i < names.size() && recordPlan; ++i) {
+            if (rootSets[i].empty()) continue;
+            beginPlanSection(PlanSection::Browser, names[i]);
+            for (const auto& entry : planned[i]) {
+                planWriter->add(entry);
             }
         }
-    } catch (const std::exception& e) {
-        std::string error = "Error cleaning Brave cache: " + std::string(e.what());
-        logError("cleanBraveCache", error);
-        braveStats.errors++;
-        braveStats.errorMessages.push_back(error);
     }
 
-    browserStats.push_back(braveStats);
-    return braveStats.errors == 0;
+    bool success = true;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (rootSets[i].empty()) {
+            Logger::getInstance().log(LogLevel::DEBUG, names[i] + " has no cache directories");
+            continue;
+        }
+        BrowserCacheStats stats;
+        stats.browserName = names[i];
+        addResult(stats, results[i]);
+        for (const auto& error : stats.errorMessages) {
+            logError("cleanBrowsers", error);
+        }
+        success = success && stats.errors == 0;
+        if (!dryRun) recordMetrics({{"cleaner", "browser"}, {"browser", names[i]}}, stats);
+        browserStats.push_back(stats);
+    }
+    return success;
 }
 
-bool Cleaner::cleanVivaldiCache(bool dryRun) {
-    const std::wstring localAppData = getLocalAppData();
-    if (localAppData.empty()) return false;
-
-    BrowserCacheStats vivaldiStats;
-    vivaldiStats.browserName = "Vivaldi";
-    
-    std::wstring vivaldiPath = localAppData + L"\\Vivaldi\\User Data\\Default\\Cache";
-    if (!std::filesystem::exists(vivaldiPath)) {
-        Logger::getInstance().log(LogLevel::WARNING, "Vivaldi cache directory not found");
-        return false;
+bool Cleaner::cleanRules(const RulePlan& plan, bool dryRun) {
+    TraceScope span("cleanRules");
+    const auto& rules = plan.getRules();
+    span.setArgument("rules", rules.size());
+    Logger::getInstance().log(LogLevel::INFO,
+        "Starting rule cleaning: " + std::to_string(rules.size()) + " rules over " +
+        std::to_string(plan.getRoots().size()) + " roots" + std::string(dryRun ? " (dry run)" : ""));
+
+    // One root set per merged root, so every file is matched against only
+    // the rules that reach it; filtered roots keep their index but stay empty
+    std::vector<std::vector<std::filesystem::path>> rootSets(plan.getRoots().size());
+    for (size_t i = 0; i < rootSets.size(); ++i) {
+        const auto& root = plan.getRoots()[i];
+        if (isPathIncluded(root) && !isPathExcluded(root)) {
+            rootSets[i].push_back(root);
+        }
     }
 
-    try {
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(vivaldiPath)) {
-            if (entry.is_regular_file()) {
-                uint64_t fileSize = entry.file_size();
-                if (dryRun) {
-                    Logger::getInstance().log(LogLevel::INFO, 
-                        "Would delete: " + entry.path().string() + 
-                        " (" + formatSize(fileSize) + ")");
-                } else {
-                    if (std::filesystem::remove(entry.path())) {
-                        vivaldiStats.filesDeleted++;
-                        vivaldiStats.bytesFreed += fileSize;
-                    }
-                }
+    struct RuleTally {
+        std::atomic<int> filesDeleted{0};
+        std::atomic<int> errors{0};
+        std::atomic<int> filesReported{0};
+        std::atomic<uint64_t> bytesReported{0};
+        std::atomic<int> filesProtected{0};
+    };
+    std::vector<RuleTally> tallies(rules.size());
+    // Shared by all rules, so a file linked under two of them is counted once
+    SpaceAccounting accounting(rules.size());
+    std::vector<std::vector<std::string>> messages(rules.size());
+    std::vector<std::vector<FileEntry>> planned(rules.size());
+    std::mutex mutex;
+
+    // Plan sections are sequential, so planned entries are buffered per rule
+    const bool recordPlan = dryRun && planWriter;
+    const std::time_t now = std::time(nullptr);
+    // The type filter is applied per rule below, not by the kernel
+    KernelContext context = makeKernelContext(dryRun, false);
+    context.fileTypes = nullptr;
+    const FileTypeFilter* typeFilter = fileTypes.isActive() ? &fileTypes : nullptr;
+    auto kernel = makeCleaningKernel(context, dryRun, backupMode, Logger::getInstance().isEnabled(LogLevel::INFO));
+    auto handler = [&](const FileEntry& entry) {
+        RulePlan::Match match = plan.match(entry, now);
+        if (match.rule < 0 || match.action == RuleAction::Keep) return false;
+        const size_t rule = static_cast<size_t>(match.rule);
+        RuleTally& tally = tallies[rule];
+        if (match.action == RuleAction::Report) {
+            tally.filesReported++;
+            tally.bytesReported += entry.size;
+            Logger& logger = Logger::getInstance();
+            if (logger.isEnabled(LogLevel::INFO)) {
+                logger.log(LogLevel::INFO, "Rule " + rules[rule].name + " reports " + toUtf8(entry.path));
             }
+            return false;
+        }
+        // A rule that lists its extensions has chosen the types itself
+        if (typeFilter && rules[rule].extensions.empty() && !typeFilter->allows(entry.path)) {
+            tally.filesProtected++;
+            Logger::getInstance().log(LogLevel::WARNING,
+                "Rule " + rules[rule].name + " matches a protected file type, kept: " + toUtf8(entry.path));
+            return false;
+        }
+        if (recordPlan) {
+            std::lock_guard<std::mutex> lock(mutex);
+            planned[rule].push_back(entry);
         }
-    } catch (const std::exception& e) {
-        std::string error = "Error cleaning Vivaldi cache: " + std::string(e.what());
-        logError("cleanVivaldiCache", error);
-        vivaldiStats.errors++;
-        vivaldiStats.errorMessages.push_back(error);
-    }
-
-    browserStats.push_back(vivaldiStats);
-    return vivaldiStats.errors == 0;
-}
 
-bool Cleaner::cleanRegistryKey(HKEY hKey, const std::wstring& subKey, bool dryRun) {
-    if (dryRun) {
-        Logger::getInstance().log(LogLevel::INFO, "Dry run: would clean registry key " + std::string(subKey.begin(), subKey.end()));
+        // Errors are counted for the rule and still reported to the engine;
+        // busy files are retried by the engine, so they are not errors yet
+        try {
+            if (!kernel(entry)) return false;
+        } catch (const std::filesystem::filesystem_error& e) {
+            if (!isFileInUseError(e.code())) {
+                tally.errors++;
+                std::lock_guard<std::mutex> lock(mutex);
+                messages[rule].push_back("Error processing " + toUtf8(entry.path) + ": " + e.what());
+            }
+            throw;
+        } catch (const std::exception& e) {
+            tally.errors++;
+            std::lock_guard<std::mutex> lock(mutex);
+            messages[rule].push_back("Error processing " + toUtf8(entry.path) + ": " + e.what());
+            throw;
+        }
+        tally.filesDeleted++;
+        accounting.record(entry, rule);
         return true;
-    }
+    };
 
-    HKEY hSubKey;
-    if (RegOpenKeyExW(hKey, subKey.c_str(), 0, KEY_ALL_ACCESS, &hSubKey) != ERROR_SUCCESS) {
-        std::string error = "Failed to open registry key: " + std::string(subKey.begin(), subKey.end());
-        logError("cleanRegistryKey", error);
-        registryStats.errors++;
-        registryStats.errorMessages.push_back(error);
-        return false;
-    }
+    // Files a rule does not select stay, so directories are never removed
+    std::vector<EngineResult> results = engine.runSets(rootSets, plan.isRecursive(), handler);
 
-    // Delete all values
-    DWORD valueCount;
-    if (RegQueryInfoKeyW(hSubKey, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &valueCount, nullptr, nullptr, nullptr, nullptr) == ERROR_SUCCESS) {
-        for (DWORD i = 0; i < valueCount; i++) {
-            wchar_t valueName[MAX_PATH];
-            DWORD valueNameSize = MAX_PATH;
-            if (RegEnumValueW(hSubKey, i, valueName, &valueNameSize, nullptr, nullptr, nullptr, nullptr) == ERROR_SUCCESS) {
-                if (deleteRegistryValue(hKey, subKey, valueName, dryRun)) {
-                    registryStats.valuesDeleted++;
-                }
-            }
+    ruleStats.clear();
+    bool success = true;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        RuleStats stats;
+        stats.ruleName = rules[i].name;
+        stats.filesDeleted = tallies[i].filesDeleted;
+        stats.errors = tallies[i].errors;
+        stats.bytesFreed = accounting.getLogicalBytes(i);
+        stats.physicalBytesFreed = accounting.getPhysicalBytes(i);
+        stats.filesReported = tallies[i].filesReported;
+        stats.bytesReported = tallies[i].bytesReported;
+        stats.filesProtected = tallies[i].filesProtected;
+        stats.errorMessages = std::move(messages[i]);
+        for (const auto& error : stats.errorMessages) {
+            logError("cleanRules", error);
         }
-    }
+        success = success && stats.errors == 0;
+        if (!dryRun) recordMetrics({{"cleaner", "rules"}, {"rule", rules[i].name}}, stats);
 
-    // Delete all subkeys
-    DWORD subKeyCount;
-    if (RegQueryInfoKeyW(hSubKey, nullptr, nullptr, nullptr, &subKeyCount, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr) == ERROR_SUCCESS) {
-        for (DWORD i = 0; i < subKeyCount; i++) {
-            wchar_t subKeyName[MAX_PATH];
-            DWORD subKeyNameSize = MAX_PATH;
-            if (RegEnumKeyExW(hSubKey, i, subKeyName, &subKeyNameSize, nullptr, nullptr, nullptr, nullptr) == ERROR_SUCCESS) {
-                std::wstring fullSubKey = subKey + L"\\" + subKeyName;
-                if (cleanRegistryKey(hKey, fullSubKey, dryRun)) {
-                    registryStats.keysDeleted++;
-                }
+        if (recordPlan && !planned[i].empty()) {
+            beginPlanSection(PlanSection::Rule, rules[i].name);
+            for (const auto& entry : planned[i]) {
+                planWriter->add(entry);
             }
         }
+        ruleStats.push_back(std::move(stats));
     }
 
-    RegCloseKey(hSubKey);
-    return true;
+    // Busy files are only known per root, not per rule
+    int filesInUse = 0;
+    for (const auto& result : results) {
+        filesInUse += result.filesInUse;
+        success = success && result.errors == 0;
+    }
+    Logger::getInstance().log(LogLevel::INFO,
+        "Rule cleaning completed, " + std::to_string(filesInUse) + " files in use skipped");
+    return success;
 }
 
-bool Cleaner::deleteRegistryValue(HKEY hKey, const std::wstring& subKey, const std::wstring& valueName, bool dryRun) {
-    if (dryRun) {
-        Logger::getInstance().log(LogLevel::INFO, 
-            "Dry run: would delete registry value " + 
-            std::string(subKey.begin(), subKey.end()) + "\\" + 
-            std::string(valueName.begin(), valueName.end()));
-        return true;
+void Cleaner::setRegistryBackend(std::unique_ptr<RegistryBackend> backend) {
+    registry = std::move(backend);
+}
+
+void Cleaner::registryError(const std::string& error) {
+    logError("cleanRegistryKey", error);
+    registryStats.errors++;
+    registryStats.errorMessages.push_back(error);
+}
+
+bool Cleaner::cleanRegistryKey(RegistryRoot root, const std::wstring& subKey, bool dryRun) {
+    std::string keyName = wideToUtf8(subKey);
+    auto key = registry ? timedRegistryCall([&] {
+                              return registry->openKey(root, subKey, dryRun ? RegistryAccess::Read
+                                                                            : RegistryAccess::Write);
+                          })
+                        : nullptr;
+    if (!key) {
+        registryError("Failed to open registry key: " + keyName);
+        return false;
     }
 
-    HKEY hSubKey;
-    if (RegOpenKeyExW(hKey, subKey.c_str(), 0, KEY_ALL_ACCESS, &hSubKey) != ERROR_SUCCESS) {
+    // Collect all names before deleting anything; enumerating by index
+    // while deleting shifts the remaining entries and skips every other one
+    std::vector<RegistryValue> values;
+    std::vector<std::wstring> subKeys;
+    if (!timedRegistryCall([&] { return key->listValues(values, false); }) ||
+        !timedRegistryCall([&] { return key->listSubKeys(subKeys); })) {
+        registryError("Failed to enumerate registry key: " + keyName);
         return false;
     }
 
-    LONG result = RegDeleteValueW(hSubKey, valueName.c_str());
-    RegCloseKey(hSubKey);
+    bool success = true;
+    for (const auto& value : values) {
+        std::string valueName = keyName + "\\" + wideToUtf8(value.name);
+        if (dryRun) {
+            Logger::getInstance().log(LogLevel::INFO, "Dry run: would delete registry value " + valueName);
+            registryStats.valuesDeleted++;
+        } else if (timedRegistryCall([&] { return key->deleteValue(value.name); })) {
+            registryStats.valuesDeleted++;
+        } else {
+            registryError("Failed to delete registry value: " + valueName);
+            success = false;
+        }
+    }
 
-    if (result != ERROR_SUCCESS) {
-        std::string error = "Failed to delete registry value: " + 
-            std::string(subKey.begin(), subKey.end()) + "\\" + 
-            std::string(valueName.begin(), valueName.end());
-        logError("deleteRegistryValue", error);
-        registryStats.errors++;
-        registryStats.errorMessages.push_back(error);
-        return false;
+    // Subkeys go as whole trees through the already open parent handle
+    for (const auto& name : subKeys) {
+        std::string subKeyName = keyName + "\\" + wideToUtf8(name);
+        if (dryRun) {
+            Logger::getInstance().log(LogLevel::INFO, "Dry run: would delete registry key " + subKeyName);
+            registryStats.keysDeleted++;
+        } else if (timedRegistryCall([&] { return key->deleteTree(name); })) {
+            registryStats.keysDeleted++;
+        } else {
+            registryError("Failed to delete registry key: " + subKeyName);
+            success = false;
+        }
     }
 
-    return true;
+    return success;
 }
 
 std::vector<std::wstring> Cleaner::getObsoleteRegistryKeys() const {
@@ -619,34 +1297,31 @@ std::vector<std::wstring> Cleaner::getObsoleteRegistryKeys() const {
     return keys;
 }
 
-std::wstring Cleaner::getLocalAppData() const {
-    wchar_t localAppData[MAX_PATH];
-    if (SUCCEEDED(SHGetFolderPathW(nullptr, CSIDL_LOCAL_APPDATA, nullptr, 0, localAppData))) {
-        return localAppData;
-    }
-    return L"";
-}
-
 std::string Cleaner::generateBackupPath(const std::string& operationType) const {
     auto now = std::chrono::system_clock::now();
     auto time = std::chrono::system_clock::to_time_t(now);
     std::stringstream ss;
-    ss << "backups\\" << operationType << "_" << std::put_time(std::localtime(&time), "%Y%m%d_%H%M%S");
-    return ss.str();
+    ss << operationType << "_" << std::put_time(std::localtime(&time), "%Y%m%d_%H%M%S");
+    return (std::filesystem::path("backups") / ss.str()).string();
 }
 
 bool Cleaner::createBackup(const std::string& operationType) {
+    TraceScope span("createBackup");
     Logger::getInstance().log(LogLevel::INFO, "Creating backup for operation: " + operationType);
     
-    BackupInfo backup;
-    backup.operationType = operationType;
-    backup.timestamp = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
-    backup.backupPath = generateBackupPath(operationType);
+    bool ownsRun = beginJournalRun(operationType);
+    BackupInfo backup = beginBackup(operationType);
+    if (currentRun && currentRun->backupComplete) {
+        addBackupToHistory(backup);
+        if (ownsRun) endJournalRun(true);
+        return true;
+    }
     
     // Create backup directory
     std::filesystem::create_directories(backup.backupPath);
     
     bool success = true;
+    std::unordered_set<std::string> backedUp(backup.files.begin(), backup.files.end());
     
     if (operationType == "temp") {
         auto tempDirs = getTempDirectories();
@@ -656,119 +1331,188 @@ bool Cleaner::createBackup(const std::string& operationType) {
             }
             
             try {
-                for (const auto& entry : std::filesystem::recursive_directory_iterator(dir)) {
-                    if (entry.is_regular_file()) {
-                        std::string sourcePath = entry.path().string();
-                        std::string targetPath = backup.backupPath + "\\" + entry.path().filename().string();
-                        if (backupFile(sourcePath, targetPath)) {
-                            backup.files.push_back(sourcePath);
-                            backup.totalSize += entry.file_size();
-                        }
-                    }
-                }
+                backupTree(dir, backup, backedUp);
             } catch (const std::exception& e) {
-                std::string error = "Error backing up directory " + std::string(dir.begin(), dir.end()) + ": " + e.what();
+                std::string error = "Error backing up directory " + toUtf8(dir) + ": " + e.what();
                 logError("createBackup", error);
                 success = false;
             }
         }
-    } else if (operationType == "registry") {
+    } else if (operationType == "registry" && registry) {
         auto obsoleteKeys = getObsoleteRegistryKeys();
         for (const auto& key : obsoleteKeys) {
-            if (backupRegistryKey(HKEY_CURRENT_USER, key, backup.backupPath)) {
-                backup.registryKeys.push_back({std::string(key.begin(), key.end()), ""});
+            if (backupRegistryKey(RegistryRoot::CurrentUser, key, backup.backupPath)) {
+                backup.registryKeys.push_back({wideToUtf8(key),
+                                               toUtf8(registrySnapshotPath(backup.backupPath, key))});
             }
         }
     } else if (operationType == "browser") {
         auto browserPaths = getBrowserPaths();
         for (const auto& path : browserPaths) {
             try {
-                for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
-                    if (entry.is_regular_file()) {
-                        std::string sourcePath = entry.path().string();
-                        std::string targetPath = backup.backupPath + "\\" + entry.path().filename().string();
-                        if (backupFile(sourcePath, targetPath)) {
-                            backup.files.push_back(sourcePath);
-                            backup.totalSize += entry.file_size();
-                        }
-                    }
-                }
+                backupTree(path, backup, backedUp);
             } catch (const std::exception& e) {
-                std::string error = "Error backing up browser path " + std::string(path.begin(), path.end()) + ": " + e.what();
+                std::string error = "Error backing up browser path " + toUtf8(path) + ": " + e.what();
                 logError("createBackup", error);
                 success = false;
             }
         }
     }
     
+    if (success && currentRun) {
+        // Cleaning may only start once the completed backup is on record
+        journal->recordBackupComplete();
+        currentRun->backupComplete = true;
+        if (!journal->sync()) {
+            logError("createBackup", "Failed to sync journal");
+            success = false;
+        }
+    }
+
     if (success) {
-        backupHistory.push_back(backup);
+        addBackupToHistory(backup);
         Logger::getInstance().log(LogLevel::INFO, "Backup created successfully: " + backup.backupPath);
     } else {
         Logger::getInstance().log(LogLevel::ERROR, "Backup creation completed with errors");
     }
     
+    if (ownsRun) endJournalRun(success);
     return success;
 }
 
-bool Cleaner::backupFile(const std::string& sourcePath, const std::string& backupPath) {
-    try {
-        std::filesystem::copy_file(sourcePath, backupPath, std::filesystem::copy_options::overwrite_existing);
-        return true;
-    } catch (const std::exception& e) {
-        std::string error = "Error backing up file " + sourcePath + ": " + e.what();
-        logError("backupFile", error);
-        return false;
+BackupInfo Cleaner::beginBackup(const std::string& operationType) {
+    BackupInfo backup;
+    backup.operationType = operationType;
+    if (currentRun && !currentRun->backupPath.empty()) {
+        // Continue the backup of an interrupted run in its original directory
+        backup.timestamp = currentRun->timestamp;
+        backup.backupPath = currentRun->backupPath;
+        backup.files = currentRun->backedUpFiles;
+        backup.totalSize = currentRun->backupBytes;
+        if (!currentRun->backupComplete) {
+            Logger::getInstance().log(LogLevel::INFO, "Continuing backup in " + backup.backupPath);
+        }
+    } else {
+        backup.timestamp = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+        backup.backupPath = generateBackupPath(operationType);
+        if (currentRun) {
+            journal->recordBackupStarted(backup.backupPath, backup.timestamp);
+        }
     }
+    return backup;
 }
 
-bool Cleaner::backupRegistryKey(HKEY hKey, const std::wstring& subKey, const std::string& backupPath) {
-    HKEY hSubKey;
-    if (RegOpenKeyExW(hKey, subKey.c_str(), 0, KEY_READ, &hSubKey) != ERROR_SUCCESS) {
+bool Cleaner::cleanWithBackup(const std::string& operationType, bool dryRun, bool (Cleaner::*clean)(bool)) {
+    TraceScope span("cleanWithBackup");
+    // A dry run deletes nothing, so there is nothing to preserve
+    if (dryRun) return (this->*clean)(true);
+
+    // Backup and cleaning are journaled as one run
+    bool ownsRun = beginJournalRun(operationType);
+    BackupInfo backup = beginBackup(operationType);
+    std::error_code ec;
+    std::filesystem::create_directories(backup.backupPath, ec);
+    if (ec) {
+        logError("cleanWithBackup", "Cannot create backup directory " + backup.backupPath + ": " + ec.message());
+        if (ownsRun) endJournalRun(false);
         return false;
     }
-    
-    // Create backup file
-    std::string backupFile = backupPath + "\\" + std::string(subKey.begin(), subKey.end()) + ".reg";
-    std::ofstream file(backupFile);
-    if (!file.is_open()) {
-        RegCloseKey(hSubKey);
-        return false;
+
+    // Each file is preserved right before it is deleted, in the same pass;
+    // a file whose backup fails is kept and counted as an error
+    fusedBackup = std::make_unique<BackupStore>(backup.backupPath,
+        currentRun ? journal.get() : nullptr, backup.files);
+    bool cleaned = (this->*clean)(false);
+    auto stored = fusedBackup->getFiles();
+    backup.files.insert(backup.files.end(), stored.begin(), stored.end());
+    backup.totalSize += fusedBackup->getTotalSize();
+    fusedBackup.reset();
+
+    if (cleaned && currentRun) {
+        journal->recordBackupComplete();
+        currentRun->backupComplete = true;
     }
-    
-    // Write registry key to file
-    file << "Windows Registry Editor Version 5.00\n\n";
-    file << "[" << std::string(subKey.begin(), subKey.end()) << "]\n";
-    
-    // Get and write values
-    DWORD valueCount;
-    if (RegQueryInfoKeyW(hSubKey, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &valueCount, nullptr, nullptr, nullptr, nullptr) == ERROR_SUCCESS) {
-        for (DWORD i = 0; i < valueCount; i++) {
-            wchar_t valueName[MAX_PATH];
-            DWORD valueNameSize = MAX_PATH;
-            DWORD valueType;
-            BYTE valueData[4096];
-            DWORD valueDataSize = sizeof(valueData);
-            
-            if (RegEnumValueW(hSubKey, i, valueName, &valueNameSize, nullptr, &valueType, valueData, &valueDataSize) == ERROR_SUCCESS) {
-                file << "\"" << std::string(valueName, valueName + valueNameSize) << "\"=";
-                
-                switch (valueType) {
-                    case REG_SZ:
-                        file << "\"" << std::string(reinterpret_cast<char*>(valueData), valueDataSize - 1) << "\"";
-                        break;
-                    case REG_DWORD:
-                        file << "dword:" << std::hex << *reinterpret_cast<DWORD*>(valueData);
-                        break;
-                    // Add more value types as needed
-                }
-                
-                file << "\n";
+    addBackupToHistory(backup);
+    Logger::getInstance().log(LogLevel::INFO,
+        "Backed up " + std::to_string(backup.files.size()) + " files to " + backup.backupPath);
+
+    if (ownsRun) endJournalRun(cleaned);
+    return cleaned;
+}
+
+void Cleaner::backupTree(const std::filesystem::path& root, BackupInfo& backup, std::unordered_set<std::string>& backedUp) {
+    std::vector<std::filesystem::path> directories{root};
+    while (!directories.empty()) {
+        std::filesystem::path dir = std::move(directories.back());
+        directories.pop_back();
+        std::string dirKey = toUtf8(dir);
+        bool done = currentRun && currentRun->backupDirectories.count(dirKey) > 0;
+        bool complete = true;
+
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.is_directory() && !entry.is_symlink()) {
+                directories.push_back(entry.path());
+                continue;
             }
+            if (done || !entry.is_regular_file()) continue;
+
+            // Files recorded by an interrupted attempt are checked against their
+            // backup too, in case they were replaced since
+            if (!backupFile(entry.path(), backupLocation(backup.backupPath, entry.path()))) {
+                complete = false;
+                continue;
+            }
+            std::string sourcePath = toUtf8(entry.path());
+            if (!backedUp.insert(sourcePath).second) continue;
+
+            uint64_t size = entry.file_size();
+            backup.files.push_back(sourcePath);
+            backup.totalSize += size;
+            if (currentRun) journal->recordBackedUp(sourcePath, size);
+        }
+
+        if (currentRun && !done && complete) {
+            journal->recordBackupDirectory(dirKey);
         }
     }
-    
-    RegCloseKey(hSubKey);
+}
+
+void Cleaner::addBackupToHistory(const BackupInfo& backup) {
+    auto it = std::find_if(backupHistory.begin(), backupHistory.end(),
+        [&backup](const BackupInfo& existing) { return existing.backupPath == backup.backupPath; });
+    if (it != backupHistory.end()) {
+        *it = backup;
+    } else {
+        backupHistory.push_back(backup);
+    }
+}
+
+bool Cleaner::backupFile(const std::filesystem::path& sourcePath, const std::filesystem::path& backupPath) {
+    std::error_code ec;
+    if (copyToBackup(sourcePath, backupPath, ec)) return true;
+    logError("backupFile", "Error backing up file " + toUtf8(sourcePath) + ": " + ec.message());
+    return false;
+}
+
+std::filesystem::path Cleaner::registrySnapshotPath(const std::string& backupPath, const std::wstring& subKey) const {
+    // One flat file per key, named after the key path
+    std::string name = wideToUtf8(subKey);
+    std::replace(name.begin(), name.end(), '\\', '_');
+    return std::filesystem::u8path(backupPath) / std::filesystem::u8path(name + ".regsnap");
+}
+
+bool Cleaner::backupRegistryKey(RegistryRoot root, const std::wstring& subKey, const std::string& backupPath) {
+    RegistrySnapshot snapshot;
+    if (!snapshot.capture(*registry, root, subKey)) {
+        Logger::getInstance().log(LogLevel::WARNING, "Registry key not backed up: " + snapshot.getError());
+        return false;
+    }
+
+    std::filesystem::path snapshotFile = registrySnapshotPath(backupPath, subKey);
+    if (!snapshot.save(snapshotFile)) {
+        logError("backupRegistryKey", "Failed to write " + toUtf8(snapshotFile));
+        return false;
+    }
     return true;
 }
 
@@ -789,14 +1533,14 @@ bool Cleaner::restoreFromBackup(const std::string& backupPath) {
     
     if (backup.operationType == "temp" || backup.operationType == "browser") {
         for (const auto& file : backup.files) {
-            std::string targetPath = file;
-            if (!restoreFile(backupPath + "\\" + std::filesystem::path(file).filename().string(), targetPath)) {
+            std::filesystem::path source = std::filesystem::u8path(file);
+            if (!restoreFile(backupLocation(backupPath, source), source)) {
                 success = false;
             }
         }
     } else if (backup.operationType == "registry") {
         for (const auto& key : backup.registryKeys) {
-            if (!restoreRegistryKey(backupPath, HKEY_CURRENT_USER, std::wstring(key.first.begin(), key.first.end()))) {
+            if (!restoreRegistryKey(backupPath, utf8ToWide(key.first))) {
                 success = false;
             }
         }
@@ -811,27 +1555,32 @@ bool Cleaner::restoreFromBackup(const std::string& backupPath) {
     return success;
 }
 
-bool Cleaner::restoreFile(const std::string& backupPath, const std::string& targetPath) {
+bool Cleaner::restoreFile(const std::filesystem::path& backupPath, const std::filesystem::path& targetPath) {
     try {
+        // Cleaning removes directories it emptied, so they are recreated
+        std::filesystem::create_directories(targetPath.parent_path());
         std::filesystem::copy_file(backupPath, targetPath, std::filesystem::copy_options::overwrite_existing);
         return true;
     } catch (const std::exception& e) {
-        std::string error = "Error restoring file " + targetPath + ": " + e.what();
+        std::string error = "Error restoring file " + toUtf8(targetPath) + ": " + e.what();
         logError("restoreFile", error);
         return false;
     }
 }
 
-bool Cleaner::restoreRegistryKey(const std::string& backupPath, HKEY hKey, const std::wstring& subKey) {
-    std::string backupFile = backupPath + "\\" + std::string(subKey.begin(), subKey.end()) + ".reg";
-    if (!std::filesystem::exists(backupFile)) {
+bool Cleaner::restoreRegistryKey(const std::string& backupPath, const std::wstring& subKey) {
+    if (!registry) {
+        logError("restoreRegistryKey", "Registry is not available on this platform");
         return false;
     }
-    
-    // Use reg.exe to import the backup file
-    std::string command = "reg import \"" + backupFile + "\"";
-    int result = system(command.c_str());
-    return result == 0;
+
+    // The snapshot records its own root and key path
+    RegistrySnapshot snapshot;
+    if (!snapshot.load(registrySnapshotPath(backupPath, subKey)) || !snapshot.restore(*registry)) {
+        logError("restoreRegistryKey", snapshot.getError());
+        return false;
+    }
+    return true;
 }
 
 std::vector<BackupInfo> Cleaner::getAvailableBackups() const {
@@ -867,15 +1616,7 @@ bool Cleaner::deleteBackup(const std::string& backupPath) {
 // Implementation of backup-specific cleaning functions
 bool Cleaner::cleanTempFilesWithBackup(bool dryRun) {
     Logger::getInstance().log(LogLevel::INFO, "Starting temporary files cleaning with backup" + std::string(dryRun ? " (dry run)" : ""));
-    
-    // Create backup first
-    if (!dryRun && !createBackup("temp")) {
-        Logger::getInstance().log(LogLevel::ERROR, "Failed to create backup before cleaning");
-        return false;
-    }
-    
-    // Perform cleaning
-    return cleanTempFiles(dryRun);
+    return cleanWithBackup("temp", dryRun, &Cleaner::cleanTempFiles);
 }
 
 bool Cleaner::cleanRegistryWithBackup(bool dryRun) {
@@ -893,15 +1634,11 @@ bool Cleaner::cleanRegistryWithBackup(bool dryRun) {
 
 bool Cleaner::cleanBrowserCacheWithBackup(bool dryRun) {
     Logger::getInstance().log(LogLevel::INFO, "Starting browser cache cleaning with backup" + std::string(dryRun ? " (dry run)" : ""));
-    
-    // Create backup first
-    if (!dryRun && !createBackup("browser")) {
-        Logger::getInstance().log(LogLevel::ERROR, "Failed to create backup before cleaning");
-        return false;
-    }
-    
-    // Perform cleaning
-    return cleanBrowserCache(dryRun);
+    return cleanWithBackup("browser", dryRun, &Cleaner::cleanBrowserCache);
+}
+
+void Cleaner::setBackupMode(BackupMode mode) {
+    backupMode = mode;
 }
 
 bool Cleaner::cleanRecycleBinWithBackup(bool dryRun) {
@@ -912,47 +1649,37 @@ bool Cleaner::cleanRecycleBinWithBackup(bool dryRun) {
     return cleanRecycleBin(dryRun);
 }
 
-bool Cleaner::deleteDirectory(const std::wstring& path, bool dryRun) {
+bool Cleaner::deleteDirectory(const std::filesystem::path& path, bool dryRun) {
+    Logger& logger = Logger::getInstance();
     try {
         if (dryRun) {
-            Logger::getInstance().log(LogLevel::INFO, "Dry run: would delete directory " + std::string(path.begin(), path.end()));
+            if (logger.isEnabled(LogLevel::INFO)) {
+                logger.log(LogLevel::INFO, "Dry run: would delete directory " + toUtf8(path));
+            }
             return true;
         }
         
-        if (std::filesystem::remove_all(path)) {
-            Logger::getInstance().log(LogLevel::INFO, "Deleted directory: " + std::string(path.begin(), path.end()));
+        // Only empty directories are removed; anything that appeared since the scan keeps it
+        std::error_code ec;
+        if (engine.getFileSystem().remove(path, ec)) {
+            if (logger.isEnabled(LogLevel::INFO)) {
+                logger.log(LogLevel::INFO, "Deleted directory: " + toUtf8(path));
+            }
             return true;
         }
+        if (ec) {
+            logger.log(LogLevel::WARNING, "Cannot remove directory " + toUtf8(path) + ": " + ec.message());
+        }
     } catch (const std::exception& e) {
-        std::string error = "Error deleting directory " + std::string(path.begin(), path.end()) + ": " + e.what();
-        logError("deleteDirectory", error);
+        logError("deleteDirectory", "Error deleting directory " + toUtf8(path) + ": " + e.what());
     }
     return false;
 }
 
-std::vector<std::wstring> Cleaner::getBrowserPaths() const {
-    std::vector<std::wstring> paths;
-    const std::wstring localAppData = getLocalAppData();
-    
-    if (!localAppData.empty()) {
-        // Chrome
-        paths.push_back(localAppData + L"\\Google\\Chrome\\User Data\\Default\\Cache");
-        
-        // Edge
-        paths.push_back(localAppData + L"\\Microsoft\\Edge\\User Data\\Default\\Cache");
-        
-        // Firefox
-        paths.push_back(localAppData + L"\\Mozilla\\Firefox\\Profiles");
-        
-        // Opera
-        paths.push_back(localAppData + L"\\Opera Software\\Opera Stable\\Cache");
-        
-        // Brave
-        paths.push_back(localAppData + L"\\BraveSoftware\\Brave-Browser\\User Data\\Default\\Cache");
-        
-        // Vivaldi
-        paths.push_back(localAppData + L"\\Vivaldi\\User Data\\Default\\Cache");
+std::vector<std::filesystem::path> Cleaner::getBrowserPaths() const {
+    std::vector<std::filesystem::path> paths;
+    for (const auto& profile : discoverBrowserProfiles()) {
+        paths.insert(paths.end(), profile.cacheDirs.begin(), profile.cacheDirs.end());
     }
-    
     return paths;
-} 
\ No newline at end of file
+}
@@ -0,0 +1,862 @@
+#include "CleaningEngine.h"
+#include "IoExecutor.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "OpenFileIndex.h"
+#include "PathArena.h"
+#include "SpaceAccounting.h"
+#include "ThreadAutotuner.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+    constexpr size_t kDefaultBatchSize = 64;
+    constexpr size_t kMaxNetworkThreads = 32;
+    constexpr size_t kDefaultMaxThreads = 64;
+    constexpr auto kTuneInterval = std::chrono::milliseconds(250);
+    constexpr size_t kDefaultOpenFileRetries = 3;
+    // Deep enough for real trees, shallow enough to stop a runaway walk
+    constexpr size_t kDefaultMaxDepth = 128;
+    constexpr auto kDefaultOpenFileDelay = std::chrono::milliseconds(250);
+    constexpr size_t kAsyncQueueDepth = 1024;
+    constexpr size_t kAsyncThreads = 4;
+    // Handler operations started before the producer waits for some to finish
+    constexpr size_t kAsyncInFlight = 4096;
+
+    size_t hardwareThreads() {
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    // Counters of one root set, updated from worker threads
+    struct SetTally {
+        std::atomic<int> filesDeleted{0};
+        std::atomic<int> directoriesRemoved{0};
+        std::atomic<int> errors{0};
+    };
+
+    template <typename Iterator, typename Callback>
+    void walk(Iterator it, std::error_code& ec, Callback callback) {
+        for (Iterator end; !ec && it != end; it.increment(ec)) {
+            callback(*it);
+        }
+    }
+}
+
+// Per-device state of a run: the pool, its progress counters and controller
+struct CleaningEngine::DeviceRun {
+    uint64_t device = 0;
+    std::unique_ptr<WorkerPool> pool;
+    std::unique_ptr<ThreadAutotuner> tuner;
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> latencyNs{0};
+    uint64_t lastCompleted = 0;
+    uint64_t lastLatencyNs = 0;
+};
+
+// Directories seen by a recursive scan with the number of children still
+// present. Index 0 is reserved for "not tracked"; roots have parent 0.
+// The scan hands every entry its parent's index, so nodes are never looked
+// up by path. Paths and nodes live in the scan's arena.
+struct CleaningEngine::DirectoryTable {
+    struct Node {
+        PathView path;
+        size_t parent = 0;
+        std::atomic<int64_t> pending{0};
+    };
+
+    PathArena arena;
+    std::pmr::deque<Node> nodes;
+
+    DirectoryTable() : nodes(1, arena.resource()) {}
+
+    size_t add(PathView path, size_t parent) {
+        nodes.emplace_back();
+        nodes.back().path = arena.store(path);
+        nodes.back().parent = parent;
+        return nodes.size() - 1;
+    }
+
+    // Drop one child; walk up while directories empty out and get removed
+    int release(size_t index, const DirectoryHandler& handler) {
+        int removed = 0;
+        while (index != 0) {
+            Node& node = nodes[index];
+            if (--node.pending != 0 || node.parent == 0) break;
+            bool ok = false;
+            try {
+                ok = handler(std::filesystem::path(node.path));
+            } catch (const std::exception&) {
+                ok = false;
+            }
+            if (!ok) break;
+            removed++;
+            index = node.parent;
+        }
+        return removed;
+    }
+};
+
+CleaningEngine::CleaningEngine()
+    : batchSize(kDefaultBatchSize), maxThreads(kDefaultMaxThreads), autotune(false),
+      openFileCheck(true), openFileRetries(kDefaultOpenFileRetries), openFileDelay(kDefaultOpenFileDelay),
+      followSymlinks(false), maxDepth(kDefaultMaxDepth), sameFileSystem(false) {}
+
+void CleaningEngine::setConcurrency(StorageType type, size_t threads) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (threads == 0) {
+        concurrency.erase(type);
+    } else {
+        concurrency[type] = threads;
+    }
+}
+
+size_t CleaningEngine::getConcurrency(StorageType type) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return threadsFor(type);
+}
+
+bool CleaningEngine::setStorageType(const std::filesystem::path& path, StorageType type) {
+    uint64_t device = 0;
+    if (!getFileSystem().deviceId(path, device)) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    storageTypes[device] = type;
+    return true;
+}
+
+void CleaningEngine::setBatchSize(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    batchSize = std::max<size_t>(size, 1);
+}
+
+size_t CleaningEngine::getBatchSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return batchSize;
+}
+
+void CleaningEngine::setMaxThreads(size_t threads) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxThreads = (threads == 0) ? kDefaultMaxThreads : threads;
+}
+
+size_t CleaningEngine::getMaxThreads() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxThreads;
+}
+
+void CleaningEngine::setAutotune(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    autotune = enable;
+}
+
+bool CleaningEngine::isAutotuneEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return autotune;
+}
+
+void CleaningEngine::setOpenFileCheck(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    openFileCheck = enable;
+}
+
+void CleaningEngine::setFollowSymlinks(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    followSymlinks = enable;
+}
+
+bool CleaningEngine::isFollowingSymlinks() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return followSymlinks;
+}
+
+void CleaningEngine::setMaxDepth(size_t depth) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxDepth = (depth == 0) ? kDefaultMaxDepth : depth;
+}
+
+size_t CleaningEngine::getMaxDepth() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxDepth;
+}
+
+void CleaningEngine::setSameFileSystem(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sameFileSystem = enable;
+}
+
+bool CleaningEngine::isSameFileSystem() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sameFileSystem;
+}
+
+void CleaningEngine::setFileSystem(std::shared_ptr<FileSystemBackend> backend) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fileSystem = std::move(backend);
+}
+
+FileSystemBackend& CleaningEngine::getFileSystem() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fileSystem) return *fileSystem;
+    return NativeFileSystem::instance();
+}
+
+bool CleaningEngine::isOpenFileCheckEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return openFileCheck;
+}
+
+void CleaningEngine::setOpenFileRetries(size_t retries, std::chrono::milliseconds delay) {
+    std::lock_guard<std::mutex> lock(mutex);
+    openFileRetries = retries;
+    openFileDelay = delay;
+}
+
+size_t CleaningEngine::getOpenFileRetries() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return openFileRetries;
+}
+
+size_t CleaningEngine::threadsFor(StorageType type) const {
+    auto it = concurrency.find(type);
+    if (it != concurrency.end()) return std::min(it->second, maxThreads);
+
+    size_t threads = std::max<size_t>(hardwareThreads() / 2, 1);
+    switch (type) {
+        case StorageType::Rotational:
+            // Parallel deletes on a spinning disk only add seeks
+            threads = 1;
+            break;
+        case StorageType::SolidState:
+            threads = std::max<size_t>(hardwareThreads(), 2);
+            break;
+        case StorageType::Network:
+            // Latency-bound: keep many requests in flight
+            threads = std::min(hardwareThreads() * 4, kMaxNetworkThreads);
+            break;
+        case StorageType::Unknown:
+            break;
+    }
+    return std::min(threads, maxThreads);
+}
+
+void CleaningEngine::tune(DeviceRun& run, double seconds) {
+    uint64_t completed = run.completed.load();
+    uint64_t latencyNs = run.latencyNs.load();
+    uint64_t deltaCompleted = completed - run.lastCompleted;
+    uint64_t deltaLatency = latencyNs - run.lastLatencyNs;
+    run.lastCompleted = completed;
+    run.lastLatencyNs = latencyNs;
+
+    // Nothing finished in this interval: no signal to act on
+    if (deltaCompleted == 0 || seconds <= 0.0) return;
+
+    double throughput = static_cast<double>(deltaCompleted) / seconds;
+    double latency = static_cast<double>(deltaLatency) / static_cast<double>(deltaCompleted) / 1e9;
+    TuningDecision decision = run.tuner->update(throughput, latency);
+    if (decision.threads == decision.previousThreads) return;
+
+    run.pool->setActiveLimit(decision.threads);
+    std::ostringstream ss;
+    ss << "Autotune device " << run.device << ": " << decision.previousThreads << " -> "
+       << decision.threads << " threads (" << static_cast<uint64_t>(decision.throughput)
+       << " files/s, " << decision.latency * 1000.0 << " ms latency, " << decision.reason << ")";
+    Logger::getInstance().log(LogLevel::INFO, ss.str());
+}
+
+StorageType CleaningEngine::resolveStorageType(uint64_t device, const std::filesystem::path& sample) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = storageTypes.find(device);
+        if (it != storageTypes.end()) return it->second;
+    }
+
+    StorageType type = getFileSystem().storageType(sample);
+    std::lock_guard<std::mutex> lock(mutex);
+    storageTypes.emplace(device, type);
+    return type;
+}
+
+void CleaningEngine::scanRoot(const std::filesystem::path& root, bool recursive, uint32_t rootSet,
+                              std::map<uint64_t, DeviceGroup>& groups, DirectoryTable* directories,
+                              EngineResult& result) {
+    FileSystemBackend& files = getFileSystem();
+    Metrics& metrics = Metrics::getInstance();
+    std::error_code ec;
+    if (files.status(root, ec) == FileType::None) return;
+
+    uint64_t rootDevice = 0;
+    files.deviceId(root, rootDevice);
+    size_t rootNode = 0;
+    if (directories) {
+        // Children report "dir" as their parent even when the root is "dir/"
+        rootNode = directories->add((root.has_filename() ? root : root.parent_path()).native(), 0);
+    }
+    VisitedSet visited;
+    FileId rootId;
+    if (recursive && isFollowingSymlinks() && files.identify(root, rootId, ec)) visited.insert(rootId);
+    ec.clear();
+    const bool sharedRoot = recursive && isSharedRoot(root);
+
+    // Depth-first with an explicit stack; each directory is listed in one call
+    struct Pending {
+        std::filesystem::path directory;
+        size_t node;
+        size_t depth;
+    };
+    std::vector<Pending> pending{{root, rootNode, 0}};
+    std::vector<DirectoryItem> items;
+    while (!pending.empty()) {
+        auto [directory, node, depth] = std::move(pending.back());
+        pending.pop_back();
+        items.clear();
+        uint64_t started = metrics.start();
+        files.listDirectory(directory, items, ec);
+        metrics.finish(MetricOperation::ReadDirectory, started);
+        if (ec) {
+            result.errors++;
+            result.errorMessages.push_back("Error processing directory " + toUtf8(directory) + ": " + ec.message());
+            ec.clear();
+            continue;
+        }
+
+        for (auto& item : items) {
+            // Every child counts, including ones that will never be deleted
+            if (node != 0) directories->nodes[node].pending++;
+            FileType target = item.type;
+            if (item.type == FileType::Symlink) {
+                std::error_code targetEc;
+                target = files.status(item.path, targetEc);
+            }
+            if (target == FileType::Directory) {
+                if (!recursive) continue;
+                Descent descent = descend(item, target, depth + 1, rootDevice, sharedRoot, visited, result);
+                if (descent == Descent::Skip) continue;
+                // Below an untracked directory nothing is tracked either
+                size_t child = descent == Descent::Enter && node != 0 ? directories->add(item.path.native(), node) : 0;
+                pending.push_back({std::move(item.path), child, depth + 1});
+                continue;
+            }
+            // A symlink to a file is removed itself, its target is never touched
+            if (target != FileType::Regular) continue;
+
+            FileEntry file;
+            file.device = rootDevice;
+            file.directory = node;
+            file.rootSet = rootSet;
+            std::error_code statEc;
+            started = metrics.start();
+            bool found = files.stat(item.path, file, statEc);
+            metrics.finish(MetricOperation::Stat, started);
+            if (!found) continue;
+            addToGroup(groups, std::move(file), &root);
+        }
+    }
+}
+
+CleaningEngine::Descent CleaningEngine::descend(const DirectoryItem& item, FileType target, size_t depth,
+                                                uint64_t rootDevice, bool sharedRoot, VisitedSet& visited,
+                                                EngineResult& result) {
+    bool linked = item.type == FileType::Symlink;
+    bool follow = isFollowingSymlinks();
+    if (linked && (!follow || target != FileType::Directory)) return Descent::Skip;
+
+    const char* reason = nullptr;
+    if (depth > getMaxDepth()) {
+        reason = "depth limit";
+    } else if (follow || isSameFileSystem()) {
+        // Only pay for the identity when something depends on it
+        FileId id;
+        std::error_code ec;
+        if (!getFileSystem().identify(item.path, id, ec)) {
+            reason = "cannot identify";
+        } else if (isSameFileSystem() && id.device != rootDevice) {
+            reason = "other file system";
+        } else if (linked && !isTrustedLink(item.path, sharedRoot)) {
+            // Checked before the target is marked, so a trusted path can still reach it
+            reason = "link owner";
+        } else if (follow && !visited.insert(id).second) {
+            reason = "already scanned";
+        }
+    }
+    if (!reason) return linked ? Descent::Follow : Descent::Enter;
+
+    result.directoriesSkipped++;
+    Logger& logger = Logger::getInstance();
+    if (logger.isEnabled(LogLevel::DEBUG)) {
+        logger.log(LogLevel::DEBUG, std::string("Not entering (") + reason + "): " + toUtf8(item.path));
+    }
+    return Descent::Skip;
+}
+
+bool CleaningEngine::isSharedRoot(const std::filesystem::path& root) const {
+    if (!isFollowingSymlinks()) return false;
+    FileOwner owner;
+    std::error_code ec;
+    return getFileSystem().owner(root, true, owner, ec) && owner.worldWritable;
+}
+
+bool CleaningEngine::isTrustedLink(const std::filesystem::path& link, bool sharedRoot) const {
+    FileSystemBackend& files = getFileSystem();
+    std::error_code ec;
+    if (!sharedRoot) {
+        // Outside a shared root only a world-writable directory lets others plant links
+        FileOwner directory;
+        if (!files.owner(link.parent_path(), true, directory, ec)) return false;
+        if (!directory.worldWritable) return true;
+    }
+    FileOwner linkOwner;
+    FileOwner targetOwner;
+    if (!files.owner(link, false, linkOwner, ec) || !files.owner(link, true, targetOwner, ec)) return false;
+    return linkOwner.user == 0 || linkOwner.user == targetOwner.user;
+}
+
+void CleaningEngine::addToGroup(std::map<uint64_t, DeviceGroup>& groups, FileEntry&& entry,
+                                const std::filesystem::path* sample) {
+    auto group = groups.find(entry.device);
+    if (group == groups.end()) {
+        // Only the first entry of a device pays for a sample path
+        group = groups.emplace(entry.device, DeviceGroup()).first;
+        group->second.type = resolveStorageType(entry.device, sample ? *sample : entry.path.parent_path());
+    }
+    group->second.entries.push_back(std::move(entry));
+}
+
+// One root of an asynchronous scan; every callback runs on the driving thread,
+// so the groups, the directory table and the visited set need no locking
+struct CleaningEngine::AsyncScan {
+    std::filesystem::path root;
+    uint64_t rootDevice = 0;
+    uint32_t rootSet = 0;
+    bool recursive = false;
+    bool sharedRoot = false;        ///< See isSharedRoot()
+    VisitedSet visited;
+    std::map<uint64_t, DeviceGroup>* groups = nullptr;
+    DirectoryTable* directories = nullptr;
+    EngineResult* result = nullptr;
+};
+
+void CleaningEngine::listAsync(IoExecutor& io, const std::shared_ptr<AsyncScan>& scan,
+                               const std::filesystem::path& directory, size_t node, size_t depth) {
+    // Latencies include the time queued behind other operations
+    uint64_t listed = Metrics::getInstance().start();
+    io.readDirectory(directory, [this, &io, scan, directory, node, depth, listed](std::error_code ec,
+                                                                                  std::vector<DirectoryItem>&& items) {
+        Metrics::getInstance().finish(MetricOperation::ReadDirectory, listed);
+        if (ec) {
+            scan->result->errors++;
+            scan->result->errorMessages.push_back(
+                "Error processing directory " + toUtf8(directory) + ": " + ec.message());
+            return;
+        }
+
+        DirectoryTable* directories = scan->directories;
+        for (const auto& item : items) {
+            // Every child counts, including ones that will never be deleted
+            if (node != 0) directories->nodes[node].pending++;
+
+            // Symlinks are rare enough to resolve inline, see scanRoot()
+            FileType target = item.type;
+            if (item.type == FileType::Symlink) {
+                std::error_code targetEc;
+                target = getFileSystem().status(item.path, targetEc);
+            }
+            if (target == FileType::Directory) {
+                if (!scan->recursive) continue;
+                Descent descent = descend(item, target, depth + 1, scan->rootDevice, scan->sharedRoot, scan->visited,
+                                          *scan->result);
+                if (descent == Descent::Skip) continue;
+                size_t child = descent == Descent::Enter && node != 0 ? directories->add(item.path.native(), node) : 0;
+                listAsync(io, scan, item.path, child, depth + 1);
+                continue;
+            }
+            if (target != FileType::Regular) continue;
+
+            uint64_t started = Metrics::getInstance().start();
+            io.stat(item.path, [this, scan, node, started](std::error_code statEc, FileEntry&& file) {
+                Metrics::getInstance().finish(MetricOperation::Stat, started);
+                if (statEc) return;
+                if (file.device == 0) file.device = scan->rootDevice;
+                file.directory = node;
+                file.rootSet = scan->rootSet;
+                addToGroup(*scan->groups, std::move(file), &scan->root);
+            });
+        }
+    });
+}
+
+EngineResult CleaningEngine::run(const std::vector<std::filesystem::path>& roots, bool recursive,
+                                 const EntryHandler& handler, const DirectoryHandler& directoryHandler) {
+    return runSets({roots}, recursive, handler, directoryHandler).front();
+}
+
+std::vector<EngineResult> CleaningEngine::runSets(const std::vector<std::vector<std::filesystem::path>>& rootSets,
+                                                  bool recursive, const EntryHandler& handler,
+                                                  const DirectoryHandler& directoryHandler) {
+    std::vector<EngineResult> results(std::max<size_t>(rootSets.size(), 1));
+    std::map<uint64_t, DeviceGroup> groups;
+    std::unique_ptr<DirectoryTable> directories;
+    if (recursive && directoryHandler) directories = std::make_unique<DirectoryTable>();
+    for (size_t set = 0; set < rootSets.size(); ++set) {
+        TraceScope span("scan", "engine");
+        span.setArgument("set", set);
+        for (const auto& root : rootSets[set]) {
+            scanRoot(root, recursive, static_cast<uint32_t>(set), groups, directories.get(), results[set]);
+        }
+    }
+    process(groups, [&](std::map<uint64_t, DeviceGroup>& round, const OpenFileIndex* openFiles,
+                        SpaceAccounting& accounting, std::vector<FileEntry>& deferred) {
+        dispatch(round, handler, directories.get(), directoryHandler, openFiles, accounting, deferred, results);
+    }, results);
+    return results;
+}
+
+std::vector<EngineResult> CleaningEngine::runSetsAsync(const std::vector<std::vector<std::filesystem::path>>& rootSets,
+                                                       bool recursive, const AsyncEntryHandler& handler,
+                                                       const DirectoryHandler& directoryHandler) {
+    std::vector<EngineResult> results(std::max<size_t>(rootSets.size(), 1));
+    std::map<uint64_t, DeviceGroup> groups;
+    std::unique_ptr<DirectoryTable> directories;
+    if (recursive && directoryHandler) directories = std::make_unique<DirectoryTable>();
+
+    IoExecutor io(kAsyncQueueDepth, kAsyncThreads, fileSystem.get());
+    Logger::getInstance().log(LogLevel::DEBUG,
+        std::string("Asynchronous I/O through ") + (io.isNative() ? "io_uring" : "blocking threads"));
+
+    // Every root is listed at once; the scan is over when no operation is left
+    {
+        TraceScope span("scan", "engine");
+        for (size_t set = 0; set < rootSets.size(); ++set) {
+            for (const auto& root : rootSets[set]) {
+                std::error_code ec;
+                if (getFileSystem().status(root, ec) == FileType::None) continue;
+
+                auto scan = std::make_shared<AsyncScan>();
+                scan->root = root;
+                getFileSystem().deviceId(root, scan->rootDevice);
+                scan->rootSet = static_cast<uint32_t>(set);
+                scan->recursive = recursive;
+                scan->sharedRoot = recursive && isSharedRoot(root);
+                FileId rootId;
+                if (recursive && isFollowingSymlinks() && getFileSystem().identify(root, rootId, ec)) {
+                    scan->visited.insert(rootId);
+                }
+                scan->groups = &groups;
+                scan->directories = directories.get();
+                scan->result = &results[set];
+                size_t node = 0;
+                if (directories) {
+                    // Children report "dir" as their parent even when the root is "dir/"
+                    node = directories->add((root.has_filename() ? root : root.parent_path()).native(), 0);
+                }
+                listAsync(io, scan, root, node, 0);
+            }
+        }
+        io.wait();
+    }
+
+    process(groups, [&](std::map<uint64_t, DeviceGroup>& round, const OpenFileIndex* openFiles,
+                        SpaceAccounting& accounting, std::vector<FileEntry>& deferred) {
+        dispatchAsync(io, round, handler, directories.get(), directoryHandler, openFiles, accounting, deferred,
+                      results);
+    }, results);
+    return results;
+}
+
+EngineResult CleaningEngine::runEntries(std::vector<FileEntry> entries, const EntryHandler& handler) {
+    std::vector<EngineResult> results(1);
+    std::map<uint64_t, DeviceGroup> groups;
+    for (auto& entry : entries) {
+        entry.directory = 0;
+        entry.rootSet = 0;
+        addToGroup(groups, std::move(entry), nullptr);
+    }
+    process(groups, [&](std::map<uint64_t, DeviceGroup>& round, const OpenFileIndex* openFiles,
+                        SpaceAccounting& accounting, std::vector<FileEntry>& deferred) {
+        dispatch(round, handler, nullptr, nullptr, openFiles, accounting, deferred, results);
+    }, results);
+    return results.front();
+}
+
+void CleaningEngine::process(std::map<uint64_t, DeviceGroup>& groups, const Dispatcher& dispatcher,
+                             std::vector<EngineResult>& results) {
+    if (groups.empty()) return;
+
+    std::unique_ptr<OpenFileIndex> openFiles;
+    size_t retries = 0;
+    std::chrono::milliseconds delay;
+    if (isOpenFileCheckEnabled()) {
+        openFiles = std::make_unique<OpenFileIndex>();
+        TraceScope span("openFiles", "engine");
+        openFiles->build();
+        std::lock_guard<std::mutex> lock(mutex);
+        retries = openFileRetries;
+        delay = openFileDelay;
+    }
+
+    // Links of one file may sit in several root sets and retry rounds
+    SpaceAccounting accounting(results.size());
+    std::vector<FileEntry> deferred;
+    dispatcher(groups, openFiles.get(), accounting, deferred);
+
+    for (size_t attempt = 0; attempt < retries && !deferred.empty(); ++attempt) {
+        Logger::getInstance().log(LogLevel::DEBUG,
+            "Retrying " + std::to_string(deferred.size()) + " open files in " + std::to_string(delay.count()) + " ms");
+        std::this_thread::sleep_for(delay);
+        delay *= 2;
+        TraceScope span("retry", "engine");
+        span.setArgument("files", deferred.size());
+        openFiles->build();
+
+        std::map<uint64_t, DeviceGroup> retryGroups;
+        for (auto& entry : deferred) {
+            addToGroup(retryGroups, std::move(entry), nullptr);
+        }
+        deferred.clear();
+        dispatcher(retryGroups, openFiles.get(), accounting, deferred);
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        results[i].bytesFreed += accounting.getLogicalBytes(i);
+        results[i].physicalBytesFreed += accounting.getPhysicalBytes(i);
+    }
+
+    Logger& logger = Logger::getInstance();
+    for (const auto& entry : deferred) {
+        if (logger.isEnabled(LogLevel::WARNING)) {
+            logger.log(LogLevel::WARNING, "Skipping file in use: " + toUtf8(entry.path));
+        }
+        results[entry.rootSet].filesInUse++;
+    }
+}
+
+void CleaningEngine::dispatch(std::map<uint64_t, DeviceGroup>& groups, const EntryHandler& handler,
+                              DirectoryTable* directories, const DirectoryHandler& directoryHandler,
+                              const OpenFileIndex* openFiles, SpaceAccounting& accounting,
+                              std::vector<FileEntry>& deferred,
+                              std::vector<EngineResult>& results) {
+    std::vector<std::unique_ptr<SetTally>> tallies;
+    for (size_t i = 0; i < results.size(); ++i) {
+        tallies.push_back(std::make_unique<SetTally>());
+    }
+    std::mutex messagesMutex;
+    std::mutex deferredMutex;
+    const size_t batch = getBatchSize();
+    const bool tuning = isAutotuneEnabled();
+    const size_t threadLimit = getMaxThreads();
+
+    auto processRange = [&](DeviceRun& run, const std::vector<FileEntry>& entries, size_t begin, size_t end) {
+        TraceScope span("batch", "engine");
+        span.setArgument("files", end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            const FileEntry& entry = entries[i];
+            auto defer = [&] {
+                std::lock_guard<std::mutex> lock(deferredMutex);
+                deferred.push_back(entry);
+            };
+            if (openFiles && openFiles->contains(entry)) {
+                // Unlinking now would free nothing while the file stays open
+                defer();
+                continue;
+            }
+
+            SetTally& tally = *tallies[entry.rootSet];
+            auto start = std::chrono::steady_clock::now();
+            try {
+                if (handler(entry)) {
+                    tally.filesDeleted++;
+                    accounting.record(entry, entry.rootSet);
+                    if (directories && entry.directory != 0) {
+                        tally.directoriesRemoved += directories->release(entry.directory, directoryHandler);
+                    }
+                }
+            } catch (const std::filesystem::filesystem_error& e) {
+                if (openFiles && isFileInUseError(e.code())) {
+                    defer();
+                } else {
+                    tally.errors++;
+                    std::lock_guard<std::mutex> lock(messagesMutex);
+                    results[entry.rootSet].errorMessages.push_back(
+                        "Error processing " + toUtf8(entry.path) + ": " + e.what());
+                }
+            } catch (const std::exception& e) {
+                tally.errors++;
+                std::lock_guard<std::mutex> lock(messagesMutex);
+                results[entry.rootSet].errorMessages.push_back(
+                    "Error processing " + toUtf8(entry.path) + ": " + e.what());
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start);
+            run.latencyNs += static_cast<uint64_t>(elapsed.count());
+            run.completed++;
+        }
+    };
+
+    // All device pools run side by side; each one drains its own queue
+    std::vector<std::unique_ptr<DeviceRun>> runs;
+    for (auto& [device, group] : groups) {
+        if (group.type == StorageType::Rotational) {
+            std::sort(group.entries.begin(), group.entries.end(),
+                [](const FileEntry& a, const FileEntry& b) { return a.inode < b.inode; });
+        }
+
+        auto run = std::make_unique<DeviceRun>();
+        run->device = device;
+        size_t threads = getConcurrency(group.type);
+        if (tuning) {
+            // Start every thread up to the limit but only activate the default
+            run->tuner = std::make_unique<ThreadAutotuner>(threads, 1, threadLimit);
+            run->pool = std::make_unique<WorkerPool>(threadLimit, threads);
+        } else {
+            run->pool = std::make_unique<WorkerPool>(threads);
+        }
+        Logger::getInstance().log(LogLevel::DEBUG,
+            "Device " + std::to_string(device) + " (" + storageTypeName(group.type) + "): " +
+            std::to_string(group.entries.size()) + " files, " + std::to_string(threads) + " threads");
+
+        DeviceRun* runPtr = run.get();
+        const auto& entries = group.entries;
+        for (size_t begin = 0; begin < entries.size(); begin += batch) {
+            size_t end = std::min(begin + batch, entries.size());
+            run->pool->submit([&processRange, runPtr, &entries, begin, end] {
+                processRange(*runPtr, entries, begin, end);
+            });
+        }
+        runs.push_back(std::move(run));
+    }
+
+    if (tuning) {
+        auto lastTick = std::chrono::steady_clock::now();
+        for (;;) {
+            auto busy = std::find_if(runs.begin(), runs.end(),
+                [](const std::unique_ptr<DeviceRun>& run) { return !run->pool->waitFor(std::chrono::seconds(0)); });
+            if (busy == runs.end()) break;
+
+            auto now = std::chrono::steady_clock::now();
+            if ((*busy)->pool->waitFor(lastTick + kTuneInterval - now)) continue;
+
+            now = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(now - lastTick).count();
+            lastTick = now;
+            for (auto& run : runs) {
+                tune(*run, seconds);
+            }
+        }
+    }
+    for (auto& run : runs) {
+        run->pool->wait();
+    }
+    runs.clear();
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        results[i].filesDeleted += tallies[i]->filesDeleted;
+        results[i].directoriesRemoved += tallies[i]->directoriesRemoved;
+        results[i].errors += tallies[i]->errors;
+    }
+}
+
+void CleaningEngine::dispatchAsync(IoExecutor& io, std::map<uint64_t, DeviceGroup>& groups,
+                                   const AsyncEntryHandler& handler, DirectoryTable* directories,
+                                   const DirectoryHandler& directoryHandler, const OpenFileIndex* openFiles,
+                                   SpaceAccounting& accounting, std::vector<FileEntry>& deferred,
+                                   std::vector<EngineResult>& results) {
+    // Completions run on this thread, so nothing here needs a lock
+    std::vector<SetTally> tallies(results.size());
+
+    auto finish = [&](const FileEntry& entry, bool handled, std::exception_ptr error) {
+        SetTally& tally = tallies[entry.rootSet];
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::filesystem::filesystem_error& e) {
+                if (openFiles && isFileInUseError(e.code())) {
+                    deferred.push_back(entry);
+                } else {
+                    tally.errors++;
+                    results[entry.rootSet].errorMessages.push_back(
+                        "Error processing " + toUtf8(entry.path) + ": " + e.what());
+                }
+            } catch (const std::exception& e) {
+                tally.errors++;
+                results[entry.rootSet].errorMessages.push_back(
+                    "Error processing " + toUtf8(entry.path) + ": " + e.what());
+            }
+            return;
+        }
+        if (!handled) return;
+        tally.filesDeleted++;
+        accounting.record(entry, entry.rootSet);
+        if (directories && entry.directory != 0) {
+            tally.directoriesRemoved += directories->release(entry.directory, directoryHandler);
+        }
+    };
+
+    for (auto& [device, group] : groups) {
+        Logger::getInstance().log(LogLevel::DEBUG,
+            "Device " + std::to_string(device) + ": " + std::to_string(group.entries.size()) + " files");
+        TraceScope span("device", "engine");
+        span.setArgument("files", group.entries.size());
+        // The entries outlive every completion, which all run before io.wait() returns
+        for (const FileEntry& entry : group.entries) {
+            if (openFiles && openFiles->contains(entry)) {
+                deferred.push_back(entry);
+                continue;
+            }
+            try {
+                handler(entry, io, [&finish, &entry](bool handled, std::exception_ptr error) {
+                    finish(entry, handled, error);
+                });
+            } catch (...) {
+                finish(entry, false, std::current_exception());
+            }
+            io.drain(kAsyncInFlight);
+        }
+    }
+    io.wait();
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        results[i].filesDeleted += tallies[i].filesDeleted;
+        results[i].directoriesRemoved += tallies[i].directoriesRemoved;
+        results[i].errors += tallies[i].errors;
+    }
+}
+
+bool statFileEntry(const std::filesystem::path& path, FileEntry& entry) {
+    entry.path = path;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) return false;
+    entry.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    DWORD allocatedHigh = 0;
+    DWORD allocatedLow = GetCompressedFileSizeW(path.c_str(), &allocatedHigh);
+    if (allocatedLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        entry.allocated = entry.size;
+    } else {
+        entry.allocated = (static_cast<uint64_t>(allocatedHigh) << 32) | allocatedLow;
+    }
+    entry.mtime = static_cast<int64_t>((static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                       data.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) return false;
+    entry.size = static_cast<uint64_t>(st.st_size);
+    // st_blocks is always in 512-byte units
+    entry.allocated = static_cast<uint64_t>(st.st_blocks) * 512;
+    entry.links = static_cast<uint32_t>(st.st_nlink);
+    entry.device = static_cast<uint64_t>(st.st_dev);
+    entry.inode = static_cast<uint64_t>(st.st_ino);
+    entry.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
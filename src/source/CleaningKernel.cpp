@@ -0,0 +1,41 @@
+#include "CleaningKernel.h"
+
+namespace {
+    // Handler is the synchronous or asynchronous engine callback; every
+    // kernel provides both call forms
+    template <typename Handler, typename Run, typename Stats>
+    Handler withBackup(const KernelContext& context, BackupMode mode) {
+        switch (mode) {
+            case BackupMode::Copy:
+                return CleaningKernel<Run, CopyBackupPolicy, Stats>(context);
+            case BackupMode::Quarantine:
+                return CleaningKernel<Run, QuarantinePolicy, Stats>(context);
+            case BackupMode::None:
+                break;
+        }
+        return CleaningKernel<Run, NoBackupPolicy, Stats>(context);
+    }
+
+    template <typename Handler, typename Stats>
+    Handler withRun(const KernelContext& context, bool dryRun, BackupMode mode) {
+        if (dryRun) return CleaningKernel<DryRunPolicy, NoBackupPolicy, Stats>(context);
+        return withBackup<Handler, DeletePolicy, Stats>(context, mode);
+    }
+
+    template <typename Handler>
+    Handler makeKernel(const KernelContext& context, bool dryRun, BackupMode mode, bool perFile) {
+        if (!context.backup) mode = BackupMode::None;
+        return perFile ? withRun<Handler, PerFileStatsPolicy>(context, dryRun, mode)
+                       : withRun<Handler, SummaryStatsPolicy>(context, dryRun, mode);
+    }
+}
+
+CleaningEngine::EntryHandler makeCleaningKernel(const KernelContext& context, bool dryRun,
+                                                BackupMode mode, bool perFile) {
+    return makeKernel<CleaningEngine::EntryHandler>(context, dryRun, mode, perFile);
+}
+
+CleaningEngine::AsyncEntryHandler makeAsyncCleaningKernel(const KernelContext& context, bool dryRun,
+                                                          BackupMode mode, bool perFile) {
+    return makeKernel<CleaningEngine::AsyncEntryHandler>(context, dryRun, mode, perFile);
+}
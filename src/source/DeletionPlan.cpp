@@ -0,0 +1,274 @@
+#include "DeletionPlan.h"
+#include "BinaryIO.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char kMagic[8] = {'C', 'M', 'P', 'L', 'A', 'N', '\0', '\2'};
+    constexpr uint8_t kRecordSection = 1;
+    constexpr uint8_t kRecordEntry = 2;
+    constexpr uint8_t kRecordEnd = 0xFF;
+
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // Plans store paths as UTF-8 on Windows and as native bytes elsewhere
+    std::string toPlanBytes(const std::filesystem::path& path) {
+#ifdef _WIN32
+        auto utf8 = path.u8string();
+        return std::string(utf8.begin(), utf8.end());
+#else
+        return path.string();
+#endif
+    }
+
+    std::filesystem::path fromPlanBytes(const std::string& bytes) {
+#ifdef _WIN32
+#if defined(__cpp_char8_t)
+        return std::filesystem::path(std::u8string(bytes.begin(), bytes.end()));
+#else
+        return std::filesystem::u8path(bytes);
+#endif
+#else
+        return std::filesystem::path(bytes);
+#endif
+    }
+}
+
+PlanWriter::~PlanWriter() {
+    if (isOpen()) close();
+}
+
+bool PlanWriter::open(const std::filesystem::path& file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stream.open(file, std::ios::binary | std::ios::trunc);
+    if (!stream.is_open()) return false;
+    stream.write(kMagic, sizeof(kMagic));
+    previousPath.clear();
+    entryCount = 0;
+    totalBytes = 0;
+    return stream.good();
+}
+
+bool PlanWriter::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stream.is_open();
+}
+
+uint64_t PlanWriter::getEntryCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entryCount;
+}
+
+void PlanWriter::writeVarint(uint64_t value) {
+    std::string buffer;
+    appendVarint(buffer, value);
+    stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+void PlanWriter::writeBytes(const std::string& bytes) {
+    writeVarint(bytes.size());
+    stream.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void PlanWriter::beginSection(PlanSection kind, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!stream.is_open()) return;
+    stream.put(static_cast<char>(kRecordSection));
+    writeVarint(static_cast<uint8_t>(kind));
+    writeBytes(name);
+}
+
+void PlanWriter::add(const FileEntry& entry) {
+    std::string path = toPlanBytes(entry.path);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!stream.is_open()) return;
+
+    size_t shared = 0;
+    size_t limit = std::min(path.size(), previousPath.size());
+    while (shared < limit && path[shared] == previousPath[shared]) {
+        shared++;
+    }
+
+    stream.put(static_cast<char>(kRecordEntry));
+    writeVarint(shared);
+    writeBytes(path.substr(shared));
+    writeVarint(entry.size);
+    writeVarint(entry.device);
+    writeVarint(entry.inode);
+    writeVarint(zigzag(entry.mtime));
+    writeVarint(entry.allocated);
+    writeVarint(entry.links);
+
+    previousPath = std::move(path);
+    entryCount++;
+    totalBytes += entry.size;
+}
+
+bool PlanWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!stream.is_open()) return false;
+    stream.put(static_cast<char>(kRecordEnd));
+    writeVarint(entryCount);
+    writeVarint(totalBytes);
+    bool ok = stream.good();
+    stream.close();
+    return ok && !stream.fail();
+}
+
+PlanReader::~PlanReader() {
+    close();
+}
+
+bool PlanReader::open(const std::filesystem::path& file) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(handle);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        return false;
+    }
+    fileHandle = handle;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+    madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void PlanReader::close() {
+    if (!data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool PlanReader::read(std::vector<PlanSectionData>& sections, std::string& error) const {
+    if (!data || size < sizeof(kMagic) || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+        error = "not a deletion plan";
+        return false;
+    }
+
+    ByteReader cursor(data, size, sizeof(kMagic));
+    std::string previousPath;
+    uint64_t entryCount = 0;
+    uint64_t totalBytes = 0;
+
+    for (;;) {
+        uint8_t type;
+        if (!cursor.readByte(type)) {
+            error = "plan is incomplete (missing footer)";
+            return false;
+        }
+
+        if (type == kRecordSection) {
+            uint64_t kind;
+            PlanSectionData section;
+            uint64_t nameLength;
+            if (!cursor.readVarint(kind) || !cursor.readVarint(nameLength) ||
+                !cursor.readBytes(static_cast<size_t>(nameLength), section.name)) {
+                error = "truncated section record";
+                return false;
+            }
+            if (kind < static_cast<uint8_t>(PlanSection::Temp) || kind > static_cast<uint8_t>(PlanSection::Rule)) {
+                error = "unknown section kind " + std::to_string(kind);
+                return false;
+            }
+            section.kind = static_cast<PlanSection>(kind);
+            sections.push_back(std::move(section));
+        } else if (type == kRecordEntry) {
+            uint64_t shared, suffixLength, mtime, links;
+            std::string suffix;
+            FileEntry entry;
+            if (!cursor.readVarint(shared) || !cursor.readVarint(suffixLength) ||
+                !cursor.readBytes(static_cast<size_t>(suffixLength), suffix) ||
+                !cursor.readVarint(entry.size) || !cursor.readVarint(entry.device) ||
+                !cursor.readVarint(entry.inode) || !cursor.readVarint(mtime) ||
+                !cursor.readVarint(entry.allocated) || !cursor.readVarint(links)) {
+                error = "truncated entry record";
+                return false;
+            }
+            if (sections.empty() || shared > previousPath.size()) {
+                error = "corrupt entry record";
+                return false;
+            }
+            previousPath.resize(static_cast<size_t>(shared));
+            previousPath += suffix;
+            entry.path = fromPlanBytes(previousPath);
+            entry.mtime = unzigzag(mtime);
+            entry.links = static_cast<uint32_t>(links);
+            totalBytes += entry.size;
+            entryCount++;
+            sections.back().entries.push_back(std::move(entry));
+        } else if (type == kRecordEnd) {
+            uint64_t expectedCount, expectedBytes;
+            if (!cursor.readVarint(expectedCount) || !cursor.readVarint(expectedBytes) ||
+                expectedCount != entryCount || expectedBytes != totalBytes) {
+                error = "footer does not match plan contents";
+                return false;
+            }
+            return true;
+        } else {
+            error = "unknown record type " + std::to_string(type);
+            return false;
+        }
+    }
+}
+
+bool matchesFingerprint(const FileEntry& planned) {
+    FileEntry current;
+    current.device = planned.device;
+    if (!statFileEntry(planned.path, current)) return false;
+    return current.size == planned.size && current.device == planned.device &&
+           current.inode == planned.inode && current.mtime == planned.mtime;
+}
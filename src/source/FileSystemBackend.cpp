@@ -0,0 +1,403 @@
+#include "FileSystemBackend.h"
+#include "CleaningEngine.h"
+#include "PathArena.h"
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+    FileType toFileType(std::filesystem::file_type type) {
+        switch (type) {
+            case std::filesystem::file_type::regular: return FileType::Regular;
+            case std::filesystem::file_type::directory: return FileType::Directory;
+            case std::filesystem::file_type::symlink: return FileType::Symlink;
+            case std::filesystem::file_type::none:
+            case std::filesystem::file_type::not_found: return FileType::None;
+            default: return FileType::Other;
+        }
+    }
+
+    constexpr uint64_t kAllocationUnit = 4096;
+}
+
+NativeFileSystem& NativeFileSystem::instance() {
+    static NativeFileSystem fileSystem;
+    return fileSystem;
+}
+
+FileType NativeFileSystem::status(const std::filesystem::path& path, std::error_code& ec) {
+    FileType type = toFileType(std::filesystem::status(path, ec).type());
+    // A missing path is an answer, not an error
+    if (type == FileType::None) ec.clear();
+    return type;
+}
+
+void NativeFileSystem::listDirectory(const std::filesystem::path& path, std::vector<DirectoryItem>& items,
+                                     std::error_code& ec) {
+    const auto options = std::filesystem::directory_options::skip_permission_denied;
+    std::filesystem::directory_iterator it(path, options, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        // The type usually comes from the directory listing itself
+        std::error_code typeEc;
+        items.push_back({it->path(), toFileType(it->symlink_status(typeEc).type())});
+    }
+}
+
+bool NativeFileSystem::stat(const std::filesystem::path& path, FileEntry& entry, std::error_code& ec) {
+    if (statFileEntry(path, entry)) return true;
+#ifdef _WIN32
+    ec = std::error_code(static_cast<int>(GetLastError()), std::system_category());
+#else
+    ec = std::error_code(errno, std::generic_category());
+#endif
+    return false;
+}
+
+bool NativeFileSystem::remove(const std::filesystem::path& path, std::error_code& ec) {
+    return std::filesystem::remove(path, ec);
+}
+
+void NativeFileSystem::rename(const std::filesystem::path& from, const std::filesystem::path& to,
+                              std::error_code& ec) {
+    std::filesystem::rename(from, to, ec);
+}
+
+bool NativeFileSystem::deviceId(const std::filesystem::path& path, uint64_t& device) {
+    return getDeviceId(path, device);
+}
+
+bool NativeFileSystem::identify(const std::filesystem::path& path, FileId& id, std::error_code& ec) {
+#ifdef _WIN32
+    // Directories can only be opened with backup semantics
+    HANDLE handle = CreateFileW(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        ec = std::error_code(static_cast<int>(GetLastError()), std::system_category());
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL ok = GetFileInformationByHandle(handle, &info);
+    if (!ok) ec = std::error_code(static_cast<int>(GetLastError()), std::system_category());
+    CloseHandle(handle);
+    if (!ok) return false;
+    id.device = info.dwVolumeSerialNumber;
+    id.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    id.device = static_cast<uint64_t>(st.st_dev);
+    id.inode = static_cast<uint64_t>(st.st_ino);
+#endif
+    return true;
+}
+
+bool NativeFileSystem::owner(const std::filesystem::path& path, bool follow, FileOwner& owner,
+                             std::error_code& ec) {
+#ifdef _WIN32
+    auto state = follow ? std::filesystem::status(path, ec) : std::filesystem::symlink_status(path, ec);
+    if (!ec && !std::filesystem::exists(state)) ec = std::make_error_code(std::errc::no_such_file_or_directory);
+    if (ec) return false;
+    owner = FileOwner();
+#else
+    struct stat st;
+    if ((follow ? ::stat(path.c_str(), &st) : ::lstat(path.c_str(), &st)) != 0) {
+        ec = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    owner.user = static_cast<uint64_t>(st.st_uid);
+    owner.worldWritable = (st.st_mode & S_IWOTH) != 0;
+#endif
+    return true;
+}
+
+StorageType NativeFileSystem::storageType(const std::filesystem::path& path) {
+    return detectStorageType(path);
+}
+
+MemoryFileSystem::MemoryFileSystem(uint64_t device, StorageType type) : device(device), type(type) {}
+
+std::string MemoryFileSystem::keyOf(const std::filesystem::path& path) {
+    std::string key = toUtf8(path.lexically_normal());
+    std::replace(key.begin(), key.end(), '\\', '/');
+    // "dir/" and "dir" are the same directory, "/" and "C:/" stay roots
+    while (key.size() > 1 && key.back() == '/' && !(key.size() == 3 && key[1] == ':')) {
+        key.pop_back();
+    }
+    return key;
+}
+
+std::pair<std::string, std::string> MemoryFileSystem::split(const std::string& key) {
+    size_t separator = key.rfind('/');
+    if (separator == std::string::npos) return {std::string(), key};
+    if (separator + 1 == key.size()) return {key, std::string()};
+    bool root = separator == 0 || (separator == 2 && key[1] == ':');
+    return {key.substr(0, root ? separator + 1 : separator), key.substr(separator + 1)};
+}
+
+MemoryFileSystem::Directory& MemoryFileSystem::makeDirectory(const std::string& key) {
+    auto it = directories.find(key);
+    if (it != directories.end()) return it->second;
+
+    // References stay valid while parents are inserted
+    Directory& directory = directories[key];
+    auto [parent, name] = split(key);
+    if (!parent.empty() && !name.empty()) {
+        Directory& parentDirectory = makeDirectory(parent);
+        Node node;
+        node.type = FileType::Directory;
+        node.inode = nextInode++;
+        parentDirectory.emplace(name, node);
+    }
+    return directory;
+}
+
+const MemoryFileSystem::Node* MemoryFileSystem::find(const std::string& key) const {
+    auto [parent, name] = split(key);
+    auto directory = directories.find(parent);
+    if (name.empty() || directory == directories.end()) return nullptr;
+    auto node = directory->second.find(name);
+    return node == directory->second.end() ? nullptr : &node->second;
+}
+
+bool MemoryFileSystem::enter(FileOperation operation, const std::string& key, std::error_code& ec) {
+    size_t index = static_cast<size_t>(operation);
+    calls[index]++;
+    int64_t latency = latencies[index].load();
+    if (latency > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(latency));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& fault : faults) {
+        if (fault.operation != operation || fault.remaining == 0) continue;
+        if (!fault.key.empty() && fault.key != key) continue;
+        if (fault.remaining > 0) fault.remaining--;
+        ec = std::make_error_code(fault.error);
+        return false;
+    }
+    return true;
+}
+
+void MemoryFileSystem::addFile(const std::filesystem::path& path, uint64_t size, int64_t mtime) {
+    auto [parent, name] = split(keyOf(path));
+    std::lock_guard<std::mutex> lock(mutex);
+    Directory& directory = makeDirectory(parent);
+    Node node;
+    node.size = size;
+    node.mtime = mtime;
+    node.inode = nextInode++;
+    auto [it, inserted] = directory.emplace(name, node);
+    if (inserted) {
+        files++;
+    } else if (it->second.type == FileType::Regular) {
+        it->second.size = size;
+        it->second.mtime = mtime;
+    }
+}
+
+void MemoryFileSystem::addDirectory(const std::filesystem::path& path) {
+    std::string key = keyOf(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    makeDirectory(key);
+}
+
+void MemoryFileSystem::addTree(const std::filesystem::path& root, size_t directoryCount, size_t filesPerDirectory,
+                               uint64_t fileSize) {
+    std::string rootKey = keyOf(root);
+    std::lock_guard<std::mutex> lock(mutex);
+    makeDirectory(rootKey);
+    for (size_t i = 0; i < directoryCount; ++i) {
+        Directory& directory = makeDirectory(rootKey + "/d" + std::to_string(i));
+        for (size_t j = 0; j < filesPerDirectory; ++j) {
+            Node node;
+            node.size = fileSize;
+            node.inode = nextInode++;
+            if (directory.emplace("f" + std::to_string(j), node).second) files++;
+        }
+    }
+}
+
+FileType MemoryFileSystem::typeOf(const std::filesystem::path& path) const {
+    std::string key = keyOf(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (directories.count(key)) return FileType::Directory;
+    const Node* node = find(key);
+    return node ? node->type : FileType::None;
+}
+
+uint64_t MemoryFileSystem::getFileCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return files;
+}
+
+void MemoryFileSystem::setLatency(FileOperation operation, std::chrono::nanoseconds latency) {
+    latencies[static_cast<size_t>(operation)] = latency.count();
+}
+
+void MemoryFileSystem::injectFault(FileOperation operation, const std::filesystem::path& path, std::errc error,
+                                   int count) {
+    std::string key = path.empty() ? std::string() : keyOf(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    faults.push_back({operation, key, error, count});
+}
+
+void MemoryFileSystem::clearFaults() {
+    std::lock_guard<std::mutex> lock(mutex);
+    faults.clear();
+}
+
+void MemoryFileSystem::setListHook(std::function<void(const std::filesystem::path&)> hook) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listHook = std::move(hook);
+}
+
+uint64_t MemoryFileSystem::getCallCount(FileOperation operation) const {
+    return calls[static_cast<size_t>(operation)].load();
+}
+
+FileType MemoryFileSystem::status(const std::filesystem::path& path, std::error_code& ec) {
+    if (!enter(FileOperation::Stat, keyOf(path), ec)) return FileType::None;
+    return typeOf(path);
+}
+
+void MemoryFileSystem::listDirectory(const std::filesystem::path& path, std::vector<DirectoryItem>& items,
+                                     std::error_code& ec) {
+    std::string key = keyOf(path);
+    if (!enter(FileOperation::List, key, ec)) {
+        // Like the native listing, unreadable directories are skipped silently
+        if (ec == std::errc::permission_denied) ec.clear();
+        return;
+    }
+
+    std::function<void(const std::filesystem::path&)> hook;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto directory = directories.find(key);
+        if (directory == directories.end()) {
+            ec = std::make_error_code(find(key) ? std::errc::not_a_directory : std::errc::no_such_file_or_directory);
+            return;
+        }
+        items.reserve(items.size() + directory->second.size());
+        for (const auto& [name, node] : directory->second) {
+            items.push_back({path / name, node.type});
+        }
+        hook = listHook;
+    }
+    if (hook) hook(path);
+}
+
+bool MemoryFileSystem::stat(const std::filesystem::path& path, FileEntry& entry, std::error_code& ec) {
+    std::string key = keyOf(path);
+    if (!enter(FileOperation::Stat, key, ec)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const Node* node = find(key);
+    if (!node && !directories.count(key)) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return false;
+    }
+    entry.path = path;
+    entry.size = node ? node->size : 0;
+    entry.allocated = (entry.size + kAllocationUnit - 1) / kAllocationUnit * kAllocationUnit;
+    entry.links = 1;
+    entry.device = device;
+    entry.inode = node ? node->inode : 0;
+    entry.mtime = node ? node->mtime : 0;
+    return true;
+}
+
+bool MemoryFileSystem::remove(const std::filesystem::path& path, std::error_code& ec) {
+    std::string key = keyOf(path);
+    if (!enter(FileOperation::Remove, key, ec)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [parent, name] = split(key);
+    auto directory = directories.find(parent);
+    if (name.empty() || directory == directories.end()) return false;
+    auto node = directory->second.find(name);
+    if (node == directory->second.end()) return false;
+
+    if (node->second.type == FileType::Directory) {
+        auto contents = directories.find(key);
+        if (contents != directories.end()) {
+            if (!contents->second.empty()) {
+                ec = std::make_error_code(std::errc::directory_not_empty);
+                return false;
+            }
+            directories.erase(contents);
+        }
+    } else {
+        files--;
+    }
+    directory->second.erase(node);
+    return true;
+}
+
+void MemoryFileSystem::rename(const std::filesystem::path& from, const std::filesystem::path& to,
+                              std::error_code& ec) {
+    std::string fromKey = keyOf(from);
+    if (!enter(FileOperation::Rename, fromKey, ec)) return;
+    std::string toKey = keyOf(to);
+    if (toKey == fromKey) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [fromParent, fromName] = split(fromKey);
+    auto [toParent, toName] = split(toKey);
+    auto source = directories.find(fromParent);
+    auto target = directories.find(toParent);
+    if (source == directories.end() || target == directories.end() || !source->second.count(fromName)) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return;
+    }
+    Node node = source->second.at(fromName);
+    if (node.type == FileType::Directory) {
+        // Only files are moved; directories would have to carry their subtree
+        ec = std::make_error_code(std::errc::operation_not_supported);
+        return;
+    }
+    auto existing = target->second.find(toName);
+    if (existing != target->second.end()) {
+        if (existing->second.type == FileType::Directory) {
+            ec = std::make_error_code(std::errc::is_a_directory);
+            return;
+        }
+        files--;
+        target->second.erase(existing);
+    }
+    source->second.erase(fromName);
+    target->second.emplace(toName, node);
+}
+
+bool MemoryFileSystem::deviceId(const std::filesystem::path&, uint64_t& id) {
+    id = device;
+    return true;
+}
+
+bool MemoryFileSystem::identify(const std::filesystem::path& path, FileId& id, std::error_code& ec) {
+    FileEntry entry;
+    if (!stat(path, entry, ec)) return false;
+    id.device = entry.device;
+    id.inode = entry.inode;
+    return true;
+}
+
+bool MemoryFileSystem::owner(const std::filesystem::path& path, bool, FileOwner& owner, std::error_code& ec) {
+    if (!enter(FileOperation::Stat, keyOf(path), ec)) return false;
+    if (typeOf(path) == FileType::None) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return false;
+    }
+    owner = FileOwner();
+    return true;
+}
+
+StorageType MemoryFileSystem::storageType(const std::filesystem::path&) {
+    return type;
+}
@@ -0,0 +1,211 @@
+#include "FileTypeFilter.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace {
+    using NativeChar = std::filesystem::path::value_type;
+
+    // Search bound per bucket before the table is grown
+    constexpr uint32_t kMaxDisplacement = 1u << 16;
+
+    template <typename Char>
+    uint32_t fold(Char c) {
+        auto value = static_cast<uint32_t>(static_cast<std::make_unsigned_t<Char>>(c));
+        return value >= 'A' && value <= 'Z' ? value + ('a' - 'A') : value;
+    }
+
+    // FNV-1a over case-folded characters
+    uint64_t hashExtension(const NativeChar* begin, const NativeChar* end) {
+        uint64_t hash = 14695981039346656037ull;
+        for (; begin != end; ++begin) {
+            hash ^= fold(*begin);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    size_t bucketOf(uint64_t hash, size_t buckets) {
+        return static_cast<size_t>(hash >> 32) & (buckets - 1);
+    }
+
+    size_t slotOf(uint64_t hash, uint32_t displacement, size_t slots) {
+        return static_cast<size_t>(mix(hash + displacement * 0x9E3779B97F4A7C15ull)) & (slots - 1);
+    }
+
+    size_t nextPowerOfTwo(size_t value) {
+        size_t power = 1;
+        while (power < value) power <<= 1;
+        return power;
+    }
+
+    std::string normalizeType(const std::string& type) {
+        std::string normalized = type.substr(std::min(type.find_first_not_of('.'), type.size()));
+        std::transform(normalized.begin(), normalized.end(), normalized.begin(),
+                       [](unsigned char c) { return static_cast<char>(fold(c)); });
+        return normalized;
+    }
+}
+
+ExtensionSet::ExtensionSet(const std::vector<std::string>& types) {
+    for (const auto& type : types) {
+        std::string extension = normalizeType(type);
+        if (extension.empty() || std::find(extensions.begin(), extensions.end(), extension) != extensions.end()) {
+            continue;
+        }
+        extensions.push_back(extension);
+        nativeExtensions.push_back(std::filesystem::u8path(extension).native());
+    }
+    if (extensions.empty()) return;
+
+    std::vector<uint64_t> hashes;
+    for (const auto& extension : nativeExtensions) {
+        hashes.push_back(hashExtension(extension.data(), extension.data() + extension.size()));
+    }
+    // Half full tables settle within a few displacements per bucket
+    size_t tableSize = nextPowerOfTwo(extensions.size() * 2);
+    while (!build(tableSize, hashes)) {
+        tableSize *= 2;
+    }
+}
+
+bool ExtensionSet::build(size_t tableSize, const std::vector<uint64_t>& hashes) {
+    const size_t bucketCount = nextPowerOfTwo((extensions.size() + 1) / 2);
+    displacements.assign(bucketCount, 0);
+    slots.assign(tableSize, Slot());
+    sameHash.clear();
+
+    // Distinct extensions with one hash cannot get distinct slots; they are
+    // compared only after a slot matched their hash
+    std::vector<std::vector<uint32_t>> buckets(bucketCount);
+    for (uint32_t i = 0; i < hashes.size(); ++i) {
+        if (std::find(hashes.begin(), hashes.begin() + i, hashes[i]) != hashes.begin() + i) {
+            sameHash.push_back(i);
+        } else {
+            buckets[bucketOf(hashes[i], bucketCount)].push_back(i);
+        }
+    }
+
+    // Fullest buckets first, while most slots are still free
+    std::vector<size_t> order(bucketCount);
+    for (size_t i = 0; i < bucketCount; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&buckets](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    std::vector<size_t> taken;
+    for (size_t bucket : order) {
+        if (buckets[bucket].empty()) break;
+        uint32_t displacement = 0;
+        for (; displacement < kMaxDisplacement; ++displacement) {
+            taken.clear();
+            for (uint32_t index : buckets[bucket]) {
+                size_t slot = slotOf(hashes[index], displacement, tableSize);
+                if (slots[slot].index != kEmpty || std::find(taken.begin(), taken.end(), slot) != taken.end()) break;
+                taken.push_back(slot);
+            }
+            if (taken.size() == buckets[bucket].size()) break;
+        }
+        if (displacement == kMaxDisplacement) return false;
+
+        displacements[bucket] = displacement;
+        for (size_t i = 0; i < taken.size(); ++i) {
+            slots[taken[i]].hash = hashes[buckets[bucket][i]];
+            slots[taken[i]].index = buckets[bucket][i];
+        }
+    }
+    return true;
+}
+
+bool ExtensionSet::matches(uint32_t index, const NativeChar* begin, const NativeChar* end) const {
+    const auto& extension = nativeExtensions[index];
+    if (extension.size() != static_cast<size_t>(end - begin)) return false;
+    return std::equal(begin, end, extension.begin(),
+                      [](NativeChar a, NativeChar b) { return fold(a) == fold(b); });
+}
+
+bool ExtensionSet::contains(const NativeChar* begin, const NativeChar* end) const {
+    if (extensions.empty()) return false;
+    const uint64_t hash = hashExtension(begin, end);
+    const Slot& slot = slots[slotOf(hash, displacements[bucketOf(hash, displacements.size())], slots.size())];
+    if (slot.index == kEmpty || slot.hash != hash) return false;
+    if (matches(slot.index, begin, end)) return true;
+    return std::any_of(sameHash.begin(), sameHash.end(),
+                       [&](uint32_t index) { return matches(index, begin, end); });
+}
+
+bool ExtensionSet::contains(const std::string& extension) const {
+    std::filesystem::path::string_type native = std::filesystem::u8path(extension).native();
+    return contains(native.data(), native.data() + native.size());
+}
+
+const char* sniffFileType(const unsigned char* header, size_t length) {
+    auto startsWith = [header, length](const char* magic, size_t size) {
+        return length >= size && std::memcmp(header, magic, size) == 0;
+    };
+    if (startsWith("MZ", 2)) return "exe";
+    if (startsWith("\x7f" "ELF", 4)) return "elf";
+    if (startsWith("\xfe\xed\xfa\xce", 4) || startsWith("\xfe\xed\xfa\xcf", 4) ||
+        startsWith("\xce\xfa\xed\xfe", 4) || startsWith("\xcf\xfa\xed\xfe", 4) ||
+        startsWith("\xca\xfe\xba\xbe", 4)) {
+        return "macho";
+    }
+    if (startsWith("#!", 2)) return "script";
+    if (startsWith("%PDF-", 5)) return "pdf";
+    // Compound files hold legacy Office documents and installers
+    if (startsWith("\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8)) return "ole";
+    if (startsWith("PK\x03\x04", 4)) return "zip";
+    if (startsWith("{\\rtf", 5)) return "rtf";
+    return nullptr;
+}
+
+FileTypeFilter::FileTypeFilter() : excluded(getDefaultExcludedTypes()) {}
+
+const std::vector<std::string>& FileTypeFilter::getDefaultExcludedTypes() {
+    static const std::vector<std::string> types = {
+        // Executables, libraries and installers
+        "exe", "dll", "sys", "msi", "com", "scr", "cpl", "ocx", "elf", "macho",
+        // Scripts
+        "bat", "cmd", "ps1", "vbs", "sh", "script",
+        // Documents
+        "doc", "docx", "xls", "xlsx", "ppt", "pptx", "odt", "ods", "odp", "pdf", "rtf", "ole",
+    };
+    return types;
+}
+
+bool FileTypeFilter::allowsType(const NativeChar* begin, const NativeChar* end) const {
+    if (!allowed.empty() && !allowed.contains(begin, end)) return false;
+    return !excluded.contains(begin, end);
+}
+
+bool FileTypeFilter::allows(const std::filesystem::path& path) const {
+    const auto& native = path.native();
+    const NativeChar* data = native.data();
+    size_t name = native.find_last_of(std::filesystem::path::string_type{std::filesystem::path::preferred_separator,
+                                                                         NativeChar('/')});
+    name = name == std::filesystem::path::string_type::npos ? 0 : name + 1;
+    size_t dot = native.rfind(NativeChar('.'));
+    // A leading dot names a hidden file, not an extension
+    if (dot != std::filesystem::path::string_type::npos && dot > name && dot + 1 < native.size()) {
+        return allowsType(data + dot + 1, data + native.size());
+    }
+
+    if (sniffing) {
+        unsigned char header[kSniffBytes];
+        std::ifstream in(path, std::ios::binary);
+        in.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (const char* type = sniffFileType(header, static_cast<size_t>(in.gcount()))) {
+            std::filesystem::path::string_type typeName(type, type + std::strlen(type));
+            return allowsType(typeName.data(), typeName.data() + typeName.size());
+        }
+    }
+    // Untyped files are only cleaned without an allow list
+    return allowed.empty();
+}
@@ -0,0 +1,208 @@
+#include "FirefoxCache.h"
+#include "BinaryIO.h"
+#include "PathArena.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    constexpr uint32_t kIndexVersion = 0xA;
+    constexpr size_t kHeaderSize = 16;
+    // hash, frecency, origin attributes hash, on-start/on-stop times, content type, flags
+    constexpr size_t kRecordSize = 20 + 4 + 8 + 2 + 2 + 1 + 4;
+    constexpr size_t kFlagsOffset = kRecordSize - 4;
+    constexpr uint32_t kRemovedMask = 0x20000000u;
+
+    // Entry metadata: chunk hashes are 16 bits per 256 kB of data
+    constexpr uint32_t kChunkSize = 256 * 1024;
+    constexpr uint32_t kMinMetadataVersion = 2;
+    constexpr uint32_t kMaxMetadataVersion = 3;
+
+    constexpr std::time_t kSecondsPerDay = 24 * 60 * 60;
+
+    inline void mix(uint32_t& a, uint32_t& b, uint32_t& c) {
+        a -= b; a -= c; a ^= (c >> 13);
+        b -= c; b -= a; b ^= (a << 8);
+        c -= a; c -= b; c ^= (b >> 13);
+        a -= b; a -= c; a ^= (c >> 12);
+        b -= c; b -= a; b ^= (a << 16);
+        c -= a; c -= b; c ^= (b >> 5);
+        a -= b; a -= c; a ^= (c >> 3);
+        b -= c; b -= a; b ^= (a << 10);
+        c -= a; c -= b; c ^= (b >> 15);
+    }
+
+    uint32_t readLE(const uint8_t* k) {
+        return k[0] | (uint32_t(k[1]) << 8) | (uint32_t(k[2]) << 16) | (uint32_t(k[3]) << 24);
+    }
+
+    std::filesystem::path indexPath(const std::filesystem::path& directory) {
+        return directory / "index";
+    }
+}
+
+uint32_t firefoxCacheHash(const void* data, size_t length, uint32_t initval) {
+    const uint8_t* k = static_cast<const uint8_t*>(data);
+    uint32_t a = 0x9e3779b9u, b = 0x9e3779b9u, c = initval;
+    size_t left = length;
+    while (left >= 12) {
+        a += readLE(k);
+        b += readLE(k + 4);
+        c += readLE(k + 8);
+        mix(a, b, c);
+        k += 12;
+        left -= 12;
+    }
+
+    // The first byte of c is reserved for the length
+    c += static_cast<uint32_t>(length);
+    switch (left) {
+        case 11: c += uint32_t(k[10]) << 24; [[fallthrough]];
+        case 10: c += uint32_t(k[9]) << 16; [[fallthrough]];
+        case 9: c += uint32_t(k[8]) << 8; [[fallthrough]];
+        case 8: b += uint32_t(k[7]) << 24; [[fallthrough]];
+        case 7: b += uint32_t(k[6]) << 16; [[fallthrough]];
+        case 6: b += uint32_t(k[5]) << 8; [[fallthrough]];
+        case 5: b += k[4]; [[fallthrough]];
+        case 4: a += uint32_t(k[3]) << 24; [[fallthrough]];
+        case 3: a += uint32_t(k[2]) << 16; [[fallthrough]];
+        case 2: a += uint32_t(k[1]) << 8; [[fallthrough]];
+        case 1: a += k[0]; break;
+        default: break;
+    }
+    mix(a, b, c);
+    return c;
+}
+
+bool FirefoxCacheIndex::isCache2(const std::filesystem::path& directory) {
+    std::error_code ec;
+    return std::filesystem::is_regular_file(indexPath(directory), ec) &&
+           std::filesystem::is_directory(directory / "entries", ec);
+}
+
+std::filesystem::path FirefoxCacheIndex::entryFile(const std::filesystem::path& directory,
+                                                   const std::array<uint8_t, 20>& hash) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string name;
+    name.reserve(40);
+    for (uint8_t byte : hash) {
+        name.push_back(digits[byte >> 4]);
+        name.push_back(digits[byte & 0xF]);
+    }
+    return directory / "entries" / name;
+}
+
+bool FirefoxCacheIndex::readLastFetched(const std::filesystem::path& file, uint32_t& lastFetched) {
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    std::streamoff fileSize = in.tellg();
+    if (fileSize < 4) return false;
+
+    // The last four bytes hold the offset of the metadata, i.e. the data size
+    char tail[4];
+    in.seekg(fileSize - 4);
+    if (!in.read(tail, 4)) return false;
+    uint32_t offset;
+    ByteReader(tail, 4).readU32BE(offset);
+
+    uint64_t headerPos = static_cast<uint64_t>(offset) + 4 + 2 * ((static_cast<uint64_t>(offset) + kChunkSize - 1) / kChunkSize);
+    if (headerPos + 16 > static_cast<uint64_t>(fileSize)) return false;
+
+    // Metadata header: version, fetch count, last fetched, ...
+    char header[12];
+    in.seekg(static_cast<std::streamoff>(headerPos));
+    if (!in.read(header, sizeof(header))) return false;
+    ByteReader reader(header, sizeof(header));
+    uint32_t version, fetchCount;
+    reader.readU32BE(version);
+    reader.readU32BE(fetchCount);
+    reader.readU32BE(lastFetched);
+    return version >= kMinMetadataVersion && version <= kMaxMetadataVersion;
+}
+
+bool FirefoxCacheIndex::load(const std::filesystem::path& directory) {
+    entries.clear();
+    error.clear();
+
+    std::ifstream in(indexPath(directory), std::ios::binary);
+    if (!in.is_open()) {
+        error = "cannot open " + toUtf8(indexPath(directory));
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < kHeaderSize + 4 || (data.size() - kHeaderSize - 4) % kRecordSize != 0) {
+        error = "unexpected index size";
+        return false;
+    }
+
+    uint32_t stored;
+    ByteReader(data.data(), data.size(), data.size() - 4).readU32BE(stored);
+    if (firefoxCacheHash(data.data(), data.size() - 4) != stored) {
+        error = "index hash mismatch";
+        return false;
+    }
+
+    ByteReader reader(data.data(), data.size() - 4);
+    uint32_t timestamp;
+    reader.readU32BE(version);
+    reader.readU32BE(timestamp);
+    reader.readU32BE(dirty);
+    reader.readU32BE(kbWritten);
+    if (version != kIndexVersion) {
+        error = "unsupported index version " + std::to_string(version);
+        return false;
+    }
+
+    size_t count = (data.size() - kHeaderSize - 4) / kRecordSize;
+    entries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        FirefoxCacheEntry entry;
+        reader.readBytes(kRecordSize, entry.record);
+        std::copy(entry.record.begin(), entry.record.begin() + 20, entry.hash.begin());
+        ByteReader(entry.record.data(), kRecordSize, 20).readU32BE(entry.frecency);
+        ByteReader(entry.record.data(), kRecordSize, kFlagsOffset).readU32BE(entry.flags);
+        if (entry.flags & kRemovedMask) continue;
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool FirefoxCacheIndex::save(const std::filesystem::path& directory) const {
+    std::string data;
+    appendU32BE(data, version);
+    appendU32BE(data, static_cast<uint32_t>(std::time(nullptr)));
+    appendU32BE(data, dirty);
+    appendU32BE(data, kbWritten);
+    for (const auto& entry : entries) data += entry.record;
+    appendU32BE(data, firefoxCacheHash(data.data(), data.size()));
+
+    return writeFileAtomically(indexPath(directory), data, directory / "index.tmp");
+}
+
+std::vector<FirefoxCacheEntry> selectFirefoxEvictions(std::vector<FirefoxCacheEntry> entries,
+                                                      const CacheEvictionPolicy& policy, std::time_t now) {
+    uint64_t total = 0;
+    for (const auto& entry : entries) total += entry.size();
+
+    std::vector<FirefoxCacheEntry> evicted;
+    if (policy.maxAgeDays > 0) {
+        const std::time_t maxAge = static_cast<std::time_t>(policy.maxAgeDays) * kSecondsPerDay;
+        auto stale = std::stable_partition(entries.begin(), entries.end(), [now, maxAge](const FirefoxCacheEntry& entry) {
+            return entry.lastFetched == 0 || now - static_cast<std::time_t>(entry.lastFetched) <= maxAge;
+        });
+        for (auto it = stale; it != entries.end(); ++it) {
+            total -= it->size();
+            evicted.push_back(std::move(*it));
+        }
+        entries.erase(stale, entries.end());
+    }
+
+    std::sort(entries.begin(), entries.end(),
+        [](const FirefoxCacheEntry& a, const FirefoxCacheEntry& b) { return a.frecency < b.frecency; });
+    for (auto& entry : entries) {
+        if (total <= policy.maxBytes) break;
+        total -= entry.size();
+        evicted.push_back(std::move(entry));
+    }
+    return evicted;
+}
@@ -0,0 +1,402 @@
+#include "IoExecutor.h"
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#ifdef STATX_BASIC_STATS
+#define COOKIEMONSTER_IO_URING 1
+#endif
+#endif
+#endif
+
+struct IoExecutor::Operation {
+    enum class Kind { ReadDirectory, Stat, Unlink, Rename, Copy, Work };
+
+    explicit Operation(Kind kind) : kind(kind) {}
+
+    Kind kind;
+    std::filesystem::path path;
+    std::filesystem::path target;
+    std::error_code error;
+    FileEntry entry;
+    std::vector<DirectoryItem> entries;
+    std::function<std::error_code()> work;
+    Callback done;
+    StatCallback statDone;
+    DirectoryCallback directoryDone;
+#ifdef COOKIEMONSTER_IO_URING
+    struct statx attributes;
+#endif
+};
+
+#ifdef COOKIEMONSTER_IO_URING
+// Minimal io_uring over the raw system calls, driven by one thread
+class IoExecutor::Ring {
+public:
+    static std::unique_ptr<Ring> create(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            Logger::getInstance().log(LogLevel::DEBUG,
+                std::string("io_uring unavailable, using blocking threads: ") + std::strerror(errno));
+            return nullptr;
+        }
+        std::unique_ptr<Ring> ring(new Ring(fd));
+        if (!ring->map(params)) return nullptr;
+        return ring;
+    }
+
+    ~Ring() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqSize);
+        if (sqRing) munmap(sqRing, sqSize);
+        close(fd);
+    }
+
+    bool handles(Operation::Kind kind) const {
+        switch (kind) {
+            case Operation::Kind::Stat: return statSupport != Support::No;
+            case Operation::Kind::Unlink: return unlinkSupport != Support::No;
+            case Operation::Kind::Rename: return renameSupport != Support::No;
+            default: return false;
+        }
+    }
+
+    bool isFull() const { return inFlight >= capacity; }
+    size_t getInFlight() const { return inFlight; }
+
+    void push(Operation* operation) {
+        unsigned tail = *sqTail;
+        unsigned index = tail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(operation->path.c_str());
+        sqe->user_data = reinterpret_cast<uint64_t>(operation);
+        switch (operation->kind) {
+            case Operation::Kind::Stat:
+                sqe->opcode = IORING_OP_STATX;
+                sqe->len = STATX_BASIC_STATS;
+                sqe->off = reinterpret_cast<uint64_t>(&operation->attributes);
+                sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+                break;
+            case Operation::Kind::Unlink:
+                sqe->opcode = IORING_OP_UNLINKAT;
+                break;
+            default:
+                sqe->opcode = IORING_OP_RENAMEAT;
+                sqe->len = static_cast<uint32_t>(AT_FDCWD);
+                sqe->off = reinterpret_cast<uint64_t>(operation->target.c_str());
+                break;
+        }
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted++;
+        inFlight++;
+    }
+
+    /**
+     * Submit prepared entries, optionally waiting for one completion
+     */
+    void submit(bool waitForOne) {
+        while (unsubmitted > 0 || waitForOne) {
+            unsigned flags = waitForOne ? IORING_ENTER_GETEVENTS : 0;
+            long submitted = syscall(__NR_io_uring_enter, fd, unsubmitted, waitForOne ? 1u : 0u, flags, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR) continue;
+                // EAGAIN/EBUSY: the kernel wants completions reaped first
+                return;
+            }
+            unsubmitted -= static_cast<unsigned>(submitted);
+            waitForOne = false;
+        }
+    }
+
+    /**
+     * Hand every available completion to the callback; the operation
+     * pointer and the negated errno (or 0) are passed
+     */
+    template <typename Callback>
+    bool reap(Callback callback) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail) return false;
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            auto* operation = reinterpret_cast<Operation*>(cqe.user_data);
+            int result = cqe.res;
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            inFlight--;
+            callback(operation, learn(operation->kind, result));
+        }
+        return true;
+    }
+
+private:
+    enum class Support { Unknown, Yes, No };
+
+    explicit Ring(int fd) : fd(fd) {}
+
+    bool map(const io_uring_params& params) {
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqSize = cqSize = std::max(sqSize, cqSize);
+
+        sqRing = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) { sqRing = nullptr; return false; }
+        cqRing = single ? sqRing
+                        : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) { cqRing = nullptr; return false; }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* mapped = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (mapped == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(mapped);
+
+        auto* sq = static_cast<char*>(sqRing);
+        auto* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        // The completion queue is larger, so it can never overflow
+        capacity = params.sq_entries;
+        return true;
+    }
+
+    // Kernels predating an opcode reject it with EINVAL; from then on that
+    // operation goes to the blocking threads
+    int learn(Operation::Kind kind, int result) {
+        Support& support = kind == Operation::Kind::Stat ? statSupport
+                         : kind == Operation::Kind::Unlink ? unlinkSupport : renameSupport;
+        if (support == Support::Unknown) {
+            support = (result == -EINVAL || result == -EOPNOTSUPP) ? Support::No : Support::Yes;
+        }
+        return support == Support::No ? 1 : result;
+    }
+
+    int fd;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqSize = 0;
+    size_t cqSize = 0;
+    size_t sqesSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    size_t capacity = 0;
+    size_t inFlight = 0;
+    unsigned unsubmitted = 0;
+    Support statSupport = Support::Unknown;
+    Support unlinkSupport = Support::Unknown;
+    Support renameSupport = Support::Unknown;
+};
+#else
+class IoExecutor::Ring {};
+#endif
+
+IoExecutor::IoExecutor(size_t queueDepth, size_t threads, FileSystemBackend* backend)
+    : fileSystem(backend ? *backend : NativeFileSystem::instance()),
+      pool(std::make_unique<WorkerPool>(std::max<size_t>(threads, 1))) {
+#ifdef COOKIEMONSTER_IO_URING
+    if (!backend) ring = Ring::create(static_cast<unsigned>(std::clamp<size_t>(queueDepth, 1, 4096)));
+#else
+    (void)queueDepth;
+#endif
+}
+
+IoExecutor::~IoExecutor() {
+    wait();
+}
+
+bool IoExecutor::isNative() const {
+    return ring != nullptr;
+}
+
+void IoExecutor::readDirectory(const std::filesystem::path& path, DirectoryCallback done) {
+    auto operation = std::make_unique<Operation>(Operation::Kind::ReadDirectory);
+    operation->path = path;
+    operation->directoryDone = std::move(done);
+    start(std::move(operation));
+}
+
+void IoExecutor::stat(const std::filesystem::path& path, StatCallback done) {
+    auto operation = std::make_unique<Operation>(Operation::Kind::Stat);
+    operation->path = path;
+    operation->statDone = std::move(done);
+    start(std::move(operation));
+}
+
+void IoExecutor::unlink(const std::filesystem::path& path, Callback done) {
+    auto operation = std::make_unique<Operation>(Operation::Kind::Unlink);
+    operation->path = path;
+    operation->done = std::move(done);
+    start(std::move(operation));
+}
+
+void IoExecutor::rename(const std::filesystem::path& from, const std::filesystem::path& to, Callback done) {
+    auto operation = std::make_unique<Operation>(Operation::Kind::Rename);
+    operation->path = from;
+    operation->target = to;
+    operation->done = std::move(done);
+    start(std::move(operation));
+}
+
+void IoExecutor::copy(const std::filesystem::path& from, const std::filesystem::path& to, Callback done) {
+    auto operation = std::make_unique<Operation>(Operation::Kind::Copy);
+    operation->path = from;
+    operation->target = to;
+    operation->done = std::move(done);
+    start(std::move(operation));
+}
+
+void IoExecutor::submit(std::function<std::error_code()> work, Callback done) {
+    auto operation = std::make_unique<Operation>(Operation::Kind::Work);
+    operation->work = std::move(work);
+    operation->done = std::move(done);
+    start(std::move(operation));
+}
+
+void IoExecutor::start(std::unique_ptr<Operation> operation) {
+    outstanding++;
+#ifdef COOKIEMONSTER_IO_URING
+    if (ring && ring->handles(operation->kind)) {
+        if (ring->isFull() || !backlog.empty()) {
+            backlog.push_back(std::move(operation));
+        } else {
+            ring->push(operation.release());
+        }
+        return;
+    }
+#endif
+    runBlocking(std::move(operation));
+}
+
+void IoExecutor::runBlocking(std::unique_ptr<Operation> operation) {
+    blockingInFlight++;
+    Operation* raw = operation.release();
+    pool->submit([this, raw] {
+        Operation& op = *raw;
+        switch (op.kind) {
+            case Operation::Kind::ReadDirectory:
+                fileSystem.listDirectory(op.path, op.entries, op.error);
+                break;
+            case Operation::Kind::Stat:
+                fileSystem.stat(op.path, op.entry, op.error);
+                break;
+            case Operation::Kind::Unlink:
+                if (!fileSystem.remove(op.path, op.error) && !op.error) {
+                    op.error = std::make_error_code(std::errc::no_such_file_or_directory);
+                }
+                break;
+            case Operation::Kind::Rename:
+                fileSystem.rename(op.path, op.target, op.error);
+                break;
+            case Operation::Kind::Copy:
+                std::filesystem::copy_file(op.path, op.target,
+                    std::filesystem::copy_options::overwrite_existing, op.error);
+                break;
+            case Operation::Kind::Work:
+                op.error = op.work();
+                break;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.emplace_back(raw);
+        completed.notify_one();
+    });
+}
+
+void IoExecutor::complete(Operation& operation) {
+    outstanding--;
+    switch (operation.kind) {
+        case Operation::Kind::ReadDirectory:
+            operation.directoryDone(operation.error, std::move(operation.entries));
+            break;
+        case Operation::Kind::Stat:
+            operation.statDone(operation.error, std::move(operation.entry));
+            break;
+        default:
+            operation.done(operation.error);
+            break;
+    }
+}
+
+bool IoExecutor::reapBlocking(bool block) {
+    std::vector<std::unique_ptr<Operation>> ready;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto available = [this] { return !finished.empty(); };
+        if (block) {
+            completed.wait(lock, available);
+        } else {
+            // Ring completions are pending too, so only wait briefly
+            completed.wait_for(lock, std::chrono::milliseconds(1), available);
+        }
+        ready.swap(finished);
+    }
+    for (auto& operation : ready) {
+        blockingInFlight--;
+        complete(*operation);
+    }
+    return !ready.empty();
+}
+
+void IoExecutor::drain(size_t maxOutstanding) {
+    while (outstanding > maxOutstanding) {
+#ifdef COOKIEMONSTER_IO_URING
+        if (ring) {
+            while (!backlog.empty() && !ring->isFull()) {
+                ring->push(backlog.front().release());
+                backlog.pop_front();
+            }
+            ring->submit(blockingInFlight == 0 && ring->getInFlight() > 0);
+            ring->reap([this](Operation* raw, int result) {
+                std::unique_ptr<Operation> operation(raw);
+                if (result > 0) {
+                    // Not supported by this kernel
+                    outstanding--;
+                    start(std::move(operation));
+                    return;
+                }
+                if (result < 0) {
+                    operation->error = std::error_code(-result, std::system_category());
+                } else if (operation->kind == Operation::Kind::Stat) {
+                    const struct statx& st = operation->attributes;
+                    FileEntry& entry = operation->entry;
+                    entry.path = operation->path;
+                    entry.size = st.stx_size;
+                    entry.allocated = st.stx_blocks * 512;
+                    entry.links = st.stx_nlink;
+                    entry.device = makedev(st.stx_dev_major, st.stx_dev_minor);
+                    entry.inode = st.stx_ino;
+                    entry.mtime = static_cast<int64_t>(st.stx_mtime.tv_sec) * 1000000000 + st.stx_mtime.tv_nsec;
+                }
+                complete(*operation);
+            });
+            if (blockingInFlight > 0) reapBlocking(ring->getInFlight() == 0);
+            continue;
+        }
+#endif
+        reapBlocking(true);
+    }
+}
@@ -0,0 +1,163 @@
+#include "IoThrottle.h"
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Burst allowance expressed as seconds worth of tokens
+    constexpr double kBurstSeconds = 0.1;
+    // Adaptive mode never throttles below this fraction of the configured rate
+    constexpr double kMinScale = 0.05;
+    constexpr double kDecreaseFactor = 0.7;
+    constexpr double kIncreaseStep = 0.02;
+    // Latency ratios (short-term / baseline) that trigger back-off and recovery
+    constexpr double kBackoffRatio = 2.0;
+    constexpr double kRecoverRatio = 1.25;
+    constexpr auto kMinAdjustInterval = std::chrono::milliseconds(100);
+
+#ifdef __linux__
+    constexpr int kIoprioClassShift = 13;
+    constexpr int kIoprioClassIdle = 3;
+    constexpr int kIoprioWhoProcess = 1;
+#endif
+}
+
+IoThrottle::IoThrottle()
+    : maxOps(0), maxBytes(0), adaptive(false), scale(1.0),
+      fastLatency(0.0), baseLatency(0.0), lastRefill(Clock::now()), lastAdjust() {}
+
+void IoThrottle::setMaxOpsPerSecond(uint64_t ops) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxOps = ops;
+    opsBucket.rate = static_cast<double>(ops);
+    opsBucket.tokens = 0.0;
+}
+
+void IoThrottle::setMaxBytesPerSecond(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxBytes = bytes;
+    bytesBucket.rate = static_cast<double>(bytes);
+    bytesBucket.tokens = 0.0;
+}
+
+void IoThrottle::setAdaptive(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    adaptive = enable;
+    scale = 1.0;
+}
+
+uint64_t IoThrottle::getMaxOpsPerSecond() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxOps;
+}
+
+uint64_t IoThrottle::getMaxBytesPerSecond() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxBytes;
+}
+
+bool IoThrottle::isAdaptive() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return adaptive;
+}
+
+bool IoThrottle::isEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxOps > 0 || maxBytes > 0 || adaptive;
+}
+
+double IoThrottle::getRateScale() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return scale;
+}
+
+void IoThrottle::refill(Bucket& bucket, double elapsedSeconds) const {
+    if (bucket.rate <= 0.0) return;
+    double rate = bucket.rate * scale;
+    double capacity = std::max(rate * kBurstSeconds, 1.0);
+    bucket.tokens = std::min(capacity, bucket.tokens + elapsedSeconds * rate);
+}
+
+double IoThrottle::reserve(Bucket& bucket, double cost) const {
+    if (bucket.rate <= 0.0) return 0.0;
+    // Tokens may go negative: the debt is paid off by sleeping, which keeps
+    // concurrent callers correctly serialized without holding the lock.
+    bucket.tokens -= cost;
+    if (bucket.tokens >= 0.0) return 0.0;
+    return -bucket.tokens / (bucket.rate * scale);
+}
+
+void IoThrottle::acquire(uint64_t bytes) {
+    double waitSeconds = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (maxOps == 0 && maxBytes == 0 && !adaptive) return;
+
+        auto now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+        lastRefill = now;
+
+        refill(opsBucket, elapsed);
+        refill(bytesBucket, elapsed);
+        waitSeconds = std::max(reserve(opsBucket, 1.0), reserve(bytesBucket, static_cast<double>(bytes)));
+
+        // Without explicit limits adaptive mode paces by duty cycle: at scale s
+        // each operation is followed by a pause of baseline * (1/s - 1).
+        if (adaptive && maxOps == 0 && maxBytes == 0 && scale < 1.0) {
+            waitSeconds = std::max(waitSeconds, baseLatency * (1.0 / scale - 1.0));
+        }
+    }
+
+    if (waitSeconds > 0.0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(waitSeconds));
+    }
+}
+
+void IoThrottle::recordLatency(std::chrono::nanoseconds latency) {
+    double sample = std::chrono::duration<double>(latency).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fastLatency == 0.0) {
+        fastLatency = baseLatency = sample;
+        return;
+    }
+
+    fastLatency = 0.8 * fastLatency + 0.2 * sample;
+    // The baseline follows improvements quickly but degradations slowly, so a
+    // sustained spike stands out against it.
+    if (sample < baseLatency) {
+        baseLatency = 0.9 * baseLatency + 0.1 * sample;
+    } else {
+        baseLatency = 0.995 * baseLatency + 0.005 * sample;
+    }
+
+    if (!adaptive || baseLatency <= 0.0) return;
+
+    double ratio = fastLatency / baseLatency;
+    auto now = Clock::now();
+    if (ratio > kBackoffRatio) {
+        if (now - lastAdjust >= kMinAdjustInterval) {
+            scale = std::max(kMinScale, scale * kDecreaseFactor);
+            lastAdjust = now;
+        }
+    } else if (ratio < kRecoverRatio) {
+        scale = std::min(1.0, scale + kIncreaseStep);
+    }
+}
+
+bool applyIdleIoPriority() {
+#ifdef _WIN32
+    return SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN) != FALSE;
+#elif defined(__linux__)
+    int prio = kIoprioClassIdle << kIoprioClassShift;
+    return syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, prio) == 0;
+#else
+    return false;
+#endif
+}
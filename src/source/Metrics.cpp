@@ -0,0 +1,261 @@
+#include "Metrics.h"
+#include "BinaryIO.h"
+#include "TextUtil.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace {
+    // Exported Prometheus buckets: powers of two from ~1 us to ~34 s. They
+    // coincide with histogram bucket edges, so no recording is split.
+    constexpr unsigned kFirstExportedBit = 10;
+    constexpr unsigned kLastExportedBit = 35;
+
+    constexpr const char* kLatencyMetric = "cookiemonster_operation_duration_seconds";
+
+    unsigned highestBit(uint64_t value) {
+        unsigned bit = 0;
+        while (value >>= 1) bit++;
+        return bit;
+    }
+
+    std::string escapeLabel(const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '\\' || c == '"') escaped += '\\';
+            if (c == '\n') {
+                escaped += "\\n";
+                continue;
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    std::string formatLabels(const MetricLabels& labels) {
+        std::string text;
+        for (const auto& [name, value] : labels) {
+            text += (text.empty() ? "" : ",") + name + "=\"" + escapeLabel(value) + "\"";
+        }
+        return text;
+    }
+
+    std::string seconds(uint64_t nanoseconds) {
+        std::ostringstream out;
+        out << static_cast<double>(nanoseconds) / 1e9;
+        return out.str();
+    }
+
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t nanoseconds) {
+    if (nanoseconds < kSubBuckets) return static_cast<size_t>(nanoseconds);
+    unsigned shift = highestBit(nanoseconds) - kSubBucketBits;
+    size_t sub = static_cast<size_t>(nanoseconds >> shift) - kSubBuckets;
+    return kSubBuckets + shift * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketEnd(size_t bucket) {
+    if (bucket < kSubBuckets) return bucket + 1;
+    unsigned shift = static_cast<unsigned>((bucket - kSubBuckets) / kSubBuckets);
+    uint64_t next = kSubBuckets + (bucket - kSubBuckets) % kSubBuckets + 1;
+    if (next > (std::numeric_limits<uint64_t>::max() >> shift)) return std::numeric_limits<uint64_t>::max();
+    return next << shift;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (nanoseconds > current && !max.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::getQuantile(double quantile) const {
+    // Buckets rather than the count, which may run ahead while recording
+    uint64_t total = 0;
+    for (const auto& bucket : buckets) total += bucket.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+
+    quantile = std::clamp(quantile, 0.0, 1.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucketEnd(i) - 1, getMax());
+    }
+    return getMax();
+}
+
+uint64_t LatencyHistogram::countBelow(uint64_t nanoseconds) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBuckets && bucketEnd(i) <= nanoseconds; ++i) {
+        total += buckets[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+const char* metricOperationName(MetricOperation operation) {
+    switch (operation) {
+        case MetricOperation::ReadDirectory: return "readdir";
+        case MetricOperation::Stat: return "stat";
+        case MetricOperation::Unlink: return "unlink";
+        case MetricOperation::Copy: return "copy";
+        case MetricOperation::Registry: return "registry";
+        case MetricOperation::Overwrite: return "overwrite";
+        case MetricOperation::Count: break;
+    }
+    return "unknown";
+}
+
+Metrics& Metrics::getInstance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+uint64_t Metrics::start() const {
+    if (!isEnabled()) return 0;
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::max<uint64_t>(1, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()));
+}
+
+void Metrics::finish(MetricOperation operation, uint64_t started) {
+    if (started == 0) return;
+    uint64_t now = start();
+    if (now == 0) return;
+    getHistogram(operation).record(now > started ? now - started : 0);
+}
+
+void Metrics::record(MetricOperation operation, std::chrono::nanoseconds latency) {
+    if (!isEnabled()) return;
+    getHistogram(operation).record(static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0)));
+}
+
+void Metrics::addCounter(const std::string& name, const MetricLabels& labels, uint64_t value) {
+    std::lock_guard<std::mutex> lock(counterMutex);
+    counters[{name, labels}] += value;
+}
+
+uint64_t Metrics::getCounter(const std::string& name, const MetricLabels& labels) const {
+    std::lock_guard<std::mutex> lock(counterMutex);
+    auto it = counters.find({name, labels});
+    return it == counters.end() ? 0 : it->second;
+}
+
+std::string Metrics::toPrometheus() const {
+    std::ostringstream out;
+    out << "# HELP " << kLatencyMetric << " Latency of file system and registry operations\n"
+        << "# TYPE " << kLatencyMetric << " histogram\n";
+    for (size_t i = 0; i < histograms.size(); ++i) {
+        const LatencyHistogram& histogram = histograms[i];
+        std::string label = std::string("operation=\"") + metricOperationName(static_cast<MetricOperation>(i)) + "\"";
+        for (unsigned bit = kFirstExportedBit; bit <= kLastExportedBit; ++bit) {
+            uint64_t bound = uint64_t(1) << bit;
+            out << kLatencyMetric << "_bucket{" << label << ",le=\"" << seconds(bound) << "\"} "
+                << histogram.countBelow(bound) << "\n";
+        }
+        out << kLatencyMetric << "_bucket{" << label << ",le=\"+Inf\"} " << histogram.getCount() << "\n"
+            << kLatencyMetric << "_sum{" << label << "} " << seconds(histogram.getSum()) << "\n"
+            << kLatencyMetric << "_count{" << label << "} " << histogram.getCount() << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(counterMutex);
+    const std::string* previous = nullptr;
+    for (const auto& [key, value] : counters) {
+        // Keys are sorted by name, so each family is contiguous
+        if (!previous || *previous != key.first) {
+            out << "# TYPE " << key.first << " counter\n";
+            previous = &key.first;
+        }
+        out << key.first;
+        if (!key.second.empty()) out << "{" << formatLabels(key.second) << "}";
+        out << " " << value << "\n";
+    }
+    return out.str();
+}
+
+std::string Metrics::toJson() const {
+    std::ostringstream out;
+    out << "{\"operations\":{";
+    for (size_t i = 0; i < histograms.size(); ++i) {
+        const LatencyHistogram& histogram = histograms[i];
+        out << (i ? "," : "") << "\"" << metricOperationName(static_cast<MetricOperation>(i)) << "\":{"
+            << "\"count\":" << histogram.getCount()
+            << ",\"sum_ns\":" << histogram.getSum()
+            << ",\"max_ns\":" << histogram.getMax()
+            << ",\"p50_ns\":" << histogram.getQuantile(0.5)
+            << ",\"p90_ns\":" << histogram.getQuantile(0.9)
+            << ",\"p99_ns\":" << histogram.getQuantile(0.99)
+            << ",\"p999_ns\":" << histogram.getQuantile(0.999) << "}";
+    }
+    out << "},\"counters\":[";
+
+    std::lock_guard<std::mutex> lock(counterMutex);
+    bool first = true;
+    for (const auto& [key, value] : counters) {
+        out << (first ? "" : ",") << "{\"name\":\"" << escapeJson(key.first) << "\",\"labels\":{";
+        for (size_t i = 0; i < key.second.size(); ++i) {
+            out << (i ? "," : "") << "\"" << escapeJson(key.second[i].first) << "\":\""
+                << escapeJson(key.second[i].second) << "\"";
+        }
+        out << "},\"value\":" << value << "}";
+        first = false;
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+bool Metrics::write(const std::string& prometheusPath, const std::string& jsonPath) const {
+    // Replaced atomically so the node exporter never reads a partial file
+    bool written = true;
+    if (!prometheusPath.empty()) written = writeFileAtomically(prometheusPath, toPrometheus()) && written;
+    if (!jsonPath.empty()) written = writeFileAtomically(jsonPath, toJson()) && written;
+    return written;
+}
+
+void Metrics::reset() {
+    for (auto& histogram : histograms) histogram.reset();
+    std::lock_guard<std::mutex> lock(counterMutex);
+    counters.clear();
+}
+
+MetricsReporter::MetricsReporter(std::string prometheusPath, std::string jsonPath,
+                                 std::chrono::milliseconds interval)
+    : prometheusPath(std::move(prometheusPath)), jsonPath(std::move(jsonPath)),
+      interval(std::max(interval, std::chrono::milliseconds(1))),
+      thread(&MetricsReporter::run, this) {}
+
+MetricsReporter::~MetricsReporter() {
+    stop();
+}
+
+void MetricsReporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+    Metrics::getInstance().write(prometheusPath, jsonPath);
+    reports++;
+}
+
+void MetricsReporter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+        lock.unlock();
+        Metrics::getInstance().write(prometheusPath, jsonPath);
+        reports++;
+        lock.lock();
+    }
+}
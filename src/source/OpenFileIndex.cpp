@@ -0,0 +1,69 @@
+#include "OpenFileIndex.h"
+#include <cctype>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+#ifdef __linux__
+    bool isPid(const char* name) {
+        if (!*name) return false;
+        for (; *name; ++name) {
+            if (!std::isdigit(static_cast<unsigned char>(*name))) return false;
+        }
+        return true;
+    }
+
+    // Plain readdir: this runs over thousands of entries and must not throw
+    template <typename Callback>
+    void listDirectory(const std::string& path, Callback callback) {
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return;
+        while (struct dirent* entry = readdir(dir)) {
+            callback(entry->d_name);
+        }
+        closedir(dir);
+    }
+#endif
+}
+
+size_t OpenFileIndex::build() {
+    files.clear();
+#ifdef __linux__
+    listDirectory("/proc", [this](const char* pid) {
+        if (!isPid(pid)) return;
+        std::string fdDir = std::string("/proc/") + pid + "/fd/";
+        listDirectory(fdDir, [this, &fdDir](const char* fd) {
+            if (fd[0] == '.') return;
+            // stat follows the magic link to the open file itself
+            struct stat st;
+            if (stat((fdDir + fd).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return;
+            add(static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino));
+        });
+    });
+#endif
+    return files.size();
+}
+
+void OpenFileIndex::add(uint64_t device, uint64_t inode) {
+    files.emplace(device, inode);
+}
+
+bool OpenFileIndex::contains(const FileEntry& entry) const {
+    if (entry.inode == 0 || files.empty()) return false;
+    return files.count({entry.device, entry.inode}) != 0;
+}
+
+bool isFileInUseError(const std::error_code& error) {
+#ifdef _WIN32
+    if (error.category() == std::system_category() &&
+        (error.value() == ERROR_SHARING_VIOLATION || error.value() == ERROR_LOCK_VIOLATION)) {
+        return true;
+    }
+#endif
+    return error == std::errc::device_or_resource_busy || error == std::errc::text_file_busy;
+}
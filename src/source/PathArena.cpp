@@ -0,0 +1,111 @@
+#include "PathArena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    constexpr uint32_t kReplacement = 0xFFFD;
+
+    bool isScalarValue(uint32_t c) {
+        return c <= 0x10FFFF && (c < 0xD800 || c >= 0xE000);
+    }
+
+    void appendWide(std::wstring& out, uint32_t c) {
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (c >= 0x10000) {
+                c -= 0x10000;
+                out.push_back(static_cast<wchar_t>(0xD800 + (c >> 10)));
+                out.push_back(static_cast<wchar_t>(0xDC00 + (c & 0x3FF)));
+                return;
+            }
+        }
+        out.push_back(static_cast<wchar_t>(c));
+    }
+}
+
+PathArena::PathArena(size_t blockSize) : arena(blockSize) {}
+
+PathView PathArena::store(PathView text) {
+    using Char = PathView::value_type;
+    // Null-terminated so a view can also serve as a C string
+    auto* copy = static_cast<Char*>(arena.allocate((text.size() + 1) * sizeof(Char), alignof(Char)));
+    std::copy(text.begin(), text.end(), copy);
+    copy[text.size()] = Char();
+    bytesStored += text.size() * sizeof(Char);
+    return PathView(copy, text.size());
+}
+
+std::string toUtf8(const std::filesystem::path& path) {
+#ifdef _WIN32
+    auto utf8 = path.u8string();
+    return std::string(utf8.begin(), utf8.end());
+#else
+    return path.native();
+#endif
+}
+
+void appendUtf8(std::string& out, uint32_t c) {
+    if (c < 0x80) {
+        out.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+
+std::string wideToUtf8(const std::wstring& text) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        // wchar_t is signed on some platforms; negative values end up invalid
+        auto c = static_cast<uint32_t>(text[i]);
+        if constexpr (sizeof(wchar_t) == 2) {
+            c &= 0xFFFF;
+            if (c >= 0xD800 && c < 0xDC00 && i + 1 < text.size()) {
+                uint32_t low = static_cast<uint32_t>(text[i + 1]) & 0xFFFF;
+                if (low >= 0xDC00 && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+        }
+        appendUtf8(out, isScalarValue(c) ? c : kReplacement);
+    }
+    return out;
+}
+
+std::wstring utf8ToWide(const std::string& text) {
+    // Smallest code point of each sequence length, to reject overlong forms
+    static constexpr uint32_t kMinimum[5] = {0, 0, 0x80, 0x800, 0x10000};
+    std::wstring out;
+    out.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        auto lead = static_cast<unsigned char>(text[i]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        uint32_t c = length == 1 ? lead : lead & (0x7F >> length);
+        bool valid = length > 0 && i + length <= text.size();
+        for (size_t k = 1; valid && k < length; ++k) {
+            auto next = static_cast<unsigned char>(text[i + k]);
+            valid = (next & 0xC0) == 0x80;
+            c = (c << 6) | (next & 0x3F);
+        }
+        if (!valid || c < kMinimum[length] || !isScalarValue(c)) {
+            out.push_back(static_cast<wchar_t>(kReplacement));
+            ++i;
+            continue;
+        }
+        appendWide(out, c);
+        i += length;
+    }
+    return out;
+}
@@ -0,0 +1,561 @@
+#include "ProfileDiscovery.h"
+#include "Logger.h"
+#include "PathArena.h"
+#include "TextUtil.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <shlobj.h>
+#else
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    enum class DataBase { Config, Cache, Home };
+
+    // Where a browser keeps its profile list and its caches
+    struct BrowserLayout {
+        const char* name;
+        BrowserFamily family;
+        DataBase dataBase;          ///< Base the data directory is relative to
+        const char* dataDir;        ///< Holds Local State or profiles.ini
+        const char* cacheDir;       ///< Relative to UserDirectories::cacheDir
+        bool singleProfile;         ///< The cache directory is the profile itself
+    };
+
+#ifdef _WIN32
+    const BrowserLayout kBrowsers[] = {
+        {"Google Chrome", BrowserFamily::Chromium, DataBase::Cache, "Google/Chrome/User Data", "Google/Chrome/User Data", false},
+        {"Microsoft Edge", BrowserFamily::Chromium, DataBase::Cache, "Microsoft/Edge/User Data", "Microsoft/Edge/User Data", false},
+        {"Chromium", BrowserFamily::Chromium, DataBase::Cache, "Chromium/User Data", "Chromium/User Data", false},
+        {"Brave", BrowserFamily::Chromium, DataBase::Cache, "BraveSoftware/Brave-Browser/User Data", "BraveSoftware/Brave-Browser/User Data", false},
+        {"Vivaldi", BrowserFamily::Chromium, DataBase::Cache, "Vivaldi/User Data", "Vivaldi/User Data", false},
+        {"Opera", BrowserFamily::Chromium, DataBase::Config, "Opera Software/Opera Stable", "Opera Software/Opera Stable", true},
+        {"Mozilla Firefox", BrowserFamily::Firefox, DataBase::Config, "Mozilla/Firefox", "Mozilla/Firefox", false},
+    };
+#else
+    const BrowserLayout kBrowsers[] = {
+        {"Google Chrome", BrowserFamily::Chromium, DataBase::Config, "google-chrome", "google-chrome", false},
+        {"Microsoft Edge", BrowserFamily::Chromium, DataBase::Config, "microsoft-edge", "microsoft-edge", false},
+        {"Chromium", BrowserFamily::Chromium, DataBase::Config, "chromium", "chromium", false},
+        {"Brave", BrowserFamily::Chromium, DataBase::Config, "BraveSoftware/Brave-Browser", "BraveSoftware/Brave-Browser", false},
+        {"Vivaldi", BrowserFamily::Chromium, DataBase::Config, "vivaldi", "vivaldi", false},
+        {"Opera", BrowserFamily::Chromium, DataBase::Config, "opera", "opera", true},
+        {"Mozilla Firefox", BrowserFamily::Firefox, DataBase::Home, ".mozilla/firefox", "mozilla/firefox", false},
+    };
+#endif
+
+    const char* const kChromiumCaches[] = {"Cache", "Code Cache", "GPUCache"};
+    constexpr int kMaxJsonDepth = 64;
+
+    bool isDirectory(const std::filesystem::path& path) {
+        std::error_code ec;
+        return std::filesystem::is_directory(path, ec);
+    }
+
+    // A real directory, not a link to one; on POSIX also owned by the given user
+    bool isOwnDirectory(const std::filesystem::path& path, uint64_t owner, bool checkOwner) {
+#ifdef _WIN32
+        (void)owner;
+        (void)checkOwner;
+        // Junctions are not directories to symlink_status either
+        std::error_code ec;
+        return std::filesystem::symlink_status(path, ec).type() == std::filesystem::file_type::directory;
+#else
+        struct stat info;
+        if (::lstat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) return false;
+        return !checkOwner || static_cast<uint64_t>(info.st_uid) == owner;
+#endif
+    }
+
+    // Another account's cache directory has to be reachable from its home
+    // without a link and belong to the account, or the account could point a
+    // cleaner running as root at anyone's files
+    bool isVouchedFor(const UserDirectories& user, const std::filesystem::path& dir) {
+        if (!user.confined) return true;
+        std::filesystem::path home = user.home.lexically_normal();
+        if (!home.has_filename()) home = home.parent_path();
+        std::vector<std::filesystem::path> components;
+        for (const auto& component : dir.lexically_normal().lexically_relative(home)) {
+            if (component == "." || component == "..") return false;
+            if (!component.empty()) components.push_back(component);
+        }
+        if (components.empty()) return false;
+
+        std::error_code ec;
+        std::filesystem::path current = std::filesystem::canonical(home, ec);
+        if (ec) return false;
+        for (size_t i = 0; i < components.size(); ++i) {
+            current /= components[i];
+            if (!isOwnDirectory(current, user.owner, i + 1 == components.size())) return false;
+        }
+        return true;
+    }
+
+    bool readFile(const std::filesystem::path& path, std::string& contents) {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) return false;
+        contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        return !stream.bad();
+    }
+
+    // A profile name becomes a path component, so it must stay one
+    bool isSafeComponent(const std::string& name) {
+        return !name.empty() && name != "." && name != ".." &&
+               name.find_first_of("/\\") == std::string::npos;
+    }
+
+    // Just enough JSON to walk down to one object and list its keys
+    class JsonCursor {
+    public:
+        explicit JsonCursor(const std::string& text) : text(text) {}
+
+        // Enter the object at the cursor and stop at the value of key
+        bool findMember(const std::string& key) {
+            if (!consume('{')) return false;
+            if (consume('}')) return false;
+            for (;;) {
+                std::string name;
+                if (!parseString(name) || !consume(':')) return false;
+                if (name == key) return true;
+                if (!skipValue(0) || !consume(',')) return false;
+            }
+        }
+
+        // List the keys of the object at the cursor
+        bool readKeys(std::vector<std::string>& keys) {
+            if (!consume('{')) return false;
+            if (consume('}')) return true;
+            for (;;) {
+                std::string name;
+                if (!parseString(name) || !consume(':') || !skipValue(0)) return false;
+                keys.push_back(std::move(name));
+                if (consume('}')) return true;
+                if (!consume(',')) return false;
+            }
+        }
+
+    private:
+        void skipWhitespace() {
+            while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' ||
+                                         text[pos] == '\n' || text[pos] == '\r')) {
+                ++pos;
+            }
+        }
+
+        bool consume(char c) {
+            skipWhitespace();
+            if (pos >= text.size() || text[pos] != c) return false;
+            ++pos;
+            return true;
+        }
+
+        bool readHex(uint32_t& value) {
+            if (text.size() - pos < 4) return false;
+            value = 0;
+            for (int i = 0; i < 4; ++i) {
+                char c = text[pos++];
+                value <<= 4;
+                if (c >= '0' && c <= '9') value |= static_cast<uint32_t>(c - '0');
+                else if (c >= 'a' && c <= 'f') value |= static_cast<uint32_t>(c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F') value |= static_cast<uint32_t>(c - 'A' + 10);
+                else return false;
+            }
+            return true;
+        }
+
+        bool parseString(std::string& out) {
+            if (!consume('"')) return false;
+            while (pos < text.size()) {
+                char c = text[pos++];
+                if (c == '"') return true;
+                if (static_cast<unsigned char>(c) < 0x20) return false;
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (pos >= text.size()) return false;
+                switch (text[pos++]) {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u': {
+                        uint32_t code = 0;
+                        if (!readHex(code)) return false;
+                        if (code >= 0xD800 && code < 0xDC00) {
+                            // A high surrogate must be followed by its low half
+                            uint32_t low = 0;
+                            if (text.compare(pos, 2, "\\u") != 0) return false;
+                            pos += 2;
+                            if (!readHex(low) || low < 0xDC00 || low >= 0xE000) return false;
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        appendUtf8(out, code);
+                        break;
+                    }
+                    default: return false;
+                }
+            }
+            return false;
+        }
+
+        bool skipValue(int depth) {
+            if (depth > kMaxJsonDepth) return false;
+            skipWhitespace();
+            if (pos >= text.size()) return false;
+
+            char c = text[pos];
+            if (c == '"') {
+                std::string ignored;
+                return parseString(ignored);
+            }
+            if (c == '{') {
+                ++pos;
+                if (consume('}')) return true;
+                for (;;) {
+                    std::string ignored;
+                    if (!parseString(ignored) || !consume(':') || !skipValue(depth + 1)) return false;
+                    if (consume('}')) return true;
+                    if (!consume(',')) return false;
+                }
+            }
+            if (c == '[') {
+                ++pos;
+                if (consume(']')) return true;
+                for (;;) {
+                    if (!skipValue(depth + 1)) return false;
+                    if (consume(']')) return true;
+                    if (!consume(',')) return false;
+                }
+            }
+
+            // Numbers and the true/false/null literals
+            size_t start = pos;
+            while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) ||
+                                         text[pos] == '-' || text[pos] == '+' || text[pos] == '.')) {
+                ++pos;
+            }
+            return pos > start;
+        }
+
+        const std::string& text;
+        size_t pos = 0;
+    };
+
+    std::filesystem::path dataRoot(const UserDirectories& user, const BrowserLayout& layout) {
+        switch (layout.dataBase) {
+            case DataBase::Config: return user.configDir / layout.dataDir;
+            case DataBase::Cache: return user.cacheDir / layout.dataDir;
+            case DataBase::Home: break;
+        }
+        return user.home / layout.dataDir;
+    }
+
+    void addProfile(std::vector<BrowserProfile>& profiles, const UserDirectories& user,
+                    const BrowserLayout& layout, const std::string& profileName,
+                    const std::vector<std::filesystem::path>& candidates) {
+        BrowserProfile profile;
+        profile.browserName = layout.name;
+        profile.family = layout.family;
+        profile.user = user.user;
+        profile.profileName = profileName;
+        for (const auto& dir : candidates) {
+            if (!isDirectory(dir)) continue;
+            if (!isVouchedFor(user, dir)) {
+                Logger::getInstance().log(LogLevel::WARNING,
+                    "Skipping " + toUtf8(dir) + ": not a directory of " + user.user + " inside its home");
+                continue;
+            }
+            profile.cacheDirs.push_back(dir);
+        }
+        if (!profile.cacheDirs.empty()) profiles.push_back(std::move(profile));
+    }
+
+    std::vector<std::filesystem::path> chromiumCaches(const std::filesystem::path& profileDir) {
+        std::vector<std::filesystem::path> dirs;
+        for (const char* name : kChromiumCaches) {
+            dirs.push_back(profileDir / name);
+        }
+        return dirs;
+    }
+
+    // Profile directories Chromium creates, for installs without a usable Local State
+    std::vector<std::string> listChromiumProfiles(const std::vector<std::filesystem::path>& roots) {
+        std::set<std::string> names;
+        for (const auto& root : roots) {
+            std::error_code ec;
+            for (std::filesystem::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+                std::string name = toUtf8(it->path().filename());
+                if ((name == "Default" || name.rfind("Profile ", 0) == 0) && isDirectory(it->path())) {
+                    names.insert(name);
+                }
+            }
+        }
+        return std::vector<std::string>(names.begin(), names.end());
+    }
+
+    void discoverChromium(const UserDirectories& user, const BrowserLayout& layout,
+                          std::vector<BrowserProfile>& profiles) {
+        const std::filesystem::path data = dataRoot(user, layout);
+        const std::filesystem::path cache = user.cacheDir / layout.cacheDir;
+        if (layout.singleProfile) {
+            addProfile(profiles, user, layout, "", chromiumCaches(cache));
+            return;
+        }
+
+        std::string localState;
+        std::vector<std::string> names;
+        if (readFile(data / "Local State", localState)) names = parseLocalStateProfiles(localState);
+        if (names.empty()) names = listChromiumProfiles({data, cache});
+
+        for (const auto& name : names) {
+            addProfile(profiles, user, layout, name, chromiumCaches(cache / std::filesystem::u8path(name)));
+        }
+    }
+
+    void discoverFirefox(const UserDirectories& user, const BrowserLayout& layout,
+                         std::vector<BrowserProfile>& profiles) {
+        const std::filesystem::path data = dataRoot(user, layout);
+        const std::filesystem::path cache = user.cacheDir / layout.cacheDir;
+
+        std::string ini;
+        std::vector<FirefoxProfileEntry> entries;
+        if (readFile(data / "profiles.ini", ini)) entries = parseProfilesIni(ini);
+
+        if (!entries.empty()) {
+            for (const auto& entry : entries) {
+                std::filesystem::path path = std::filesystem::u8path(entry.path);
+                // The local (cache) twin of a relative profile mirrors its path
+                std::filesystem::path profileDir = entry.relative ? cache / path : path;
+                addProfile(profiles, user, layout, toUtf8(path.filename()), {profileDir / "cache2"});
+            }
+            return;
+        }
+
+        // Without profiles.ini every directory with a cache2 child is a profile
+        for (const auto& root : {cache, cache / "Profiles"}) {
+            std::error_code ec;
+            std::set<std::filesystem::path> dirs;
+            for (std::filesystem::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+                dirs.insert(it->path());
+            }
+            for (const auto& dir : dirs) {
+                addProfile(profiles, user, layout, toUtf8(dir.filename()), {dir / "cache2"});
+            }
+        }
+    }
+
+#ifndef _WIN32
+    std::filesystem::path environmentPath(const char* name) {
+        const char* value = std::getenv(name);
+        return value && *value ? std::filesystem::path(value) : std::filesystem::path();
+    }
+#endif
+}
+
+std::vector<std::string> supportedBrowsers() {
+    std::vector<std::string> names;
+    for (const auto& layout : kBrowsers) {
+        names.push_back(layout.name);
+    }
+    return names;
+}
+
+BrowserFamily browserFamily(const std::string& browserName) {
+    for (const auto& layout : kBrowsers) {
+        if (browserName == layout.name) return layout.family;
+    }
+    return BrowserFamily::Chromium;
+}
+
+UserDirectories userDirectoriesForHome(const std::filesystem::path& home, const std::string& user) {
+    UserDirectories dirs;
+    dirs.user = user;
+    dirs.home = home;
+#ifdef _WIN32
+    dirs.configDir = home / "AppData" / "Roaming";
+    dirs.cacheDir = home / "AppData" / "Local";
+#else
+    dirs.configDir = home / ".config";
+    dirs.cacheDir = home / ".cache";
+#endif
+    return dirs;
+}
+
+std::vector<UserDirectories> findUserDirectories(bool allUsers) {
+    std::vector<UserDirectories> users;
+    std::set<std::filesystem::path> seen;
+
+#ifdef _WIN32
+    wchar_t profile[MAX_PATH];
+    wchar_t roaming[MAX_PATH];
+    wchar_t local[MAX_PATH];
+    if (SUCCEEDED(SHGetFolderPathW(nullptr, CSIDL_PROFILE, nullptr, 0, profile)) &&
+        SUCCEEDED(SHGetFolderPathW(nullptr, CSIDL_APPDATA, nullptr, 0, roaming)) &&
+        SUCCEEDED(SHGetFolderPathW(nullptr, CSIDL_LOCAL_APPDATA, nullptr, 0, local))) {
+        UserDirectories current;
+        current.home = profile;
+        current.user = toUtf8(current.home.filename());
+        current.configDir = roaming;
+        current.cacheDir = local;
+        seen.insert(current.home.lexically_normal());
+        users.push_back(std::move(current));
+    }
+    if (!allUsers || users.empty()) return users;
+
+    // Every other profile folder next to ours, minus the built-in templates
+    const std::set<std::string> builtIn = {"Public", "Default", "Default User", "All Users"};
+    std::vector<UserDirectories> homes;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(users.front().home.parent_path(), ec), end;
+         !ec && it != end; it.increment(ec)) {
+        std::string user = toUtf8(it->path().filename());
+        if (builtIn.count(user) == 0) homes.push_back(userDirectoriesForHome(it->path(), user));
+    }
+#else
+    std::filesystem::path home = environmentPath("HOME");
+    std::string name;
+    if (struct passwd* entry = getpwuid(getuid())) {
+        if (home.empty()) home = entry->pw_dir;
+        name = entry->pw_name;
+    }
+    if (!home.empty()) {
+        UserDirectories current = userDirectoriesForHome(home, name);
+        std::filesystem::path config = environmentPath("XDG_CONFIG_HOME");
+        std::filesystem::path cache = environmentPath("XDG_CACHE_HOME");
+        if (!config.empty()) current.configDir = config;
+        if (!cache.empty()) current.cacheDir = cache;
+        seen.insert(current.home.lexically_normal());
+        users.push_back(std::move(current));
+    }
+    if (!allUsers) return users;
+
+    // Regular accounts and root from passwd, plus /home for directory-service accounts
+    std::vector<UserDirectories> homes;
+    setpwent();
+    while (struct passwd* entry = getpwent()) {
+        if (entry->pw_uid == 0 || (entry->pw_uid >= 1000 && entry->pw_uid != 65534)) {
+            homes.push_back(userDirectoriesForHome(entry->pw_dir, entry->pw_name));
+            homes.back().owner = entry->pw_uid;
+        }
+    }
+    endpwent();
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it("/home", ec), end; !ec && it != end; it.increment(ec)) {
+        std::string user = toUtf8(it->path().filename());
+        struct stat info;
+        if (struct passwd* entry = getpwnam(user.c_str())) {
+            homes.push_back(userDirectoriesForHome(it->path(), user));
+            homes.back().owner = entry->pw_uid;
+        } else if (::lstat(it->path().c_str(), &info) == 0) {
+            // Unknown to NSS, so the home vouches for its owner
+            homes.push_back(userDirectoriesForHome(it->path(), user));
+            homes.back().owner = info.st_uid;
+        }
+    }
+#endif
+
+    for (auto& dirs : homes) {
+        if (!isDirectory(dirs.home) || !seen.insert(dirs.home.lexically_normal()).second) continue;
+        dirs.confined = true;
+        users.push_back(std::move(dirs));
+    }
+    return users;
+}
+
+std::vector<BrowserProfile> discoverProfiles(const UserDirectories& user) {
+    std::vector<BrowserProfile> profiles;
+    for (const auto& layout : kBrowsers) {
+        if (layout.family == BrowserFamily::Firefox) {
+            discoverFirefox(user, layout, profiles);
+        } else {
+            discoverChromium(user, layout, profiles);
+        }
+    }
+    return profiles;
+}
+
+std::vector<BrowserProfile> discoverProfiles(const std::vector<UserDirectories>& users) {
+    std::vector<std::vector<BrowserProfile>> perUser(users.size());
+    {
+        // Each user is a handful of stats and small reads; homes may sit on slow network shares
+        WorkerPool pool(std::max<size_t>(std::min<size_t>(users.size(), std::thread::hardware_concurrency()), 1));
+        for (size_t i = 0; i < users.size(); ++i) {
+            pool.submit([&users, &perUser, i] { perUser[i] = discoverProfiles(users[i]); });
+        }
+        pool.wait();
+    }
+
+    std::vector<BrowserProfile> profiles;
+    for (auto& list : perUser) {
+        std::move(list.begin(), list.end(), std::back_inserter(profiles));
+    }
+    return profiles;
+}
+
+std::vector<std::string> parseLocalStateProfiles(const std::string& json) {
+    std::vector<std::string> keys;
+    JsonCursor cursor(json);
+    if (!cursor.findMember("profile") || !cursor.findMember("info_cache") || !cursor.readKeys(keys)) {
+        return {};
+    }
+    keys.erase(std::remove_if(keys.begin(), keys.end(),
+        [](const std::string& key) { return !isSafeComponent(key); }), keys.end());
+    return keys;
+}
+
+std::vector<FirefoxProfileEntry> parseProfilesIni(const std::string& text) {
+    std::vector<FirefoxProfileEntry> entries;
+    std::istringstream stream(text);
+    std::string line;
+    bool inProfile = false;
+    FirefoxProfileEntry current;
+
+    auto finish = [&] {
+        if (!inProfile || current.path.empty()) return;
+        // Relative paths must stay below the Firefox directory
+        std::filesystem::path path(current.path);
+        bool escapes = std::any_of(path.begin(), path.end(),
+            [](const std::filesystem::path& part) { return part == ".."; });
+        if (!current.relative || !escapes) entries.push_back(current);
+    };
+
+    while (std::getline(stream, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == ';' || line[0] == '#') continue;
+        if (line.front() == '[' && line.back() == ']') {
+            finish();
+            inProfile = line.compare(1, 7, "Profile") == 0;
+            current = FirefoxProfileEntry();
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (!inProfile || equals == std::string::npos) continue;
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        if (key == "Path") {
+            current.path = value;
+        } else if (key == "IsRelative") {
+            current.relative = value != "0";
+        }
+    }
+    finish();
+    return entries;
+}
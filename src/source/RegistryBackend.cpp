@@ -0,0 +1,254 @@
+#include "RegistryBackend.h"
+#include <algorithm>
+#include <cwctype>
+#include <map>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+    // Registry names compare case-insensitively
+    bool sameName(const std::wstring& a, const std::wstring& b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+            [](wchar_t x, wchar_t y) { return std::towlower(x) == std::towlower(y); });
+    }
+
+    struct NameLess {
+        bool operator()(const std::wstring& a, const std::wstring& b) const {
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+                [](wchar_t x, wchar_t y) { return std::towlower(x) < std::towlower(y); });
+        }
+    };
+
+    std::vector<std::wstring> splitPath(const std::wstring& path) {
+        std::vector<std::wstring> parts;
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = path.find(L'\\', start);
+            if (end == std::wstring::npos) end = path.size();
+            if (end > start) parts.push_back(path.substr(start, end - start));
+            start = end + 1;
+        }
+        return parts;
+    }
+}
+
+struct MemoryRegistry::Node {
+    std::map<std::wstring, std::shared_ptr<Node>, NameLess> subKeys;
+    std::vector<RegistryValue> values;
+    bool deleted = false;
+
+    void markDeleted() {
+        deleted = true;
+        for (auto& [name, child] : subKeys) child->markDeleted();
+        subKeys.clear();
+        values.clear();
+    }
+};
+
+namespace {
+    using Node = MemoryRegistry::Node;
+
+    std::shared_ptr<Node> walk(std::shared_ptr<Node> node, const std::wstring& path, bool create) {
+        for (const auto& part : splitPath(path)) {
+            auto it = node->subKeys.find(part);
+            if (it == node->subKeys.end()) {
+                if (!create) return nullptr;
+                it = node->subKeys.emplace(part, std::make_shared<Node>()).first;
+            }
+            node = it->second;
+        }
+        return node;
+    }
+}
+
+class MemoryRegistryKey : public RegistryKey {
+public:
+    MemoryRegistryKey(MemoryRegistry& owner, std::shared_ptr<Node> node)
+        : owner(owner), node(std::move(node)) {}
+
+    bool listValues(std::vector<RegistryValue>& values, bool withData) const override {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        owner.calls++;
+        if (node->deleted) return false;
+        for (const auto& value : node->values) {
+            values.push_back(value);
+            if (!withData) values.back().data.clear();
+        }
+        return true;
+    }
+
+    bool listSubKeys(std::vector<std::wstring>& names) const override {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        owner.calls++;
+        if (node->deleted) return false;
+        for (const auto& [name, child] : node->subKeys) names.push_back(name);
+        return true;
+    }
+
+    std::unique_ptr<RegistryKey> openSubKey(const std::wstring& path, RegistryAccess access) override {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        owner.calls++;
+        if (node->deleted) return nullptr;
+        auto child = walk(node, path, access == RegistryAccess::Create);
+        if (!child) return nullptr;
+        return std::make_unique<MemoryRegistryKey>(owner, child);
+    }
+
+    bool setValue(const RegistryValue& value) override {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        owner.calls++;
+        if (node->deleted) return false;
+        auto it = std::find_if(node->values.begin(), node->values.end(),
+            [&value](const RegistryValue& existing) { return sameName(existing.name, value.name); });
+        if (it != node->values.end()) {
+            it->type = value.type;
+            it->data = value.data;
+        } else {
+            node->values.push_back(value);
+        }
+        return true;
+    }
+
+    bool deleteValue(const std::wstring& name) override {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        owner.calls++;
+        auto it = std::find_if(node->values.begin(), node->values.end(),
+            [&name](const RegistryValue& existing) { return sameName(existing.name, name); });
+        if (it == node->values.end()) return false;
+        node->values.erase(it);
+        return true;
+    }
+
+    bool deleteTree(const std::wstring& name) override {
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        owner.calls++;
+        auto it = node->subKeys.find(name);
+        if (it == node->subKeys.end()) return false;
+        it->second->markDeleted();
+        node->subKeys.erase(it);
+        return true;
+    }
+
+private:
+    MemoryRegistry& owner;
+    std::shared_ptr<Node> node;
+};
+
+MemoryRegistry::MemoryRegistry()
+    : currentUser(std::make_shared<Node>()), localMachine(std::make_shared<Node>()), calls(0) {}
+
+std::unique_ptr<RegistryKey> MemoryRegistry::openKey(RegistryRoot root, const std::wstring& path,
+                                                     RegistryAccess access) {
+    std::lock_guard<std::mutex> lock(mutex);
+    calls++;
+    auto node = walk(root == RegistryRoot::CurrentUser ? currentUser : localMachine, path,
+                     access == RegistryAccess::Create);
+    if (!node) return nullptr;
+    return std::make_unique<MemoryRegistryKey>(*this, node);
+}
+
+uint64_t MemoryRegistry::getCallCount() const {
+    return calls.load();
+}
+
+#ifdef _WIN32
+namespace {
+    std::unique_ptr<RegistryKey> openWin32(HKEY parent, const std::wstring& path, RegistryAccess access);
+
+    class Win32RegistryKey : public RegistryKey {
+    public:
+        explicit Win32RegistryKey(HKEY handle) : handle(handle) {}
+        ~Win32RegistryKey() override { RegCloseKey(handle); }
+
+        bool listValues(std::vector<RegistryValue>& values, bool withData) const override {
+            // Buffers are sized once from the key's maximum name and data length
+            DWORD count = 0, maxName = 0, maxData = 0;
+            if (RegQueryInfoKeyW(handle, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                                 &count, &maxName, &maxData, nullptr, nullptr) != ERROR_SUCCESS) {
+                return false;
+            }
+            std::vector<wchar_t> name(maxName + 1);
+            std::vector<BYTE> data(withData ? maxData : 0);
+            values.reserve(values.size() + count);
+
+            for (DWORD i = 0; i < count; ++i) {
+                DWORD nameSize = static_cast<DWORD>(name.size());
+                DWORD dataSize = static_cast<DWORD>(data.size());
+                DWORD type = 0;
+                LONG result = RegEnumValueW(handle, i, name.data(), &nameSize, nullptr, &type,
+                                            withData ? data.data() : nullptr, withData ? &dataSize : nullptr);
+                if (result == ERROR_NO_MORE_ITEMS) break;
+                if (result != ERROR_SUCCESS) return false;
+
+                RegistryValue value;
+                value.name.assign(name.data(), nameSize);
+                value.type = type;
+                if (withData) value.data.assign(data.begin(), data.begin() + dataSize);
+                values.push_back(std::move(value));
+            }
+            return true;
+        }
+
+        bool listSubKeys(std::vector<std::wstring>& names) const override {
+            DWORD count = 0, maxName = 0;
+            if (RegQueryInfoKeyW(handle, nullptr, nullptr, nullptr, &count, &maxName, nullptr,
+                                 nullptr, nullptr, nullptr, nullptr, nullptr) != ERROR_SUCCESS) {
+                return false;
+            }
+            std::vector<wchar_t> name(maxName + 1);
+            names.reserve(names.size() + count);
+
+            for (DWORD i = 0; i < count; ++i) {
+                DWORD nameSize = static_cast<DWORD>(name.size());
+                LONG result = RegEnumKeyExW(handle, i, name.data(), &nameSize, nullptr, nullptr, nullptr, nullptr);
+                if (result == ERROR_NO_MORE_ITEMS) break;
+                if (result != ERROR_SUCCESS) return false;
+                names.emplace_back(name.data(), nameSize);
+            }
+            return true;
+        }
+
+        std::unique_ptr<RegistryKey> openSubKey(const std::wstring& path, RegistryAccess access) override {
+            return openWin32(handle, path, access);
+        }
+
+        bool setValue(const RegistryValue& value) override {
+            return RegSetValueExW(handle, value.name.c_str(), 0, value.type,
+                                  value.data.empty() ? nullptr : value.data.data(),
+                                  static_cast<DWORD>(value.data.size())) == ERROR_SUCCESS;
+        }
+
+        bool deleteValue(const std::wstring& name) override {
+            return RegDeleteValueW(handle, name.c_str()) == ERROR_SUCCESS;
+        }
+
+        bool deleteTree(const std::wstring& name) override {
+            return RegDeleteTreeW(handle, name.c_str()) == ERROR_SUCCESS;
+        }
+
+    private:
+        HKEY handle;
+    };
+
+    std::unique_ptr<RegistryKey> openWin32(HKEY parent, const std::wstring& path, RegistryAccess access) {
+        HKEY handle;
+        LONG result;
+        if (access == RegistryAccess::Create) {
+            result = RegCreateKeyExW(parent, path.c_str(), 0, nullptr, REG_OPTION_NON_VOLATILE,
+                                     KEY_ALL_ACCESS, nullptr, &handle, nullptr);
+        } else {
+            result = RegOpenKeyExW(parent, path.c_str(), 0,
+                                   access == RegistryAccess::Read ? KEY_READ : KEY_ALL_ACCESS, &handle);
+        }
+        if (result != ERROR_SUCCESS) return nullptr;
+        return std::make_unique<Win32RegistryKey>(handle);
+    }
+}
+
+std::unique_ptr<RegistryKey> Win32Registry::openKey(RegistryRoot root, const std::wstring& path,
+                                                    RegistryAccess access) {
+    return openWin32(root == RegistryRoot::CurrentUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE, path, access);
+}
+#endif
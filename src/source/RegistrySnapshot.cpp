@@ -0,0 +1,250 @@
+#include "RegistrySnapshot.h"
+#include "BinaryIO.h"
+#include "PathArena.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    constexpr char kMagic[8] = {'C', 'M', 'R', 'E', 'G', 'S', 'N', '\1'};
+
+    // Deepest key nesting the Win32 registry allows
+    constexpr size_t kMaxDepth = 512;
+
+    void appendName(std::string& out, const std::wstring& name) {
+        appendVarint(out, name.size());
+        for (wchar_t c : name) appendVarint(out, static_cast<uint64_t>(c));
+    }
+
+    bool readName(ByteReader& reader, std::wstring& name) {
+        uint64_t length;
+        if (!reader.readVarint(length) || length > reader.remaining()) return false;
+        name.clear();
+        name.reserve(static_cast<size_t>(length));
+        for (uint64_t i = 0; i < length; ++i) {
+            uint64_t c;
+            if (!reader.readVarint(c)) return false;
+            name.push_back(static_cast<wchar_t>(c));
+        }
+        return true;
+    }
+}
+
+bool RegistrySnapshot::capture(RegistryBackend& backend, RegistryRoot keyRoot, const std::wstring& keyPath) {
+    root = keyRoot;
+    path = keyPath;
+    tree = Node();
+    error.clear();
+
+    auto key = backend.openKey(root, path, RegistryAccess::Read);
+    if (!key) {
+        error = "Cannot open registry key " + wideToUtf8(path);
+        return false;
+    }
+    return captureKey(*key, tree, path);
+}
+
+bool RegistrySnapshot::captureKey(RegistryKey& key, Node& node, const std::wstring& keyPath) {
+    std::vector<std::wstring> subKeys;
+    if (!key.listValues(node.values, true) || !key.listSubKeys(subKeys)) {
+        error = "Cannot enumerate registry key " + wideToUtf8(keyPath);
+        return false;
+    }
+
+    node.children.reserve(subKeys.size());
+    for (const auto& name : subKeys) {
+        // Children are opened relative to the parent handle
+        auto child = key.openSubKey(name, RegistryAccess::Read);
+        std::wstring childPath = keyPath + L"\\" + name;
+        if (!child) {
+            error = "Cannot open registry key " + wideToUtf8(childPath);
+            return false;
+        }
+        node.children.push_back(Node());
+        node.children.back().name = name;
+        if (!captureKey(*child, node.children.back(), childPath)) return false;
+    }
+    return true;
+}
+
+bool RegistrySnapshot::restore(RegistryBackend& backend) {
+    error.clear();
+    auto key = backend.openKey(root, path, RegistryAccess::Create);
+    if (!key) {
+        error = "Cannot create registry key " + wideToUtf8(path);
+        return false;
+    }
+    return restoreKey(*key, tree, path);
+}
+
+bool RegistrySnapshot::restoreKey(RegistryKey& key, const Node& node, const std::wstring& keyPath) {
+    bool success = true;
+    for (const auto& value : node.values) {
+        if (!key.setValue(value)) {
+            error = "Cannot write registry value " + wideToUtf8(keyPath) + "\\" + wideToUtf8(value.name);
+            success = false;
+        }
+    }
+
+    for (const auto& childNode : node.children) {
+        std::wstring childPath = keyPath + L"\\" + childNode.name;
+        auto child = key.openSubKey(childNode.name, RegistryAccess::Create);
+        if (!child) {
+            error = "Cannot create registry key " + wideToUtf8(childPath);
+            success = false;
+            continue;
+        }
+        success = restoreKey(*child, childNode, childPath) && success;
+    }
+    return success;
+}
+
+bool RegistrySnapshot::save(const std::filesystem::path& file) const {
+    std::string body;
+    body.push_back(static_cast<char>(root == RegistryRoot::CurrentUser ? 0 : 1));
+    appendName(body, path);
+
+    // Pre-order walk with an explicit stack: name, values, child count
+    std::vector<const Node*> pending{&tree};
+    while (!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+
+        appendName(body, node->name);
+        appendVarint(body, node->values.size());
+        for (const auto& value : node->values) {
+            appendName(body, value.name);
+            appendVarint(body, value.type);
+            appendVarint(body, value.data.size());
+            body.append(reinterpret_cast<const char*>(value.data.data()), value.data.size());
+        }
+        appendVarint(body, node->children.size());
+        for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+            pending.push_back(&*it);
+        }
+    }
+    appendU32(body, crc32(body.data(), body.size()));
+
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write(kMagic, sizeof(kMagic));
+    out.write(body.data(), static_cast<std::streamsize>(body.size()));
+    return out.good();
+}
+
+bool RegistrySnapshot::load(const std::filesystem::path& file) {
+    error.clear();
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) {
+        error = "Cannot open snapshot " + toUtf8(file);
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (data.size() < sizeof(kMagic) + 4 || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+        error = "Not a registry snapshot: " + toUtf8(file);
+        return false;
+    }
+    size_t bodySize = data.size() - sizeof(kMagic) - 4;
+    uint32_t checksum;
+    ByteReader trailer(data.data(), data.size(), data.size() - 4);
+    trailer.readU32(checksum);
+    if (crc32(data.data() + sizeof(kMagic), bodySize) != checksum) {
+        error = "Registry snapshot is corrupt: " + toUtf8(file);
+        return false;
+    }
+
+    ByteReader reader(data.data(), data.size() - 4, sizeof(kMagic));
+    uint8_t rootByte;
+    std::wstring loadedPath;
+    Node loaded;
+    if (!reader.readByte(rootByte) || rootByte > 1 || !readName(reader, loadedPath)) {
+        error = "Invalid registry snapshot header: " + toUtf8(file);
+        return false;
+    }
+
+    // Mirror of the writer's pre-order walk; each entry is a node still
+    // expecting the given number of children
+    std::vector<std::pair<Node*, uint64_t>> open;
+    bool first = true;
+    while (first || !open.empty()) {
+        Node* node;
+        if (first) {
+            node = &loaded;
+            first = false;
+        } else {
+            auto& [parent, remaining] = open.back();
+            if (remaining == 0) {
+                open.pop_back();
+                continue;
+            }
+            remaining--;
+            parent->children.push_back(Node());
+            node = &parent->children.back();
+        }
+
+        uint64_t valueCount, childCount;
+        if (!readName(reader, node->name) || !reader.readVarint(valueCount) || valueCount > reader.remaining()) {
+            error = "Truncated registry snapshot: " + toUtf8(file);
+            return false;
+        }
+        for (uint64_t i = 0; i < valueCount; ++i) {
+            RegistryValue value;
+            uint64_t type, length;
+            std::string bytes;
+            if (!readName(reader, value.name) || !reader.readVarint(type) || !reader.readVarint(length) ||
+                !reader.readBytes(static_cast<size_t>(length), bytes)) {
+                error = "Truncated registry snapshot: " + toUtf8(file);
+                return false;
+            }
+            value.type = static_cast<uint32_t>(type);
+            value.data.assign(bytes.begin(), bytes.end());
+            node->values.push_back(std::move(value));
+        }
+        if (!reader.readVarint(childCount) || childCount > reader.remaining()) {
+            error = "Truncated registry snapshot: " + toUtf8(file);
+            return false;
+        }
+        if (childCount > 0) {
+            if (open.size() >= kMaxDepth) {
+                error = "Registry snapshot nests too deeply: " + toUtf8(file);
+                return false;
+            }
+            node->children.reserve(static_cast<size_t>(childCount));
+            open.emplace_back(node, childCount);
+        }
+    }
+
+    if (reader.remaining() != 0) {
+        error = "Trailing data in registry snapshot: " + toUtf8(file);
+        return false;
+    }
+    root = rootByte == 0 ? RegistryRoot::CurrentUser : RegistryRoot::LocalMachine;
+    path = std::move(loadedPath);
+    tree = std::move(loaded);
+    return true;
+}
+
+size_t RegistrySnapshot::getKeyCount() const {
+    size_t count = 0;
+    std::vector<const Node*> pending{&tree};
+    while (!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+        count++;
+        for (const auto& child : node->children) pending.push_back(&child);
+    }
+    return count;
+}
+
+size_t RegistrySnapshot::getValueCount() const {
+    size_t count = 0;
+    std::vector<const Node*> pending{&tree};
+    while (!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+        count += node->values.size();
+        for (const auto& child : node->children) pending.push_back(&child);
+    }
+    return count;
+}
@@ -0,0 +1,345 @@
+#include "RuleSet.h"
+#include "PathArena.h"
+#include "TextUtil.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#ifdef _WIN32
+#include <cwctype>
+#endif
+
+namespace {
+    using NativeString = std::filesystem::path::string_type;
+    using NativeChar = NativeString::value_type;
+
+    constexpr NativeChar kSeparator = std::filesystem::path::preferred_separator;
+
+    std::string lower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    std::vector<std::string> splitList(const std::string& text) {
+        std::vector<std::string> items;
+        std::istringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            item = lower(trim(item));
+            if (!item.empty() && item[0] == '.') item.erase(0, 1);
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    // Seconds from a number with an s, m, h or d suffix, days by default
+    bool parseAge(const std::string& text, int64_t& seconds) {
+        if (text.empty()) return false;
+        char last = text.back();
+        bool hasUnit = last < '0' || last > '9';
+        uint64_t value = 0;
+        if (!parseCount(hasUnit ? text.substr(0, text.size() - 1) : text, value)) return false;
+        uint64_t scale = 0;
+        switch (hasUnit ? last : 'd') {
+            case 's': scale = 1; break;
+            case 'm': scale = 60; break;
+            case 'h': scale = 3600; break;
+            case 'd': scale = 86400; break;
+            default: return false;
+        }
+        // Checked before scaling, signed overflow would be undefined
+        if (value > static_cast<uint64_t>(INT64_MAX) / scale) return false;
+        seconds = static_cast<int64_t>(value * scale);
+        return true;
+    }
+
+    std::string environment(const std::string& name) {
+        const char* value = std::getenv(name.c_str());
+        return value ? value : "";
+    }
+
+    // Leading "~" and every ${VAR}
+    std::string expandRoot(const std::string& text) {
+        std::string expanded;
+        size_t pos = 0;
+        if (!text.empty() && text[0] == '~' && (text.size() == 1 || text[1] == '/' || text[1] == '\\')) {
+#ifdef _WIN32
+            expanded = environment("USERPROFILE");
+#else
+            expanded = environment("HOME");
+#endif
+            pos = 1;
+        }
+        while (pos < text.size()) {
+            size_t open = text.find("${", pos);
+            size_t close = open == std::string::npos ? std::string::npos : text.find('}', open);
+            if (close == std::string::npos) {
+                expanded += text.substr(pos);
+                break;
+            }
+            expanded += text.substr(pos, open - pos) + environment(text.substr(open + 2, close - open - 2));
+            pos = close + 1;
+        }
+        return expanded;
+    }
+
+    NativeString nativeOf(const std::string& text) {
+        std::filesystem::path path = std::filesystem::u8path(text);
+        path.make_preferred();
+        return path.native();
+    }
+
+    // Directories compare without a trailing separator
+    NativeString normalRoot(const std::filesystem::path& root) {
+        NativeString native = root.lexically_normal().make_preferred().native();
+        while (native.size() > 1 && native.back() == kSeparator) native.pop_back();
+        return native;
+    }
+
+    bool isBelow(const NativeString& path, const NativeString& root) {
+        if (path.size() <= root.size() || path.compare(0, root.size(), root) != 0) return false;
+        return path[root.size()] == kSeparator || root.back() == kSeparator;
+    }
+
+    bool sameChar(NativeChar a, NativeChar b) {
+#ifdef _WIN32
+        return std::towlower(a) == std::towlower(b);
+#else
+        return a == b;
+#endif
+    }
+
+    bool globMatchRange(const NativeChar* pattern, const NativeChar* patternEnd,
+                        const NativeChar* text, const NativeChar* textEnd) {
+        while (pattern != patternEnd) {
+            if (*pattern == '*') {
+                bool deep = pattern + 1 != patternEnd && pattern[1] == '*';
+                pattern += deep ? 2 : 1;
+                // "**/" also matches no directory at all
+                if (deep && pattern != patternEnd && *pattern == kSeparator &&
+                    globMatchRange(pattern + 1, patternEnd, text, textEnd)) {
+                    return true;
+                }
+                for (const NativeChar* rest = text;; ++rest) {
+                    if (globMatchRange(pattern, patternEnd, rest, textEnd)) return true;
+                    if (rest == textEnd || (!deep && *rest == kSeparator)) return false;
+                }
+            }
+            if (text == textEnd) return false;
+            if (*pattern == '?') {
+                if (*text == kSeparator) return false;
+            } else if (!sameChar(*pattern, *text)) {
+                return false;
+            }
+            ++pattern;
+            ++text;
+        }
+        return text == textEnd;
+    }
+
+    int64_t toUnixSeconds(int64_t mtime) {
+#ifdef _WIN32
+        // FILETIME ticks of 100 ns since 1601
+        return mtime / 10000000 - 11644473600ll;
+#else
+        return mtime / 1000000000;
+#endif
+    }
+
+    bool anyOf(const std::vector<NativeString>& candidates, const NativeString& value) {
+        return std::any_of(candidates.begin(), candidates.end(),
+                           [&value](const NativeString& candidate) {
+                               return candidate.size() == value.size() &&
+                                      std::equal(candidate.begin(), candidate.end(), value.begin(), sameChar);
+                           });
+    }
+}
+
+bool globMatch(const NativeString& pattern, const NativeString& text) {
+    return globMatchRange(pattern.data(), pattern.data() + pattern.size(), text.data(), text.data() + text.size());
+}
+
+bool parseRules(const std::string& text, std::vector<CleaningRule>& rules, std::string& error) {
+    std::istringstream stream(text);
+    std::string line;
+    size_t lineNumber = 0;
+    std::vector<CleaningRule> parsed;
+    auto fail = [&](const std::string& reason) {
+        error = "line " + std::to_string(lineNumber) + ": " + reason;
+        return false;
+    };
+
+    while (std::getline(stream, line)) {
+        lineNumber++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') continue;
+        if (line.front() == '[') {
+            if (line.back() != ']' || trim(line.substr(1, line.size() - 2)).empty()) return fail("invalid section");
+            if (!parsed.empty() && parsed.back().roots.empty()) return fail("rule " + parsed.back().name + " has no root");
+            parsed.emplace_back();
+            parsed.back().name = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) return fail("expected key = value");
+        if (parsed.empty()) return fail("key outside of a [rule] section");
+        std::string key = lower(trim(line.substr(0, equals)));
+        std::string value = trim(line.substr(equals + 1));
+        CleaningRule& rule = parsed.back();
+
+        if (key == "root") {
+            std::string root = expandRoot(value);
+            if (root.empty()) return fail("empty root");
+            rule.roots.push_back(std::filesystem::u8path(root));
+        } else if (key == "glob") {
+            if (value.empty()) return fail("empty glob");
+            rule.globs.push_back(value);
+        } else if (key == "extensions") {
+            rule.extensions = splitList(value);
+        } else if (key == "exclude-extensions") {
+            rule.excludedExtensions = splitList(value);
+        } else if (key == "min-age") {
+            if (!parseAge(value, rule.minAgeSeconds)) return fail("invalid min-age " + value);
+        } else if (key == "min-size") {
+            if (!parseSize(value, rule.minSize)) return fail("invalid min-size " + value);
+        } else if (key == "max-size") {
+            if (!parseSize(value, rule.maxSize)) return fail("invalid max-size " + value);
+        } else if (key == "recursive") {
+            std::string flag = lower(value);
+            if (flag != "yes" && flag != "no" && flag != "true" && flag != "false") {
+                return fail("invalid recursive " + value);
+            }
+            rule.recursive = flag == "yes" || flag == "true";
+        } else if (key == "action") {
+            std::string action = lower(value);
+            if (action == "delete") rule.action = RuleAction::Delete;
+            else if (action == "report") rule.action = RuleAction::Report;
+            else if (action == "keep") rule.action = RuleAction::Keep;
+            else return fail("invalid action " + value);
+        } else {
+            return fail("unknown key " + key);
+        }
+    }
+    if (!parsed.empty() && parsed.back().roots.empty()) {
+        return fail("rule " + parsed.back().name + " has no root");
+    }
+    rules.insert(rules.end(), parsed.begin(), parsed.end());
+    return true;
+}
+
+bool loadRules(const std::filesystem::path& path, std::vector<CleaningRule>& rules, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + toUtf8(path);
+        return false;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    return parseRules(text.str(), rules, error);
+}
+
+RulePlan::RulePlan(std::vector<CleaningRule> source) : rules(std::move(source)) {
+    // Every distinct root once; sorting puts "a" before "a/b"
+    std::set<NativeString> distinct;
+    for (const auto& rule : rules) {
+        for (const auto& root : rule.roots) {
+            distinct.insert(normalRoot(root));
+        }
+    }
+    std::vector<NativeString> merged;
+    for (const auto& root : distinct) {
+        // A root below an already merged one is walked with it
+        bool covered = false;
+        for (std::filesystem::path parent = std::filesystem::path(root).parent_path();
+             !covered && !parent.empty(); parent = parent.parent_path()) {
+            covered = std::binary_search(merged.begin(), merged.end(), normalRoot(parent));
+            if (parent == parent.parent_path()) break;
+        }
+        if (!covered) merged.push_back(root);
+    }
+    std::sort(merged.begin(), merged.end());
+
+    roots.assign(merged.begin(), merged.end());
+    bindings.resize(merged.size());
+    compiled.resize(rules.size());
+    for (size_t i = 0; i < rules.size(); ++i) {
+        const CleaningRule& rule = rules[i];
+        CompiledRule& compiledRule = compiled[i];
+        for (const auto& glob : rule.globs) {
+            bool hasSeparator = glob.find('/') != std::string::npos || glob.find('\\') != std::string::npos;
+            (hasSeparator ? compiledRule.paths : compiledRule.names).push_back(nativeOf(glob));
+        }
+        for (const auto& extension : rule.extensions) compiledRule.extensions.push_back(nativeOf(extension));
+        for (const auto& extension : rule.excludedExtensions) {
+            compiledRule.excludedExtensions.push_back(nativeOf(extension));
+        }
+        recursive = recursive || rule.recursive;
+
+        for (const auto& root : rule.roots) {
+            NativeString native = normalRoot(root);
+            for (size_t m = 0; m < merged.size(); ++m) {
+                if (native != merged[m] && !isBelow(native, merged[m])) continue;
+                bindings[m].push_back({i, native});
+                // Direct children of a deeper root are further down the walk
+                recursive = recursive || native != merged[m];
+                break;
+            }
+        }
+    }
+}
+
+bool RulePlan::accepts(const Binding& binding, const FileEntry& entry, std::time_t now) const {
+    const CleaningRule& rule = rules[binding.rule];
+    const CompiledRule& compiledRule = compiled[binding.rule];
+    const NativeString& path = entry.path.native();
+    if (!isBelow(path, binding.root)) return false;
+    size_t offset = binding.root.size() + (binding.root.back() == kSeparator ? 0 : 1);
+    if (!rule.recursive && path.find(kSeparator, offset) != NativeString::npos) return false;
+
+    if (entry.size < rule.minSize || entry.size > rule.maxSize) return false;
+    if (rule.minAgeSeconds > 0 && static_cast<int64_t>(now) - toUnixSeconds(entry.mtime) < rule.minAgeSeconds) {
+        return false;
+    }
+
+    if (!compiledRule.extensions.empty() || !compiledRule.excludedExtensions.empty()) {
+        NativeString extension = entry.path.extension().native();
+        if (!extension.empty()) extension.erase(0, 1);
+        if (!compiledRule.extensions.empty() && !anyOf(compiledRule.extensions, extension)) return false;
+        if (anyOf(compiledRule.excludedExtensions, extension)) return false;
+    }
+
+    if (compiledRule.paths.empty() && compiledRule.names.empty()) return true;
+    NativeString relative = path.substr(offset);
+    for (const auto& glob : compiledRule.paths) {
+        if (globMatch(glob, relative)) return true;
+    }
+    size_t name = relative.rfind(kSeparator);
+    NativeString fileName = name == NativeString::npos ? relative : relative.substr(name + 1);
+    for (const auto& glob : compiledRule.names) {
+        if (globMatch(glob, fileName)) return true;
+    }
+    return false;
+}
+
+RulePlan::Match RulePlan::match(const FileEntry& entry, std::time_t now) const {
+    Match decided;
+    if (entry.rootSet >= bindings.size()) return decided;
+    Match report;
+    for (const auto& binding : bindings[entry.rootSet]) {
+        RuleAction action = rules[binding.rule].action;
+        // Only a keep rule can still change a decision once a delete rule matched
+        if (decided.rule >= 0 && action != RuleAction::Keep) continue;
+        if (action == RuleAction::Report && report.rule >= 0) continue;
+        if (!accepts(binding, entry, now)) continue;
+
+        Match match{action, static_cast<int>(binding.rule)};
+        if (action == RuleAction::Keep) return match;
+        (action == RuleAction::Delete ? decided : report) = match;
+    }
+    return decided.rule >= 0 ? decided : report;
+}
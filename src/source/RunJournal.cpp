@@ -0,0 +1,275 @@
+#include "RunJournal.h"
+#include "BinaryIO.h"
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    enum RecordType : uint8_t {
+        kBeginRun = 1,
+        kBackupStarted = 2,
+        kBackedUp = 3,
+        kBackupDirectory = 4,
+        kBackupComplete = 5,
+        kDeleted = 6,
+        kCleanedDirectory = 7,
+        kFinishRun = 8
+    };
+
+    // Fields of kBackupStarted are joined by this separator
+    constexpr char kFieldSeparator = '\0';
+
+    // Apply one decoded record, false if it cannot belong to any run
+    bool applyRecord(std::vector<JournalRun>& runs, uint8_t type, uint64_t value, std::string text) {
+        if (type == kBeginRun) {
+            JournalRun run;
+            run.operation = std::move(text);
+            runs.push_back(std::move(run));
+            return true;
+        }
+        if (runs.empty()) return false;
+
+        JournalRun& run = runs.back();
+        switch (type) {
+            case kBackupStarted: {
+                size_t separator = text.find(kFieldSeparator);
+                if (separator == std::string::npos) return false;
+                run.backupPath = text.substr(0, separator);
+                run.timestamp = text.substr(separator + 1);
+                return true;
+            }
+            case kBackedUp:
+                run.backedUpFiles.push_back(std::move(text));
+                run.backupBytes += value;
+                return true;
+            case kBackupDirectory:
+                run.backupDirectories.insert(std::move(text));
+                return true;
+            case kBackupComplete:
+                run.backupComplete = true;
+                return true;
+            case kDeleted:
+                run.filesDeleted++;
+                run.bytesFreed += value;
+                return true;
+            case kCleanedDirectory:
+                run.cleanedDirectories.insert(std::move(text));
+                return true;
+            case kFinishRun:
+                run.finished = true;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool syncFile(std::FILE* file) {
+        if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+}
+
+RunJournal::RunJournal() : commitInterval(100), commitBatch(256) {}
+
+RunJournal::~RunJournal() {
+    close();
+}
+
+bool RunJournal::open(const std::filesystem::path& journalFile, std::vector<JournalRun>& runs) {
+    close();
+    path = journalFile;
+
+    // Replay every intact record; a torn or corrupt record ends the journal
+    std::string data;
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (in) data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    size_t valid = 0;
+    ByteReader reader(data.data(), data.size());
+    for (;;) {
+        uint32_t length, checksum;
+        if (!reader.readU32(length) || !reader.readU32(checksum) || length == 0 || length > reader.remaining()) break;
+        if (crc32(data.data() + reader.getPosition(), length) != checksum) break;
+
+        uint8_t type;
+        uint64_t value, textLength;
+        std::string text;
+        if (!reader.readByte(type) || !reader.readVarint(value) || !reader.readVarint(textLength) ||
+            !reader.readBytes(static_cast<size_t>(textLength), text) ||
+            reader.getPosition() != valid + 8 + length) {
+            break;
+        }
+        if (!applyRecord(runs, type, value, std::move(text))) break;
+        valid = reader.getPosition();
+    }
+
+    std::error_code ec;
+    if (valid < data.size()) {
+        std::filesystem::resize_file(path, valid, ec);
+        if (ec) return false;
+    }
+
+#ifdef _WIN32
+    file = _wfopen(path.c_str(), L"ab");
+#else
+    file = std::fopen(path.c_str(), "ab");
+#endif
+    if (!file) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.clear();
+        pendingRecords = 0;
+        appended = durable = syncs = 0;
+        stopping = failed = syncRequested = false;
+    }
+    flusher = std::thread(&RunJournal::flusherLoop, this);
+    return true;
+}
+
+void RunJournal::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!file) return;
+        stopping = true;
+    }
+    wake.notify_all();
+    if (flusher.joinable()) flusher.join();
+    std::fclose(file);
+    file = nullptr;
+}
+
+bool RunJournal::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return file != nullptr;
+}
+
+void RunJournal::setCommitInterval(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(mutex);
+    commitInterval = interval;
+}
+
+void RunJournal::setCommitBatch(size_t records) {
+    std::lock_guard<std::mutex> lock(mutex);
+    commitBatch = records > 0 ? records : 1;
+}
+
+void RunJournal::beginRun(const std::string& operation) {
+    append(kBeginRun, 0, operation);
+}
+
+void RunJournal::recordBackupStarted(const std::string& backupPath, const std::string& timestamp) {
+    append(kBackupStarted, 0, backupPath + kFieldSeparator + timestamp);
+}
+
+void RunJournal::recordBackedUp(const std::string& source, uint64_t size) {
+    append(kBackedUp, size, source);
+}
+
+void RunJournal::recordBackupDirectory(const std::string& directory) {
+    append(kBackupDirectory, 0, directory);
+}
+
+void RunJournal::recordBackupComplete() {
+    append(kBackupComplete, 0);
+}
+
+void RunJournal::recordDeleted(uint64_t size) {
+    append(kDeleted, size);
+}
+
+void RunJournal::recordCleanedDirectory(const std::string& directory) {
+    append(kCleanedDirectory, 0, directory);
+}
+
+void RunJournal::finishRun() {
+    append(kFinishRun, 0);
+}
+
+void RunJournal::append(uint8_t type, uint64_t value, const std::string& text) {
+    std::string payload(1, static_cast<char>(type));
+    appendVarint(payload, value);
+    appendVarint(payload, text.size());
+    payload += text;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file) return;
+    appendU32(pending, static_cast<uint32_t>(payload.size()));
+    appendU32(pending, crc32(payload.data(), payload.size()));
+    pending += payload;
+    appended++;
+    if (++pendingRecords >= commitBatch) {
+        wake.notify_one();
+    }
+}
+
+bool RunJournal::sync() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!file) return false;
+    uint64_t target = appended;
+    if (durable >= target) return !failed;
+    syncRequested = true;
+    wake.notify_one();
+    committed.wait(lock, [this, target] { return durable >= target || failed || stopping; });
+    return durable >= target && !failed;
+}
+
+bool RunJournal::reset() {
+    if (!sync()) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    // Nothing is pending after sync(), so the flusher is idle
+#ifdef _WIN32
+    bool ok = _chsize_s(_fileno(file), 0) == 0;
+#else
+    bool ok = ftruncate(fileno(file), 0) == 0;
+#endif
+    return ok && syncFile(file);
+}
+
+uint64_t RunJournal::getSyncCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return syncs;
+}
+
+void RunJournal::flusherLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, commitInterval, [this] {
+            return stopping || syncRequested || pendingRecords >= commitBatch;
+        });
+        if (!pending.empty()) commit(lock);
+    }
+    if (!pending.empty()) commit(lock);
+}
+
+void RunJournal::commit(std::unique_lock<std::mutex>& lock) {
+    std::string batch;
+    batch.swap(pending);
+    pendingRecords = 0;
+    syncRequested = false;
+    uint64_t target = appended;
+
+    // Writers keep appending to the next batch while this one is written
+    lock.unlock();
+    bool ok = std::fwrite(batch.data(), 1, batch.size(), file) == batch.size() && syncFile(file);
+    lock.lock();
+
+    syncs++;
+    if (ok) {
+        durable = target;
+    } else {
+        failed = true;
+    }
+    committed.notify_all();
+}
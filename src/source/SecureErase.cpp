@@ -0,0 +1,405 @@
+#include "SecureErase.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "PathArena.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#include <cwchar>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#elif defined(__APPLE__)
+#include <cstring>
+#include <sys/mount.h>
+#endif
+#endif
+
+namespace {
+    // Never written, so every thread can pass it to its writes
+    alignas(SecureEraser::kAlignment) char zeros[SecureEraser::kChunkSize];
+
+    using Extent = std::pair<uint64_t, uint64_t>;   // begin, end
+
+    uint64_t alignDown(uint64_t value) {
+        return value & ~static_cast<uint64_t>(SecureEraser::kAlignment - 1);
+    }
+
+    uint64_t alignUp(uint64_t value) {
+        return alignDown(value + SecureEraser::kAlignment - 1);
+    }
+
+#ifdef _WIN32
+    using NativeHandle = HANDLE;
+
+    std::error_code lastError() {
+        return std::error_code(static_cast<int>(GetLastError()), std::system_category());
+    }
+
+    const HANDLE kInvalidHandle = INVALID_HANDLE_VALUE;
+
+    void closeHandle(HANDLE handle) {
+        CloseHandle(handle);
+    }
+
+    HANDLE openForOverwrite(const std::filesystem::path& path, bool direct) {
+        DWORD flags = FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_WRITE_THROUGH;
+        if (direct) flags |= FILE_FLAG_NO_BUFFERING;
+        return CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                           flags, nullptr);
+    }
+
+    bool isCopyOnWriteVolume(HANDLE handle) {
+        wchar_t fileSystem[MAX_PATH + 1] = {};
+        if (!GetVolumeInformationByHandleW(handle, nullptr, 0, nullptr, nullptr, nullptr,
+                                           fileSystem, MAX_PATH + 1)) {
+            return false;
+        }
+        return std::wcscmp(fileSystem, L"ReFS") == 0;
+    }
+
+    // Allocated ranges of a sparse file; the whole file if they cannot be queried
+    std::vector<Extent> dataExtents(HANDLE handle, uint64_t size) {
+        std::vector<Extent> extents;
+        FILE_ALLOCATED_RANGE_BUFFER query;
+        query.FileOffset.QuadPart = 0;
+        query.Length.QuadPart = static_cast<LONGLONG>(size);
+        FILE_ALLOCATED_RANGE_BUFFER ranges[64];
+        while (true) {
+            DWORD returned = 0;
+            BOOL ok = DeviceIoControl(handle, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query),
+                                      ranges, sizeof(ranges), &returned, nullptr);
+            if (!ok && GetLastError() != ERROR_MORE_DATA) return {{0, size}};
+            size_t count = returned / sizeof(ranges[0]);
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t begin = static_cast<uint64_t>(ranges[i].FileOffset.QuadPart);
+                extents.emplace_back(begin, begin + static_cast<uint64_t>(ranges[i].Length.QuadPart));
+            }
+            if (ok || count == 0) break;
+            query.FileOffset.QuadPart = static_cast<LONGLONG>(extents.back().second);
+            query.Length.QuadPart = static_cast<LONGLONG>(size - extents.back().second);
+        }
+        return extents;
+    }
+
+    bool writeAt(HANDLE handle, uint64_t offset, size_t length, std::error_code& ec) {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD written = 0;
+        if (!WriteFile(handle, zeros, static_cast<DWORD>(length), &written, &overlapped) || written != length) {
+            ec = lastError();
+            return false;
+        }
+        return true;
+    }
+
+    bool truncateTo(HANDLE handle, uint64_t size) {
+        FILE_END_OF_FILE_INFO end;
+        end.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        return SetFileInformationByHandle(handle, FileEndOfFileInfo, &end, sizeof(end)) != 0;
+    }
+
+    bool flush(HANDLE handle) {
+        return FlushFileBuffers(handle) != 0;
+    }
+#else
+    using NativeHandle = int;
+
+    std::error_code lastError() {
+        return std::error_code(errno, std::generic_category());
+    }
+
+    constexpr int kInvalidHandle = -1;
+
+    void closeHandle(int fd) {
+        close(fd);
+    }
+
+#ifdef O_DIRECT
+    constexpr int kDirectFlag = O_DIRECT;
+#else
+    constexpr int kDirectFlag = 0;
+#endif
+
+    int openForOverwrite(const std::filesystem::path& path, bool direct) {
+        int flags = O_WRONLY | O_NOFOLLOW | O_CLOEXEC;
+        if (direct) flags |= kDirectFlag;
+        int fd = open(path.c_str(), flags);
+#ifdef __APPLE__
+        // macOS has no O_DIRECT, the cache is bypassed per descriptor
+        if (fd >= 0 && direct) fcntl(fd, F_NOCACHE, 1);
+#endif
+        return fd;
+    }
+
+#ifdef __linux__
+    // statfs f_type values of file systems that never overwrite in place
+    constexpr uint32_t kCopyOnWriteFsMagic[] = {
+        0x9123683E,         // Btrfs
+        0x2FC12FC1,         // ZFS
+        0xCA451A4E,         // bcachefs
+        0x3434,             // NILFS
+        0xF2F52010,         // F2FS
+    };
+#endif
+
+    bool isCopyOnWriteVolume(int fd) {
+#ifdef __linux__
+        struct statfs fs;
+        if (fstatfs(fd, &fs) != 0) return false;
+        for (uint32_t magic : kCopyOnWriteFsMagic) {
+            if (static_cast<uint32_t>(fs.f_type) == magic) return true;
+        }
+        return false;
+#elif defined(__APPLE__)
+        struct statfs fs;
+        if (fstatfs(fd, &fs) != 0) return false;
+        return std::strcmp(fs.f_fstypename, "apfs") == 0 || std::strcmp(fs.f_fstypename, "zfs") == 0;
+#else
+        (void)fd;
+        return false;
+#endif
+    }
+
+    // Data extents of a sparse file; the whole file if holes cannot be queried
+    std::vector<Extent> dataExtents(int fd, uint64_t size) {
+#ifdef SEEK_DATA
+        std::vector<Extent> extents;
+        off_t position = 0;
+        while (static_cast<uint64_t>(position) < size) {
+            off_t data = lseek(fd, position, SEEK_DATA);
+            if (data < 0) {
+                if (errno == ENXIO) break;      // Only a hole is left
+                return {{0, size}};
+            }
+            off_t hole = lseek(fd, data, SEEK_HOLE);
+            if (hole < 0 || static_cast<uint64_t>(hole) > size) hole = static_cast<off_t>(size);
+            extents.emplace_back(static_cast<uint64_t>(data), static_cast<uint64_t>(hole));
+            position = hole;
+        }
+        return extents;
+#else
+        (void)fd;
+        return {{0, size}};
+#endif
+    }
+
+    bool writeAt(int fd, uint64_t offset, size_t length, std::error_code& ec) {
+        while (length > 0) {
+            ssize_t written = pwrite(fd, zeros, length, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                ec = lastError();
+                return false;
+            }
+            offset += static_cast<uint64_t>(written);
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool truncateTo(int fd, uint64_t size) {
+        return ftruncate(fd, static_cast<off_t>(size)) == 0;
+    }
+
+    bool flush(int fd) {
+#ifdef __APPLE__
+        return fsync(fd) == 0;
+#else
+        return fdatasync(fd) == 0;
+#endif
+    }
+#endif
+
+    // Closes the file it was last given
+    class FileHandle {
+    public:
+        FileHandle() = default;
+        ~FileHandle() { reset(kInvalidHandle); }
+        FileHandle(const FileHandle&) = delete;
+        FileHandle& operator=(const FileHandle&) = delete;
+
+        bool open(const std::filesystem::path& path, bool direct) {
+            reset(openForOverwrite(path, direct));
+            return handle != kInvalidHandle;
+        }
+        NativeHandle get() const { return handle; }
+
+    private:
+        void reset(NativeHandle replacement) {
+            if (handle != kInvalidHandle) closeHandle(handle);
+            handle = replacement;
+        }
+
+        NativeHandle handle = kInvalidHandle;
+    };
+
+    // Direct I/O wants aligned offsets and lengths, so extents are widened to
+    // whole blocks; a write past the end is truncated away again afterwards
+    bool writeExtents(NativeHandle handle, const std::vector<Extent>& extents, uint64_t& written,
+                      std::error_code& ec) {
+        for (const auto& [begin, end] : extents) {
+            for (uint64_t offset = alignDown(begin); offset < end; offset += SecureEraser::kChunkSize) {
+                size_t length = static_cast<size_t>(
+                    std::min<uint64_t>(SecureEraser::kChunkSize, alignUp(end) - offset));
+                if (!writeAt(handle, offset, length, ec)) return false;
+                written += length;
+            }
+        }
+        return true;
+    }
+
+    bool isMissing(const std::error_code& ec) {
+#ifdef _WIN32
+        if (ec.value() == ERROR_PATH_NOT_FOUND) return true;
+#endif
+        return ec == std::errc::no_such_file_or_directory;
+    }
+
+    // Refused direct I/O shows up as an invalid argument, on open or on the first write
+    bool isDirectIoRefused(const std::error_code& ec) {
+#ifdef _WIN32
+        return ec.value() == ERROR_INVALID_PARAMETER;
+#else
+        return ec == std::errc::invalid_argument;
+#endif
+    }
+}
+
+EraseOutcome SecureEraser::overwrite(const FileEntry& entry, std::error_code& ec) {
+    ec.clear();
+    OperationTimer timer(MetricOperation::Overwrite);
+
+    FileHandle file;
+    bool direct = file.open(entry.path, true);
+    if (!direct && (!isDirectIoRefused(lastError()) || !file.open(entry.path, false))) {
+        std::error_code error = lastError();
+        if (!isMissing(error)) ec = error;
+        return EraseOutcome::Missing;
+    }
+    const NativeHandle handle = file.get();
+
+    // The file may have changed since the scan, so its current metadata counts
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(handle, &info)) {
+        ec = lastError();
+        return EraseOutcome::Missing;
+    }
+    const uint64_t size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    const bool hardLinked = info.nNumberOfLinks > 1;
+    const bool compressed = (info.dwFileAttributes & FILE_ATTRIBUTE_COMPRESSED) != 0;
+    const bool sparse = (info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0;
+#else
+    struct stat st;
+    if (fstat(handle, &st) != 0) {
+        ec = lastError();
+        return EraseOutcome::Missing;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        ec = std::make_error_code(std::errc::invalid_argument);
+        return EraseOutcome::Missing;
+    }
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+    const bool hardLinked = st.st_nlink > 1;
+    const bool compressed = false;
+    // st_blocks is always in 512-byte units
+    const bool sparse = static_cast<uint64_t>(st.st_blocks) * 512 < size;
+#endif
+
+    if (hardLinked) {
+        hardLinkedFiles++;
+        return EraseOutcome::HardLinked;
+    }
+    if (compressed) {
+        compressedFiles++;
+        return EraseOutcome::Compressed;
+    }
+    bool copyOnWrite;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto known = copyOnWriteDevices.find(entry.device);
+        if (known == copyOnWriteDevices.end()) {
+            known = copyOnWriteDevices.emplace(entry.device, isCopyOnWriteVolume(handle)).first;
+            if (known->second) {
+                Logger::getInstance().log(LogLevel::WARNING,
+                    "Copy-on-write file system at " + toUtf8(entry.path) +
+                    ": files on it cannot be overwritten and are only deleted");
+            }
+        }
+        copyOnWrite = known->second;
+    }
+    if (copyOnWrite) {
+        copyOnWriteFiles++;
+        return EraseOutcome::CopyOnWrite;
+    }
+
+    std::vector<Extent> extents = sparse ? dataExtents(handle, size) : std::vector<Extent>{{0, size}};
+    uint64_t written = 0;
+    if (!writeExtents(file.get(), extents, written, ec)) {
+        // Some file systems accept the flag on open but not the writes
+        if (!direct || !isDirectIoRefused(ec)) return EraseOutcome::Missing;
+        direct = false;
+        ec.clear();
+        written = 0;
+        if (!file.open(entry.path, false)) {
+            ec = lastError();
+            return EraseOutcome::Missing;
+        }
+        if (!writeExtents(file.get(), extents, written, ec)) return EraseOutcome::Missing;
+    }
+    if ((alignUp(size) != size && !truncateTo(file.get(), size)) || !flush(file.get())) {
+        ec = lastError();
+        return EraseOutcome::Missing;
+    }
+
+    if (!direct) bufferedFiles++;
+    if (sparse) sparseFiles++;
+    filesOverwritten++;
+    bytesOverwritten += written;
+    return sparse ? EraseOutcome::Sparse : EraseOutcome::Overwritten;
+}
+
+SecureEraseStats SecureEraser::getStats() const {
+    SecureEraseStats stats;
+    stats.filesOverwritten = filesOverwritten.load();
+    stats.bytesOverwritten = bytesOverwritten.load();
+    stats.sparseFiles = sparseFiles.load();
+    stats.copyOnWriteFiles = copyOnWriteFiles.load();
+    stats.compressedFiles = compressedFiles.load();
+    stats.hardLinkedFiles = hardLinkedFiles.load();
+    stats.bufferedFiles = bufferedFiles.load();
+    return stats;
+}
+
+void SecureEraser::resetStats() {
+    filesOverwritten = 0;
+    bytesOverwritten = 0;
+    sparseFiles = 0;
+    copyOnWriteFiles = 0;
+    compressedFiles = 0;
+    hardLinkedFiles = 0;
+    bufferedFiles = 0;
+}
+
+const char* eraseOutcomeName(EraseOutcome outcome) {
+    switch (outcome) {
+        case EraseOutcome::Overwritten: return "overwritten";
+        case EraseOutcome::Sparse: return "sparse file, data extents overwritten";
+        case EraseOutcome::CopyOnWrite: return "copy-on-write file system";
+        case EraseOutcome::Compressed: return "compressed file";
+        case EraseOutcome::HardLinked: return "other hard links";
+        case EraseOutcome::Missing: return "missing";
+    }
+    return "unknown";
+}
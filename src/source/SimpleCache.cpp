@@ -0,0 +1,160 @@
+#include "SimpleCache.h"
+#include "BinaryIO.h"
+#include "PathArena.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    constexpr uint64_t kIndexMagic = 0x656e74657220796full;
+    constexpr uint32_t kMinVersion = 7;
+    constexpr uint32_t kMaxVersion = 9;
+    // From version 8 on sizes are stored in 256-byte units next to in-memory flags
+    constexpr uint32_t kPackedSizeVersion = 8;
+
+    // Seconds between 1601-01-01 and 1970-01-01
+    constexpr int64_t kEpochDelta = 11644473600ll;
+    constexpr int64_t kMicrosecondsPerDay = 24ll * 60 * 60 * 1000000;
+
+    std::filesystem::path indexPath(const std::filesystem::path& directory) {
+        return directory / "index-dir" / "the-real-index";
+    }
+
+    std::string hashName(uint64_t hash) {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016" PRIx64, hash);
+        return name;
+    }
+}
+
+int64_t toChromiumTime(std::time_t time) {
+    return (static_cast<int64_t>(time) + kEpochDelta) * 1000000;
+}
+
+bool SimpleCacheIndex::isSimpleCache(const std::filesystem::path& directory) {
+    std::error_code ec;
+    return std::filesystem::is_regular_file(indexPath(directory), ec);
+}
+
+std::vector<std::filesystem::path> SimpleCacheIndex::find(const std::filesystem::path& root) {
+    std::vector<std::filesystem::path> found;
+    if (isSimpleCache(root)) found.push_back(root);
+
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code entryEc;
+        if (it->is_directory(entryEc) && isSimpleCache(it->path())) found.push_back(it->path());
+    }
+    return found;
+}
+
+std::vector<std::filesystem::path> SimpleCacheIndex::entryFiles(const std::filesystem::path& directory,
+                                                                uint64_t hash) {
+    std::string name = hashName(hash);
+    return {directory / (name + "_0"), directory / (name + "_1"), directory / (name + "_s")};
+}
+
+bool SimpleCacheIndex::load(const std::filesystem::path& directory) {
+    entries.clear();
+    error.clear();
+
+    std::ifstream in(indexPath(directory), std::ios::binary);
+    if (!in.is_open()) {
+        error = "cannot open " + toUtf8(indexPath(directory));
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    ByteReader header(data.data(), data.size());
+    uint32_t payloadSize, checksum;
+    if (!header.readU32(payloadSize) || !header.readU32(checksum) || payloadSize != data.size() - 8) {
+        error = "truncated index";
+        return false;
+    }
+    if (crc32(data.data() + 8, payloadSize) != checksum) {
+        error = "index checksum mismatch";
+        return false;
+    }
+
+    ByteReader reader(data.data(), data.size(), 8);
+    uint64_t magic, entryCount, cacheSize;
+    if (!reader.readU64(magic) || magic != kIndexMagic || !reader.readU32(version)) {
+        error = "not a simple cache index";
+        return false;
+    }
+    if (version < kMinVersion || version > kMaxVersion) {
+        error = "unsupported index version " + std::to_string(version);
+        return false;
+    }
+    if (!reader.readU64(entryCount) || !reader.readU64(cacheSize) || !reader.readU32(reason) ||
+        entryCount > reader.remaining() / 24) {
+        error = "corrupt index header";
+        return false;
+    }
+
+    entries.reserve(static_cast<size_t>(entryCount));
+    for (uint64_t i = 0; i < entryCount; ++i) {
+        SimpleCacheEntry entry;
+        uint64_t lastUsed, size;
+        if (!reader.readU64(entry.hash) || !reader.readU64(lastUsed) || !reader.readU64(size)) {
+            error = "truncated index entries";
+            return false;
+        }
+        entry.lastUsed = static_cast<int64_t>(lastUsed);
+        entry.size = (version >= kPackedSizeVersion) ? (size >> 8) * 256 : size;
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+bool SimpleCacheIndex::save(const std::filesystem::path& directory) const {
+    uint64_t cacheSize = 0;
+    std::string payload;
+    appendU64(payload, kIndexMagic);
+    appendU32(payload, version);
+    appendU64(payload, entries.size());
+    size_t sizeOffset = payload.size();
+    appendU64(payload, 0);
+    appendU32(payload, reason);
+    for (const auto& entry : entries) {
+        appendU64(payload, entry.hash);
+        appendU64(payload, static_cast<uint64_t>(entry.lastUsed));
+        // Packed form: 256-byte chunks above the in-memory data byte, which is dropped
+        appendU64(payload, version >= kPackedSizeVersion ? ((entry.size + 255) / 256) << 8 : entry.size);
+        cacheSize += entry.size;
+    }
+    appendU64(payload, static_cast<uint64_t>(toChromiumTime(std::time(nullptr))));
+
+    std::string sizeBytes;
+    appendU64(sizeBytes, cacheSize);
+    payload.replace(sizeOffset, 8, sizeBytes);
+
+    std::string file;
+    appendU32(file, static_cast<uint32_t>(payload.size()));
+    appendU32(file, crc32(payload.data(), payload.size()));
+    file += payload;
+
+    std::filesystem::path target = indexPath(directory);
+    return writeFileAtomically(target, file, target.parent_path() / "temp-index");
+}
+
+std::vector<SimpleCacheEntry> selectCacheEvictions(std::vector<SimpleCacheEntry> entries,
+                                                   const CacheEvictionPolicy& policy, int64_t now) {
+    std::sort(entries.begin(), entries.end(),
+        [](const SimpleCacheEntry& a, const SimpleCacheEntry& b) { return a.lastUsed < b.lastUsed; });
+
+    uint64_t total = 0;
+    for (const auto& entry : entries) total += entry.size;
+
+    std::vector<SimpleCacheEntry> evicted;
+    const int64_t maxAge = static_cast<int64_t>(policy.maxAgeDays) * kMicrosecondsPerDay;
+    for (const auto& entry : entries) {
+        bool tooOld = policy.maxAgeDays > 0 && now - entry.lastUsed > maxAge;
+        if (!tooOld && total <= policy.maxBytes) break;
+        total -= entry.size;
+        evicted.push_back(entry);
+    }
+    return evicted;
+}
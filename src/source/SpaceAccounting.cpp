@@ -0,0 +1,36 @@
+#include "SpaceAccounting.h"
+#include <algorithm>
+
+SpaceAccounting::SpaceAccounting(size_t buckets)
+    : buckets(std::max<size_t>(buckets, 1)) {
+}
+
+void SpaceAccounting::record(const FileEntry& entry, size_t bucket) {
+    Bucket& tally = buckets[bucket];
+    // Without an inode number links cannot be matched; count the file as is
+    if (entry.links <= 1 || entry.inode == 0) {
+        tally.logicalBytes += entry.size;
+        tally.physicalBytes += entry.allocated;
+        return;
+    }
+
+    InodeKey key{entry.device, entry.inode};
+    size_t hash = InodeKeyHash()(key);
+    Shard& shard = shards[(hash >> 7) % kShards];
+    uint32_t removed;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        removed = ++shard.removedLinks[key];
+    }
+
+    if (removed == 1) tally.logicalBytes += entry.size;
+    if (removed == entry.links) tally.physicalBytes += entry.allocated;
+}
+
+uint64_t SpaceAccounting::getLogicalBytes(size_t bucket) const {
+    return buckets[bucket].logicalBytes.load();
+}
+
+uint64_t SpaceAccounting::getPhysicalBytes(size_t bucket) const {
+    return buckets[bucket].physicalBytes.load();
+}
@@ -0,0 +1,138 @@
+#include "StorageInfo.h"
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#endif
+#endif
+
+namespace {
+#ifdef __linux__
+    // statfs f_type values of network filesystems
+    constexpr uint32_t kNetworkFsMagic[] = {
+        0x6969,             // NFS
+        0x517B,             // SMB
+        0xFF534D42,         // CIFS
+        0xFE534D42,         // SMB2
+        0x564C,             // NCP
+        0x73757245,         // Coda
+        0x6B414653,         // AFS
+        0x47504653,         // GPFS
+        0x00C36400,         // Ceph
+    };
+
+    bool readRotationalFlag(const std::string& path, bool& rotational) {
+        std::ifstream file(path);
+        int value = 0;
+        if (!(file >> value)) return false;
+        rotational = value != 0;
+        return true;
+    }
+#endif
+
+#ifdef _WIN32
+    std::wstring getVolumeRoot(const std::filesystem::path& path) {
+        wchar_t volume[MAX_PATH];
+        if (!GetVolumePathNameW(path.wstring().c_str(), volume, MAX_PATH)) {
+            return L"";
+        }
+        return volume;
+    }
+#endif
+}
+
+const char* storageTypeName(StorageType type) {
+    switch (type) {
+        case StorageType::Rotational: return "hdd";
+        case StorageType::SolidState: return "ssd";
+        case StorageType::Network: return "network";
+        case StorageType::Unknown: break;
+    }
+    return "unknown";
+}
+
+bool parseStorageType(const std::string& name, StorageType& type) {
+    if (name == "hdd") {
+        type = StorageType::Rotational;
+    } else if (name == "ssd") {
+        type = StorageType::SolidState;
+    } else if (name == "network") {
+        type = StorageType::Network;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool getDeviceId(const std::filesystem::path& path, uint64_t& device) {
+#ifdef _WIN32
+    std::wstring root = getVolumeRoot(path);
+    DWORD serial = 0;
+    if (root.empty() || !GetVolumeInformationW(root.c_str(), nullptr, 0, &serial, nullptr, nullptr, nullptr, 0)) {
+        return false;
+    }
+    device = serial;
+    return true;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    device = static_cast<uint64_t>(st.st_dev);
+    return true;
+#endif
+}
+
+StorageType detectStorageType(const std::filesystem::path& path) {
+#ifdef _WIN32
+    std::wstring root = getVolumeRoot(path);
+    if (root.empty()) return StorageType::Unknown;
+    if (GetDriveTypeW(root.c_str()) == DRIVE_REMOTE) return StorageType::Network;
+
+    // "C:\" -> "\\.\C:"
+    if (root.size() < 2 || root[1] != L':') return StorageType::Unknown;
+    std::wstring device = L"\\\\.\\" + root.substr(0, 2);
+    HANDLE handle = CreateFileW(device.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                nullptr, OPEN_EXISTING, 0, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return StorageType::Unknown;
+
+    STORAGE_PROPERTY_QUERY query = {};
+    query.PropertyId = StorageDeviceSeekPenaltyProperty;
+    query.QueryType = PropertyStandardQuery;
+    DEVICE_SEEK_PENALTY_DESCRIPTOR penalty = {};
+    DWORD returned = 0;
+    BOOL ok = DeviceIoControl(handle, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query),
+                              &penalty, sizeof(penalty), &returned, nullptr);
+    CloseHandle(handle);
+    if (!ok || returned < sizeof(penalty)) return StorageType::Unknown;
+    return penalty.IncursSeekPenalty ? StorageType::Rotational : StorageType::SolidState;
+#elif defined(__linux__)
+    struct statfs fs;
+    if (statfs(path.c_str(), &fs) == 0) {
+        for (uint32_t magic : kNetworkFsMagic) {
+            if (static_cast<uint32_t>(fs.f_type) == magic) return StorageType::Network;
+        }
+    }
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return StorageType::Unknown;
+
+    // Partitions have no queue directory of their own, the flag lives on the
+    // parent disk one level up.
+    std::string base = "/sys/dev/block/" + std::to_string(major(st.st_dev)) + ":" +
+                       std::to_string(minor(st.st_dev));
+    bool rotational = false;
+    if (readRotationalFlag(base + "/queue/rotational", rotational) ||
+        readRotationalFlag(base + "/../queue/rotational", rotational)) {
+        return rotational ? StorageType::Rotational : StorageType::SolidState;
+    }
+    return StorageType::Unknown;
+#else
+    (void)path;
+    return StorageType::Unknown;
+#endif
+}
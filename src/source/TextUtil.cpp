@@ -0,0 +1,66 @@
+#include "TextUtil.h"
+#include <cstdio>
+#include <stdexcept>
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool parseSize(const std::string& text, uint64_t& value) {
+    // std::stoull would accept leading whitespace and a sign, wrapping -1
+    if (text.empty() || text[0] < '0' || text[0] > '9') return false;
+    size_t pos = 0;
+    try {
+        value = std::stoull(text, &pos);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (pos == text.size()) return true;
+    if (pos + 1 != text.size()) return false;
+    unsigned shift = 0;
+    switch (text[pos]) {
+        case 'K': case 'k': shift = 10; break;
+        case 'M': case 'm': shift = 20; break;
+        case 'G': case 'g': shift = 30; break;
+        default: return false;
+    }
+    if (value > (UINT64_MAX >> shift)) return false;
+    value <<= shift;
+    return true;
+}
+
+bool parseCount(const std::string& text, uint64_t& value) {
+    if (text.empty()) return false;
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        uint64_t digit = static_cast<uint64_t>(c - '0');
+        if (value > (UINT64_MAX - digit) / 10) return false;
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+std::string escapeJson(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    escaped += buffer;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
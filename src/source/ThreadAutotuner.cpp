@@ -0,0 +1,72 @@
+#include "ThreadAutotuner.h"
+#include <algorithm>
+
+namespace {
+    // Relative throughput gain required to keep adding workers
+    constexpr double kMinGain = 0.05;
+    // Latency above this multiple of the best observed latency halves the pool
+    constexpr double kLatencyLimit = 3.0;
+    // Allowed upward drift of the latency baseline per interval, so that a
+    // permanent workload change is eventually accepted as the new normal
+    constexpr double kBaselineDrift = 1.05;
+    constexpr size_t kHoldIntervals = 4;
+}
+
+ThreadAutotuner::ThreadAutotuner(size_t initialThreads, size_t minThreads, size_t maxThreads)
+    : minThreads(std::max<size_t>(minThreads, 1)),
+      maxThreads(std::max(maxThreads, std::max<size_t>(minThreads, 1))),
+      phase(Phase::Probing), holdIntervals(0), lastThroughput(0.0),
+      bestLatency(0.0), hasSample(false) {
+    threads = std::clamp(initialThreads, this->minThreads, this->maxThreads);
+}
+
+size_t ThreadAutotuner::getThreads() const {
+    return threads;
+}
+
+TuningDecision ThreadAutotuner::update(double throughput, double latency) {
+    TuningDecision decision;
+    decision.previousThreads = threads;
+    decision.throughput = throughput;
+    decision.latency = latency;
+
+    if (latency > 0.0) {
+        bestLatency = (bestLatency > 0.0) ? std::min(latency, bestLatency * kBaselineDrift) : latency;
+    }
+
+    if (!hasSample) {
+        hasSample = true;
+        if (threads < maxThreads) threads++;
+        decision.reason = "initial probe";
+    } else if (bestLatency > 0.0 && latency > bestLatency * kLatencyLimit && threads > minThreads) {
+        // Multiplicative decrease: the device is saturated
+        threads = std::max(minThreads, threads / 2);
+        phase = Phase::Holding;
+        holdIntervals = 0;
+        decision.reason = "latency rise";
+    } else if (phase == Phase::Probing) {
+        if (throughput > lastThroughput * (1.0 + kMinGain)) {
+            if (threads < maxThreads) {
+                threads++;
+                decision.reason = "throughput improved";
+            } else {
+                decision.reason = "at maximum";
+            }
+        } else {
+            if (threads > minThreads) threads--;
+            phase = Phase::Holding;
+            holdIntervals = 0;
+            decision.reason = "no improvement";
+        }
+    } else if (++holdIntervals >= kHoldIntervals) {
+        phase = Phase::Probing;
+        if (threads < maxThreads) threads++;
+        decision.reason = "probing";
+    } else {
+        decision.reason = "holding";
+    }
+
+    lastThroughput = throughput;
+    decision.threads = threads;
+    return decision;
+}
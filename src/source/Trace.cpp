@@ -0,0 +1,138 @@
+#include "Trace.h"
+#include "TextUtil.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    // Trace timestamps are microseconds; three decimals keep nanoseconds
+    std::string microseconds(uint64_t nanoseconds) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%llu.%03llu",
+                      static_cast<unsigned long long>(nanoseconds / 1000),
+                      static_cast<unsigned long long>(nanoseconds % 1000));
+        return buffer;
+    }
+}
+
+Tracer::Tracer() : origin(std::chrono::steady_clock::now()) {}
+
+Tracer& Tracer::getInstance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+uint64_t Tracer::now() const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+}
+
+Tracer::ThreadBuffer& Tracer::localBuffer() {
+    // Shared with the tracer, so spans survive the thread that recorded them
+    thread_local std::shared_ptr<ThreadBuffer> local;
+    if (!local) {
+        local = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(mutex);
+        local->thread = ++nextThread;
+        buffers.push_back(local);
+    }
+    return *local;
+}
+
+void Tracer::record(TraceEvent event) {
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() >= kMaxEventsPerThread) {
+        dropped++;
+        return;
+    }
+    buffer.events.push_back(std::move(event));
+}
+
+std::string Tracer::toJson() const {
+    std::vector<std::pair<uint32_t, TraceEvent>> events;
+    std::vector<uint32_t> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            threads.push_back(buffer->thread);
+            for (const auto& event : buffer->events) {
+                events.emplace_back(buffer->thread, event);
+            }
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const auto& a, const auto& b) {
+        return a.second.start < b.second.start;
+    });
+
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"cookiemonster\"}}";
+    for (uint32_t thread : threads) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+            << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+    }
+    for (const auto& [thread, event] : events) {
+        out << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"" << event.category
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+            << ",\"ts\":" << microseconds(event.start) << ",\"dur\":" << microseconds(event.duration);
+        if (event.argName) out << ",\"args\":{\"" << event.argName << "\":" << event.argValue << "}";
+        out << "}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+bool Tracer::write(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << toJson();
+    return out.good();
+}
+
+size_t Tracer::getEventCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        count += buffer->events.size();
+    }
+    return count;
+}
+
+void Tracer::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+    }
+    // Buffers only the tracer still holds belong to finished threads
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+                                 [](const auto& buffer) { return buffer.use_count() == 1; }),
+                  buffers.end());
+    dropped = 0;
+}
+
+TraceScope::TraceScope(const char* name, const char* category)
+    : literal(name), category(category), active(Tracer::getInstance().isEnabled()) {
+    if (active) start = Tracer::getInstance().now();
+}
+
+TraceScope::TraceScope(std::string name, const char* category)
+    : name(std::move(name)), category(category), active(Tracer::getInstance().isEnabled()) {
+    if (active) start = Tracer::getInstance().now();
+}
+
+TraceScope::~TraceScope() {
+    if (!active) return;
+    Tracer& tracer = Tracer::getInstance();
+    TraceEvent event;
+    event.name = literal ? std::string(literal) : std::move(name);
+    event.category = category;
+    event.start = start;
+    event.duration = tracer.now() - start;
+    event.argName = argName;
+    event.argValue = argValue;
+    tracer.record(std::move(event));
+}
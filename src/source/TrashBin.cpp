@@ -0,0 +1,247 @@
+#include "TrashBin.h"
+#include "BinaryIO.h"
+#include "CleaningEngine.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const char* const kInfoSuffix = ".trashinfo";
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    std::string percentDecode(const std::string& text) {
+        std::string decoded;
+        decoded.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '%' && i + 2 < text.size()) {
+                int high = hexValue(text[i + 1]);
+                int low = hexValue(text[i + 2]);
+                if (high >= 0 && low >= 0) {
+                    decoded.push_back(static_cast<char>(high * 16 + low));
+                    i += 2;
+                    continue;
+                }
+            }
+            decoded.push_back(text[i]);
+        }
+        return decoded;
+    }
+
+    // DeletionDate is local time in the form YYYY-MM-DDThh:mm:ss
+    bool parseDeletionDate(const std::string& text, std::time_t& time) {
+        std::tm tm = {};
+        std::istringstream in(text);
+        in >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
+        if (in.fail()) return false;
+        tm.tm_isdst = -1;
+        time = std::mktime(&tm);
+        return time != static_cast<std::time_t>(-1);
+    }
+
+    // Sum sizes of an item; directories are walked without following links
+    void sizeItem(TrashItem& item) {
+        FileEntry entry;
+        if (!statFileEntry(item.file, entry)) return;
+        item.size = entry.size;
+        item.allocated = entry.allocated;
+        item.inode = entry.inode;
+
+        std::error_code ec;
+        if (!std::filesystem::is_directory(std::filesystem::symlink_status(item.file, ec))) return;
+        const auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (std::filesystem::recursive_directory_iterator it(item.file, options, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            FileEntry child;
+            if (!statFileEntry(it->path(), child)) continue;
+            item.size += child.size;
+            item.allocated += child.allocated;
+        }
+    }
+
+#ifdef __linux__
+    // Mount points from /proc/self/mounts, with octal escapes decoded
+    std::vector<std::filesystem::path> mountPoints() {
+        std::vector<std::filesystem::path> mounts;
+        std::ifstream in("/proc/self/mounts");
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string device, mountPoint;
+            if (!(fields >> device >> mountPoint)) continue;
+            std::string decoded;
+            for (size_t i = 0; i < mountPoint.size(); ++i) {
+                if (mountPoint[i] == '\\' && i + 3 < mountPoint.size()) {
+                    decoded.push_back(static_cast<char>(std::stoi(mountPoint.substr(i + 1, 3), nullptr, 8)));
+                    i += 3;
+                } else {
+                    decoded.push_back(mountPoint[i]);
+                }
+            }
+            mounts.emplace_back(decoded);
+        }
+        return mounts;
+    }
+#endif
+}
+
+bool parseTrashInfo(const std::string& text, std::string& originalPath, std::time_t& deletionTime) {
+    std::istringstream in(text);
+    std::string line;
+    bool inGroup = false;
+    bool sawGroup = false;
+    bool sawPath = false;
+    deletionTime = 0;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (line[0] == '[') {
+            inGroup = (line == "[Trash Info]");
+            sawGroup = sawGroup || inGroup;
+            continue;
+        }
+        if (!inGroup) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (key == "Path") {
+            originalPath = percentDecode(value);
+            sawPath = true;
+        } else if (key == "DeletionDate") {
+            parseDeletionDate(value, deletionTime);
+        }
+    }
+    return sawGroup && sawPath;
+}
+
+std::vector<std::filesystem::path> TrashBin::findAll() {
+    std::vector<std::filesystem::path> found;
+    std::error_code ec;
+    auto addIfPresent = [&found, &ec](const std::filesystem::path& dir) {
+        if (!std::filesystem::is_directory(dir / "info", ec)) return;
+        if (std::find(found.begin(), found.end(), dir) == found.end()) found.push_back(dir);
+    };
+
+    if (const char* dataHome = std::getenv("XDG_DATA_HOME"); dataHome && *dataHome) {
+        addIfPresent(std::filesystem::path(dataHome) / "Trash");
+    } else if (const char* home = std::getenv("HOME")) {
+        addIfPresent(std::filesystem::path(home) / ".local" / "share" / "Trash");
+    }
+
+#ifdef __linux__
+    std::string uid = std::to_string(getuid());
+    for (const auto& mount : mountPoints()) {
+        // $topdir/.Trash is shared and only trusted with the sticky bit set
+        struct stat st;
+        std::filesystem::path shared = mount / ".Trash";
+        if (lstat(shared.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && (st.st_mode & S_ISVTX)) {
+            addIfPresent(shared / uid);
+        }
+        addIfPresent(mount / (".Trash-" + uid));
+    }
+#endif
+    return found;
+}
+
+bool TrashBin::load(std::vector<TrashItem>& items) const {
+    std::error_code ec;
+    std::filesystem::directory_iterator it(directory / "info", ec);
+    if (ec) return false;
+
+    const std::string suffix = kInfoSuffix;
+    for (std::filesystem::directory_iterator end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+
+        TrashItem item;
+        item.info = it->path();
+        item.file = directory / "files" / name.substr(0, name.size() - suffix.size());
+        std::error_code existsEc;
+        if (!std::filesystem::exists(std::filesystem::symlink_status(item.file, existsEc))) continue;
+
+        std::ifstream in(item.info, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!parseTrashInfo(text, item.originalPath, item.deletionTime)) continue;
+
+        sizeItem(item);
+        getDeviceId(directory, item.device);
+        items.push_back(std::move(item));
+    }
+    return true;
+}
+
+bool TrashBin::purge(const std::filesystem::path& file) {
+    std::error_code ec;
+    std::filesystem::remove_all(file, ec);
+    if (ec) return false;
+    // The info file goes last so a failed purge is still listed in the trash
+    std::filesystem::path info = file.parent_path().parent_path() / "info" / (file.filename().string() + kInfoSuffix);
+    std::filesystem::remove(info, ec);
+    return true;
+}
+
+bool TrashBin::pruneDirectorySizes() const {
+    std::filesystem::path cache = directory / "directorysizes";
+    std::ifstream in(cache);
+    if (!in.is_open()) return true;
+
+    // Lines are "size mtime percent-encoded-name"
+    std::string kept;
+    std::string line;
+    bool changed = false;
+    while (std::getline(in, line)) {
+        size_t space = line.rfind(' ');
+        std::error_code ec;
+        if (space != std::string::npos &&
+            !std::filesystem::exists(directory / "files" / percentDecode(line.substr(space + 1)), ec)) {
+            changed = true;
+            continue;
+        }
+        kept += line + "\n";
+    }
+    in.close();
+    if (!changed) return true;
+
+    // Replace atomically so readers never see a partial cache
+    return writeFileAtomically(cache, kept);
+}
+
+std::vector<TrashItem> selectTrashItems(std::vector<TrashItem> items, const TrashPurgePolicy& policy,
+                                        std::time_t now) {
+    std::sort(items.begin(), items.end(),
+        [](const TrashItem& a, const TrashItem& b) { return a.deletionTime < b.deletionTime; });
+
+    bool unlimited = policy.maxAgeDays <= 0 && policy.maxBytes == std::numeric_limits<uint64_t>::max();
+    if (unlimited) return items;
+
+    uint64_t total = 0;
+    for (const auto& item : items) total += item.size;
+
+    std::vector<TrashItem> selected;
+    const std::time_t maxAge = static_cast<std::time_t>(policy.maxAgeDays) * 24 * 60 * 60;
+    for (auto& item : items) {
+        bool tooOld = policy.maxAgeDays > 0 && item.deletionTime != 0 && now - item.deletionTime > maxAge;
+        // Items are oldest first, so the budget evicts least recently trashed ones
+        if (tooOld || total > policy.maxBytes) {
+            total -= item.size;
+            selected.push_back(std::move(item));
+        }
+    }
+    return selected;
+}
@@ -0,0 +1,88 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t threadCount, size_t activeLimit) : pending(0), stopping(false) {
+    threadCount = std::max<size_t>(threadCount, 1);
+    this->activeLimit = (activeLimit == 0) ? threadCount : std::min(activeLimit, threadCount);
+    threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+    bool parkedWorkers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+        ++pending;
+        parkedWorkers = activeLimit < threads.size();
+    }
+    // A single wake-up could land on a parked worker and be lost
+    if (parkedWorkers) {
+        taskAvailable.notify_all();
+    } else {
+        taskAvailable.notify_one();
+    }
+}
+
+void WorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this] { return pending == 0; });
+}
+
+bool WorkerPool::waitFor(std::chrono::steady_clock::duration timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return allDone.wait_for(lock, timeout, [this] { return pending == 0; });
+}
+
+void WorkerPool::setActiveLimit(size_t limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        activeLimit = std::clamp<size_t>(limit, 1, threads.size());
+    }
+    taskAvailable.notify_all();
+}
+
+size_t WorkerPool::getActiveLimit() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return activeLimit;
+}
+
+size_t WorkerPool::getThreadCount() const {
+    return threads.size();
+}
+
+void WorkerPool::workerLoop(size_t index) {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this, index] {
+                return stopping || (index < activeLimit && !tasks.empty());
+            });
+            // Parked workers leave on shutdown, active ones drain the queue first
+            if (index >= activeLimit || tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            allDone.notify_all();
+        }
+    }
+}
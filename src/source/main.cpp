@@ -1,8 +1,41 @@
+#include "Agent.h"
 #include "Cleaner.h"
+#include "Metrics.h"
+#include "TextUtil.h"
+#include "Trace.h"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+// Worker threads a single device pool may be given on the command line
+constexpr uint64_t kMaxThreadsPerDevice = 256;
+
+// Parse a log level name: debug, info, warning or error
+bool parseLogLevel(const std::string& text, LogLevel& level) {
+    if (text == "debug") level = LogLevel::DEBUG;
+    else if (text == "info") level = LogLevel::INFO;
+    else if (text == "warning") level = LogLevel::WARNING;
+    else if (text == "error") level = LogLevel::ERROR;
+    else return false;
+    return true;
+}
+
+// Split a comma-separated list, dropping empty items
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        if (end > start) items.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
 
 void printHelp() {
     std::cout << "CookieMonster - Windows System Cleanup Utility\n\n"
@@ -12,12 +45,60 @@ void printHelp() {
               << "  --dry-run, -d        Perform a dry run without deleting files\n"
               << "  --exclude=PATH       Exclude specific paths (can be used multiple times)\n"
               << "  --include=PATH       Include only specific paths (can be used multiple times)\n"
+              << "  --exclude-types=LIST Never delete these comma-separated types (default: executables,\n"
+              << "                       scripts and documents; empty to clean every type)\n"
+              << "  --allow-types=LIST   Only delete files of these comma-separated types\n"
+              << "  --sniff-types        Type files without an extension by their first bytes\n"
               << "  --no-log             Disable console logging\n"
+              << "  --log-level=LEVEL    Only log debug, info, warning or error and above (default debug)\n"
               << "  --temp               Clean temporary files\n"
               << "  --browser            Clean browser cache\n"
               << "  --recycle            Clean recycle bin\n"
               << "  --registry           Clean registry\n"
-              << "  --all                Clean all (default if no specific options provided)\n";
+              << "  --all                Clean all (default if no specific options provided)\n"
+              << "  --rules=FILE         Clean by the rules in FILE, walking every root once\n"
+              << "  --max-iops=N         Limit delete operations per second across all threads\n"
+              << "  --max-bandwidth=N    Limit bytes per second (suffixes K, M, G accepted)\n"
+              << "  --adaptive-throttle  Back off automatically when delete latency rises\n"
+              << "  --idle-io            Run at idle I/O priority\n"
+              << "  --storage=TYPE:PATH  Treat the device holding PATH as hdd, ssd or network\n"
+              << "  --threads-hdd=N      Worker threads per rotational device (default 1)\n"
+              << "  --threads-ssd=N      Worker threads per solid-state device\n"
+              << "  --threads-network=N  Worker threads per network filesystem\n"
+              << "  --max-threads=N      Upper bound on worker threads per device\n"
+              << "  --autotune           Adjust worker threads at runtime from measured throughput\n"
+              << "  --ignore-open-files  Delete files even while other processes hold them open\n"
+              << "  --open-file-retries=N  Retry rounds for files that were open (default 3, at most 10)\n"
+              << "  --async-io           Keep thousands of stats and deletions in flight (io_uring on\n"
+              << "                       Linux), for network-mounted or high-latency storage\n"
+              << "  --follow-symlinks    Descend into symlinked directories, each directory at most once\n"
+              << "  --max-depth=N        Scan at most N directory levels below each root (default 128)\n"
+              << "  --one-file-system    Do not descend into directories on other devices\n"
+              << "  --all-users          Clean the browser profiles of every account on the host\n"
+              << "  --cache-max-age=N    Evict only browser cache entries unused for N days\n"
+              << "  --cache-budget=N     Evict least recently used cache entries down to N bytes\n"
+              << "  --trash-max-age=N    Only purge trash items deleted more than N days ago\n"
+              << "  --trash-budget=N     Purge the oldest trash items until the rest fits N bytes (K, M, G)\n"
+              << "  --plan-out=FILE      With --dry-run, write a binary deletion plan to FILE\n"
+              << "  --execute-plan=FILE  Delete the entries of a plan without rescanning\n"
+              << "  --backup             Back up temp files and browser cache before cleaning\n"
+              << "  --backup-mode=MODE   copy files into the backup, or quarantine (move) them (default copy)\n"
+              << "  --secure-erase       Overwrite file contents before deleting them; files on copy-on-write\n"
+              << "                       or compressed file systems are reported and only deleted\n"
+              << "  --journal=FILE       Record progress in FILE and resume an interrupted run\n"
+              << "  --metrics-prom=FILE  Write latency histograms and counters in Prometheus text format\n"
+              << "  --metrics-json=FILE  Write the same metrics as JSON with latency percentiles\n"
+              << "  --metrics-interval=N Also rewrite the metrics files every N seconds while running\n"
+              << "  --trace=FILE         Record a timeline of cleaners and worker batches in Chrome\n"
+              << "                       trace-event format (open in chrome://tracing or Perfetto)\n"
+              << "\nAgent:\n"
+              << "  --agent[=ENDPOINT]   Stay resident and run jobs submitted over a local socket (a named\n"
+              << "                       pipe on Windows); the other options configure every job\n"
+              << "  --submit[=ENDPOINT]  Run the selected cleaners as a job of a running agent and\n"
+              << "                       print its progress (--dry-run analyzes, --backup backs up first)\n"
+              << "  --job=KIND           With --submit: clean, analyze or backup (back up without cleaning)\n"
+              << "  --restore=BACKUP     With --submit: restore a backup the agent created\n"
+              << "  --agent-stop[=ENDPOINT]  Stop a running agent after its current job\n";
 }
 
 int main(int argc, char* argv[]) {
@@ -29,8 +110,47 @@ int main(int argc, char* argv[]) {
     bool cleanRegistry = false;
     bool showHelp = false;
     bool noLog = false;
-    std::vector<std::wstring> excludedPaths;
-    std::vector<std::wstring> includedPaths;
+    LogLevel logLevel = LogLevel::DEBUG;
+    bool idleIo = false;
+    bool adaptiveThrottle = false;
+    bool autotune = false;
+    bool ignoreOpenFiles = false;
+    bool allUsers = false;
+    bool asyncIo = false;
+    bool followSymlinks = false;
+    bool oneFileSystem = false;
+    uint64_t maxDepth = 0;
+    uint64_t openFileRetries = 3;
+    uint64_t cacheMaxAge = 0;
+    uint64_t cacheBudget = 0;
+    uint64_t trashMaxAge = 0;
+    uint64_t trashBudget = 0;
+    uint64_t maxThreads = 0;
+    uint64_t maxIops = 0;
+    uint64_t maxBandwidth = 0;
+    std::string planOut;
+    std::string executePlan;
+    std::string journalPath;
+    std::string metricsProm;
+    std::string metricsJson;
+    uint64_t metricsInterval = 0;
+    std::string tracePath;
+    std::string rulesPath;
+    bool withBackup = false;
+    bool secureErase = false;
+    BackupMode backupMode = BackupMode::Copy;
+    std::vector<std::pair<StorageType, std::filesystem::path>> storageOverrides;
+    std::vector<std::pair<StorageType, uint64_t>> storageThreads;
+    std::vector<std::filesystem::path> excludedPaths;
+    std::vector<std::filesystem::path> includedPaths;
+    std::optional<std::vector<std::string>> excludedTypes;
+    std::vector<std::string> allowedTypes;
+    bool sniffTypes = false;
+    std::optional<std::string> agentEndpoint;
+    std::optional<std::string> submitEndpoint;
+    std::optional<std::string> stopEndpoint;
+    std::optional<JobKind> jobKind;
+    std::string restorePath;
 
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -42,6 +162,11 @@ int main(int argc, char* argv[]) {
             dryRun = true;
         } else if (arg == "--no-log") {
             noLog = true;
+        } else if (arg.find("--log-level=") == 0) {
+            if (!parseLogLevel(arg.substr(12), logLevel)) {
+                std::cerr << "Invalid value for --log-level: " << arg.substr(12) << "\n";
+                return 1;
+            }
         } else if (arg == "--temp") {
             cleanTemp = true;
         } else if (arg == "--browser") {
@@ -52,17 +177,156 @@ int main(int argc, char* argv[]) {
             cleanRegistry = true;
         } else if (arg == "--all") {
             cleanTemp = cleanBrowser = cleanRecycle = cleanRegistry = true;
+        } else if (arg == "--idle-io") {
+            idleIo = true;
+        } else if (arg == "--adaptive-throttle") {
+            adaptiveThrottle = true;
+        } else if (arg.find("--max-iops=") == 0) {
+            if (!parseSize(arg.substr(11), maxIops)) {
+                std::cerr << "Invalid value for --max-iops: " << arg.substr(11) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--max-bandwidth=") == 0) {
+            if (!parseSize(arg.substr(16), maxBandwidth)) {
+                std::cerr << "Invalid value for --max-bandwidth: " << arg.substr(16) << "\n";
+                return 1;
+            }
+        } else if (arg == "--autotune") {
+            autotune = true;
+        } else if (arg == "--ignore-open-files") {
+            ignoreOpenFiles = true;
+        } else if (arg == "--async-io") {
+            asyncIo = true;
+        } else if (arg == "--follow-symlinks") {
+            followSymlinks = true;
+        } else if (arg == "--one-file-system") {
+            oneFileSystem = true;
+        } else if (arg.find("--max-depth=") == 0) {
+            if (!parseCount(arg.substr(12), maxDepth) || maxDepth == 0 || maxDepth > INT32_MAX) {
+                std::cerr << "Invalid value for --max-depth: " << arg.substr(12) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--open-file-retries=") == 0) {
+            // The retry delay doubles every round
+            if (!parseCount(arg.substr(20), openFileRetries) || openFileRetries > 10) {
+                std::cerr << "Invalid value for --open-file-retries: " << arg.substr(20) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--max-threads=") == 0) {
+            if (!parseCount(arg.substr(14), maxThreads) || maxThreads == 0 || maxThreads > kMaxThreadsPerDevice) {
+                std::cerr << "Invalid value for --max-threads: " << arg.substr(14) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--storage=") == 0) {
+            std::string spec = arg.substr(10);
+            size_t colon = spec.find(':');
+            StorageType type;
+            if (colon == std::string::npos || !parseStorageType(spec.substr(0, colon), type)) {
+                std::cerr << "Invalid value for --storage: " << spec << "\n";
+                return 1;
+            }
+            storageOverrides.emplace_back(type, std::filesystem::u8path(spec.substr(colon + 1)));
+        } else if (arg.find("--threads-") == 0 && arg.find('=') != std::string::npos) {
+            size_t eq = arg.find('=');
+            StorageType type;
+            uint64_t threads = 0;
+            if (!parseStorageType(arg.substr(10, eq - 10), type) || !parseCount(arg.substr(eq + 1), threads) ||
+                threads > kMaxThreadsPerDevice) {
+                std::cerr << "Invalid option: " << arg << "\n";
+                return 1;
+            }
+            storageThreads.emplace_back(type, threads);
+        } else if (arg == "--all-users") {
+            allUsers = true;
+        } else if (arg.find("--cache-max-age=") == 0) {
+            if (!parseCount(arg.substr(16), cacheMaxAge) || cacheMaxAge > INT32_MAX) {
+                std::cerr << "Invalid value for --cache-max-age: " << arg.substr(16) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--cache-budget=") == 0) {
+            if (!parseSize(arg.substr(15), cacheBudget)) {
+                std::cerr << "Invalid value for --cache-budget: " << arg.substr(15) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--trash-max-age=") == 0) {
+            if (!parseCount(arg.substr(16), trashMaxAge) || trashMaxAge > INT32_MAX) {
+                std::cerr << "Invalid value for --trash-max-age: " << arg.substr(16) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--trash-budget=") == 0) {
+            if (!parseSize(arg.substr(15), trashBudget)) {
+                std::cerr << "Invalid value for --trash-budget: " << arg.substr(15) << "\n";
+                return 1;
+            }
+        } else if (arg == "--backup") {
+            withBackup = true;
+        } else if (arg.find("--backup-mode=") == 0) {
+            std::string mode = arg.substr(14);
+            if (mode == "copy") {
+                backupMode = BackupMode::Copy;
+            } else if (mode == "quarantine") {
+                backupMode = BackupMode::Quarantine;
+            } else {
+                std::cerr << "Invalid value for --backup-mode: " << mode << "\n";
+                return 1;
+            }
+        } else if (arg.find("--metrics-prom=") == 0) {
+            metricsProm = arg.substr(15);
+        } else if (arg.find("--metrics-json=") == 0) {
+            metricsJson = arg.substr(15);
+        } else if (arg.find("--metrics-interval=") == 0) {
+            // At most a day between rewrites
+            if (!parseCount(arg.substr(19), metricsInterval) || metricsInterval == 0 || metricsInterval > 86400) {
+                std::cerr << "Invalid value for --metrics-interval: " << arg.substr(19) << "\n";
+                return 1;
+            }
+        } else if (arg.find("--exclude-types=") == 0) {
+            excludedTypes = splitList(arg.substr(16));
+        } else if (arg.find("--allow-types=") == 0) {
+            allowedTypes = splitList(arg.substr(14));
+        } else if (arg == "--sniff-types") {
+            sniffTypes = true;
+        } else if (arg == "--secure-erase") {
+            secureErase = true;
+        } else if (arg == "--agent" || arg.find("--agent=") == 0) {
+            agentEndpoint = arg.size() > 8 ? arg.substr(8) : defaultAgentEndpoint();
+        } else if (arg == "--submit" || arg.find("--submit=") == 0) {
+            submitEndpoint = arg.size() > 9 ? arg.substr(9) : defaultAgentEndpoint();
+        } else if (arg == "--agent-stop" || arg.find("--agent-stop=") == 0) {
+            stopEndpoint = arg.size() > 13 ? arg.substr(13) : defaultAgentEndpoint();
+        } else if (arg.find("--job=") == 0) {
+            std::string kind = arg.substr(6);
+            if (kind == "clean") {
+                jobKind = JobKind::Clean;
+            } else if (kind == "analyze") {
+                jobKind = JobKind::Analyze;
+            } else if (kind == "backup") {
+                jobKind = JobKind::Backup;
+            } else {
+                std::cerr << "Invalid value for --job: " << kind << "\n";
+                return 1;
+            }
+        } else if (arg.find("--restore=") == 0) {
+            restorePath = arg.substr(10);
+        } else if (arg.find("--rules=") == 0) {
+            rulesPath = arg.substr(8);
+        } else if (arg.find("--trace=") == 0) {
+            tracePath = arg.substr(8);
+        } else if (arg.find("--journal=") == 0) {
+            journalPath = arg.substr(10);
+        } else if (arg.find("--plan-out=") == 0) {
+            planOut = arg.substr(11);
+        } else if (arg.find("--execute-plan=") == 0) {
+            executePlan = arg.substr(15);
         } else if (arg.find("--exclude=") == 0) {
-            std::string path = arg.substr(10);
-            excludedPaths.push_back(std::wstring(path.begin(), path.end()));
+            excludedPaths.push_back(std::filesystem::u8path(arg.substr(10)));
         } else if (arg.find("--include=") == 0) {
-            std::string path = arg.substr(10);
-            includedPaths.push_back(std::wstring(path.begin(), path.end()));
+            includedPaths.push_back(std::filesystem::u8path(arg.substr(10)));
         }
     }
 
-    // If no specific options are provided, clean all
-    if (!cleanTemp && !cleanBrowser && !cleanRecycle && !cleanRegistry) {
+    // If no specific options are provided, clean all; a rule file replaces the defaults
+    if (!cleanTemp && !cleanBrowser && !cleanRecycle && !cleanRegistry && rulesPath.empty()) {
         cleanTemp = cleanBrowser = cleanRecycle = cleanRegistry = true;
     }
 
@@ -71,10 +335,147 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    // Clients only talk to the agent; the agent's own options configure the jobs
+    if ((jobKind || !restorePath.empty()) && !submitEndpoint) {
+        std::cerr << "--job and --restore require --submit\n";
+        return 1;
+    }
+    if (stopEndpoint) {
+        std::string error;
+        if (!AgentClient(*stopEndpoint).shutdown(error)) {
+            std::cerr << "Cannot stop agent: " << error << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (submitEndpoint) {
+        JobRequest request;
+        request.kind = jobKind ? *jobKind : (dryRun ? JobKind::Analyze : JobKind::Clean);
+        if (!restorePath.empty()) {
+            request.kind = JobKind::Restore;
+            request.backupPath = restorePath;
+        }
+        if (cleanTemp) request.targets |= kJobTemp;
+        if (cleanBrowser) request.targets |= kJobBrowser;
+        if (cleanRecycle) request.targets |= kJobRecycle;
+        if (cleanRegistry) request.targets |= kJobRegistry;
+        request.withBackup = withBackup && request.kind == JobKind::Clean;
+
+        JobResult result;
+        std::string error;
+        auto printProgress = [noLog](LogLevel level, const std::string& message) {
+            if (noLog) return;
+            static const char* const names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+            std::cout << "[" << names[static_cast<int>(level)] << "] " << message << std::endl;
+        };
+        if (!AgentClient(*submitEndpoint).submit(request, printProgress, result, error)) {
+            std::cerr << "Job failed: " << error << "\n";
+            return 1;
+        }
+        std::cout << "Job " << result.jobId << (result.coalesced ? " (joined an identical queued job)" : "")
+                  << ": " << result.filesDeleted << " files, " << cleaner.formatSize(result.bytesFreed) << ", "
+                  << result.errors << " errors" << (result.message.empty() ? "" : " - " + result.message) << "\n";
+        return result.success ? 0 : 1;
+    }
+    if (agentEndpoint && (!executePlan.empty() || !planOut.empty() || !rulesPath.empty())) {
+        std::cerr << "--agent cannot be combined with --execute-plan, --plan-out or --rules\n";
+        return 1;
+    }
+
+    // Rules are parsed and compiled once, before any work starts
+    RulePlan rulePlan;
+    if (!rulesPath.empty()) {
+        std::vector<CleaningRule> rules;
+        std::string error;
+        if (!loadRules(std::filesystem::u8path(rulesPath), rules, error)) {
+            std::cerr << "Invalid rule file " << rulesPath << ": " << error << "\n";
+            return 1;
+        }
+        rulePlan = RulePlan(std::move(rules));
+    }
+
+    if (secureErase && withBackup && backupMode == BackupMode::Quarantine) {
+        std::cerr << "--secure-erase cannot be combined with --backup-mode=quarantine\n";
+        return 1;
+    }
+    if (!planOut.empty() && !dryRun) {
+        std::cerr << "--plan-out requires --dry-run\n";
+        return 1;
+    }
+    if (!executePlan.empty() && (dryRun || !planOut.empty())) {
+        std::cerr << "--execute-plan cannot be combined with --dry-run or --plan-out\n";
+        return 1;
+    }
+
     // Configure logger
     Logger::getInstance().setConsoleOutput(!noLog);
+    Logger::getInstance().setLevel(logLevel);
     Logger::getInstance().log(LogLevel::INFO, "CookieMonster started" + std::string(dryRun ? " (dry run)" : ""));
 
+    Tracer::getInstance().setEnabled(!tracePath.empty());
+
+    // Latencies are only measured when someone reads them
+    std::unique_ptr<MetricsReporter> metricsReporter;
+    const bool metricsEnabled = !metricsProm.empty() || !metricsJson.empty();
+    Metrics::getInstance().setEnabled(metricsEnabled);
+    if (metricsEnabled && metricsInterval > 0) {
+        metricsReporter = std::make_unique<MetricsReporter>(metricsProm, metricsJson,
+                                                            std::chrono::seconds(metricsInterval));
+    }
+    auto writeReports = [&] {
+        if (metricsReporter) {
+            metricsReporter->stop();
+        } else if (metricsEnabled && !Metrics::getInstance().write(metricsProm, metricsJson)) {
+            Logger::getInstance().log(LogLevel::ERROR, "Cannot write metrics files");
+        }
+        // Spans of every thread are merged only now
+        Tracer& tracer = Tracer::getInstance();
+        if (!tracePath.empty()) {
+            tracer.setEnabled(false);
+            if (!tracer.write(tracePath)) {
+                Logger::getInstance().log(LogLevel::ERROR, "Cannot write trace file " + tracePath);
+            } else if (tracer.getDroppedCount() > 0) {
+                Logger::getInstance().log(LogLevel::WARNING,
+                    "Trace buffers were full, " + std::to_string(tracer.getDroppedCount()) + " spans dropped");
+            }
+        }
+    };
+
+    // Configure I/O scheduling before any work starts
+    if (idleIo) {
+        cleaner.enableIdleIoPriority();
+    }
+    cleaner.setIoLimits(maxIops, maxBandwidth);
+    cleaner.setAdaptiveThrottle(adaptiveThrottle);
+    if (maxThreads > 0) {
+        cleaner.setMaxThreads(static_cast<int>(maxThreads));
+    }
+    cleaner.setAutotune(autotune);
+    cleaner.setOpenFileCheck(!ignoreOpenFiles);
+    cleaner.setAsyncIo(asyncIo);
+    cleaner.setFollowSymlinks(followSymlinks);
+    cleaner.setSameFileSystem(oneFileSystem);
+    if (maxDepth > 0) {
+        cleaner.setMaxScanDepth(static_cast<int>(maxDepth));
+    }
+    cleaner.setAllUsers(allUsers);
+    cleaner.setBackupMode(backupMode);
+    cleaner.setSecureErase(secureErase);
+    if (excludedTypes) {
+        cleaner.setExcludedFileTypes(*excludedTypes);
+    }
+    cleaner.setAllowedFileTypes(allowedTypes);
+    cleaner.setFileTypeSniffing(sniffTypes);
+    cleaner.setOpenFileRetries(static_cast<int>(openFileRetries), 250);
+    cleaner.setTrashPolicy(static_cast<int>(trashMaxAge), trashBudget);
+    cleaner.setCacheEvictionPolicy(static_cast<int>(cacheMaxAge), cacheBudget);
+    for (const auto& [type, threads] : storageThreads) {
+        cleaner.setStorageConcurrency(type, static_cast<size_t>(threads));
+    }
+    for (const auto& [type, path] : storageOverrides) {
+        cleaner.setStorageType(path, type);
+    }
+
     // Set excluded and included paths
     if (!excludedPaths.empty()) {
         cleaner.setExcludedPaths(excludedPaths);
@@ -89,17 +490,52 @@ int main(int argc, char* argv[]) {
             "Running without administrator privileges. Some operations may be restricted.");
     }
 
+    if (!journalPath.empty() && !cleaner.enableJournal(journalPath)) {
+        return 1;
+    }
+
+    // A resident agent keeps this cleaner, and its caches, for every job
+    if (agentEndpoint) {
+        AgentServer agent(*agentEndpoint, makeCleanerJobRunner(cleaner));
+        std::string error;
+        if (!agent.start(error)) {
+            Logger::getInstance().log(LogLevel::ERROR, "Cannot start agent: " + error);
+            return 1;
+        }
+        Logger::getInstance().log(LogLevel::INFO, "Agent listening on " + *agentEndpoint);
+        agent.wait();
+        agent.stop();
+        AgentStats stats = agent.getStats();
+        Logger::getInstance().log(LogLevel::INFO, "Agent stopped after " + std::to_string(stats.jobsRun) +
+            " jobs (" + std::to_string(stats.jobsCoalesced) + " requests coalesced)");
+        writeReports();
+        return 0;
+    }
+
+    // A reviewed plan replaces the scan entirely
+    if (!executePlan.empty()) {
+        bool executed = cleaner.executePlan(executePlan);
+        cleaner.showStatistics();
+        writeReports();
+        Logger::getInstance().log(LogLevel::INFO, "CookieMonster completed");
+        return executed ? 0 : 1;
+    }
+
+    if (!planOut.empty() && !cleaner.startPlan(planOut)) {
+        return 1;
+    }
+
     // Perform cleaning operations
     if (cleanTemp) {
         Logger::getInstance().log(LogLevel::INFO, "Cleaning temporary files...");
-        if (cleaner.cleanTempFiles(dryRun)) {
+        if (withBackup ? cleaner.cleanTempFilesWithBackup(dryRun) : cleaner.cleanTempFiles(dryRun)) {
             Logger::getInstance().log(LogLevel::INFO, "Temporary files cleaned successfully.");
         }
     }
 
     if (cleanBrowser && cleaner.isAdmin()) {
         Logger::getInstance().log(LogLevel::INFO, "Cleaning browser cache...");
-        if (cleaner.cleanBrowserCache(dryRun)) {
+        if (withBackup ? cleaner.cleanBrowserCacheWithBackup(dryRun) : cleaner.cleanBrowserCache(dryRun)) {
             Logger::getInstance().log(LogLevel::INFO, "Browser cache cleaned successfully.");
         }
     }
@@ -118,8 +554,20 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (!rulesPath.empty()) {
+        Logger::getInstance().log(LogLevel::INFO, "Cleaning by rules...");
+        if (cleaner.cleanRules(rulePlan, dryRun)) {
+            Logger::getInstance().log(LogLevel::INFO, "Rules applied successfully.");
+        }
+    }
+
+    if (!planOut.empty() && !cleaner.finishPlan()) {
+        return 1;
+    }
+
     // Show statistics
     cleaner.showStatistics();
+    writeReports();
 
     Logger::getInstance().log(LogLevel::INFO, "CookieMonster completed");
     return 0;
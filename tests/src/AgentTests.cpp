@@ -0,0 +1,153 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/Agent.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <thread>
+#include <tuple>
+
+namespace {
+    std::string testEndpoint() {
+#ifdef _WIN32
+        return "\\\\.\\pipe\\cookiemonster_agent_test";
+#else
+        return (std::filesystem::temp_directory_path() / "cookiemonster_agent_test.sock").string();
+#endif
+    }
+
+    template <typename Predicate>
+    bool waitFor(Predicate predicate) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!predicate()) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+}
+
+TEST_CASE("Agent messages round-trip", "[agent]") {
+    JobRequest request;
+    request.kind = JobKind::Restore;
+    request.targets = kJobTemp | kJobRegistry;
+    request.withBackup = true;
+    request.backupPath = "/var/backups/temp_20240101";
+
+    JobRequest decoded;
+    std::string payload = encodeJobRequest(request);
+    REQUIRE(decodeJobRequest(payload, decoded));
+    REQUIRE(decoded == request);
+    for (size_t length = 0; length < payload.size(); ++length) {
+        REQUIRE_FALSE(decodeJobRequest(payload.substr(0, length), decoded));
+    }
+    payload[1] = 42;
+    REQUIRE_FALSE(decodeJobRequest(payload, decoded));
+
+    JobResult result;
+    result.success = true;
+    result.filesDeleted = 12;
+    result.bytesFreed = 1ull << 40;
+    result.errors = 3;
+    result.message = "partial";
+    JobResult back;
+    back.jobId = 7;
+    REQUIRE(decodeJobResult(encodeJobResult(result), back));
+    REQUIRE(back.success);
+    REQUIRE(back.filesDeleted == 12);
+    REQUIRE(back.bytesFreed == 1ull << 40);
+    REQUIRE(back.errors == 3);
+    REQUIRE(back.message == "partial");
+    REQUIRE(back.jobId == 7);
+}
+
+TEST_CASE("Agent runs submitted jobs", "[agent]") {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> runs{0};
+    auto runner = [&](const JobRequest& request) {
+        int run = ++runs;
+        Logger::getInstance().log(LogLevel::INFO, "job " + std::to_string(run) + " working");
+        // The first job holds the worker so that later ones queue up
+        if (run == 1) released.wait();
+        JobResult result;
+        result.success = true;
+        result.filesDeleted = request.targets;
+        result.bytesFreed = 100;
+        return result;
+    };
+
+    AgentServer agent(testEndpoint(), runner);
+    std::string error;
+    REQUIRE(agent.start(error));
+
+    SECTION("A second agent cannot take the endpoint") {
+        AgentServer other(testEndpoint(), runner);
+        REQUIRE_FALSE(other.start(error));
+        REQUIRE_FALSE(error.empty());
+        release.set_value();
+    }
+
+    SECTION("Progress is streamed and equal queued jobs are coalesced") {
+        auto submit = [](uint32_t targets) {
+            JobRequest request;
+            request.kind = JobKind::Analyze;
+            request.targets = targets;
+            std::vector<std::string> lines;
+            JobResult result;
+            std::string submitError;
+            bool ok = AgentClient(testEndpoint()).submit(request, [&lines](LogLevel, const std::string& line) {
+                lines.push_back(line);
+            }, result, submitError);
+            return std::make_tuple(ok, result, lines);
+        };
+
+        auto first = std::async(std::launch::async, submit, kJobTemp);
+        REQUIRE(waitFor([&] { return runs == 1; }));
+        auto second = std::async(std::launch::async, submit, kJobTemp | kJobBrowser);
+        REQUIRE(waitFor([&] { return agent.getStats().queued == 1; }));
+        auto third = std::async(std::launch::async, submit, kJobTemp | kJobBrowser);
+        REQUIRE(waitFor([&] { return agent.getStats().jobsCoalesced == 1; }));
+        release.set_value();
+
+        auto [firstOk, firstResult, firstLines] = first.get();
+        auto [secondOk, secondResult, secondLines] = second.get();
+        auto [thirdOk, thirdResult, thirdLines] = third.get();
+        REQUIRE(firstOk);
+        REQUIRE(secondOk);
+        REQUIRE(thirdOk);
+        REQUIRE(runs == 2);
+        REQUIRE(firstResult.filesDeleted == kJobTemp);
+        REQUIRE(firstLines == std::vector<std::string>{"job 1 working"});
+        REQUIRE(secondResult.jobId == thirdResult.jobId);
+        REQUIRE(secondResult.jobId != firstResult.jobId);
+        REQUIRE(secondResult.coalesced != thirdResult.coalesced);
+        REQUIRE(secondResult.filesDeleted == (kJobTemp | kJobBrowser));
+        REQUIRE(thirdResult.bytesFreed == 100);
+        REQUIRE(secondLines == std::vector<std::string>{"job 2 working"});
+        REQUIRE(thirdLines == secondLines);
+        REQUIRE(agent.getStats().jobsRun == 2);
+    }
+
+    SECTION("A shutdown request ends the wait and refuses new jobs") {
+        release.set_value();
+        auto waiting = std::async(std::launch::async, [&agent] { agent.wait(); });
+        auto stopping = std::async(std::launch::async, [] {
+            std::string stopError;
+            return AgentClient(testEndpoint()).shutdown(stopError);
+        });
+        REQUIRE(waiting.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+
+        JobResult result;
+        REQUIRE(AgentClient(testEndpoint()).submit(JobRequest(), nullptr, result, error));
+        REQUIRE_FALSE(result.success);
+        REQUIRE(result.message == "agent is shutting down");
+
+        agent.stop();
+        REQUIRE(stopping.get());
+        REQUIRE(runs == 0);
+        REQUIRE_FALSE(AgentClient(testEndpoint()).submit(JobRequest(), nullptr, result, error));
+    }
+
+    agent.stop();
+}
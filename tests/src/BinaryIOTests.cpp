@@ -0,0 +1,43 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/BinaryIO.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace {
+    std::string readAll(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+}
+
+TEST_CASE("Atomic file replacement", "[binaryio]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_atomic_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    auto target = root / "index";
+
+    SECTION("New contents replace the file and the temporary file is gone") {
+        REQUIRE(writeFileAtomically(target, "old"));
+        REQUIRE(writeFileAtomically(target, std::string("new\0data", 8)));
+        REQUIRE(readAll(target) == std::string("new\0data", 8));
+        REQUIRE_FALSE(std::filesystem::exists(root / "index.tmp"));
+    }
+
+    SECTION("A named temporary file is used instead of the default") {
+        REQUIRE(writeFileAtomically(target, "data", root / "temp-index"));
+        REQUIRE(readAll(target) == "data");
+        REQUIRE_FALSE(std::filesystem::exists(root / "temp-index"));
+    }
+
+    SECTION("A failed rename keeps the old file and removes the temporary file") {
+        std::filesystem::create_directories(root / "busy" / "child");
+        REQUIRE_FALSE(writeFileAtomically(root / "busy", "data"));
+        REQUIRE(std::filesystem::is_directory(root / "busy" / "child"));
+        REQUIRE_FALSE(std::filesystem::exists(root / "busy.tmp"));
+        REQUIRE_FALSE(writeFileAtomically(root / "missing" / "index", "data"));
+    }
+
+    std::filesystem::remove_all(root);
+}
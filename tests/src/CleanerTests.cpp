@@ -35,6 +35,16 @@ TEST_CASE("Basic functionality", "[basic]") {
         }
         REQUIRE(atLeastOneExists);
     }
+
+    SECTION("Scan settings") {
+        REQUIRE_FALSE(cleaner.isFollowingSymlinks());
+        cleaner.setFollowSymlinks(true);
+        REQUIRE(cleaner.isFollowingSymlinks());
+        cleaner.setMaxScanDepth(5);
+        REQUIRE(cleaner.getMaxScanDepth() == 5);
+        cleaner.setMaxScanDepth(-1);
+        REQUIRE(cleaner.getMaxScanDepth() > 0);
+    }
 }
 
 TEST_CASE("File operations in user space", "[file_ops]") {
@@ -0,0 +1,336 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/CleaningEngine.h"
+#include "../../src/include/IoExecutor.h"
+#include "../../src/include/WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+    std::filesystem::path makeTree(const std::string& name, int files) {
+        auto root = std::filesystem::temp_directory_path() / name;
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root / "nested");
+        for (int i = 0; i < files; ++i) {
+            auto dir = (i % 2 == 0) ? root : root / "nested";
+            std::ofstream file(dir / ("file" + std::to_string(i) + ".tmp"), std::ios::binary);
+            file << std::string(100, 'x');
+        }
+        return root;
+    }
+}
+
+TEST_CASE("Worker pool", "[engine]") {
+    std::atomic<int> counter(0);
+    WorkerPool pool(4);
+    REQUIRE(pool.getThreadCount() == 4);
+    for (int i = 0; i < 100; ++i) {
+        pool.submit([&counter] { counter++; });
+    }
+    pool.wait();
+    REQUIRE(counter == 100);
+
+    SECTION("Active limit can change while running") {
+        WorkerPool limited(4, 1);
+        REQUIRE(limited.getActiveLimit() == 1);
+        for (int i = 0; i < 50; ++i) {
+            limited.submit([&counter] { counter++; });
+        }
+        limited.setActiveLimit(3);
+        REQUIRE(limited.getActiveLimit() == 3);
+        limited.setActiveLimit(0);
+        REQUIRE(limited.getActiveLimit() == 1);
+        REQUIRE(limited.waitFor(std::chrono::seconds(10)));
+        REQUIRE(counter == 150);
+    }
+}
+
+TEST_CASE("Engine scan and delete", "[engine]") {
+    auto root = makeTree("cookiemonster_engine_test", 20);
+    CleaningEngine engine;
+    engine.setBatchSize(3);
+
+    SECTION("Handler sees every file") {
+        auto result = engine.run({root}, true, [](const FileEntry&) { return true; });
+        REQUIRE(result.filesDeleted == 20);
+        REQUIRE(result.bytesFreed == 2000);
+        REQUIRE(result.errors == 0);
+    }
+
+    SECTION("Non-recursive run stays at the top level") {
+        auto result = engine.run({root}, false, [](const FileEntry&) { return true; });
+        REQUIRE(result.filesDeleted == 10);
+    }
+
+    SECTION("Deleting handler removes files") {
+        auto result = engine.run({root}, true, [](const FileEntry& entry) {
+            return std::filesystem::remove(entry.path);
+        });
+        REQUIRE(result.filesDeleted == 20);
+        REQUIRE(std::filesystem::is_empty(root / "nested"));
+    }
+
+    SECTION("Handler exceptions are counted as errors") {
+        auto result = engine.run({root}, true, [](const FileEntry&) -> bool {
+            throw std::runtime_error("boom");
+        });
+        REQUIRE(result.filesDeleted == 0);
+        REQUIRE(result.errors == 20);
+        REQUIRE(result.errorMessages.size() == 20);
+    }
+
+    SECTION("Root sets share one pass but are accounted separately") {
+        std::atomic<int> mismatched(0);
+        auto results = engine.runSets({{root / "nested"}, {root / "missing"}, {root}}, false,
+            [&](const FileEntry& entry) {
+                bool nested = entry.path.parent_path().filename() == "nested";
+                if (nested != (entry.rootSet == 0)) mismatched++;
+                return true;
+            });
+        REQUIRE(results.size() == 3);
+        REQUIRE(mismatched == 0);
+        REQUIRE(results[0].filesDeleted == 10);
+        REQUIRE(results[1].filesDeleted == 0);
+        REQUIRE(results[2].filesDeleted == 10);
+        REQUIRE(results[2].bytesFreed == 1000);
+    }
+
+    SECTION("Asynchronous runs scan, delete and prune like synchronous ones") {
+        std::vector<std::filesystem::path> pruned;
+        auto results = engine.runSetsAsync({{root}, {root / "missing"}}, true,
+            [](const FileEntry& entry, IoExecutor& io, CleaningEngine::EntryCompletion done) {
+                if (entry.path.filename() == "file0.tmp") {
+                    done(false, std::make_exception_ptr(std::runtime_error("boom")));
+                    return;
+                }
+                io.unlink(entry.path, [done](std::error_code ec) { done(!ec, nullptr); });
+            },
+            [&pruned](const std::filesystem::path& dir) {
+                pruned.push_back(dir);
+                return std::filesystem::remove(dir);
+            });
+        REQUIRE(results.size() == 2);
+        REQUIRE(results[0].filesDeleted == 19);
+        REQUIRE(results[0].bytesFreed == 1900);
+        REQUIRE(results[0].errors == 1);
+        REQUIRE(results[0].directoriesRemoved == 1);
+        REQUIRE(pruned == std::vector<std::filesystem::path>{root / "nested"});
+        REQUIRE(std::filesystem::exists(root / "file0.tmp"));
+        REQUIRE(results[1].filesDeleted == 0);
+    }
+
+    SECTION("Missing roots are skipped") {
+        auto result = engine.run({root / "missing"}, true, [](const FileEntry&) { return true; });
+        REQUIRE(result.filesDeleted == 0);
+        REQUIRE(result.errors == 0);
+    }
+
+#ifndef _WIN32
+    SECTION("Rotational devices are processed in inode order") {
+        REQUIRE(engine.setStorageType(root, StorageType::Rotational));
+        REQUIRE(engine.getConcurrency(StorageType::Rotational) == 1);
+
+        std::mutex mutex;
+        std::vector<uint64_t> inodes;
+        engine.run({root}, true, [&](const FileEntry& entry) {
+            std::lock_guard<std::mutex> lock(mutex);
+            inodes.push_back(entry.inode);
+            return true;
+        });
+        REQUIRE(inodes.size() == 20);
+        REQUIRE(std::is_sorted(inodes.begin(), inodes.end()));
+    }
+#endif
+
+    SECTION("Autotuned run processes every file") {
+        engine.setAutotune(true);
+        engine.setMaxThreads(4);
+        engine.setBatchSize(1);
+        // Slow handler so that at least one tuning interval elapses
+        auto result = engine.run({root}, true, [](const FileEntry&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            return true;
+        });
+        REQUIRE(result.filesDeleted == 20);
+        REQUIRE(engine.getConcurrency(StorageType::SolidState) <= 4);
+    }
+
+    SECTION("Configured concurrency") {
+        engine.setConcurrency(StorageType::SolidState, 7);
+        REQUIRE(engine.getConcurrency(StorageType::SolidState) == 7);
+        engine.setConcurrency(StorageType::SolidState, 0);
+        REQUIRE(engine.getConcurrency(StorageType::SolidState) >= 2);
+    }
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Engine prunes emptied directories bottom-up", "[engine]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_prune_test";
+    std::filesystem::remove_all(root);
+    for (const char* dir : {"a/b/c", "a/d", "keep", "excluded/inner", "empty"}) {
+        std::filesystem::create_directories(root / dir);
+    }
+    for (const char* file : {"a/one.tmp", "a/b/two.tmp", "a/b/c/three.tmp", "a/d/four.tmp",
+                             "keep/locked.tmp", "excluded/inner/five.tmp", "top.tmp"}) {
+        std::ofstream(root / file) << "x";
+    }
+
+    CleaningEngine engine;
+    engine.setBatchSize(1);
+    auto deleteFile = [](const FileEntry& entry) {
+        if (entry.path.filename() == "locked.tmp") return false;
+        return std::filesystem::remove(entry.path);
+    };
+    std::mutex mutex;
+    std::vector<std::string> removed;
+    auto removeDirectory = [&](const std::filesystem::path& dir) {
+        if (dir.string().find("excluded") != std::string::npos) return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        removed.push_back(dir.lexically_relative(root).generic_string());
+        return std::filesystem::remove(dir);
+    };
+
+    auto result = engine.run({root}, true, deleteFile, removeDirectory);
+    REQUIRE(result.filesDeleted == 6);
+    REQUIRE(result.directoriesRemoved == 4);
+    REQUIRE_FALSE(std::filesystem::exists(root / "a"));
+    REQUIRE(std::filesystem::exists(root / "keep/locked.tmp"));
+    REQUIRE(std::filesystem::exists(root / "excluded/inner"));
+    REQUIRE(std::filesystem::exists(root / "empty"));
+    REQUIRE(std::filesystem::exists(root));
+
+    // Children always go before their parents
+    auto position = [&removed](const std::string& name) {
+        return std::find(removed.begin(), removed.end(), name) - removed.begin();
+    };
+    REQUIRE(position("a/b/c") < position("a/b"));
+    REQUIRE(position("a/b") < position("a"));
+    REQUIRE(position("a/d") < position("a"));
+
+    SECTION("Non-recursive runs leave directories alone") {
+        std::filesystem::create_directories(root / "flat");
+        std::ofstream(root / "flat/file.tmp") << "x";
+        auto flat = engine.run({root / "flat"}, false, deleteFile, removeDirectory);
+        REQUIRE(flat.directoriesRemoved == 0);
+        REQUIRE(std::filesystem::exists(root / "flat"));
+    }
+
+    std::filesystem::remove_all(root);
+}
+
+TEST_CASE("Engine limits the scan depth", "[engine]") {
+    auto fs = std::make_shared<MemoryFileSystem>();
+    for (const char* file : {"/m/a", "/m/1/b", "/m/1/2/c", "/m/1/2/3/d"}) {
+        fs->addFile(file, 10);
+    }
+    CleaningEngine engine;
+    engine.setFileSystem(fs);
+    engine.setOpenFileCheck(false);
+    REQUIRE(engine.getMaxDepth() > 0);
+    engine.setMaxDepth(2);
+    REQUIRE(engine.getMaxDepth() == 2);
+
+    auto result = engine.run({"/m"}, true, [](const FileEntry&) { return true; });
+    REQUIRE(result.filesDeleted == 3);
+    REQUIRE(result.directoriesSkipped == 1);
+
+    engine.setMaxDepth(0);
+    REQUIRE(engine.run({"/m"}, true, [](const FileEntry&) { return true; }).filesDeleted == 4);
+}
+
+#ifndef _WIN32
+TEST_CASE("Engine follows symlinked directories once", "[engine]") {
+    auto base = std::filesystem::temp_directory_path() / "cookiemonster_symlink_test";
+    auto root = base / "root";
+    auto outside = base / "outside";
+    std::filesystem::remove_all(base);
+    std::filesystem::create_directories(root / "a");
+    std::filesystem::create_directories(outside / "inner");
+    std::ofstream(root / "a/one.tmp") << "x";
+    std::ofstream(outside / "two.tmp") << "x";
+    std::ofstream(outside / "inner/three.tmp") << "x";
+    std::filesystem::create_directory_symlink(root, root / "a/loop");
+    std::filesystem::create_directory_symlink(root / "a", root / "alias");
+    std::filesystem::create_directory_symlink(outside, root / "link");
+
+    CleaningEngine engine;
+    engine.setOpenFileCheck(false);
+    std::mutex mutex;
+    std::vector<std::string> seen;
+    auto record = [&](const FileEntry& entry) {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.push_back(entry.path.filename().string());
+        return true;
+    };
+
+    SECTION("Symlinked directories are skipped by default") {
+        REQUIRE_FALSE(engine.isFollowingSymlinks());
+        auto result = engine.run({root}, true, record);
+        REQUIRE(result.filesDeleted == 1);
+        REQUIRE(seen == std::vector<std::string>{"one.tmp"});
+    }
+
+    SECTION("Every directory is walked once, cycles included") {
+        engine.setFollowSymlinks(true);
+        auto result = engine.run({root}, true, record);
+        REQUIRE(result.filesDeleted == 3);
+        // The loop back to the root and one of "a" and "alias"
+        REQUIRE(result.directoriesSkipped == 2);
+        std::sort(seen.begin(), seen.end());
+        REQUIRE(seen == std::vector<std::string>{"one.tmp", "three.tmp", "two.tmp"});
+    }
+
+    SECTION("Asynchronous scans follow the same rules") {
+        engine.setFollowSymlinks(true);
+        auto results = engine.runSetsAsync({{root}}, true,
+            [&](const FileEntry& entry, IoExecutor&, CleaningEngine::EntryCompletion done) {
+                done(record(entry), nullptr);
+            });
+        REQUIRE(results.front().filesDeleted == 3);
+        REQUIRE(results.front().directoriesSkipped == 2);
+    }
+
+    SECTION("Directories reached through a link are never pruned") {
+        engine.setFollowSymlinks(true);
+        auto deleteFile = [](const FileEntry& entry) { return std::filesystem::remove(entry.path); };
+        auto removeDirectory = [](const std::filesystem::path& dir) { return std::filesystem::remove(dir); };
+        auto result = engine.run({root}, true, deleteFile, removeDirectory);
+        REQUIRE(result.filesDeleted == 3);
+        REQUIRE(result.directoriesRemoved == 0);
+        REQUIRE(std::filesystem::is_symlink(root / "link"));
+        REQUIRE(std::filesystem::exists(outside / "inner"));
+        REQUIRE_FALSE(std::filesystem::exists(outside / "inner/three.tmp"));
+    }
+
+    SECTION("Below a world-writable root a link needs the target's owner") {
+        engine.setFollowSymlinks(true);
+        std::filesystem::permissions(root, std::filesystem::perms::all | std::filesystem::perms::sticky_bit);
+        // Links owned by whoever owns their targets are followed as before
+        REQUIRE(engine.run({root}, true, record).filesDeleted == 3);
+
+        // Only root can hand a link to another user
+        if (::geteuid() == 0) {
+            REQUIRE(::lchown((root / "link").c_str(), 4242, 4242) == 0);
+            seen.clear();
+            auto result = engine.run({root}, true, record);
+            REQUIRE(result.filesDeleted == 1);
+            REQUIRE(result.directoriesSkipped == 3);
+            REQUIRE(seen == std::vector<std::string>{"one.tmp"});
+
+            // The same link in a private root is trusted
+            std::filesystem::permissions(root, std::filesystem::perms::owner_all);
+            REQUIRE(engine.run({root}, true, record).filesDeleted == 3);
+        }
+    }
+
+    std::filesystem::remove_all(base);
+}
+#endif
@@ -0,0 +1,148 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/CleaningKernel.h"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    FileEntry makeFile(const std::filesystem::path& path, size_t size) {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << std::string(size, 'k');
+        FileEntry entry;
+        entry.path = path;
+        entry.size = size;
+        return entry;
+    }
+}
+
+TEST_CASE("Cleaning kernels", "[kernel]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_kernel_test";
+    std::filesystem::remove_all(root);
+    auto backupDir = root / "backup";
+    std::filesystem::create_directories(backupDir);
+    auto entry = makeFile(root / "cache" / "entry.bin", 64);
+    auto stored = backupLocation(backupDir, entry.path);
+
+    IoThrottle throttle;
+    BackupStore store(backupDir, nullptr, {});
+    KernelContext context;
+    context.throttle = &throttle;
+    context.backup = &store;
+
+    SECTION("A dry run touches nothing") {
+        auto kernel = makeCleaningKernel(context, true, BackupMode::Copy, true);
+        REQUIRE(kernel(entry));
+        REQUIRE(std::filesystem::exists(entry.path));
+        REQUIRE(store.getFiles().empty());
+    }
+
+    SECTION("Without a backup the file is only deleted") {
+        auto kernel = makeCleaningKernel(context, false, BackupMode::None, false);
+        REQUIRE(kernel(entry));
+        REQUIRE_FALSE(std::filesystem::exists(entry.path));
+        REQUIRE(store.getFiles().empty());
+    }
+
+    SECTION("Copy mode preserves the file before deleting it") {
+        auto kernel = makeCleaningKernel(context, false, BackupMode::Copy, false);
+        REQUIRE(kernel(entry));
+        REQUIRE_FALSE(std::filesystem::exists(entry.path));
+        REQUIRE(std::filesystem::file_size(stored) == 64);
+        REQUIRE(store.getFiles() == std::vector<std::string>{entry.path.string()});
+        REQUIRE(store.getTotalSize() == 64);
+    }
+
+    SECTION("Quarantine mode moves the file") {
+        auto kernel = makeCleaningKernel(context, false, BackupMode::Quarantine, true);
+        REQUIRE(kernel(entry));
+        REQUIRE_FALSE(std::filesystem::exists(entry.path));
+        REQUIRE(std::filesystem::file_size(stored) == 64);
+        REQUIRE(store.getFiles().size() == 1);
+    }
+
+    SECTION("Same-named files from different directories are stored apart") {
+        auto other = makeFile(root / "other" / "entry.bin", 32);
+        for (auto mode : {BackupMode::Copy, BackupMode::Quarantine}) {
+            makeFile(entry.path, 64);
+            makeFile(other.path, 32);
+            std::filesystem::remove_all(backupDir);
+            BackupStore fresh(backupDir, nullptr, {});
+            context.backup = &fresh;
+            auto kernel = makeCleaningKernel(context, false, mode, false);
+            REQUIRE(kernel(entry));
+            REQUIRE(kernel(other));
+            REQUIRE(std::filesystem::file_size(stored) == 64);
+            REQUIRE(std::filesystem::file_size(backupLocation(backupDir, other.path)) == 32);
+            REQUIRE(fresh.getFiles().size() == 2);
+        }
+    }
+
+    SECTION("An existing backup is never replaced") {
+        makeFile(stored, 64);
+        for (auto mode : {BackupMode::Copy, BackupMode::Quarantine}) {
+            // A different file at the target keeps the source
+            std::ofstream(stored, std::ios::binary) << "other";
+            auto kernel = makeCleaningKernel(context, false, mode, false);
+            REQUIRE_THROWS(kernel(entry));
+            REQUIRE(std::filesystem::exists(entry.path));
+            REQUIRE(std::filesystem::file_size(stored) == 5);
+        }
+        REQUIRE(store.getFiles().empty());
+    }
+
+    SECTION("A file already backed up by an interrupted run is checked, not stored again") {
+        BackupStore resumed(backupDir, nullptr, {entry.path.string()});
+        context.backup = &resumed;
+        auto kernel = makeCleaningKernel(context, false, BackupMode::Copy, false);
+        std::filesystem::create_directories(stored.parent_path());
+        std::filesystem::copy_file(entry.path, stored);
+        REQUIRE(kernel(entry));
+        REQUIRE_FALSE(std::filesystem::exists(entry.path));
+        REQUIRE(std::filesystem::file_size(stored) == 64);
+        REQUIRE(resumed.getFiles().empty());
+
+        // A file recreated since its backup is kept
+        makeFile(entry.path, 16);
+        REQUIRE_THROWS(kernel(entry));
+        REQUIRE(std::filesystem::file_size(entry.path) == 16);
+        REQUIRE(std::filesystem::file_size(stored) == 64);
+    }
+
+    SECTION("The asynchronous form backs up and deletes through the executor") {
+        auto kernel = makeAsyncCleaningKernel(context, false, BackupMode::Copy, false);
+        IoExecutor io(4, 1);
+        bool handled = false;
+        kernel(entry, io, [&handled](bool result, std::exception_ptr error) {
+            REQUIRE_FALSE(error);
+            handled = result;
+        });
+        io.wait();
+        REQUIRE(handled);
+        REQUIRE_FALSE(std::filesystem::exists(entry.path));
+        REQUIRE(std::filesystem::file_size(stored) == 64);
+    }
+
+    SECTION("A file whose backup fails is kept") {
+        std::filesystem::remove_all(backupDir);
+        std::ofstream(backupDir) << "not a directory";
+        auto kernel = makeCleaningKernel(context, false, BackupMode::Copy, false);
+        REQUIRE_THROWS(kernel(entry));
+        REQUIRE(std::filesystem::exists(entry.path));
+
+        CleaningEngine engine;
+        engine.setOpenFileCheck(false);
+        auto result = engine.runEntries({entry}, kernel);
+        REQUIRE(result.errors == 1);
+        REQUIRE(result.filesDeleted == 0);
+        REQUIRE(std::filesystem::exists(entry.path));
+
+        IoExecutor io(4, 1);
+        std::exception_ptr failure;
+        makeAsyncCleaningKernel(context, false, BackupMode::Copy, false)(entry, io,
+            [&failure](bool, std::exception_ptr error) { failure = error; });
+        io.wait();
+        REQUIRE(failure);
+        REQUIRE(std::filesystem::exists(entry.path));
+    }
+
+    std::filesystem::remove_all(root);
+}
@@ -0,0 +1,98 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/DeletionPlan.h"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    std::filesystem::path makeFile(const std::filesystem::path& path, size_t size) {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file(path, std::ios::binary);
+        file << std::string(size, 'x');
+        return path;
+    }
+
+    FileEntry entryFor(const std::filesystem::path& path) {
+        FileEntry entry;
+        REQUIRE(statFileEntry(path, entry));
+        return entry;
+    }
+}
+
+TEST_CASE("Deletion plan round trip", "[plan]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_plan_test";
+    std::filesystem::remove_all(root);
+    auto planFile = root / "plan.bin";
+
+    std::vector<FileEntry> temp;
+    for (int i = 0; i < 10; ++i) {
+        temp.push_back(entryFor(makeFile(root / "temp" / "deep" / ("file" + std::to_string(i) + ".tmp"), 10 + i)));
+    }
+    FileEntry cacheEntry = entryFor(makeFile(root / "cache" / "data_0", 500));
+
+    PlanWriter writer;
+    REQUIRE(writer.open(planFile));
+    writer.beginSection(PlanSection::Temp, "");
+    for (const auto& entry : temp) writer.add(entry);
+    writer.beginSection(PlanSection::Browser, "Brave");
+    writer.add(cacheEntry);
+    REQUIRE(writer.getEntryCount() == 11);
+    REQUIRE(writer.close());
+
+    SECTION("Sections and fingerprints survive the round trip") {
+        PlanReader reader;
+        REQUIRE(reader.open(planFile));
+        std::vector<PlanSectionData> sections;
+        std::string error;
+        REQUIRE(reader.read(sections, error));
+        REQUIRE(sections.size() == 2);
+        REQUIRE(sections[0].kind == PlanSection::Temp);
+        REQUIRE(sections[0].entries.size() == 10);
+        REQUIRE(sections[1].kind == PlanSection::Browser);
+        REQUIRE(sections[1].name == "Brave");
+
+        for (size_t i = 0; i < temp.size(); ++i) {
+            const FileEntry& read = sections[0].entries[i];
+            REQUIRE(read.path == temp[i].path);
+            REQUIRE(read.size == temp[i].size);
+            REQUIRE(read.inode == temp[i].inode);
+            REQUIRE(read.mtime == temp[i].mtime);
+            REQUIRE(matchesFingerprint(read));
+        }
+    }
+
+    SECTION("Shared path prefixes are not repeated") {
+        size_t listing = 0;
+        for (const auto& entry : temp) listing += entry.path.string().size();
+        REQUIRE(std::filesystem::file_size(planFile) < listing);
+    }
+
+    SECTION("Changed and missing files fail validation") {
+        makeFile(temp[0].path, 999);
+        std::filesystem::remove(temp[1].path);
+        REQUIRE_FALSE(matchesFingerprint(temp[0]));
+        REQUIRE_FALSE(matchesFingerprint(temp[1]));
+        REQUIRE(matchesFingerprint(temp[2]));
+    }
+
+    SECTION("Truncated plans are rejected") {
+        auto size = std::filesystem::file_size(planFile);
+        std::filesystem::resize_file(planFile, size - 1);
+        PlanReader reader;
+        REQUIRE(reader.open(planFile));
+        std::vector<PlanSectionData> sections;
+        std::string error;
+        REQUIRE_FALSE(reader.read(sections, error));
+        REQUIRE_FALSE(error.empty());
+    }
+
+    SECTION("Other files are not plans") {
+        PlanReader reader;
+        REQUIRE(reader.open(temp[0].path));
+        std::vector<PlanSectionData> sections;
+        std::string error;
+        REQUIRE_FALSE(reader.read(sections, error));
+        REQUIRE_FALSE(reader.open(root / "missing.bin"));
+    }
+
+    std::filesystem::remove_all(root);
+}
@@ -0,0 +1,178 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/Cleaner.h"
+#include "../../src/include/CleaningEngine.h"
+#include "../../src/include/FileSystemBackend.h"
+#include "../../src/include/IoExecutor.h"
+#include <atomic>
+#include <memory>
+
+namespace {
+    const std::filesystem::path kRoot = "/vfs/cache";
+}
+
+TEST_CASE("Memory file system", "[vfs]") {
+    MemoryFileSystem fs;
+    fs.addFile(kRoot / "a.tmp", 100, 42);
+    fs.addFile(kRoot / "sub" / "b.tmp", 5000);
+    REQUIRE(fs.getFileCount() == 2);
+    REQUIRE(fs.typeOf(kRoot / "sub") == FileType::Directory);
+    REQUIRE(fs.typeOf(kRoot / "missing") == FileType::None);
+
+    SECTION("Listings are sorted and typed") {
+        std::vector<DirectoryItem> items;
+        std::error_code ec;
+        fs.listDirectory(kRoot, items, ec);
+        REQUIRE_FALSE(ec);
+        REQUIRE(items.size() == 2);
+        REQUIRE(items[0].path == kRoot / "a.tmp");
+        REQUIRE(items[0].type == FileType::Regular);
+        REQUIRE(items[1].type == FileType::Directory);
+
+        fs.listDirectory(kRoot / "a.tmp", items, ec);
+        REQUIRE(ec == std::errc::not_a_directory);
+    }
+
+    SECTION("Stat reports size, allocation and identity") {
+        FileEntry entry;
+        std::error_code ec;
+        REQUIRE(fs.stat(kRoot / "sub" / "b.tmp", entry, ec));
+        REQUIRE(entry.size == 5000);
+        REQUIRE(entry.allocated == 8192);
+        REQUIRE(entry.inode != 0);
+        REQUIRE(fs.stat(kRoot / "a.tmp", entry, ec));
+        REQUIRE(entry.mtime == 42);
+        REQUIRE_FALSE(fs.stat(kRoot / "gone.tmp", entry, ec));
+        REQUIRE(ec == std::errc::no_such_file_or_directory);
+    }
+
+    SECTION("Remove and rename") {
+        std::error_code ec;
+        REQUIRE_FALSE(fs.remove(kRoot / "sub", ec));
+        REQUIRE(ec == std::errc::directory_not_empty);
+        ec.clear();
+        fs.rename(kRoot / "sub" / "b.tmp", kRoot / "c.tmp", ec);
+        REQUIRE_FALSE(ec);
+        REQUIRE(fs.typeOf(kRoot / "c.tmp") == FileType::Regular);
+        REQUIRE(fs.remove(kRoot / "sub", ec));
+        REQUIRE_FALSE(fs.remove(kRoot / "sub", ec));
+        REQUIRE_FALSE(ec);
+        REQUIRE(fs.getFileCount() == 2);
+    }
+
+    SECTION("Faults fire on the chosen path the chosen number of times") {
+        fs.injectFault(FileOperation::Remove, kRoot / "a.tmp", std::errc::device_or_resource_busy, 1);
+        std::error_code ec;
+        REQUIRE_FALSE(fs.remove(kRoot / "a.tmp", ec));
+        REQUIRE(ec == std::errc::device_or_resource_busy);
+        ec.clear();
+        REQUIRE(fs.remove(kRoot / "a.tmp", ec));
+        REQUIRE(fs.getCallCount(FileOperation::Remove) == 2);
+    }
+
+    SECTION("Latency slows every call of an operation") {
+        fs.setLatency(FileOperation::Stat, std::chrono::milliseconds(5));
+        FileEntry entry;
+        std::error_code ec;
+        auto start = std::chrono::steady_clock::now();
+        fs.stat(kRoot / "a.tmp", entry, ec);
+        fs.stat(kRoot / "a.tmp", entry, ec);
+        REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(10));
+    }
+}
+
+TEST_CASE("Engine over a memory file system", "[vfs][engine]") {
+    auto fs = std::make_shared<MemoryFileSystem>();
+    fs->addTree(kRoot, 20, 50, 100);
+    CleaningEngine engine;
+    engine.setBatchSize(64);
+    engine.setFileSystem(fs);
+    auto remove = [&fs](const FileEntry& entry) {
+        std::error_code ec;
+        bool removed = fs->remove(entry.path, ec);
+        if (ec) throw std::filesystem::filesystem_error("cannot remove", entry.path, ec);
+        return removed;
+    };
+
+    SECTION("Every file is scanned and removed without touching the disk") {
+        auto result = engine.run({kRoot}, true, remove);
+        REQUIRE(result.filesDeleted == 1000);
+        REQUIRE(result.bytesFreed == 100000);
+        REQUIRE(result.physicalBytesFreed == 1000 * 4096);
+        REQUIRE(result.errors == 0);
+        REQUIRE(fs->getFileCount() == 0);
+        REQUIRE(fs->getCallCount(FileOperation::List) == 21);
+    }
+
+    SECTION("Emptied directories are pruned through the backend") {
+        auto result = engine.run({kRoot}, true, remove, [&fs](const std::filesystem::path& directory) {
+            std::error_code ec;
+            return fs->remove(directory, ec);
+        });
+        REQUIRE(result.directoriesRemoved == 20);
+        REQUIRE(fs->typeOf(kRoot / "d0") == FileType::None);
+        REQUIRE(fs->typeOf(kRoot) == FileType::Directory);
+    }
+
+    SECTION("Injected errors are counted per file") {
+        // Files that cannot be inspected are skipped like vanished ones
+        fs->injectFault(FileOperation::Stat, kRoot / "d1" / "f1", std::errc::permission_denied);
+        fs->injectFault(FileOperation::Remove, kRoot / "d2" / "f2", std::errc::permission_denied);
+        auto result = engine.run({kRoot}, true, remove);
+        REQUIRE(result.filesDeleted == 998);
+        REQUIRE(result.errors == 1);
+        REQUIRE(fs->getFileCount() == 2);
+    }
+
+    SECTION("Unreadable directories are skipped") {
+        fs->injectFault(FileOperation::List, kRoot / "d3", std::errc::permission_denied);
+        auto result = engine.run({kRoot}, true, remove);
+        REQUIRE(result.filesDeleted == 950);
+        REQUIRE(result.errors == 0);
+    }
+
+    SECTION("Busy files are retried when open files are checked") {
+        fs->injectFault(FileOperation::Remove, kRoot / "d4" / "f4", std::errc::device_or_resource_busy, 1);
+        engine.setOpenFileCheck(true);
+        engine.setOpenFileRetries(2, std::chrono::milliseconds(1));
+        auto result = engine.run({kRoot}, true, remove);
+        REQUIRE(result.filesDeleted == 1000);
+        REQUIRE(result.errors == 0);
+    }
+
+    SECTION("Files removed during the walk are not errors") {
+        // Deterministic race: d5 loses a file right after it was listed
+        fs->setListHook([&fs](const std::filesystem::path& directory) {
+            if (directory == kRoot / "d5") {
+                std::error_code ec;
+                fs->remove(directory / "f0", ec);
+            }
+        });
+        auto result = engine.run({kRoot}, true, remove);
+        REQUIRE(result.filesDeleted == 999);
+        REQUIRE(result.errors == 0);
+        REQUIRE(fs->getFileCount() == 0);
+    }
+
+    SECTION("Asynchronous runs use the same backend") {
+        auto result = engine.runSetsAsync({{kRoot}}, true,
+            [](const FileEntry& entry, IoExecutor& io, CleaningEngine::EntryCompletion done) {
+                io.unlink(entry.path, [done](std::error_code ec) { done(!ec, nullptr); });
+            }).front();
+        REQUIRE(result.filesDeleted == 1000);
+        REQUIRE(fs->getFileCount() == 0);
+    }
+}
+
+TEST_CASE("Cleaner over a memory file system", "[vfs]") {
+    Cleaner cleaner;
+    auto fs = std::make_shared<MemoryFileSystem>();
+    for (const auto& dir : cleaner.getTempDirectories()) {
+        fs->addTree(dir, 3, 4, 10);
+    }
+    cleaner.setFileSystem(fs);
+
+    REQUIRE(cleaner.cleanTempFiles(true));
+    REQUIRE(fs->getFileCount() == cleaner.getTempDirectories().size() * 12);
+    REQUIRE(cleaner.cleanTempFiles(false));
+    REQUIRE(fs->getFileCount() == 0);
+}
@@ -0,0 +1,124 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/Cleaner.h"
+#include "../../src/include/FileSystemBackend.h"
+#include "../../src/include/FileTypeFilter.h"
+#include <filesystem>
+#include <fstream>
+
+TEST_CASE("Perfect-hash extension sets", "[file-types]") {
+    SECTION("Members are found, case-insensitively and with or without dots") {
+        ExtensionSet set({".EXE", "dll", "..ps1", "exe", ""});
+        REQUIRE(set.size() == 3);
+        REQUIRE(set.getExtensions() == std::vector<std::string>{"exe", "dll", "ps1"});
+        REQUIRE(set.contains("exe"));
+        REQUIRE(set.contains("Exe"));
+        REQUIRE(set.contains("PS1"));
+        REQUIRE_FALSE(set.contains("ex"));
+        REQUIRE_FALSE(set.contains("exee"));
+        REQUIRE_FALSE(set.contains(""));
+        REQUIRE_FALSE(ExtensionSet().contains("exe"));
+    }
+
+    SECTION("Large sets have no false positives or negatives") {
+        std::vector<std::string> members;
+        for (int i = 0; i < 500; ++i) {
+            members.push_back("m" + std::to_string(i * 7));
+        }
+        ExtensionSet set(members);
+        REQUIRE(set.size() == members.size());
+        for (int i = 0; i < 3500; ++i) {
+            REQUIRE(set.contains("m" + std::to_string(i)) == (i % 7 == 0));
+        }
+    }
+}
+
+TEST_CASE("Content sniffing", "[file-types]") {
+    auto sniff = [](const std::string& header) -> std::string {
+        const char* type = sniffFileType(reinterpret_cast<const unsigned char*>(header.data()), header.size());
+        return type ? type : "";
+    };
+    REQUIRE(sniff("MZ\x90") == "exe");
+    REQUIRE(sniff("\x7f" "ELF\x02\x01") == "elf");
+    REQUIRE(sniff("\xcf\xfa\xed\xfe") == "macho");
+    REQUIRE(sniff("#!/bin/sh\n") == "script");
+    REQUIRE(sniff("%PDF-1.7") == "pdf");
+    REQUIRE(sniff(std::string("\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8)) == "ole");
+    REQUIRE(sniff(std::string("PK\x03\x04", 4)) == "zip");
+    REQUIRE(sniff("{\\rtf1") == "rtf");
+    REQUIRE(sniff("M") == "");
+    REQUIRE(sniff("plain text") == "");
+}
+
+TEST_CASE("File type filter", "[file-types]") {
+    FileTypeFilter filter;
+
+    SECTION("Executables and documents are excluded by default") {
+        REQUIRE(filter.isActive());
+        REQUIRE_FALSE(filter.allows("/tmp/setup.exe"));
+        REQUIRE_FALSE(filter.allows("/tmp/Report.PDF"));
+        REQUIRE(filter.allows("/tmp/download.tmp"));
+        REQUIRE(filter.allows("/tmp/archive.exe.part"));
+        // Hidden files and files without extensions are untyped
+        REQUIRE(filter.allows("/tmp/.exe"));
+        REQUIRE(filter.allows("/tmp/noext"));
+        REQUIRE(filter.allows("/tmp/dir.exe/noext"));
+    }
+
+    SECTION("Allow lists restrict cleaning to their types") {
+        filter.setExcludedTypes({});
+        filter.setAllowedTypes({"tmp", "log"});
+        REQUIRE(filter.allows("/tmp/a.tmp"));
+        REQUIRE(filter.allows("/tmp/a.LOG"));
+        REQUIRE_FALSE(filter.allows("/tmp/a.txt"));
+        REQUIRE_FALSE(filter.allows("/tmp/noext"));
+    }
+
+    SECTION("Files without an extension are typed by their content") {
+        auto dir = std::filesystem::temp_directory_path() / "cookiemonster_file_type_test";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        {
+            std::ofstream out(dir / "payload", std::ios::binary);
+            out << "MZ" << std::string(100, '\0');
+        }
+        {
+            std::ofstream out(dir / "notes", std::ios::binary);
+            out << "nothing special";
+        }
+        REQUIRE(filter.allows(dir / "payload"));
+        filter.setContentSniffing(true);
+        REQUIRE_FALSE(filter.allows(dir / "payload"));
+        REQUIRE(filter.allows(dir / "notes"));
+        REQUIRE(filter.allows(dir / "missing"));
+        std::filesystem::remove_all(dir);
+    }
+
+    SECTION("No types configured disables the filter") {
+        filter.setExcludedTypes({});
+        REQUIRE_FALSE(filter.isActive());
+    }
+}
+
+TEST_CASE("Cleaners keep protected file types", "[file-types]") {
+    Cleaner cleaner;
+    REQUIRE_FALSE(cleaner.isFileTypeAllowed(L"test.exe"));
+    REQUIRE(cleaner.isFileTypeAllowed(L"test.txt"));
+    cleaner.setExcludedFileTypes({".exe", ".dll"});
+    REQUIRE(cleaner.getExcludedFileTypes().size() == 2);
+    REQUIRE(cleaner.isFileTypeAllowed(L"report.pdf"));
+
+    auto fs = std::make_shared<MemoryFileSystem>();
+    fs->addFile("/work/a.exe", 10);
+    fs->addFile("/work/b.DLL", 10);
+    fs->addFile("/work/c.tmp", 10);
+    fs->addFile("/work/d.pdf", 10);
+    cleaner.setFileSystem(fs);
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules("[all]\nroot = /work\n", rules, error));
+    REQUIRE(cleaner.cleanRules(RulePlan(rules), false));
+    REQUIRE(fs->typeOf("/work/a.exe") == FileType::Regular);
+    REQUIRE(fs->typeOf("/work/b.DLL") == FileType::Regular);
+    REQUIRE(fs->typeOf("/work/c.tmp") == FileType::None);
+    REQUIRE(fs->typeOf("/work/d.pdf") == FileType::None);
+}
@@ -0,0 +1,138 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/FirefoxCache.h"
+#include "../../src/include/BinaryIO.h"
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+namespace {
+    struct FixtureEntry {
+        uint8_t id;                 ///< Fills the SHA-1 hash
+        uint32_t frecency;
+        uint32_t sizeKB;
+        uint32_t lastFetched;       ///< 0 writes no metadata
+    };
+
+    std::array<uint8_t, 20> hashOf(uint8_t id) {
+        std::array<uint8_t, 20> hash;
+        hash.fill(id);
+        return hash;
+    }
+
+    // Entry file: data, metadata hash, one chunk hash, metadata header, key, offset
+    void writeEntry(const std::filesystem::path& file, uint32_t lastFetched) {
+        const std::string data(100, 'd');
+        std::string content = data;
+        appendU32BE(content, 0);
+        content += std::string(2, '\0');
+        for (uint32_t field : {3u, 1u, lastFetched, lastFetched, 5u, 0u, 4u, 0u}) appendU32BE(content, field);
+        content += std::string("key") + '\0';
+        appendU32BE(content, static_cast<uint32_t>(data.size()));
+        std::ofstream(file, std::ios::binary) << content;
+    }
+
+    std::filesystem::path makeCache(const std::vector<FixtureEntry>& entries) {
+        auto cache = std::filesystem::temp_directory_path() / "cookiemonster_cache2_test";
+        std::filesystem::remove_all(cache);
+        std::filesystem::create_directories(cache / "entries");
+
+        std::string index;
+        for (uint32_t field : {0xAu, 1000u, 0u, 0u}) appendU32BE(index, field);
+        for (const auto& entry : entries) {
+            auto hash = hashOf(entry.id);
+            index.append(reinterpret_cast<const char*>(hash.data()), hash.size());
+            appendU32BE(index, entry.frecency);
+            index += std::string(8 + 2 + 2 + 1, '\0');
+            appendU32BE(index, 0x80000000u | entry.sizeKB);
+            if (entry.lastFetched != 0) {
+                writeEntry(FirefoxCacheIndex::entryFile(cache, hash), entry.lastFetched);
+            } else {
+                std::ofstream(FirefoxCacheIndex::entryFile(cache, hash)) << "no metadata";
+            }
+        }
+        appendU32BE(index, firefoxCacheHash(index.data(), index.size()));
+        std::ofstream(cache / "index", std::ios::binary) << index;
+        return cache;
+    }
+}
+
+TEST_CASE("Firefox cache hash", "[firefox]") {
+    // Every tail length goes through a different switch branch
+    std::string data = "The quick brown fox jumps over the lazy dog";
+    std::set<uint32_t> hashes;
+    for (size_t length = 0; length <= data.size(); ++length) {
+        hashes.insert(firefoxCacheHash(data.data(), length));
+    }
+    REQUIRE(hashes.size() == data.size() + 1);
+    REQUIRE(firefoxCacheHash("", 0, 1) != firefoxCacheHash("", 0, 2));
+}
+
+TEST_CASE("Firefox cache2 index", "[firefox]") {
+    const std::time_t now = std::time(nullptr);
+    const uint32_t day = 24 * 60 * 60;
+    auto cache = makeCache({
+        {1, 500, 10, static_cast<uint32_t>(now) - 90 * day},
+        {2, 100, 20, static_cast<uint32_t>(now) - 1 * day},
+        {3, 900, 30, static_cast<uint32_t>(now) - 2 * day},
+        {4, 50, 40, 0},
+    });
+    REQUIRE(FirefoxCacheIndex::isCache2(cache));
+    std::string expectedName;
+    for (int i = 0; i < 20; ++i) expectedName += "AB";
+    REQUIRE(FirefoxCacheIndex::entryFile(cache, hashOf(0xAB)).filename().string() == expectedName);
+
+    FirefoxCacheIndex index;
+    REQUIRE(index.load(cache));
+    REQUIRE_FALSE(index.isDirty());
+    REQUIRE(index.getEntries().size() == 4);
+    REQUIRE(index.getEntries()[2].size() == 30 * 1024);
+
+    uint32_t lastFetched = 0;
+    REQUIRE(FirefoxCacheIndex::readLastFetched(FirefoxCacheIndex::entryFile(cache, hashOf(1)), lastFetched));
+    REQUIRE(lastFetched == static_cast<uint32_t>(now) - 90 * day);
+    REQUIRE_FALSE(FirefoxCacheIndex::readLastFetched(FirefoxCacheIndex::entryFile(cache, hashOf(4)), lastFetched));
+
+    for (auto& entry : index.getEntries()) {
+        FirefoxCacheIndex::readLastFetched(FirefoxCacheIndex::entryFile(cache, entry.hash), entry.lastFetched);
+    }
+
+    SECTION("Age limit uses the metadata's last fetch time") {
+        CacheEvictionPolicy policy;
+        policy.maxAgeDays = 30;
+        auto evicted = selectFirefoxEvictions(index.getEntries(), policy, now);
+        REQUIRE(evicted.size() == 1);
+        REQUIRE(evicted[0].hash == hashOf(1));
+    }
+
+    SECTION("Budget evicts the lowest frecency first") {
+        CacheEvictionPolicy policy;
+        policy.maxBytes = 50 * 1024;
+        auto evicted = selectFirefoxEvictions(index.getEntries(), policy, now);
+        REQUIRE(evicted.size() == 2);
+        REQUIRE(evicted[0].hash == hashOf(4));
+        REQUIRE(evicted[1].hash == hashOf(2));
+    }
+
+    SECTION("Saved index stays valid") {
+        index.getEntries().erase(index.getEntries().begin());
+        REQUIRE(index.save(cache));
+        FirefoxCacheIndex reloaded;
+        REQUIRE(reloaded.load(cache));
+        REQUIRE(reloaded.getEntries().size() == 3);
+        REQUIRE(reloaded.getEntries()[0].hash == hashOf(2));
+        REQUIRE(reloaded.getEntries()[0].frecency == 100);
+    }
+
+    SECTION("Corrupt indexes are rejected") {
+        {
+            std::fstream stream(cache / "index", std::ios::binary | std::ios::in | std::ios::out);
+            stream.seekp(30);
+            stream.put('\x7F');
+        }
+        FirefoxCacheIndex corrupt;
+        REQUIRE_FALSE(corrupt.load(cache));
+        REQUIRE_FALSE(corrupt.getError().empty());
+    }
+
+    std::filesystem::remove_all(cache);
+}
@@ -0,0 +1,93 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/IoExecutor.h"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    void writeFile(const std::filesystem::path& path, size_t size) {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << std::string(size, 'i');
+    }
+}
+
+TEST_CASE("I/O executor", "[io]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_io_test";
+    std::filesystem::remove_all(root);
+    writeFile(root / "a.bin", 10);
+    writeFile(root / "sub" / "b.bin", 20);
+    IoExecutor io(8, 2);
+
+    SECTION("Operations complete on the driving thread") {
+        int completed = 0;
+        uint64_t size = 0;
+        size_t listed = 0;
+        io.stat(root / "a.bin", [&](std::error_code ec, FileEntry&& entry) {
+            REQUIRE_FALSE(ec);
+            size = entry.size;
+            completed++;
+        });
+        io.readDirectory(root, [&](std::error_code ec, std::vector<DirectoryItem>&& entries) {
+            REQUIRE_FALSE(ec);
+            listed = entries.size();
+            completed++;
+        });
+        io.submit([] { return std::error_code(); }, [&](std::error_code ec) {
+            REQUIRE_FALSE(ec);
+            completed++;
+        });
+        REQUIRE(io.getOutstanding() == 3);
+        io.wait();
+        REQUIRE(completed == 3);
+        REQUIRE(size == 10);
+        REQUIRE(listed == 2);
+        REQUIRE(io.getOutstanding() == 0);
+    }
+
+    SECTION("Callbacks can chain further operations") {
+        bool removed = false;
+        io.copy(root / "a.bin", root / "copy.bin", [&](std::error_code ec) {
+            REQUIRE_FALSE(ec);
+            io.rename(root / "copy.bin", root / "moved.bin", [&](std::error_code renameEc) {
+                REQUIRE_FALSE(renameEc);
+                io.unlink(root / "moved.bin", [&](std::error_code unlinkEc) {
+                    removed = !unlinkEc;
+                });
+            });
+        });
+        io.wait();
+        REQUIRE(removed);
+        REQUIRE_FALSE(std::filesystem::exists(root / "copy.bin"));
+        REQUIRE_FALSE(std::filesystem::exists(root / "moved.bin"));
+        REQUIRE(std::filesystem::exists(root / "a.bin"));
+    }
+
+    SECTION("Failures are reported as error codes") {
+        std::error_code unlinkEc;
+        std::error_code statEc;
+        io.unlink(root / "missing", [&](std::error_code ec) { unlinkEc = ec; });
+        io.stat(root / "missing", [&](std::error_code ec, FileEntry&&) { statEc = ec; });
+        io.wait();
+        REQUIRE(unlinkEc == std::errc::no_such_file_or_directory);
+        REQUIRE(statEc);
+    }
+
+    SECTION("Far more operations than the queue depth can be outstanding") {
+        for (int i = 0; i < 300; ++i) {
+            writeFile(root / "many" / (std::to_string(i) + ".tmp"), 1);
+        }
+        int removed = 0;
+        for (int i = 0; i < 300; ++i) {
+            io.unlink(root / "many" / (std::to_string(i) + ".tmp"), [&removed](std::error_code ec) {
+                if (!ec) removed++;
+            });
+        }
+        REQUIRE(io.getOutstanding() == 300);
+        io.drain(100);
+        REQUIRE(io.getOutstanding() <= 100);
+        io.wait();
+        REQUIRE(removed == 300);
+        REQUIRE(std::filesystem::is_empty(root / "many"));
+    }
+
+    std::filesystem::remove_all(root);
+}
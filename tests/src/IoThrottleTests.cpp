@@ -0,0 +1,60 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/IoThrottle.h"
+#include <chrono>
+
+TEST_CASE("Token bucket limits", "[throttle]") {
+    IoThrottle throttle;
+
+    SECTION("Disabled by default") {
+        REQUIRE_FALSE(throttle.isEnabled());
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1000; ++i) {
+            throttle.acquire(1 << 20);
+        }
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100));
+    }
+
+    SECTION("Operations per second") {
+        throttle.setMaxOpsPerSecond(20);
+        REQUIRE(throttle.isEnabled());
+        REQUIRE(throttle.getMaxOpsPerSecond() == 20);
+
+        // 11 operations at 20/s with an empty bucket take about half a second
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 11; ++i) {
+            throttle.acquire(0);
+        }
+        REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(400));
+    }
+
+    SECTION("Bytes per second") {
+        throttle.setMaxBytesPerSecond(1000);
+        auto start = std::chrono::steady_clock::now();
+        throttle.acquire(300);
+        REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(250));
+    }
+}
+
+TEST_CASE("Adaptive back-off", "[throttle]") {
+    IoThrottle throttle;
+    throttle.setAdaptive(true);
+    REQUIRE(throttle.getRateScale() == 1.0);
+
+    for (int i = 0; i < 50; ++i) {
+        throttle.recordLatency(std::chrono::microseconds(100));
+    }
+    REQUIRE(throttle.getRateScale() == 1.0);
+
+    // A sustained latency spike lowers the scale
+    for (int i = 0; i < 20; ++i) {
+        throttle.recordLatency(std::chrono::milliseconds(10));
+    }
+    REQUIRE(throttle.getRateScale() < 1.0);
+
+    SECTION("Non-adaptive throttle ignores latency") {
+        IoThrottle fixed;
+        fixed.recordLatency(std::chrono::microseconds(100));
+        fixed.recordLatency(std::chrono::milliseconds(50));
+        REQUIRE(fixed.getRateScale() == 1.0);
+    }
+}
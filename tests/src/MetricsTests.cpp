@@ -0,0 +1,154 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/Cleaner.h"
+#include "../../src/include/FileSystemBackend.h"
+#include "../../src/include/Metrics.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+    std::string readFile(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream content;
+        content << in.rdbuf();
+        return content.str();
+    }
+}
+
+TEST_CASE("Latency histogram", "[metrics]") {
+    SECTION("Buckets are contiguous and within 1/16 of their values") {
+        for (uint64_t value : {uint64_t(0), uint64_t(15), uint64_t(16), uint64_t(17), uint64_t(1000),
+                               uint64_t(123456789), uint64_t(1) << 40, ~uint64_t(0)}) {
+            size_t bucket = LatencyHistogram::bucketOf(value);
+            REQUIRE(bucket < LatencyHistogram::kBuckets);
+            uint64_t begin = bucket == 0 ? 0 : LatencyHistogram::bucketEnd(bucket - 1);
+            REQUIRE(begin <= value);
+            if (value != ~uint64_t(0)) REQUIRE(value < LatencyHistogram::bucketEnd(bucket));
+            REQUIRE(LatencyHistogram::bucketEnd(bucket) - begin <= std::max<uint64_t>(1, begin / 16) + 1);
+        }
+        REQUIRE(LatencyHistogram::bucketOf(~uint64_t(0)) == LatencyHistogram::kBuckets - 1);
+    }
+
+    SECTION("Quantiles follow the recorded distribution") {
+        LatencyHistogram histogram;
+        REQUIRE(histogram.getQuantile(0.5) == 0);
+        for (uint64_t i = 1; i <= 1000; ++i) histogram.record(i * 1000);
+        REQUIRE(histogram.getCount() == 1000);
+        REQUIRE(histogram.getMax() == 1000000);
+        REQUIRE(histogram.getSum() == 500500000);
+        // Exact within the 1/16 bucket width
+        REQUIRE(histogram.getQuantile(0.5) >= 500000);
+        REQUIRE(histogram.getQuantile(0.5) < 500000 + 500000 / 16);
+        REQUIRE(histogram.getQuantile(0.99) >= 990000);
+        REQUIRE(histogram.getQuantile(0.99) < 990000 + 990000 / 16);
+        REQUIRE(histogram.getQuantile(1.0) == 1000000);
+        REQUIRE(histogram.countBelow(uint64_t(1) << 20) == 1000);
+        REQUIRE(histogram.countBelow(1024) == 1);
+    }
+
+    SECTION("Concurrent recording loses nothing") {
+        LatencyHistogram histogram;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&histogram, t] {
+                for (uint64_t i = 0; i < 10000; ++i) histogram.record(i * (t + 1));
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        REQUIRE(histogram.getCount() == 40000);
+        REQUIRE(histogram.countBelow(~uint64_t(0)) == 40000);
+        REQUIRE(histogram.getMax() == 39996);
+    }
+}
+
+TEST_CASE("Metrics export", "[metrics]") {
+    Metrics& metrics = Metrics::getInstance();
+    metrics.reset();
+    metrics.setEnabled(false);
+    REQUIRE(metrics.start() == 0);
+    metrics.record(MetricOperation::Stat, std::chrono::microseconds(5));
+    REQUIRE(metrics.getHistogram(MetricOperation::Stat).getCount() == 0);
+
+    metrics.setEnabled(true);
+    metrics.record(MetricOperation::Stat, std::chrono::microseconds(5));
+    metrics.record(MetricOperation::Stat, std::chrono::milliseconds(3));
+    { OperationTimer timer(MetricOperation::Registry); }
+    metrics.addCounter("cookiemonster_files_deleted_total", {{"cleaner", "browser"}, {"browser", "Chrome"}}, 3);
+    metrics.addCounter("cookiemonster_files_deleted_total", {{"cleaner", "browser"}, {"browser", "Chrome"}}, 4);
+
+    SECTION("Prometheus text format") {
+        std::string text = metrics.toPrometheus();
+        REQUIRE(text.find("# TYPE cookiemonster_operation_duration_seconds histogram") != std::string::npos);
+        REQUIRE(text.find("cookiemonster_operation_duration_seconds_bucket{operation=\"stat\",le=\"8.192e-06\"} 1")
+                != std::string::npos);
+        REQUIRE(text.find("cookiemonster_operation_duration_seconds_bucket{operation=\"stat\",le=\"+Inf\"} 2")
+                != std::string::npos);
+        REQUIRE(text.find("cookiemonster_operation_duration_seconds_count{operation=\"registry\"} 1")
+                != std::string::npos);
+        REQUIRE(text.find("# TYPE cookiemonster_files_deleted_total counter") != std::string::npos);
+        REQUIRE(text.find("cookiemonster_files_deleted_total{cleaner=\"browser\",browser=\"Chrome\"} 7")
+                != std::string::npos);
+    }
+
+    SECTION("JSON with quantiles") {
+        std::string json = metrics.toJson();
+        REQUIRE(json.find("\"stat\":{\"count\":2,\"sum_ns\":3005000,\"max_ns\":3000000") != std::string::npos);
+        REQUIRE(json.find("\"p99_ns\":3000000") != std::string::npos);
+        REQUIRE(json.find("{\"name\":\"cookiemonster_files_deleted_total\","
+                          "\"labels\":{\"cleaner\":\"browser\",\"browser\":\"Chrome\"},\"value\":7}")
+                != std::string::npos);
+    }
+
+    SECTION("Files are written and rewritten periodically") {
+        auto dir = std::filesystem::temp_directory_path() / "cookiemonster_metrics_test";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        REQUIRE(metrics.write((dir / "a.prom").string(), ""));
+        REQUIRE(readFile(dir / "a.prom") == metrics.toPrometheus());
+        REQUIRE_FALSE(std::filesystem::exists(dir / "a.prom.tmp"));
+
+        MetricsReporter reporter((dir / "b.prom").string(), (dir / "b.json").string(), std::chrono::milliseconds(5));
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (reporter.getReportCount() < 2 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(reporter.getReportCount() >= 2);
+        metrics.addCounter("cookiemonster_errors_total", {}, 1);
+        reporter.stop();
+        REQUIRE(readFile(dir / "b.prom").find("cookiemonster_errors_total 1") != std::string::npos);
+        REQUIRE(readFile(dir / "b.json") == metrics.toJson());
+        std::filesystem::remove_all(dir);
+    }
+
+    metrics.setEnabled(false);
+    metrics.reset();
+}
+
+TEST_CASE("Cleaners feed the metrics", "[metrics]") {
+    Metrics& metrics = Metrics::getInstance();
+    metrics.reset();
+    metrics.setEnabled(true);
+
+    Cleaner cleaner;
+    auto fs = std::make_shared<MemoryFileSystem>();
+    for (const auto& dir : cleaner.getTempDirectories()) {
+        fs->addTree(dir, 2, 5, 10);
+    }
+    cleaner.setFileSystem(fs);
+    const uint64_t files = cleaner.getTempDirectories().size() * 10;
+
+    REQUIRE(cleaner.cleanTempFiles(true));
+    REQUIRE(metrics.getCounter("cookiemonster_files_deleted_total", {{"cleaner", "temp"}}) == 0);
+    REQUIRE(metrics.getHistogram(MetricOperation::Stat).getCount() == files);
+
+    REQUIRE(cleaner.cleanTempFiles(false));
+    REQUIRE(metrics.getCounter("cookiemonster_files_deleted_total", {{"cleaner", "temp"}}) == files);
+    REQUIRE(metrics.getCounter("cookiemonster_bytes_freed_total", {{"cleaner", "temp"}}) == files * 10);
+    REQUIRE(metrics.getHistogram(MetricOperation::Unlink).getCount() == files);
+    REQUIRE(metrics.getHistogram(MetricOperation::ReadDirectory).getCount() ==
+            cleaner.getTempDirectories().size() * 3 * 2);
+
+    metrics.setEnabled(false);
+    metrics.reset();
+}
@@ -0,0 +1,102 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/OpenFileIndex.h"
+#include "../../src/include/CleaningEngine.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    std::filesystem::path makeFiles(const std::string& name, int files) {
+        auto root = std::filesystem::temp_directory_path() / name;
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+        for (int i = 0; i < files; ++i) {
+            std::ofstream file(root / ("file" + std::to_string(i) + ".tmp"), std::ios::binary);
+            file << std::string(100, 'x');
+        }
+        return root;
+    }
+}
+
+TEST_CASE("In-use error classification", "[openfiles]") {
+    REQUIRE(isFileInUseError(std::make_error_code(std::errc::device_or_resource_busy)));
+    REQUIRE(isFileInUseError(std::make_error_code(std::errc::text_file_busy)));
+    REQUIRE_FALSE(isFileInUseError(std::make_error_code(std::errc::no_such_file_or_directory)));
+    REQUIRE_FALSE(isFileInUseError(std::make_error_code(std::errc::permission_denied)));
+}
+
+TEST_CASE("Engine defers files that are in use", "[openfiles]") {
+    auto root = makeFiles("cookiemonster_openfiles_test", 10);
+    CleaningEngine engine;
+    engine.setOpenFileRetries(2, std::chrono::milliseconds(1));
+
+    SECTION("Busy deletes are retried instead of counted as errors") {
+        std::atomic<int> busy(0);
+        auto result = engine.run({root}, false, [&busy](const FileEntry& entry) {
+            if (entry.path.filename() == "file3.tmp" && busy++ == 0) {
+                throw std::filesystem::filesystem_error("remove", entry.path,
+                    std::make_error_code(std::errc::device_or_resource_busy));
+            }
+            return true;
+        });
+        REQUIRE(result.filesDeleted == 10);
+        REQUIRE(result.errors == 0);
+        REQUIRE(result.filesInUse == 0);
+        REQUIRE(busy == 2);
+    }
+
+    SECTION("Files still busy after the last retry are reported separately") {
+        std::atomic<int> calls(0);
+        auto result = engine.run({root}, false, [&calls](const FileEntry& entry) {
+            calls++;
+            if (entry.path.filename() == "file0.tmp") {
+                throw std::filesystem::filesystem_error("remove", entry.path,
+                    std::make_error_code(std::errc::device_or_resource_busy));
+            }
+            return true;
+        });
+        REQUIRE(result.filesDeleted == 9);
+        REQUIRE(result.filesInUse == 1);
+        REQUIRE(result.errors == 0);
+        REQUIRE(calls == 10 + 2);
+    }
+
+    SECTION("Without the check busy files are errors") {
+        engine.setOpenFileCheck(false);
+        auto result = engine.run({root}, false, [](const FileEntry& entry) -> bool {
+            throw std::filesystem::filesystem_error("remove", entry.path,
+                std::make_error_code(std::errc::device_or_resource_busy));
+        });
+        REQUIRE(result.errors == 10);
+        REQUIRE(result.filesInUse == 0);
+    }
+
+#ifdef __linux__
+    SECTION("Files this process holds open are not handed to the handler") {
+        std::ifstream held(root / "file5.tmp", std::ios::binary);
+        REQUIRE(held.is_open());
+
+        FileEntry entry;
+        REQUIRE(statFileEntry(root / "file5.tmp", entry));
+        OpenFileIndex index;
+        REQUIRE(index.build() > 0);
+        REQUIRE(index.contains(entry));
+
+        std::atomic<int> calls(0);
+        auto result = engine.run({root}, false, [&calls](const FileEntry&) {
+            calls++;
+            return true;
+        });
+        REQUIRE(calls == 9);
+        REQUIRE(result.filesInUse == 1);
+        REQUIRE(result.bytesFreed == 900);
+
+        held.close();
+        result = engine.run({root}, false, [](const FileEntry&) { return true; });
+        REQUIRE(result.filesInUse == 0);
+        REQUIRE(result.filesDeleted == 10);
+    }
+#endif
+
+    std::filesystem::remove_all(root);
+}
@@ -0,0 +1,80 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/PathArena.h"
+#include "../../src/include/Logger.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+    PathView view(const std::filesystem::path& path) {
+        return PathView(path.native());
+    }
+}
+
+TEST_CASE("Path arena", "[paths]") {
+    SECTION("Stored views stay valid while the arena grows") {
+        PathArena arena(64);
+        std::vector<std::filesystem::path> originals;
+        std::vector<PathView> views;
+        for (int i = 0; i < 1000; ++i) {
+            originals.push_back(std::filesystem::path("cache") / ("entry_" + std::to_string(i)));
+            views.push_back(arena.store(view(originals.back())));
+        }
+        for (size_t i = 0; i < originals.size(); ++i) {
+            REQUIRE(views[i] == view(originals[i]));
+            REQUIRE(views[i].data()[views[i].size()] == PathView::value_type());
+            REQUIRE(views[i].data() != originals[i].native().data());
+        }
+        REQUIRE(arena.getBytesStored() > 0);
+    }
+
+    SECTION("Empty strings can be stored") {
+        PathArena arena;
+        REQUIRE(arena.store(PathView()).empty());
+    }
+}
+
+TEST_CASE("Paths convert to UTF-8 without truncation", "[paths]") {
+    std::filesystem::path path = std::filesystem::u8path("caf\xC3\xA9/\xE6\x97\xA5\xE6\x9C\xAC.tmp");
+    std::string text = toUtf8(path);
+    REQUIRE(text.find("caf\xC3\xA9") != std::string::npos);
+    REQUIRE(text.find("\xE6\x97\xA5\xE6\x9C\xAC.tmp") != std::string::npos);
+}
+
+TEST_CASE("Wide text converts to UTF-8 and back", "[paths]") {
+    // Cyrillic and CJK names, then U+1F600, which is a surrogate pair in UTF-16
+    std::wstring wide = L"Software\\\x041A\x043B\x044E\x0447\\\x65E5\x672C";
+    std::string utf8 = "Software\\\xD0\x9A\xD0\xBB\xD1\x8E\xD1\x87\\\xE6\x97\xA5\xE6\x9C\xAC";
+    if constexpr (sizeof(wchar_t) == 2) {
+        wide += L"\xD83D\xDE00";
+    } else {
+        wide += static_cast<wchar_t>(0x1F600);
+    }
+    utf8 += "\xF0\x9F\x98\x80";
+    REQUIRE(wideToUtf8(wide) == utf8);
+    REQUIRE(utf8ToWide(utf8) == wide);
+    REQUIRE(wideToUtf8(L"") == "");
+
+    // Truncated, overlong and surrogate sequences are replaced, not dropped
+    REQUIRE(utf8ToWide("a\xD0") == std::wstring(L"a\xFFFD"));
+    REQUIRE(utf8ToWide("\xC0\xAF") == std::wstring(L"\xFFFD\xFFFD"));
+    REQUIRE(utf8ToWide("\xED\xA0\x80").size() == 3);
+    REQUIRE(wideToUtf8(std::wstring(1, static_cast<wchar_t>(0xDC00))) == "\xEF\xBF\xBD");
+}
+
+TEST_CASE("Code points append as UTF-8", "[paths]") {
+    std::string out;
+    for (uint32_t code : {0x41u, 0xE9u, 0x65E5u, 0x1F600u}) appendUtf8(out, code);
+    REQUIRE(out == "A\xC3\xA9\xE6\x97\xA5\xF0\x9F\x98\x80");
+}
+
+TEST_CASE("Logger level threshold", "[paths]") {
+    Logger& logger = Logger::getInstance();
+    logger.setLevel(LogLevel::WARNING);
+    REQUIRE_FALSE(logger.isEnabled(LogLevel::DEBUG));
+    REQUIRE_FALSE(logger.isEnabled(LogLevel::INFO));
+    REQUIRE(logger.isEnabled(LogLevel::WARNING));
+    REQUIRE(logger.isEnabled(LogLevel::ERROR));
+    logger.setLevel(LogLevel::DEBUG);
+    REQUIRE(logger.isEnabled(LogLevel::DEBUG));
+}
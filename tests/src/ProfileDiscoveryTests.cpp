@@ -0,0 +1,266 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/ProfileDiscovery.h"
+#include "../../src/include/Cleaner.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+    void writeFile(const std::filesystem::path& path, const std::string& contents) {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream file(path, std::ios::binary);
+        file << contents;
+    }
+
+    // Data (Local State) and cache roots of Chrome below a fixture home
+    std::filesystem::path chromeData(const UserDirectories& user) {
+#ifdef _WIN32
+        return user.cacheDir / "Google" / "Chrome" / "User Data";
+#else
+        return user.configDir / "google-chrome";
+#endif
+    }
+
+    std::filesystem::path chromeCache(const UserDirectories& user) {
+#ifdef _WIN32
+        return user.cacheDir / "Google" / "Chrome" / "User Data";
+#else
+        return user.cacheDir / "google-chrome";
+#endif
+    }
+
+    std::filesystem::path firefoxData(const UserDirectories& user) {
+#ifdef _WIN32
+        return user.configDir / "Mozilla" / "Firefox";
+#else
+        return user.home / ".mozilla" / "firefox";
+#endif
+    }
+
+    std::filesystem::path firefoxCache(const UserDirectories& user) {
+#ifdef _WIN32
+        return user.cacheDir / "Mozilla" / "Firefox";
+#else
+        return user.cacheDir / "mozilla" / "firefox";
+#endif
+    }
+
+#ifdef _WIN32
+    const char* const kFirefoxProfile = "Profiles/abcd.default";
+#else
+    const char* const kFirefoxProfile = "abcd.default";
+#endif
+
+    // A home with two Chrome profiles, an unlisted Chrome directory and one Firefox profile
+    UserDirectories makeHome(const std::filesystem::path& home, const std::string& user) {
+        UserDirectories dirs = userDirectoriesForHome(home, user);
+        writeFile(chromeData(dirs) / "Local State",
+            R"({"browser":{"last_redirect_origin":""},"profile":{"info_cache":{)"
+            R"("Default":{"name":"Person 1","avatar":[1,2]},"Profile 1":{"name":"Work"},)"
+            R"("Profile 9":{"name":"No cache"}},"last_used":"Default"}})");
+        writeFile(chromeCache(dirs) / "Default" / "Cache" / "Cache_Data" / "data_0", std::string(100, 'a'));
+        writeFile(chromeCache(dirs) / "Default" / "GPUCache" / "data_1", std::string(50, 'b'));
+        writeFile(chromeCache(dirs) / "Profile 1" / "Code Cache" / "js" / "index", std::string(10, 'c'));
+        writeFile(chromeCache(dirs) / "Profile 2" / "Cache" / "stale", std::string(10, 'd'));
+
+        writeFile(firefoxData(dirs) / "profiles.ini",
+            "[General]\nStartWithLastProfile=1\n\n"
+            "[Profile0]\nName=default\nIsRelative=1\nPath=" + std::string(kFirefoxProfile) + "\n\n"
+            "[Install4F96D1932A9F858E]\nDefault=" + kFirefoxProfile + "\n");
+        writeFile(firefoxCache(dirs) / kFirefoxProfile / "cache2" / "entries" / "0123", std::string(20, 'e'));
+        return dirs;
+    }
+
+    std::vector<std::string> names(const std::vector<BrowserProfile>& profiles, const std::string& browser) {
+        std::vector<std::string> result;
+        for (const auto& profile : profiles) {
+            if (profile.browserName == browser) result.push_back(profile.profileName);
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Local State profile list", "[profiles]") {
+    SECTION("Keys of profile.info_cache are returned in order") {
+        auto profiles = parseLocalStateProfiles(
+            R"({ "profile" : { "last_used" : "Profile 2", "info_cache" : {)"
+            R"( "Profile 2" : { "name" : "A \"quoted\" name", "list" : [ {}, [], null, -1.5e3 ] },)"
+            R"( "Default" : {} } } })");
+        REQUIRE(profiles == std::vector<std::string>{"Profile 2", "Default"});
+    }
+
+    SECTION("Escaped keys are decoded") {
+        auto profiles = parseLocalStateProfiles(R"({"profile":{"info_cache":{"Prof\u00e9l":{},"\ud83d\ude00":{}}}})");
+        REQUIRE(profiles == std::vector<std::string>{"Prof\xC3\xA9l", "\xF0\x9F\x98\x80"});
+    }
+
+    SECTION("Names that would leave the user data directory are dropped") {
+        auto profiles = parseLocalStateProfiles(R"({"profile":{"info_cache":{"..":{},"a/b":{},"c\\d":{},"":{},"ok":{}}}})");
+        REQUIRE(profiles == std::vector<std::string>{"ok"});
+    }
+
+    SECTION("Missing or malformed files yield nothing") {
+        REQUIRE(parseLocalStateProfiles("").empty());
+        REQUIRE(parseLocalStateProfiles(R"({"profile":{}})").empty());
+        REQUIRE(parseLocalStateProfiles(R"({"profile":{"info_cache":{"Default":{)").empty());
+        REQUIRE(parseLocalStateProfiles(R"({"profile":{"info_cache":{"Default" {}}}})").empty());
+    }
+}
+
+TEST_CASE("Firefox profiles.ini", "[profiles]") {
+    auto entries = parseProfilesIni(
+        "[General]\r\nStartWithLastProfile=1\r\n\r\n"
+        "[Profile1]\r\nName=work\r\nIsRelative=0\r\nPath=/srv/firefox/work\r\n\r\n"
+        "[Profile0]\r\nName=default\r\nIsRelative=1\r\nPath=Profiles/abcd.default\r\nDefault=1\r\n\r\n"
+        "[Profile2]\r\nName=evil\r\nPath=../../etc\r\n"
+        "[Install308046B0AF4A39CB]\r\nDefault=Profiles/abcd.default\r\nPath=ignored\r\n");
+    REQUIRE(entries.size() == 2);
+    REQUIRE(entries[0].path == "/srv/firefox/work");
+    REQUIRE_FALSE(entries[0].relative);
+    REQUIRE(entries[1].path == "Profiles/abcd.default");
+    REQUIRE(entries[1].relative);
+}
+
+TEST_CASE("Profile discovery", "[profiles]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_profiles_test";
+    std::filesystem::remove_all(root);
+    UserDirectories alice = makeHome(root / "alice", "alice");
+    UserDirectories bob = makeHome(root / "bob", "bob");
+
+    SECTION("Profiles listed in Local State are found with their existing caches") {
+        auto profiles = discoverProfiles(alice);
+        REQUIRE(names(profiles, "Google Chrome") == std::vector<std::string>{"Default", "Profile 1"});
+        REQUIRE(names(profiles, "Mozilla Firefox") == std::vector<std::string>{"abcd.default"});
+
+        auto chrome = std::find_if(profiles.begin(), profiles.end(),
+            [](const BrowserProfile& profile) { return profile.profileName == "Default"; });
+        REQUIRE(chrome->cacheDirs.size() == 2);
+        REQUIRE(chrome->user == "alice");
+        REQUIRE(chrome->family == BrowserFamily::Chromium);
+    }
+
+    SECTION("Profile directories are used without a Local State") {
+        std::filesystem::remove(chromeData(alice) / "Local State");
+        auto profiles = discoverProfiles(alice);
+        REQUIRE(names(profiles, "Google Chrome") == std::vector<std::string>{"Default", "Profile 1", "Profile 2"});
+    }
+
+    SECTION("Firefox profiles are found without profiles.ini") {
+        std::filesystem::remove(firefoxData(alice) / "profiles.ini");
+        REQUIRE(names(discoverProfiles(alice), "Mozilla Firefox") == std::vector<std::string>{"abcd.default"});
+    }
+
+    SECTION("Several users are discovered together") {
+        auto profiles = discoverProfiles(std::vector<UserDirectories>{alice, bob});
+        REQUIRE(profiles.size() == 6);
+        REQUIRE(profiles.front().user == "alice");
+        REQUIRE(profiles.back().user == "bob");
+    }
+
+#ifndef _WIN32
+    SECTION("Confined homes only yield real directories of their account") {
+        auto outside = root / "outside";
+        writeFile(outside / "Cache" / "secret", "x");
+        writeFile(outside / "Profile 1" / "Code Cache" / "secret", "x");
+        writeFile(outside / "firefox" / "cache2" / "entries" / "secret", "x");
+        alice.confined = true;
+        alice.owner = ::geteuid();
+        REQUIRE(discoverProfiles(alice).size() == 3);
+
+        // A linked cache root, a linked profile directory and an absolute profile path
+        std::filesystem::remove_all(chromeCache(alice) / "Default" / "Cache");
+        std::filesystem::create_directory_symlink(outside / "Cache", chromeCache(alice) / "Default" / "Cache");
+        std::filesystem::remove_all(chromeCache(alice) / "Profile 1");
+        std::filesystem::create_directory_symlink(outside / "Profile 1", chromeCache(alice) / "Profile 1");
+        writeFile(firefoxData(alice) / "profiles.ini",
+            "[Profile0]\nName=default\nIsRelative=0\nPath=" + (outside / "firefox").string() + "\n");
+        if (::geteuid() == 0) {
+            REQUIRE(::lchown((chromeCache(alice) / "Default" / "GPUCache").c_str(), 4242, 4242) == 0);
+        }
+
+        UserDirectories trusting = alice;
+        trusting.confined = false;
+        REQUIRE(discoverProfiles(trusting).size() == 3);
+        auto profiles = discoverProfiles(alice);
+        if (::geteuid() == 0) {
+            REQUIRE(profiles.empty());
+        } else {
+            REQUIRE(profiles.size() == 1);
+            REQUIRE(profiles[0].cacheDirs == std::vector<std::filesystem::path>{
+                chromeCache(alice) / "Default" / "GPUCache"});
+        }
+    }
+#endif
+
+    SECTION("The cleaner empties the caches of every profile of every user") {
+        Cleaner cleaner;
+        cleaner.setOpenFileCheck(false);
+        cleaner.setUserHomes({alice.home, bob.home});
+        REQUIRE(cleaner.cleanBrowserCache(false));
+
+        for (const auto& user : {alice, bob}) {
+            REQUIRE_FALSE(std::filesystem::exists(chromeCache(user) / "Default" / "Cache" / "Cache_Data" / "data_0"));
+            REQUIRE_FALSE(std::filesystem::exists(chromeCache(user) / "Profile 1" / "Code Cache" / "js" / "index"));
+            // Listed cache roots stay, the directories emptied below them go
+            REQUIRE(std::filesystem::exists(chromeCache(user) / "Default" / "Cache"));
+            REQUIRE_FALSE(std::filesystem::exists(chromeCache(user) / "Default" / "Cache" / "Cache_Data"));
+            // Profile 2 is not in Local State, so it is left alone
+            REQUIRE(std::filesystem::exists(chromeCache(user) / "Profile 2" / "Cache" / "stale"));
+        }
+    }
+
+    SECTION("Homes with non-ASCII names are cleaned and evicted") {
+        // Converting such a path to std::wstring throws in the "C" locale on POSIX
+        UserDirectories carol = makeHome(root / std::filesystem::u8path("h\xC3\xB6me"), "carol");
+        Cleaner evicting;
+        evicting.setUserHomes({carol.home});
+        evicting.setCacheEvictionPolicy(1, 0);
+        REQUIRE(evicting.cleanBrowserCache(true));
+        REQUIRE(evicting.cleanBrowserCacheWithBackup(true));
+
+        Cleaner cleaner;
+        cleaner.setOpenFileCheck(false);
+        cleaner.setUserHomes({carol.home});
+        REQUIRE(cleaner.cleanBrowserCache(false));
+        REQUIRE_FALSE(std::filesystem::exists(chromeCache(carol) / "Default" / "Cache" / "Cache_Data" / "data_0"));
+    }
+
+    SECTION("Backup and cleaning run as one pass") {
+        for (auto mode : {BackupMode::Copy, BackupMode::Quarantine}) {
+            makeHome(alice.home, "alice");
+            // Same name as the Default profile's file, different contents
+            auto sameName = chromeCache(alice) / "Profile 1" / "Cache" / "Cache_Data" / "data_0";
+            writeFile(sameName, std::string(30, 'f'));
+            Cleaner cleaner;
+            cleaner.setOpenFileCheck(false);
+            cleaner.setBackupMode(mode);
+            cleaner.setUserHomes({alice.home});
+            REQUIRE(cleaner.cleanBrowserCacheWithBackup(false));
+
+            auto backups = cleaner.getAvailableBackups();
+            REQUIRE(backups.size() == 1);
+            std::filesystem::path backupPath = backups[0].backupPath;
+            // Exactly the deleted files are preserved
+            REQUIRE(backups[0].files.size() == 5);
+            REQUIRE(backups[0].totalSize == 210);
+            auto data = chromeCache(alice) / "Default" / "Cache" / "Cache_Data" / "data_0";
+            REQUIRE(std::filesystem::file_size(backupLocation(backupPath, data)) == 100);
+            REQUIRE(std::filesystem::file_size(backupLocation(backupPath, sameName)) == 30);
+            REQUIRE_FALSE(std::filesystem::exists(backupLocation(backupPath,
+                chromeCache(alice) / "Profile 2" / "Cache" / "stale")));
+            REQUIRE_FALSE(std::filesystem::exists(data));
+            REQUIRE_FALSE(std::filesystem::exists(sameName));
+
+            REQUIRE(cleaner.restoreFromBackup(backupPath.string()));
+            REQUIRE(std::filesystem::file_size(data) == 100);
+            REQUIRE(std::filesystem::file_size(sameName) == 30);
+            REQUIRE(cleaner.deleteBackup(backupPath.string()));
+        }
+    }
+
+    std::filesystem::remove_all(root);
+}
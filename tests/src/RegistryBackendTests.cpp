@@ -0,0 +1,122 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/RegistryBackend.h"
+#include "../../src/include/Cleaner.h"
+
+namespace {
+    const std::wstring kRunMru = L"Software\\Microsoft\\Windows\\CurrentVersion\\Explorer\\RunMRU";
+
+    RegistryValue stringValue(const std::wstring& name, const std::string& text) {
+        RegistryValue value;
+        value.name = name;
+        value.type = RegistryType::String;
+        value.data.assign(text.begin(), text.end());
+        return value;
+    }
+
+    void populate(MemoryRegistry& hive, const std::wstring& path, int values, int subKeys) {
+        auto key = hive.openKey(RegistryRoot::CurrentUser, path, RegistryAccess::Create);
+        REQUIRE(key);
+        for (int i = 0; i < values; ++i) {
+            REQUIRE(key->setValue(stringValue(L"value" + std::to_wstring(i), "data")));
+        }
+        for (int i = 0; i < subKeys; ++i) {
+            auto child = key->openSubKey(L"child" + std::to_wstring(i) + L"\\nested", RegistryAccess::Create);
+            REQUIRE(child);
+            REQUIRE(child->setValue(stringValue(L"inner", "x")));
+        }
+    }
+}
+
+TEST_CASE("Memory registry", "[registry]") {
+    MemoryRegistry hive;
+    populate(hive, L"Software\\Test", 3, 2);
+
+    SECTION("Names are case-insensitive") {
+        auto key = hive.openKey(RegistryRoot::CurrentUser, L"SOFTWARE\\test", RegistryAccess::Read);
+        REQUIRE(key);
+        REQUIRE(key->setValue(stringValue(L"VALUE0", "changed")));
+        std::vector<RegistryValue> values;
+        REQUIRE(key->listValues(values, true));
+        REQUIRE(values.size() == 3);
+        REQUIRE(values[0].data.size() == 7);
+    }
+
+    SECTION("Roots are separate") {
+        REQUIRE_FALSE(hive.openKey(RegistryRoot::LocalMachine, L"Software\\Test", RegistryAccess::Read));
+    }
+
+    SECTION("Deleting a tree invalidates open subkeys") {
+        auto key = hive.openKey(RegistryRoot::CurrentUser, L"Software\\Test", RegistryAccess::Write);
+        auto nested = key->openSubKey(L"child0\\nested", RegistryAccess::Read);
+        REQUIRE(nested);
+        REQUIRE(key->deleteTree(L"child0"));
+        REQUIRE_FALSE(key->deleteTree(L"child0"));
+
+        std::vector<std::wstring> names;
+        REQUIRE_FALSE(nested->listSubKeys(names));
+        REQUIRE(key->listSubKeys(names));
+        REQUIRE(names == std::vector<std::wstring>{L"child1"});
+    }
+}
+
+TEST_CASE("Registry cleaning through a backend", "[registry]") {
+    auto hive = std::make_unique<MemoryRegistry>();
+    MemoryRegistry& view = *hive;
+    populate(view, kRunMru, 100, 10);
+
+    Cleaner cleaner;
+    cleaner.setRegistryBackend(std::move(hive));
+
+    SECTION("Dry run leaves the hive untouched") {
+        REQUIRE(cleaner.cleanRegistryKey(RegistryRoot::CurrentUser, kRunMru, true));
+        std::vector<RegistryValue> values;
+        REQUIRE(view.openKey(RegistryRoot::CurrentUser, kRunMru, RegistryAccess::Read)->listValues(values, false));
+        REQUIRE(values.size() == 100);
+    }
+
+    SECTION("Every value and subkey is deleted") {
+        uint64_t before = view.getCallCount();
+        REQUIRE(cleaner.cleanRegistryKey(RegistryRoot::CurrentUser, kRunMru, false));
+        uint64_t calls = view.getCallCount() - before;
+
+        auto key = view.openKey(RegistryRoot::CurrentUser, kRunMru, RegistryAccess::Read);
+        std::vector<RegistryValue> values;
+        std::vector<std::wstring> subKeys;
+        REQUIRE(key->listValues(values, false));
+        REQUIRE(key->listSubKeys(subKeys));
+        REQUIRE(values.empty());
+        REQUIRE(subKeys.empty());
+
+        // One open, two listings and one call per value and subtree
+        REQUIRE(calls == 1 + 2 + 100 + 10);
+    }
+
+    SECTION("Non-ASCII key and value names are cleaned") {
+        // Cyrillic and CJK names, which std::filesystem::path cannot convert in the "C" locale
+        const std::wstring key = L"Software\\\x041A\x043B\x044E\x0447";
+        auto created = view.openKey(RegistryRoot::CurrentUser, key, RegistryAccess::Create);
+        REQUIRE(created);
+        REQUIRE(created->setValue(stringValue(L"\x65E5\x672C", "data")));
+        REQUIRE(created->openSubKey(L"\x0434\x0435\x0440\x0435\x0432\x043E", RegistryAccess::Create));
+        REQUIRE(cleaner.cleanRegistryKey(RegistryRoot::CurrentUser, key, true));
+        REQUIRE(cleaner.cleanRegistryKey(RegistryRoot::CurrentUser, key, false));
+
+        std::vector<RegistryValue> values;
+        std::vector<std::wstring> subKeys;
+        REQUIRE(created->listValues(values, false));
+        REQUIRE(created->listSubKeys(subKeys));
+        REQUIRE(values.empty());
+        REQUIRE(subKeys.empty());
+    }
+
+    SECTION("Missing keys are reported as errors") {
+        REQUIRE_FALSE(cleaner.cleanRegistryKey(RegistryRoot::CurrentUser, L"Software\\Missing", false));
+    }
+
+    SECTION("Obsolete keys are cleaned by cleanRegistry") {
+        for (const auto& key : cleaner.getObsoleteRegistryKeys()) {
+            view.openKey(RegistryRoot::CurrentUser, key, RegistryAccess::Create);
+        }
+        REQUIRE(cleaner.cleanRegistry(false));
+    }
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/RegistrySnapshot.h"
+#include "../../src/include/Cleaner.h"
+#include "../../src/include/PathArena.h"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    const std::wstring kTypedPaths = L"Software\\Microsoft\\Windows\\CurrentVersion\\Explorer\\TypedPaths";
+
+    RegistryValue makeValue(const std::wstring& name, uint32_t type, std::vector<uint8_t> data) {
+        RegistryValue value;
+        value.name = name;
+        value.type = type;
+        value.data = std::move(data);
+        return value;
+    }
+
+    void populate(RegistryBackend& hive, const std::wstring& path) {
+        auto key = hive.openKey(RegistryRoot::CurrentUser, path, RegistryAccess::Create);
+        REQUIRE(key);
+        REQUIRE(key->setValue(makeValue(L"url1", RegistryType::String, {'a', 0, 0, 0})));
+        REQUIRE(key->setValue(makeValue(L"count", RegistryType::DWord, {1, 0, 0, 0})));
+        REQUIRE(key->setValue(makeValue(L"stamp", RegistryType::QWord, {1, 2, 3, 4, 5, 6, 7, 8})));
+        REQUIRE(key->setValue(makeValue(L"blob", RegistryType::Binary, std::vector<uint8_t>(10000, 0xAB))));
+        REQUIRE(key->setValue(makeValue(L"", RegistryType::MultiString, {})));
+
+        auto nested = key->openSubKey(L"Sub\\Deeper", RegistryAccess::Create);
+        REQUIRE(nested);
+        REQUIRE(nested->setValue(makeValue(L"inner", RegistryType::ExpandString, {'%', 0})));
+    }
+
+    std::vector<RegistryValue> valuesOf(RegistryBackend& hive, const std::wstring& path) {
+        std::vector<RegistryValue> values;
+        auto key = hive.openKey(RegistryRoot::CurrentUser, path, RegistryAccess::Read);
+        if (key) key->listValues(values, true);
+        return values;
+    }
+}
+
+TEST_CASE("Registry snapshot round trip", "[registry]") {
+    auto file = std::filesystem::temp_directory_path() / "cookiemonster_snapshot_test.regsnap";
+    MemoryRegistry source;
+    populate(source, kTypedPaths);
+
+    RegistrySnapshot snapshot;
+    REQUIRE(snapshot.capture(source, RegistryRoot::CurrentUser, kTypedPaths));
+    REQUIRE(snapshot.getKeyCount() == 3);
+    REQUIRE(snapshot.getValueCount() == 6);
+    REQUIRE(snapshot.save(file));
+
+    SECTION("Every key and value type is restored") {
+        RegistrySnapshot loaded;
+        REQUIRE(loaded.load(file));
+        REQUIRE(loaded.getPath() == kTypedPaths);
+        REQUIRE(loaded.getRoot() == RegistryRoot::CurrentUser);
+
+        MemoryRegistry target;
+        REQUIRE(loaded.restore(target));
+        auto original = valuesOf(source, kTypedPaths);
+        auto restored = valuesOf(target, kTypedPaths);
+        REQUIRE(restored.size() == original.size());
+        for (size_t i = 0; i < original.size(); ++i) {
+            REQUIRE(restored[i].name == original[i].name);
+            REQUIRE(restored[i].type == original[i].type);
+            REQUIRE(restored[i].data == original[i].data);
+        }
+        REQUIRE(valuesOf(target, kTypedPaths + L"\\Sub\\Deeper").size() == 1);
+    }
+
+    SECTION("Corrupt snapshots are rejected") {
+        {
+            std::fstream stream(file, std::ios::binary | std::ios::in | std::ios::out);
+            stream.seekp(20);
+            stream.put('\x7F');
+        }
+        RegistrySnapshot loaded;
+        REQUIRE_FALSE(loaded.load(file));
+        REQUIRE_FALSE(loaded.getError().empty());
+    }
+
+    SECTION("Missing keys cannot be captured") {
+        RegistrySnapshot missing;
+        REQUIRE_FALSE(missing.capture(source, RegistryRoot::CurrentUser, L"Software\\Missing"));
+        // Key names are reported in UTF-8
+        REQUIRE_FALSE(missing.capture(source, RegistryRoot::CurrentUser, L"Software\\\x041A\x043B\x044E\x0447"));
+        REQUIRE(missing.getError().find("Software\\\xD0\x9A\xD0\xBB\xD1\x8E\xD1\x87") != std::string::npos);
+    }
+
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("Registry backup and restore through the cleaner", "[registry]") {
+    auto hive = std::make_unique<MemoryRegistry>();
+    MemoryRegistry& view = *hive;
+    populate(view, kTypedPaths);
+
+    Cleaner cleaner;
+    cleaner.setRegistryBackend(std::move(hive));
+    REQUIRE(cleaner.createBackup("registry"));
+    auto backups = cleaner.getAvailableBackups();
+    REQUIRE(backups.size() == 1);
+    REQUIRE(backups[0].registryKeys.size() == 1);
+    REQUIRE(utf8ToWide(backups[0].registryKeys[0].first) == kTypedPaths);
+
+    cleaner.cleanRegistry(false);
+    REQUIRE(valuesOf(view, kTypedPaths).empty());
+
+    REQUIRE(cleaner.restoreFromBackup(backups[0].backupPath));
+    REQUIRE(valuesOf(view, kTypedPaths).size() == 5);
+    REQUIRE(valuesOf(view, kTypedPaths + L"\\Sub\\Deeper").size() == 1);
+    REQUIRE(cleaner.deleteBackup(backups[0].backupPath));
+}
@@ -0,0 +1,313 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/Cleaner.h"
+#include "../../src/include/FileSystemBackend.h"
+#include "../../src/include/RuleSet.h"
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    std::filesystem::path::string_type native(const std::string& text) {
+        return std::filesystem::path(text).make_preferred().native();
+    }
+
+    FileEntry fileEntry(const std::string& path, uint64_t size, int64_t mtime, size_t rootSet) {
+        FileEntry entry;
+        entry.path = std::filesystem::path(path).make_preferred();
+        entry.size = size;
+        entry.mtime = mtime;
+        entry.rootSet = rootSet;
+        return entry;
+    }
+
+    // Seconds since the Unix epoch in the units of FileEntry::mtime
+    int64_t toMtime(std::time_t seconds) {
+#ifdef _WIN32
+        return (static_cast<int64_t>(seconds) + 11644473600ll) * 10000000;
+#else
+        return static_cast<int64_t>(seconds) * 1000000000;
+#endif
+    }
+}
+
+TEST_CASE("Rule file parsing", "[rules]") {
+    std::vector<CleaningRule> rules;
+    std::string error;
+
+    SECTION("All keys") {
+        REQUIRE(parseRules(
+            "# build outputs\n"
+            "[logs]\n"
+            "root = /var/tmp/app\n"
+            "root = /srv/app\n"
+            "glob = **/*.log\n"
+            "extensions = .LOG, txt\n"
+            "exclude-extensions = gz\n"
+            "min-age = 12h\n"
+            "min-size = 1K\n"
+            "max-size = 2M\n"
+            "recursive = no\n"
+            "action = report\n"
+            "\n"
+            "; second rule\n"
+            "[keep]\n"
+            "root = /var/tmp/app/keep\n"
+            "min-age = 3\n"
+            "action = keep\n", rules, error));
+        REQUIRE(rules.size() == 2);
+        const CleaningRule& logs = rules[0];
+        REQUIRE(logs.name == "logs");
+        REQUIRE(logs.roots.size() == 2);
+        REQUIRE(logs.globs == std::vector<std::string>{"**/*.log"});
+        REQUIRE(logs.extensions == std::vector<std::string>{"log", "txt"});
+        REQUIRE(logs.excludedExtensions == std::vector<std::string>{"gz"});
+        REQUIRE(logs.minAgeSeconds == 12 * 3600);
+        REQUIRE(logs.minSize == 1024);
+        REQUIRE(logs.maxSize == 2 * 1024 * 1024);
+        REQUIRE_FALSE(logs.recursive);
+        REQUIRE(logs.action == RuleAction::Report);
+        REQUIRE(rules[1].minAgeSeconds == 3 * 86400);
+        REQUIRE(rules[1].action == RuleAction::Keep);
+        REQUIRE(rules[1].recursive);
+    }
+
+    SECTION("Errors name the line") {
+        REQUIRE_FALSE(parseRules("[a]\nroot = /tmp\nmin-size = lots\n", rules, error));
+        REQUIRE(error == "line 3: invalid min-size lots");
+        REQUIRE_FALSE(parseRules("[a]\nroot = /tmp\nmax-size = 99999999999G\n", rules, error));
+        REQUIRE(error == "line 3: invalid max-size 99999999999G");
+        REQUIRE_FALSE(parseRules("[a]\nroot = /tmp\nmin-age = 999999999999999d\n", rules, error));
+        REQUIRE(error == "line 3: invalid min-age 999999999999999d");
+        REQUIRE_FALSE(parseRules("[a]\nroot = /tmp\nmin-age = -1d\n", rules, error));
+        REQUIRE(error == "line 3: invalid min-age -1d");
+        REQUIRE_FALSE(parseRules("root = /tmp\n", rules, error));
+        REQUIRE(error == "line 1: key outside of a [rule] section");
+        REQUIRE_FALSE(parseRules("[a]\nroot = /tmp\ncolour = red\n", rules, error));
+        REQUIRE(error == "line 3: unknown key colour");
+        REQUIRE_FALSE(parseRules("[a]\nglob = *\n[b]\nroot = /tmp\n", rules, error));
+        REQUIRE(error == "line 3: rule a has no root");
+        REQUIRE_FALSE(parseRules("[a]\nroot = /tmp\naction = shred\n", rules, error));
+        REQUIRE(rules.empty());
+    }
+}
+
+TEST_CASE("Glob matching", "[rules]") {
+    REQUIRE(globMatch(native("*.log"), native("app.log")));
+    REQUIRE_FALSE(globMatch(native("*.log"), native("app.log.gz")));
+    REQUIRE(globMatch(native("f?"), native("f1")));
+    REQUIRE_FALSE(globMatch(native("f?"), native("f12")));
+    REQUIRE_FALSE(globMatch(native("*.log"), native("dir/app.log")));
+    REQUIRE(globMatch(native("cache/*"), native("cache/a")));
+    REQUIRE_FALSE(globMatch(native("cache/*"), native("cache/a/b")));
+    REQUIRE(globMatch(native("**/*.log"), native("a/b/c.log")));
+    REQUIRE(globMatch(native("**/*.log"), native("c.log")));
+    REQUIRE(globMatch(native("a/**"), native("a/b/c")));
+    REQUIRE(globMatch(native("a/**/c"), native("a/c")));
+    REQUIRE_FALSE(globMatch(native("a/**/c"), native("b/c")));
+}
+
+TEST_CASE("Rule plans", "[rules]") {
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules(
+        "[keep-config]\n"
+        "root = /data/app\n"
+        "glob = *.conf\n"
+        "action = keep\n"
+        "[logs]\n"
+        "root = /data/app/logs\n"
+        "extensions = log\n"
+        "recursive = no\n"
+        "[large]\n"
+        "root = /data/app\n"
+        "min-size = 1M\n"
+        "action = report\n"
+        "[old]\n"
+        "root = /data/app/\n"
+        "root = /other\n"
+        "min-age = 1d\n", rules, error));
+    RulePlan plan(rules);
+    const std::time_t now = 1700000000;
+    const int64_t fresh = toMtime(now - 60);
+    const int64_t stale = toMtime(now - 2 * 86400);
+
+    SECTION("Overlapping roots are merged") {
+        REQUIRE(plan.getRoots().size() == 2);
+        REQUIRE(plan.getRoots()[0].native() == native("/data/app"));
+        REQUIRE(plan.getRoots()[1].native() == native("/other"));
+        REQUIRE(plan.isRecursive());
+    }
+
+    SECTION("Keep wins, then delete, then report") {
+        auto conf = plan.match(fileEntry("/data/app/logs/app.conf", 10, stale, 0), now);
+        REQUIRE(conf.action == RuleAction::Keep);
+        REQUIRE(conf.rule == 0);
+
+        auto log = plan.match(fileEntry("/data/app/logs/app.log", 10, fresh, 0), now);
+        REQUIRE(log.action == RuleAction::Delete);
+        REQUIRE(log.rule == 1);
+
+        auto big = plan.match(fileEntry("/data/app/big.bin", 4 << 20, fresh, 0), now);
+        REQUIRE(big.action == RuleAction::Report);
+        REQUIRE(big.rule == 2);
+
+        auto bigAndOld = plan.match(fileEntry("/data/app/big.bin", 4 << 20, stale, 0), now);
+        REQUIRE(bigAndOld.action == RuleAction::Delete);
+        REQUIRE(bigAndOld.rule == 3);
+
+        REQUIRE(plan.match(fileEntry("/data/app/small.bin", 10, fresh, 0), now).rule == -1);
+        REQUIRE(plan.match(fileEntry("/other/x", 10, stale, 1), now).rule == 3);
+    }
+
+    SECTION("Non-recursive rules only see direct children") {
+        auto nested = plan.match(fileEntry("/data/app/logs/old/app.log", 10, fresh, 0), now);
+        REQUIRE(nested.rule == -1);
+    }
+}
+
+TEST_CASE("Cleaning by rules walks every tree once", "[rules]") {
+    auto fs = std::make_shared<MemoryFileSystem>();
+    const std::time_t now = std::time(nullptr);
+    const int64_t stale = toMtime(now - 30 * 86400);
+    fs->addFile("/work/build/a.o", 100, stale);
+    fs->addFile("/work/build/keep/b.o", 100, stale);
+    fs->addFile("/work/build/c.txt", 100, stale);
+    fs->addFile("/work/cache/d.tmp", 50, toMtime(now));
+    fs->addFile("/work/cache/e.tmp", 50, stale);
+    fs->addFile("/work/huge.iso", 8 << 20, stale);
+
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules(
+        "[objects]\n"
+        "root = /work/build\n"
+        "extensions = o\n"
+        "[protect]\n"
+        "root = /work/build/keep\n"
+        "action = keep\n"
+        "[stale-cache]\n"
+        "root = /work/cache\n"
+        "glob = *.tmp\n"
+        "min-age = 7d\n"
+        "[large]\n"
+        "root = /work\n"
+        "min-size = 1M\n"
+        "action = report\n", rules, error));
+    RulePlan plan(rules);
+    REQUIRE(plan.getRoots().size() == 1);
+
+    Cleaner cleaner;
+    cleaner.setFileSystem(fs);
+    REQUIRE(cleaner.cleanRules(plan, false));
+
+    REQUIRE(fs->typeOf("/work/build/a.o") == FileType::None);
+    REQUIRE(fs->typeOf("/work/build/keep/b.o") == FileType::Regular);
+    REQUIRE(fs->typeOf("/work/build/c.txt") == FileType::Regular);
+    REQUIRE(fs->typeOf("/work/cache/d.tmp") == FileType::Regular);
+    REQUIRE(fs->typeOf("/work/cache/e.tmp") == FileType::None);
+    REQUIRE(fs->typeOf("/work/huge.iso") == FileType::Regular);
+    // /work, build, build/keep and cache, each listed once
+    REQUIRE(fs->getCallCount(FileOperation::List) == 4);
+}
+
+TEST_CASE("Rules that list extensions override the protected file types", "[rules]") {
+    auto fs = std::make_shared<MemoryFileSystem>();
+    fs->addFile("/docs/x.log", 10);
+    fs->addFile("/docs/report.pdf", 10);
+    fs->addFile("/misc/notes.pdf", 10);
+    fs->addFile("/misc/y.tmp", 10);
+
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules("[docs]\nroot = /docs\nextensions = pdf, log\n[misc]\nroot = /misc\n", rules, error));
+    Cleaner cleaner;
+    cleaner.setFileSystem(fs);
+    REQUIRE(cleaner.cleanRules(RulePlan(rules), false));
+
+    // pdf is excluded by default, but the docs rule asks for it by name
+    REQUIRE(fs->typeOf("/docs/x.log") == FileType::None);
+    REQUIRE(fs->typeOf("/docs/report.pdf") == FileType::None);
+    REQUIRE(fs->typeOf("/misc/notes.pdf") == FileType::Regular);
+    REQUIRE(fs->typeOf("/misc/y.tmp") == FileType::None);
+    auto stats = cleaner.getRuleStats();
+    REQUIRE(stats.size() == 2);
+    REQUIRE(stats[0].filesDeleted == 2);
+    REQUIRE(stats[0].filesProtected == 0);
+    REQUIRE(stats[1].filesDeleted == 1);
+    REQUIRE(stats[1].filesProtected == 1);
+}
+
+#ifndef _WIN32
+TEST_CASE("A file linked under two rules frees its space once", "[rules]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_rule_links_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "a");
+    std::filesystem::create_directories(root / "b");
+    {
+        std::ofstream file(root / "a" / "x.tmp", std::ios::binary);
+        file << std::string(10000, 'x');
+    }
+    std::filesystem::create_hard_link(root / "a" / "x.tmp", root / "b" / "x.tmp");
+
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules("[a]\nroot = " + (root / "a").string() + "\n[b]\nroot = " + (root / "b").string() + "\n",
+                       rules, error));
+    Cleaner cleaner;
+    REQUIRE(cleaner.cleanRules(RulePlan(rules), false));
+
+    auto stats = cleaner.getRuleStats();
+    REQUIRE(stats.size() == 2);
+    REQUIRE(stats[0].filesDeleted + stats[1].filesDeleted == 2);
+    REQUIRE(stats[0].bytesFreed + stats[1].bytesFreed == 10000);
+    REQUIRE(stats[0].physicalBytesFreed + stats[1].physicalBytesFreed > 0);
+    REQUIRE(stats[0].physicalBytesFreed + stats[1].physicalBytesFreed < 20000);
+    std::filesystem::remove_all(root);
+}
+#endif
+
+TEST_CASE("Exclusions with non-ASCII names cover rule roots", "[rules]") {
+    // A Cyrillic directory name in UTF-8, the encoding of command line paths
+    const std::string cache = "/work/\xd0\x9a\xd1\x8d\xd1\x88";
+    auto fs = std::make_shared<MemoryFileSystem>();
+    fs->addFile(std::filesystem::u8path(cache + "/a.tmp"), 10);
+    fs->addFile("/other/b.tmp", 10);
+
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules("[cache]\nroot = " + cache + "\n[other]\nroot = /other\n", rules, error));
+
+    Cleaner cleaner;
+    cleaner.setFileSystem(fs);
+    cleaner.setExcludedPaths({std::filesystem::u8path(cache)});
+    REQUIRE(cleaner.cleanRules(RulePlan(rules), false));
+    REQUIRE(fs->typeOf(std::filesystem::u8path(cache + "/a.tmp")) == FileType::Regular);
+    REQUIRE(fs->typeOf("/other/b.tmp") == FileType::None);
+}
+
+#ifndef _WIN32
+TEST_CASE("Rule runs count hard-linked files once", "[rules]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_rules_links_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "links");
+    std::ofstream(root / "original.tmp", std::ios::binary) << std::string(10000, 'x');
+    std::filesystem::create_hard_link(root / "original.tmp", root / "links" / "a.tmp");
+    std::filesystem::create_hard_link(root / "original.tmp", root / "links" / "b.tmp");
+
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules("[links]\nroot = " + root.string() + "/links\n", rules, error));
+    Cleaner cleaner;
+    cleaner.setOpenFileCheck(false);
+    REQUIRE(cleaner.cleanRules(RulePlan(rules), false));
+    // Two links of one file are gone, and its blocks are still held by the third
+    REQUIRE(cleaner.getSummary().filesDeleted == 2);
+    REQUIRE(cleaner.getSummary().bytesFreed == 10000);
+
+    rules.clear();
+    REQUIRE(parseRules("[all]\nroot = " + root.string() + "\n", rules, error));
+    REQUIRE(cleaner.cleanRules(RulePlan(rules), false));
+    REQUIRE(cleaner.getSummary().bytesFreed == 10000);
+    std::filesystem::remove_all(root);
+}
+#endif
@@ -0,0 +1,121 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/RunJournal.h"
+#include "../../src/include/Cleaner.h"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    std::filesystem::path journalPath(const std::string& name) {
+        auto path = std::filesystem::temp_directory_path() / name;
+        std::filesystem::remove(path);
+        return path;
+    }
+
+    std::vector<JournalRun> replay(const std::filesystem::path& path) {
+        RunJournal journal;
+        std::vector<JournalRun> runs;
+        REQUIRE(journal.open(path, runs));
+        return runs;
+    }
+}
+
+TEST_CASE("Journal replays recorded runs", "[journal]") {
+    auto path = journalPath("cookiemonster_journal_test.bin");
+
+    {
+        RunJournal journal;
+        std::vector<JournalRun> runs;
+        REQUIRE(journal.open(path, runs));
+        REQUIRE(runs.empty());
+
+        journal.beginRun("temp");
+        journal.recordBackupStarted("backups/temp_1", "12345");
+        journal.recordBackedUp("/tmp/a", 10);
+        journal.recordBackedUp("/tmp/b", 20);
+        journal.recordBackupDirectory("/tmp");
+        journal.recordBackupComplete();
+        journal.recordDeleted(10);
+        journal.recordCleanedDirectory("/tmp");
+        REQUIRE(journal.sync());
+    }
+
+    auto runs = replay(path);
+    REQUIRE(runs.size() == 1);
+    const JournalRun& run = runs[0];
+    REQUIRE(run.operation == "temp");
+    REQUIRE(run.backupPath == "backups/temp_1");
+    REQUIRE(run.timestamp == "12345");
+    REQUIRE(run.backedUpFiles.size() == 2);
+    REQUIRE(run.backupBytes == 30);
+    REQUIRE(run.backupDirectories.count("/tmp") == 1);
+    REQUIRE(run.backupComplete);
+    REQUIRE(run.filesDeleted == 1);
+    REQUIRE(run.bytesFreed == 10);
+    REQUIRE(run.cleanedDirectories.count("/tmp") == 1);
+    REQUIRE_FALSE(run.finished);
+
+    SECTION("A torn tail is dropped") {
+        std::ofstream(path, std::ios::binary | std::ios::app) << std::string("\x20\x00\x00", 3);
+        auto size = std::filesystem::file_size(path);
+        auto recovered = replay(path);
+        REQUIRE(recovered.size() == 1);
+        REQUIRE(recovered[0].filesDeleted == 1);
+        REQUIRE(std::filesystem::file_size(path) == size - 3);
+    }
+
+    SECTION("Reset discards every run") {
+        {
+            RunJournal journal;
+            std::vector<JournalRun> existing;
+            REQUIRE(journal.open(path, existing));
+            journal.finishRun();
+            REQUIRE(journal.reset());
+        }
+        REQUIRE(replay(path).empty());
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Journal commits records in groups", "[journal]") {
+    auto path = journalPath("cookiemonster_journal_group_test.bin");
+
+    RunJournal journal;
+    std::vector<JournalRun> runs;
+    REQUIRE(journal.open(path, runs));
+    journal.setCommitBatch(100);
+    journal.beginRun("temp");
+    for (int i = 0; i < 1000; ++i) {
+        journal.recordDeleted(1);
+    }
+    REQUIRE(journal.sync());
+    REQUIRE(journal.getSyncCount() >= 1);
+    REQUIRE(journal.getSyncCount() < 100);
+    journal.close();
+
+    auto recovered = replay(path);
+    REQUIRE(recovered.size() == 1);
+    REQUIRE(recovered[0].filesDeleted == 1000);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Interrupted backups are restored into the history", "[journal]") {
+    auto path = journalPath("cookiemonster_journal_cleaner_test.bin");
+    {
+        RunJournal journal;
+        std::vector<JournalRun> runs;
+        REQUIRE(journal.open(path, runs));
+        journal.beginRun("temp");
+        journal.recordBackupStarted("backups/temp_interrupted", "1");
+        journal.recordBackedUp("/tmp/file.tmp", 42);
+    }
+
+    Cleaner cleaner;
+    REQUIRE(cleaner.enableJournal(path.string()));
+    auto backups = cleaner.getAvailableBackups();
+    REQUIRE(backups.size() == 1);
+    REQUIRE(backups[0].backupPath == "backups/temp_interrupted");
+    REQUIRE(backups[0].files.size() == 1);
+    REQUIRE(backups[0].totalSize == 42);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,146 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/Cleaner.h"
+#include "../../src/include/SecureErase.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    std::string readFile(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream content;
+        content << in.rdbuf();
+        return content.str();
+    }
+
+    void writeFile(const std::filesystem::path& path, const std::string& content) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+    }
+
+    FileEntry entryFor(const std::filesystem::path& path) {
+        FileEntry entry;
+        REQUIRE(statFileEntry(path, entry));
+        return entry;
+    }
+
+    bool allZero(const std::string& content) {
+        return content.find_first_not_of('\0') == std::string::npos;
+    }
+}
+
+TEST_CASE("Secure erase overwrites file contents", "[secure-erase]") {
+    auto dir = std::filesystem::temp_directory_path() / "cookiemonster_secure_erase_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    SecureEraser eraser;
+    std::error_code ec;
+
+    SECTION("Regular files keep their size and lose their data") {
+        // Not a multiple of the direct I/O alignment
+        const std::string secret(3 * SecureEraser::kChunkSize / 2 + 123, 's');
+        writeFile(dir / "secret", secret);
+        EraseOutcome outcome = eraser.overwrite(entryFor(dir / "secret"), ec);
+        REQUIRE_FALSE(ec);
+        std::string after = readFile(dir / "secret");
+        REQUIRE(after.size() == secret.size());
+        if (outcome == EraseOutcome::CopyOnWrite) {
+            // Nothing can be erased in place here, so nothing is written
+            REQUIRE(after == secret);
+            REQUIRE(eraser.getStats().copyOnWriteFiles == 1);
+        } else {
+            REQUIRE(outcome == EraseOutcome::Overwritten);
+            REQUIRE(allZero(after));
+            REQUIRE(eraser.getStats().filesOverwritten == 1);
+            REQUIRE(eraser.getStats().bytesOverwritten >= secret.size());
+        }
+    }
+
+    SECTION("Sparse files only have their data written") {
+        const uint64_t size = 8 * SecureEraser::kChunkSize;
+        {
+            std::ofstream out(dir / "sparse", std::ios::binary);
+        }
+        std::filesystem::resize_file(dir / "sparse", size);
+        {
+            std::fstream out(dir / "sparse", std::ios::binary | std::ios::in | std::ios::out);
+            out.seekp(static_cast<std::streamoff>(size / 2));
+            out << std::string(10000, 'd');
+        }
+        EraseOutcome outcome = eraser.overwrite(entryFor(dir / "sparse"), ec);
+        REQUIRE_FALSE(ec);
+        std::string after = readFile(dir / "sparse");
+        REQUIRE(after.size() == size);
+        if (outcome == EraseOutcome::Sparse) {
+            REQUIRE(allZero(after));
+            REQUIRE(eraser.getStats().sparseFiles == 1);
+            REQUIRE(eraser.getStats().bytesOverwritten < size);
+        } else if (outcome == EraseOutcome::Overwritten) {
+            // The file system allocated the holes after all
+            REQUIRE(allZero(after));
+        } else {
+            REQUIRE(outcome == EraseOutcome::CopyOnWrite);
+        }
+    }
+
+    SECTION("Files with other hard links are left intact") {
+        writeFile(dir / "shared", "still needed");
+        std::filesystem::create_hard_link(dir / "shared", dir / "other-name", ec);
+        if (!ec) {
+            REQUIRE(eraser.overwrite(entryFor(dir / "shared"), ec) == EraseOutcome::HardLinked);
+            REQUIRE_FALSE(ec);
+            REQUIRE(readFile(dir / "other-name") == "still needed");
+            REQUIRE(eraser.getStats().hardLinkedFiles == 1);
+        }
+    }
+
+    SECTION("Missing files are not an error") {
+        FileEntry entry;
+        entry.path = dir / "missing";
+        REQUIRE(eraser.overwrite(entry, ec) == EraseOutcome::Missing);
+        REQUIRE_FALSE(ec);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+#ifndef _WIN32
+TEST_CASE("Cleaners overwrite before deleting in secure-erase mode", "[secure-erase]") {
+    auto dir = std::filesystem::temp_directory_path() / "cookiemonster_secure_clean_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "cache");
+    const std::string secret(100000, 'p');
+    writeFile(dir / "cache" / "session", secret);
+    writeFile(dir / "cache" / "token", secret);
+
+    // Copy-on-write file systems keep the old blocks, nothing to observe
+    std::error_code ec;
+    writeFile(dir / "probe", "x");
+    SecureEraser probe;
+    if (probe.overwrite(entryFor(dir / "probe"), ec) == EraseOutcome::CopyOnWrite) {
+        std::filesystem::remove_all(dir);
+        return;
+    }
+
+    // An open descriptor still sees the contents after the unlink
+    std::ifstream held(dir / "cache" / "session", std::ios::binary);
+    REQUIRE(held);
+
+    std::vector<CleaningRule> rules;
+    std::string error;
+    REQUIRE(parseRules("[cache]\nroot = " + (dir / "cache").string() + "\n", rules, error));
+    Cleaner cleaner;
+    cleaner.setOpenFileCheck(false);
+    cleaner.setSecureErase(true);
+    REQUIRE(cleaner.cleanRules(RulePlan(rules), false));
+
+    REQUIRE_FALSE(std::filesystem::exists(dir / "cache" / "session"));
+    REQUIRE_FALSE(std::filesystem::exists(dir / "cache" / "token"));
+    std::stringstream content;
+    content << held.rdbuf();
+    REQUIRE(content.str().size() == secret.size());
+    REQUIRE(allZero(content.str()));
+
+    std::filesystem::remove_all(dir);
+}
+#endif
@@ -0,0 +1,117 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/SimpleCache.h"
+#include "../../src/include/BinaryIO.h"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    constexpr int64_t kDay = 24ll * 60 * 60 * 1000000;
+
+    struct FixtureEntry {
+        uint64_t hash;
+        int64_t lastUsed;
+        uint32_t chunks;            ///< Size in 256-byte units
+    };
+
+    // Write an index the way Chromium pickles it, independent of SimpleCacheIndex::save
+    void writeIndex(const std::filesystem::path& cache, const std::vector<FixtureEntry>& entries) {
+        std::string payload;
+        appendU64(payload, 0x656e74657220796full);
+        appendU32(payload, 9);
+        appendU64(payload, entries.size());
+        uint64_t total = 0;
+        for (const auto& entry : entries) total += entry.chunks * 256ull;
+        appendU64(payload, total);
+        appendU32(payload, 0);
+        for (const auto& entry : entries) {
+            appendU64(payload, entry.hash);
+            appendU64(payload, static_cast<uint64_t>(entry.lastUsed));
+            appendU64(payload, (static_cast<uint64_t>(entry.chunks) << 8) | 1);
+        }
+        appendU64(payload, 0);
+
+        std::string file;
+        appendU32(file, static_cast<uint32_t>(payload.size()));
+        appendU32(file, crc32(payload.data(), payload.size()));
+        std::filesystem::create_directories(cache / "index-dir");
+        std::ofstream(cache / "index-dir" / "the-real-index", std::ios::binary) << file << payload;
+    }
+
+    std::filesystem::path makeCache(int64_t now) {
+        auto root = std::filesystem::temp_directory_path() / "cookiemonster_simplecache_test";
+        std::filesystem::remove_all(root);
+        auto cache = root / "Cache_Data";
+        std::filesystem::create_directories(cache);
+        writeIndex(cache, {
+            {0x1111111111111111ull, now - 60 * kDay, 4},
+            {0x2222222222222222ull, now - 2 * kDay, 8},
+            {0x00000000000000abull, now - 1 * kDay, 2},
+        });
+        for (const char* name : {"1111111111111111_0", "1111111111111111_s", "2222222222222222_0",
+                                 "00000000000000ab_0", "00000000000000ab_1"}) {
+            std::ofstream(cache / name) << "entry";
+        }
+        std::ofstream(cache / "index") << "fake index";
+        return root;
+    }
+}
+
+TEST_CASE("Simple cache index", "[simplecache]") {
+    const int64_t now = toChromiumTime(std::time(nullptr));
+    auto root = makeCache(now);
+    auto caches = SimpleCacheIndex::find(root);
+    REQUIRE(caches.size() == 1);
+    auto cache = caches[0];
+
+    SimpleCacheIndex index;
+    REQUIRE(index.load(cache));
+    REQUIRE(index.getVersion() == 9);
+    REQUIRE(index.getEntries().size() == 3);
+    REQUIRE(index.getEntries()[0].size == 1024);
+
+    auto files = SimpleCacheIndex::entryFiles(cache, 0xab);
+    REQUIRE(files[0].filename() == "00000000000000ab_0");
+    REQUIRE(files[2].filename() == "00000000000000ab_s");
+
+    SECTION("Age limit evicts stale entries only") {
+        CacheEvictionPolicy policy;
+        policy.maxAgeDays = 30;
+        auto evicted = selectCacheEvictions(index.getEntries(), policy, now);
+        REQUIRE(evicted.size() == 1);
+        REQUIRE(evicted[0].hash == 0x1111111111111111ull);
+    }
+
+    SECTION("Budget evicts least recently used entries first") {
+        CacheEvictionPolicy policy;
+        policy.maxBytes = 1000;
+        auto evicted = selectCacheEvictions(index.getEntries(), policy, now);
+        REQUIRE(evicted.size() == 2);
+        REQUIRE(evicted[0].hash == 0x1111111111111111ull);
+        REQUIRE(evicted[1].hash == 0x2222222222222222ull);
+    }
+
+    SECTION("Saved index round-trips") {
+        index.getEntries().erase(index.getEntries().begin());
+        REQUIRE(index.save(cache));
+        REQUIRE_FALSE(std::filesystem::exists(cache / "index-dir" / "temp-index"));
+
+        SimpleCacheIndex reloaded;
+        REQUIRE(reloaded.load(cache));
+        REQUIRE(reloaded.getEntries().size() == 2);
+        REQUIRE(reloaded.getEntries()[0].hash == 0x2222222222222222ull);
+        REQUIRE(reloaded.getEntries()[0].size == 2048);
+    }
+
+    SECTION("Corrupt indexes are rejected") {
+        {
+            std::fstream stream(cache / "index-dir" / "the-real-index", std::ios::binary | std::ios::in | std::ios::out);
+            stream.seekp(40);
+            stream.put('\x7F');
+        }
+        SimpleCacheIndex corrupt;
+        REQUIRE_FALSE(corrupt.load(cache));
+        REQUIRE_FALSE(corrupt.getError().empty());
+    }
+
+    std::filesystem::remove_all(root);
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/SpaceAccounting.h"
+#include "../../src/include/CleaningEngine.h"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    FileEntry makeEntry(uint64_t inode, uint64_t size, uint64_t allocated, uint32_t links) {
+        FileEntry entry;
+        entry.device = 1;
+        entry.inode = inode;
+        entry.size = size;
+        entry.allocated = allocated;
+        entry.links = links;
+        return entry;
+    }
+}
+
+TEST_CASE("Space accounting", "[accounting]") {
+    SpaceAccounting accounting;
+
+    SECTION("Single-link files are credited immediately") {
+        accounting.record(makeEntry(1, 100, 4096, 1));
+        accounting.record(makeEntry(2, 5000, 8192, 1));
+        REQUIRE(accounting.getLogicalBytes() == 5100);
+        REQUIRE(accounting.getPhysicalBytes() == 12288);
+    }
+
+    SECTION("Hardlinks are counted once") {
+        for (int i = 0; i < 3; ++i) {
+            accounting.record(makeEntry(7, 1000, 4096, 3));
+        }
+        REQUIRE(accounting.getLogicalBytes() == 1000);
+        REQUIRE(accounting.getPhysicalBytes() == 4096);
+    }
+
+    SECTION("Space of partially removed link sets stays allocated") {
+        accounting.record(makeEntry(7, 1000, 4096, 3));
+        accounting.record(makeEntry(7, 1000, 4096, 3));
+        REQUIRE(accounting.getLogicalBytes() == 1000);
+        REQUIRE(accounting.getPhysicalBytes() == 0);
+    }
+
+    SECTION("Entries without inode numbers are not merged") {
+        accounting.record(makeEntry(0, 10, 10, 2));
+        accounting.record(makeEntry(0, 10, 10, 2));
+        REQUIRE(accounting.getLogicalBytes() == 20);
+        REQUIRE(accounting.getPhysicalBytes() == 20);
+    }
+}
+
+TEST_CASE("Space accounting buckets share their link counts", "[accounting]") {
+    SpaceAccounting accounting(2);
+    accounting.record(makeEntry(7, 1000, 4096, 2), 0);
+    accounting.record(makeEntry(7, 1000, 4096, 2), 1);
+    accounting.record(makeEntry(8, 10, 4096, 1), 1);
+
+    // The first link is credited with the size, the last with the blocks
+    REQUIRE(accounting.getLogicalBytes(0) == 1000);
+    REQUIRE(accounting.getPhysicalBytes(0) == 0);
+    REQUIRE(accounting.getLogicalBytes(1) == 10);
+    REQUIRE(accounting.getPhysicalBytes(1) == 8192);
+}
+
+#ifndef _WIN32
+TEST_CASE("Engine reports logical and physical space", "[accounting]") {
+    auto root = std::filesystem::temp_directory_path() / "cookiemonster_accounting_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "links");
+    {
+        std::ofstream file(root / "original.bin", std::ios::binary);
+        file << std::string(10000, 'x');
+    }
+    for (int i = 0; i < 4; ++i) {
+        std::filesystem::create_hard_link(root / "original.bin", root / "links" / ("link" + std::to_string(i)));
+    }
+    std::ofstream(root / "sparse.bin", std::ios::binary).close();
+    std::filesystem::resize_file(root / "sparse.bin", 64 * 1024 * 1024);
+
+    FileEntry original;
+    REQUIRE(statFileEntry(root / "original.bin", original));
+    REQUIRE(original.links == 5);
+    REQUIRE(original.allocated >= 10000);
+    FileEntry sparse;
+    REQUIRE(statFileEntry(root / "sparse.bin", sparse));
+    REQUIRE(sparse.allocated < sparse.size);
+
+    CleaningEngine engine;
+    auto result = engine.run({root}, true, [](const FileEntry&) { return true; });
+    REQUIRE(result.filesDeleted == 6);
+    REQUIRE(result.bytesFreed == 10000 + 64 * 1024 * 1024);
+    REQUIRE(result.physicalBytesFreed == original.allocated + sparse.allocated);
+
+    SECTION("Links left outside the cleaned tree keep the space allocated") {
+        auto partial = engine.run({root / "links"}, true, [](const FileEntry&) { return true; });
+        REQUIRE(partial.bytesFreed == 10000);
+        REQUIRE(partial.physicalBytesFreed == 0);
+    }
+
+    SECTION("Links in different root sets are counted once for the pass") {
+        std::filesystem::create_directory(root / "more");
+        std::filesystem::rename(root / "original.bin", root / "more" / "original.bin");
+        auto results = engine.runSets({{root / "links"}, {root / "more"}}, true,
+                                      [](const FileEntry&) { return true; });
+        REQUIRE(results.size() == 2);
+        REQUIRE(results[0].filesDeleted + results[1].filesDeleted == 5);
+        REQUIRE(results[0].bytesFreed + results[1].bytesFreed == 10000);
+        REQUIRE(results[0].physicalBytesFreed + results[1].physicalBytesFreed == original.allocated);
+    }
+
+    std::filesystem::remove_all(root);
+}
+#endif
@@ -0,0 +1,56 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/TextUtil.h"
+#include <cstdint>
+#include <string>
+
+TEST_CASE("Trimming", "[text]") {
+    REQUIRE(trim("  key = value\r\n") == "key = value");
+    REQUIRE(trim("\t\t") == "");
+    REQUIRE(trim("") == "");
+}
+
+TEST_CASE("Number parsing", "[text]") {
+    uint64_t value = 0;
+
+    SECTION("Sizes take a K, M or G suffix") {
+        REQUIRE(parseSize("512", value));
+        REQUIRE(value == 512);
+        REQUIRE(parseSize("10k", value));
+        REQUIRE(value == 10 * 1024);
+        REQUIRE(parseSize("3M", value));
+        REQUIRE(value == 3 * 1024 * 1024);
+        REQUIRE(parseSize("16777215G", value));
+        REQUIRE(value == (UINT64_C(16777215) << 30));
+    }
+
+    SECTION("Sizes reject signs, whitespace and overflow") {
+        REQUIRE_FALSE(parseSize("", value));
+        REQUIRE_FALSE(parseSize("-1", value));
+        REQUIRE_FALSE(parseSize("+1", value));
+        REQUIRE_FALSE(parseSize(" 5", value));
+        REQUIRE_FALSE(parseSize("5 ", value));
+        REQUIRE_FALSE(parseSize("5KB", value));
+        REQUIRE_FALSE(parseSize("5T", value));
+        REQUIRE_FALSE(parseSize("17179869184G", value));
+        REQUIRE_FALSE(parseSize("18446744073709551616", value));
+    }
+
+    SECTION("Counts are digits only") {
+        REQUIRE(parseCount("0", value));
+        REQUIRE(value == 0);
+        REQUIRE(parseCount("18446744073709551615", value));
+        REQUIRE(value == UINT64_MAX);
+        REQUIRE_FALSE(parseCount("18446744073709551616", value));
+        REQUIRE_FALSE(parseCount("1K", value));
+        REQUIRE_FALSE(parseCount("-1", value));
+        REQUIRE_FALSE(parseCount("", value));
+    }
+}
+
+TEST_CASE("JSON escaping", "[text]") {
+    REQUIRE(escapeJson("plain") == "plain");
+    REQUIRE(escapeJson("a\"b\\c") == "a\\\"b\\\\c");
+    REQUIRE(escapeJson("line\nnext\ttab") == "line\\nnext\\ttab");
+    REQUIRE(escapeJson(std::string("\x01", 1)) == "\\u0001");
+    REQUIRE(escapeJson("caf\xc3\xa9") == "caf\xc3\xa9");
+}
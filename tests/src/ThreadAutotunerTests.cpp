@@ -0,0 +1,42 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/ThreadAutotuner.h"
+#include <algorithm>
+
+namespace {
+    // Simulated device whose throughput peaks at six workers
+    double simulatedThroughput(size_t threads) {
+        double n = static_cast<double>(threads);
+        return n <= 6 ? n * 100.0 : 600.0 - (n - 6) * 50.0;
+    }
+}
+
+TEST_CASE("Autotuner bounds", "[autotune]") {
+    ThreadAutotuner tuner(100, 2, 8);
+    REQUIRE(tuner.getThreads() == 8);
+
+    ThreadAutotuner low(0, 0, 4);
+    REQUIRE(low.getThreads() == 1);
+}
+
+TEST_CASE("Autotuner converges on the throughput peak", "[autotune]") {
+    ThreadAutotuner tuner(1, 1, 32);
+    size_t maxSeen = 0;
+    for (int i = 0; i < 60; ++i) {
+        tuner.update(simulatedThroughput(tuner.getThreads()), 0.001);
+        if (i >= 30) maxSeen = std::max(maxSeen, tuner.getThreads());
+    }
+    REQUIRE(tuner.getThreads() >= 5);
+    REQUIRE(tuner.getThreads() <= 7);
+    REQUIRE(maxSeen <= 8);
+}
+
+TEST_CASE("Autotuner backs off on latency", "[autotune]") {
+    ThreadAutotuner tuner(8, 1, 16);
+    tuner.update(800.0, 0.001);
+    size_t before = tuner.getThreads();
+
+    TuningDecision decision = tuner.update(800.0, 0.010);
+    REQUIRE(decision.previousThreads == before);
+    REQUIRE(decision.threads == before / 2);
+    REQUIRE(std::string(decision.reason) == "latency rise");
+}
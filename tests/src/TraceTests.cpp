@@ -0,0 +1,90 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/Cleaner.h"
+#include "../../src/include/FileSystemBackend.h"
+#include "../../src/include/Trace.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+    size_t countOf(const std::string& text, const std::string& needle) {
+        size_t count = 0;
+        for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) {
+            count++;
+        }
+        return count;
+    }
+}
+
+TEST_CASE("Trace spans", "[trace]") {
+    Tracer& tracer = Tracer::getInstance();
+    tracer.reset();
+    tracer.setEnabled(false);
+    { TraceScope span("ignored"); }
+    REQUIRE(tracer.getEventCount() == 0);
+
+    tracer.setEnabled(true);
+
+    SECTION("Spans nest and carry arguments") {
+        {
+            TraceScope outer("outer");
+            TraceScope inner(std::string("inner \"quoted\""), "engine");
+            inner.setArgument("files", 42);
+        }
+        REQUIRE(tracer.getEventCount() == 2);
+        std::string json = tracer.toJson();
+        REQUIRE(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+        REQUIRE(json.find("\"name\":\"outer\",\"cat\":\"cleaner\",\"ph\":\"X\"") != std::string::npos);
+        REQUIRE(json.find("\"name\":\"inner \\\"quoted\\\"\",\"cat\":\"engine\"") != std::string::npos);
+        REQUIRE(json.find("\"args\":{\"files\":42}") != std::string::npos);
+        // Ordered by start time: the outer span opened first
+        REQUIRE(json.find("\"outer\"") < json.find("\"inner"));
+    }
+
+    SECTION("Every thread records into its own buffer") {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([] {
+                for (int i = 0; i < 100; ++i) {
+                    TraceScope span("work");
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        REQUIRE(tracer.getEventCount() == 400);
+        std::string json = tracer.toJson();
+        REQUIRE(countOf(json, "\"name\":\"work\"") == 400);
+        REQUIRE(countOf(json, "\"thread_name\"") >= 4);
+
+        auto path = std::filesystem::temp_directory_path() / "cookiemonster_trace_test.json";
+        REQUIRE(tracer.write(path.string()));
+        std::ifstream in(path);
+        std::stringstream written;
+        written << in.rdbuf();
+        REQUIRE(written.str() == json);
+        std::filesystem::remove(path);
+
+        // The finished threads' buffers go with their spans
+        tracer.reset();
+        REQUIRE(countOf(tracer.toJson(), "\"thread_name\"") <= 1);
+    }
+
+    SECTION("Cleaners and engine batches are traced") {
+        Cleaner cleaner;
+        auto fs = std::make_shared<MemoryFileSystem>();
+        for (const auto& dir : cleaner.getTempDirectories()) {
+            fs->addTree(dir, 2, 5, 10);
+        }
+        cleaner.setFileSystem(fs);
+        REQUIRE(cleaner.cleanTempFiles(false));
+        std::string json = tracer.toJson();
+        REQUIRE(countOf(json, "\"name\":\"cleanTempFiles\"") == 1);
+        REQUIRE(countOf(json, "\"name\":\"scan\"") == 1);
+        REQUIRE(countOf(json, "\"name\":\"batch\"") >= 1);
+        REQUIRE(json.find("\"cat\":\"logging\"") != std::string::npos);
+    }
+
+    tracer.setEnabled(false);
+    tracer.reset();
+}
@@ -0,0 +1,117 @@
+#include <catch2/catch_all.hpp>
+#include "../../src/include/TrashBin.h"
+#include "../../src/include/Cleaner.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    void trashFile(const std::filesystem::path& trash, const std::string& name, const std::string& date,
+                   size_t bytes) {
+        std::ofstream(trash / "files" / name, std::ios::binary) << std::string(bytes, 'x');
+        std::ofstream(trash / "info" / (name + ".trashinfo"))
+            << "[Trash Info]\nPath=/home/user/" << name << "\nDeletionDate=" << date << "\n";
+    }
+
+    std::filesystem::path makeTrash() {
+        auto trash = std::filesystem::temp_directory_path() / "cookiemonster_trash_test";
+        std::filesystem::remove_all(trash);
+        std::filesystem::create_directories(trash / "files");
+        std::filesystem::create_directories(trash / "info");
+
+        trashFile(trash, "old.txt", "2020-01-01T10:00:00", 1000);
+        trashFile(trash, "recent.txt", "2099-01-01T10:00:00", 300);
+
+        // A trashed directory whose contents count towards its size
+        std::filesystem::create_directories(trash / "files" / "project" / "src");
+        std::ofstream(trash / "files" / "project" / "a.c") << std::string(200, 'a');
+        std::ofstream(trash / "files" / "project" / "src" / "b.c") << std::string(400, 'b');
+        std::ofstream(trash / "info" / "project.trashinfo")
+            << "[Trash Info]\nPath=/home/user/my%20project\nDeletionDate=2021-06-01T08:30:00\n";
+        std::ofstream(trash / "directorysizes") << "600 1622530200 project\n";
+
+        // Leftovers without a partner are not items
+        std::ofstream(trash / "files" / "orphan.bin") << "x";
+        std::ofstream(trash / "info" / "gone.txt.trashinfo") << "[Trash Info]\nPath=/gone.txt\n";
+        return trash;
+    }
+}
+
+TEST_CASE("Trash info parsing", "[trash]") {
+    std::string path;
+    std::time_t time = 0;
+    REQUIRE(parseTrashInfo("[Trash Info]\r\nPath=/tmp/a%20b%2Fc\r\nDeletionDate=2004-08-31T22:32:08\r\n", path, time));
+    REQUIRE(path == "/tmp/a b/c");
+    REQUIRE(time != 0);
+
+    REQUIRE_FALSE(parseTrashInfo("[Other]\nPath=/x\n", path, time));
+    REQUIRE_FALSE(parseTrashInfo("[Trash Info]\nDeletionDate=2004-08-31T22:32:08\n", path, time));
+}
+
+TEST_CASE("Trash directory loading and selection", "[trash]") {
+    auto trash = makeTrash();
+    std::vector<TrashItem> items;
+    REQUIRE(TrashBin(trash).load(items));
+    REQUIRE(items.size() == 3);
+
+    auto project = std::find_if(items.begin(), items.end(),
+        [](const TrashItem& item) { return item.file.filename() == "project"; });
+    REQUIRE(project != items.end());
+    REQUIRE(project->originalPath == "/home/user/my project");
+    REQUIRE(project->size >= 600);
+
+    std::time_t now = std::time(nullptr);
+
+    SECTION("Everything without limits") {
+        REQUIRE(selectTrashItems(items, TrashPurgePolicy(), now).size() == 3);
+    }
+
+    SECTION("Age limit") {
+        TrashPurgePolicy policy;
+        policy.maxAgeDays = 30;
+        auto selected = selectTrashItems(items, policy, now);
+        REQUIRE(selected.size() == 2);
+        REQUIRE(selected[0].file.filename() == "old.txt");
+        REQUIRE(selected[1].file.filename() == "project");
+    }
+
+    SECTION("Size budget evicts the oldest items first") {
+        TrashPurgePolicy policy;
+        policy.maxBytes = project->size + 300;
+        auto selected = selectTrashItems(items, policy, now);
+        REQUIRE(selected.size() == 1);
+        REQUIRE(selected[0].file.filename() == "old.txt");
+    }
+
+    std::filesystem::remove_all(trash);
+}
+
+TEST_CASE("Recycle bin cleaning purges trash items", "[trash]") {
+    auto trash = makeTrash();
+    Cleaner cleaner;
+    cleaner.setTrashDirectories({trash.wstring()});
+    cleaner.setTrashPolicy(30, 0);
+
+    SECTION("Dry run leaves the trash alone") {
+        REQUIRE(cleaner.cleanRecycleBin(true));
+        REQUIRE(std::filesystem::exists(trash / "files" / "old.txt"));
+        REQUIRE(std::filesystem::exists(trash / "files" / "project"));
+    }
+
+    SECTION("Old items and their info files are purged") {
+        REQUIRE(cleaner.cleanRecycleBin(false));
+        REQUIRE_FALSE(std::filesystem::exists(trash / "files" / "old.txt"));
+        REQUIRE_FALSE(std::filesystem::exists(trash / "info" / "old.txt.trashinfo"));
+        REQUIRE_FALSE(std::filesystem::exists(trash / "files" / "project"));
+        REQUIRE_FALSE(std::filesystem::exists(trash / "info" / "project.trashinfo"));
+        REQUIRE(std::filesystem::exists(trash / "files" / "recent.txt"));
+        REQUIRE(std::filesystem::exists(trash / "files" / "orphan.bin"));
+
+        std::ifstream sizes(trash / "directorysizes");
+        std::string contents((std::istreambuf_iterator<char>(sizes)), std::istreambuf_iterator<char>());
+        REQUIRE(contents.empty());
+    }
+
+    std::filesystem::remove_all(trash);
+}